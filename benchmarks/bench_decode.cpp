@@ -0,0 +1,82 @@
+#include "cpu.h"
+#include "decoder.h"
+#include "instruction_table.h"
+#include "text_image.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+// Decode throughput of the table-driven predecoder and of the bulk text
+// image builders, over a stream of valid encodings drawn uniformly from
+// the instruction table.
+
+static std::vector<uint32_t> make_stream(size_t count) {
+    std::mt19937 rng(12345);
+    std::vector<uint32_t> stream(count);
+    for (uint32_t& raw : stream) {
+        const InstructionDesc& desc = INSTRUCTION_TABLE[rng() % INSTRUCTION_TABLE_SIZE];
+        raw = (rng() & ~desc.mask) | desc.match;
+    }
+    return stream;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? std::stoull(argv[1]) : 50;
+    std::vector<uint32_t> stream = make_stream(1 << 20);
+
+    std::cout << "=== Decode Throughput Benchmark ===" << std::endl;
+    std::cout << "Stream: " << stream.size() << " encodings x " << rounds << " rounds" << std::endl;
+
+    // Fold results into a checksum so nothing is optimised away
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (uint32_t raw : stream) {
+            DecodedInstruction decoded = Decoder::predecode(raw);
+            checksum += static_cast<uint8_t>(decoded.op) + decoded.imm + decoded.rd;
+        }
+    }
+    auto mid = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; round++) {
+        for (uint32_t raw : stream) {
+            Instruction inst = Decoder::decode(raw);
+            checksum += static_cast<uint8_t>(Decoder::get_operation(inst)) + inst.imm;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double total = static_cast<double>(stream.size()) * rounds;
+    double predecode_s = std::chrono::duration<double>(mid - start).count();
+    double decode_s = std::chrono::duration<double>(end - mid).count();
+
+    std::cout << "\n" << std::left << std::setw(28) << "Path" << "M decodes/s" << std::endl;
+    std::cout << std::string(40, '-') << std::endl;
+    std::cout << std::left << std::setw(28) << "predecode"
+              << std::fixed << std::setprecision(1) << total / predecode_s / 1e6 << std::endl;
+    std::cout << std::left << std::setw(28) << "decode + get_operation"
+              << total / decode_s / 1e6 << std::endl;
+
+    // Bulk decode into a structure-of-arrays text image, per SIMD path
+    const TextImage::Path paths[] = {TextImage::Path::SCALAR, TextImage::Path::SSE2, TextImage::Path::AVX2};
+    for (TextImage::Path path : paths) {
+        if (path == TextImage::Path::AVX2 && TextImage::best_path() != TextImage::Path::AVX2) {
+            continue;
+        }
+        auto image_start = std::chrono::steady_clock::now();
+        for (size_t round = 0; round < rounds; round++) {
+            TextImage image(0x1000, stream.data(), stream.size(), path);
+            checksum += image.get_imm()[round % stream.size()];
+        }
+        auto image_end = std::chrono::steady_clock::now();
+        double image_s = std::chrono::duration<double>(image_end - image_start).count();
+        std::string name = std::string("text image (") + TextImage::path_name(path) + ")";
+        std::cout << std::left << std::setw(28) << name << total / image_s / 1e6 << std::endl;
+    }
+
+    std::cout << "\n(checksum " << checksum << ")" << std::endl;
+
+    return 0;
+}
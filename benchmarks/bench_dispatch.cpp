@@ -0,0 +1,94 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+// Guest MIPS of the switch dispatcher against the threaded dispatcher on
+// a loop mixing ALU ops, loads/stores and branches, with paged memory
+// (checked TLB accesses) and the host-MMU backend (unchecked accesses).
+
+static const std::vector<uint32_t> kLoopProgram = {
+    0x00010537,  // LUI  a0, 0x10           # buffer at 0x10000
+    0x00000593,  // ADDI a1, zero, 0        # i = 0
+    0x00000613,  // ADDI a2, zero, 0        # acc = 0
+    0x0FF5F693,  // loop: ANDI a3, a1, 255
+    0x00269713,  // SLLI a4, a3, 2
+    0x00A70733,  // ADD  a4, a4, a0
+    0x00072783,  // LW   a5, 0(a4)
+    0x00B787B3,  // ADD  a5, a5, a1
+    0x00F72023,  // SW   a5, 0(a4)
+    0x00F64633,  // XOR  a2, a2, a5
+    0x00F63833,  // SLTU a6, a2, a5
+    0x01060633,  // ADD  a2, a2, a6
+    0x00158593,  // ADDI a1, a1, 1
+    0xFC05CCE3,  // BLT  a1, zero, loop
+    0xFD5FF06F   // JAL  zero, loop
+};
+
+static double run_mips(DispatchMode mode, bool profiling, MemoryBackend backend,
+                       uint64_t instructions) {
+    std::vector<uint8_t> program_bytes;
+    for (uint32_t inst : kLoopProgram) {
+        program_bytes.push_back(inst & 0xFF);
+        program_bytes.push_back((inst >> 8) & 0xFF);
+        program_bytes.push_back((inst >> 16) & 0xFF);
+        program_bytes.push_back((inst >> 24) & 0xFF);
+    }
+
+    MemoryConfig config;
+    config.backend = backend;
+    CPU cpu(config);
+    Interpreter interp(cpu);
+    cpu.load_program(program_bytes, 0x1000);
+    cpu.commit_memory(0x10000, 1024);
+    interp.set_dispatch_mode(mode);
+    if (!profiling) {
+        interp.get_profiler().disable_profiling();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    interp.run(instructions);
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    return interp.get_instructions_executed() / seconds / 1e6;
+}
+
+int main(int argc, char** argv) {
+    uint64_t instructions = argc > 1 ? std::stoull(argv[1]) : 50000000;
+
+    std::cout << "=== Interpreter Dispatch Benchmark ===" << std::endl;
+    std::cout << "Guest instructions per run: " << instructions << std::endl;
+    if (!Interpreter::threaded_dispatch_available()) {
+        std::cout << "(threaded dispatch unavailable, THREADED runs use SWITCH)" << std::endl;
+    }
+
+    struct Row { const char* name; DispatchMode mode; bool profiling; MemoryBackend backend; };
+    const Row rows[] = {
+        {"switch",             DispatchMode::SWITCH,   false, MemoryBackend::PAGED},
+        {"threaded",           DispatchMode::THREADED, false, MemoryBackend::PAGED},
+        {"switch + profile",   DispatchMode::SWITCH,   true,  MemoryBackend::PAGED},
+        {"threaded + profile", DispatchMode::THREADED, true,  MemoryBackend::PAGED},
+        {"switch + host MMU",  DispatchMode::SWITCH,   false, MemoryBackend::HOST_MMU},
+        {"threaded + host MMU", DispatchMode::THREADED, false, MemoryBackend::HOST_MMU},
+    };
+    const size_t row_count = sizeof(rows) / sizeof(rows[0]);
+
+    double results[row_count];
+    for (size_t i = 0; i < row_count; i++) {
+        results[i] = run_mips(rows[i].mode, rows[i].profiling, rows[i].backend, instructions);
+    }
+
+    std::cout << "\n" << std::left << std::setw(22) << "Mode" << "Guest MIPS" << std::endl;
+    std::cout << std::string(34, '-') << std::endl;
+    for (size_t i = 0; i < row_count; i++) {
+        std::cout << std::left << std::setw(22) << rows[i].name
+                  << std::fixed << std::setprecision(1) << results[i] << std::endl;
+    }
+    std::cout << "\nThreaded speedup (no profiling): " << std::setprecision(2)
+              << results[1] / results[0] << "x" << std::endl;
+
+    return 0;
+}
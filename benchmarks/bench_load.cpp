@@ -0,0 +1,96 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "elf_loader.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+// Startup cost of ELF images of growing size whose program touches only
+// a few pages: segments mapped copy-on-write from the file against
+// segments copied into guest memory. Mapped startup should stay flat.
+
+static const std::vector<uint32_t> kProgram = {
+    0x000102B7,  // LUI  t0, 0x10           # image base
+    0x1002A503,  // LW   a0, 256(t0)
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit(a0)
+};
+
+static void put32(std::vector<uint8_t>& out, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+// One R+W+X PT_LOAD segment at 0x10000 holding the program and filler,
+// followed by as much BSS again
+static void write_elf(const std::string& path, size_t segment_bytes) {
+    const uint32_t offset = 0x1000, vaddr = 0x10000;
+    std::vector<uint8_t> file(offset + segment_bytes);
+    for (size_t i = offset; i < file.size(); i++) {
+        file[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::copy(ident, ident + 16, file.begin());
+    file[16] = 2;                   // ET_EXEC
+    file[18] = 0xF3;                // EM_RISCV
+    put32(file, 20, 1);
+    put32(file, 24, vaddr);         // e_entry
+    put32(file, 28, 52);            // e_phoff
+    file[40] = 52;
+    file[42] = 32;
+    file[44] = 1;                   // e_phnum
+    const uint32_t phdr[8] = {1, offset, vaddr, vaddr, static_cast<uint32_t>(segment_bytes),
+                              static_cast<uint32_t>(2 * segment_bytes), 7, 0x1000};
+    for (int f = 0; f < 8; f++) {
+        put32(file, 52 + f * 4, phdr[f]);
+    }
+    for (size_t i = 0; i < kProgram.size(); i++) {
+        put32(file, offset + i * 4, kProgram[i]);
+    }
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+// Milliseconds per construct + load + run
+static double startup_ms(const std::string& path, bool map_segments, size_t rounds) {
+    LoadOptions options;
+    options.map_segments = map_segments;
+    std::streambuf* saved = std::cout.rdbuf(nullptr);  // Silence the loader
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < rounds; i++) {
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.get_profiler().disable_profiling();
+        ELFLoader::load(path, cpu, options);
+        interp.run();
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout.rdbuf(saved);
+    return std::chrono::duration<double, std::milli>(end - start).count() / rounds;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? std::stoul(argv[1]) : 10;
+    const std::string path = "bench_load.tmp.elf";
+
+    std::cout << "=== ELF Load Benchmark ===" << std::endl;
+    std::cout << "Rounds per size: " << rounds << " (paged memory, segment + equal BSS)" << std::endl;
+    std::cout << "\n" << std::left << std::setw(10) << "Segment" << std::setw(14) << "Copy (ms)"
+              << "Map (ms)" << std::endl;
+    std::cout << std::string(34, '-') << std::endl;
+
+    for (size_t mb : {1, 8, 16, 48}) {
+        write_elf(path, mb * 1024 * 1024);
+        double copy = startup_ms(path, false, rounds);
+        double map = startup_ms(path, true, rounds);
+        std::cout << std::left << std::setw(10) << (std::to_string(mb) + " MB") << std::fixed
+                  << std::setprecision(2) << std::setw(14) << copy << map << std::endl;
+    }
+
+    std::remove(path.c_str());
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+
+// Per-instance cost of guest memory: construction time and resident
+// set size with many CPU instances alive at once, before and after each
+// runs a tiny program (a stack frame plus one page of code).
+
+static const std::vector<uint32_t> kProgram = {
+    0xFF010113,  // ADDI sp, sp, -16
+    0x00000513,  // ADDI a0, zero, 0
+    0x06400593,  // ADDI a1, zero, 100
+    0x00B50533,  // loop: ADD a0, a0, a1
+    0xFFF58593,  // ADDI a1, a1, -1
+    0xFE059CE3,  // BNE  a1, zero, loop
+    0x00A12023,  // SW   a0, 0(sp)
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL
+};
+
+static size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total = 0, resident = 0;
+    statm >> total >> resident;
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+int main(int argc, char** argv) {
+    size_t instances = argc > 1 ? std::stoul(argv[1]) : 32;
+
+    std::vector<uint8_t> program_bytes;
+    for (uint32_t inst : kProgram) {
+        program_bytes.push_back(inst & 0xFF);
+        program_bytes.push_back((inst >> 8) & 0xFF);
+        program_bytes.push_back((inst >> 16) & 0xFF);
+        program_bytes.push_back((inst >> 24) & 0xFF);
+    }
+
+    std::cout << "=== Guest Memory Benchmark ===" << std::endl;
+    std::cout << "Instances: " << instances << std::endl;
+
+    std::vector<std::unique_ptr<CPU>> cpus;
+    size_t rss_start = resident_bytes();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < instances; i++) {
+        cpus.push_back(std::make_unique<CPU>());
+    }
+    auto end = std::chrono::steady_clock::now();
+    size_t rss_constructed = resident_bytes();
+
+    for (auto& cpu : cpus) {
+        Interpreter interp(*cpu);
+        interp.get_profiler().disable_profiling();
+        cpu->load_program(program_bytes, 0x1000);
+        cpu->set_register(2, cpu->get_stack_top());
+        interp.run(10000);
+    }
+    size_t rss_ran = resident_bytes();
+
+    double construct_us = std::chrono::duration<double, std::micro>(end - start).count() / instances;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Construction time per instance: " << construct_us << " us" << std::endl;
+    std::cout << "RSS per instance after construction: "
+              << (rss_constructed - rss_start) / 1024.0 / instances << " KB" << std::endl;
+    std::cout << "RSS per instance after running: "
+              << (rss_ran - rss_start) / 1024.0 / instances << " KB" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <time.h>
+
+// Cost of per-PC profiling: guest MIPS with profiling off, with the dense
+// text-range counters, with the hash fallback alone (no text range) and
+// sampling 1 in ~kSamplePeriod instructions, under block execution (run)
+// and single-stepping (step). The dense counters must stay within
+// kBudget of profiling off.
+
+static const double kBudget = 0.15;  // Max slowdown from dense counters, either mode
+static const uint32_t kSamplePeriod = 1000;
+
+static const std::vector<uint32_t> kLoopProgram = {
+    0x00010537,  // LUI  a0, 0x10           # buffer at 0x10000
+    0x00000593,  // ADDI a1, zero, 0        # i = 0
+    0x00000613,  // ADDI a2, zero, 0        # acc = 0
+    0x0FF5F693,  // loop: ANDI a3, a1, 255
+    0x00269713,  // SLLI a4, a3, 2
+    0x00A70733,  // ADD  a4, a4, a0
+    0x00072783,  // LW   a5, 0(a4)
+    0x00B787B3,  // ADD  a5, a5, a1
+    0x00F72023,  // SW   a5, 0(a4)
+    0x00F64633,  // XOR  a2, a2, a5
+    0x00F63833,  // SLTU a6, a2, a5
+    0x01060633,  // ADD  a2, a2, a6
+    0x00158593,  // ADDI a1, a1, 1
+    0x0015F293,  // ANDI t0, a1, 1
+    0x00028463,  // BEQ  t0, zero, even
+    0x00160613,  // ADDI a2, a2, 1
+    0xFC05C8E3,  // even: BLT a1, zero, loop
+    0xFC9FF06F   // JAL  zero, loop
+};
+
+enum class Counters { OFF, DENSE, FALLBACK, SAMPLED };
+
+static double run_mips(Counters counters, bool single_step, uint64_t instructions) {
+    std::vector<uint8_t> program_bytes;
+    for (uint32_t inst : kLoopProgram) {
+        for (int i = 0; i < 4; i++) {
+            program_bytes.push_back((inst >> (8 * i)) & 0xFF);
+        }
+    }
+
+    CPU cpu;
+    Interpreter interp(cpu);
+    cpu.load_program(program_bytes, 0x1000);
+    cpu.commit_memory(0x10000, 1024);
+    if (counters == Counters::OFF) {
+        interp.get_profiler().disable_profiling();
+    } else if (counters == Counters::FALLBACK) {
+        cpu.set_text_range(0, 0);
+    } else if (counters == Counters::SAMPLED) {
+        interp.get_profiler().set_sampling(kSamplePeriod);
+    }
+
+    timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    if (single_step) {
+        for (uint64_t i = 0; i < instructions; i++) {
+            interp.step();
+        }
+    } else {
+        interp.run(instructions);
+    }
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return interp.get_instructions_executed() / seconds / 1e6;
+}
+
+// Best of several rounds for each setting, interleaved so that all of
+// them see the same host conditions
+static void best_mips(bool single_step, uint64_t instructions, double mips[4]) {
+    const Counters settings[4] = {Counters::OFF, Counters::DENSE, Counters::FALLBACK, Counters::SAMPLED};
+    for (int i = 0; i < 4; i++) {
+        mips[i] = 0;
+    }
+    for (int round = 0; round < 15; round++) {
+        for (int i = 0; i < 4; i++) {
+            mips[i] = std::max(mips[i], run_mips(settings[i], single_step, instructions));
+        }
+    }
+}
+
+static std::string percent(double fraction) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << fraction * 100 << "%";
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    uint64_t instructions = argc > 1 ? std::stoull(argv[1]) : 10000000;
+
+    std::cout << "=== Profiling Overhead Benchmark ===" << std::endl;
+    std::cout << "Guest instructions per run: " << instructions << " (step: " << instructions / 10 << ")"
+              << std::endl;
+    std::cout << "Sampling: 1 in ~" << kSamplePeriod << " instructions" << std::endl;
+    std::cout << "\n" << std::left << std::setw(8) << "Mode" << std::setw(10) << "Off" << std::setw(10) << "Dense"
+              << std::setw(12) << "Fallback" << std::setw(10) << "Sampled" << std::setw(14) << "Dense cost"
+              << std::setw(16) << "Fallback cost" << "Sampled cost" << std::endl;
+    std::cout << std::string(92, '-') << std::endl;
+
+    bool within_budget = true;
+    for (bool single_step : {false, true}) {
+        uint64_t count = single_step ? instructions / 10 : instructions;
+        double mips[4];
+        best_mips(single_step, count, mips);
+        double off = mips[0], dense = mips[1], fallback = mips[2], sampled = mips[3];
+        double dense_cost = off / dense - 1;
+        within_budget &= dense_cost <= kBudget;
+        std::cout << std::left << std::setw(8) << (single_step ? "step" : "run") << std::fixed
+                  << std::setprecision(1) << std::setw(10) << off << std::setw(10) << dense << std::setw(12)
+                  << fallback << std::setw(10) << sampled << std::setw(14) << percent(dense_cost)
+                  << std::setw(16) << percent(off / fallback - 1) << percent(off / sampled - 1) << std::endl;
+    }
+
+    std::cout << "\nBudget: dense counters within " << kBudget * 100 << "% of profiling off: "
+              << (within_budget ? "met" : "EXCEEDED") << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Cost of resetting a loaded guest between runs: rebuilding the CPU and
+// reloading its image each time, against restoring a snapshot, which
+// only copies back the pages a run dirtied. The image carries a large
+// data segment so reload cost grows with it while restore cost does not.
+
+static const std::vector<uint32_t> kProgram = {
+    0x000032B7,  // LUI  t0, 0x3            # input at 0x3000
+    0x0002A503,  // LW   a0, 0(t0)
+    0x00150513,  // ADDI a0, a0, 1
+    0x00A2A223,  // SW   a0, 4(t0)
+    0xFF010113,  // ADDI sp, sp, -16
+    0x00A12023,  // SW   a0, 0(sp)
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit(a0)
+};
+
+static const uint32_t kDataBase = 0x00100000;
+
+struct Image {
+    std::vector<uint8_t> program;
+    std::vector<uint8_t> data;
+};
+
+static void load_image(CPU& cpu, const Image& image) {
+    cpu.load_program(image.data, kDataBase);
+    cpu.load_program(image.program, 0x1000);
+    cpu.set_register(2, cpu.get_stack_top());
+}
+
+// Microseconds per reset + run
+static double reload_us(const Image& image, MemoryBackend backend, size_t runs) {
+    MemoryConfig config;
+    config.backend = backend;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        CPU cpu(config);
+        Interpreter interp(cpu);
+        interp.get_profiler().disable_profiling();
+        load_image(cpu, image);
+        cpu.write_word(0x3000, static_cast<uint32_t>(i));
+        interp.run();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / runs;
+}
+
+static double restore_us(const Image& image, MemoryBackend backend, size_t runs, size_t& dirty) {
+    MemoryConfig config;
+    config.backend = backend;
+    CPU cpu(config);
+    Interpreter interp(cpu);
+    interp.get_profiler().disable_profiling();
+    load_image(cpu, image);
+    interp.take_snapshot();
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < runs; i++) {
+        interp.restore_snapshot();
+        cpu.write_word(0x3000, static_cast<uint32_t>(i));
+        interp.run();
+        dirty = cpu.get_memory().get_dirty_pages().size();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / runs;
+}
+
+int main(int argc, char** argv) {
+    size_t runs = argc > 1 ? std::stoul(argv[1]) : 200;
+    size_t data_mb = argc > 2 ? std::stoul(argv[2]) : 16;
+
+    Image image;
+    for (uint32_t inst : kProgram) {
+        image.program.push_back(inst & 0xFF);
+        image.program.push_back((inst >> 8) & 0xFF);
+        image.program.push_back((inst >> 16) & 0xFF);
+        image.program.push_back((inst >> 24) & 0xFF);
+    }
+    image.data.resize(data_mb * 1024 * 1024);
+    for (size_t i = 0; i < image.data.size(); i++) {
+        image.data[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    std::cout << "=== Snapshot Restore Benchmark ===" << std::endl;
+    std::cout << "Runs: " << runs << ", data segment: " << data_mb << " MB" << std::endl;
+
+    struct Row { const char* name; MemoryBackend backend; };
+    const Row rows[] = {
+        {"paged",    MemoryBackend::PAGED},
+        {"host MMU", MemoryBackend::HOST_MMU},
+    };
+
+    std::cout << "\n" << std::left << std::setw(12) << "Backend" << std::setw(16) << "Reload (us)"
+              << std::setw(16) << "Restore (us)" << "Dirty pages" << std::endl;
+    std::cout << std::string(56, '-') << std::endl;
+    for (const Row& row : rows) {
+        size_t dirty = 0;
+        double reload = reload_us(image, row.backend, runs);
+        double restore = restore_us(image, row.backend, runs, dirty);
+        std::cout << std::left << std::setw(12) << row.name << std::fixed << std::setprecision(1)
+                  << std::setw(16) << reload << std::setw(16) << restore << dirty << std::endl;
+    }
+
+    return 0;
+}
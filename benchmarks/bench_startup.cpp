@@ -0,0 +1,133 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "elf_loader.h"
+#include "image_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Startup cost of a predecoded load (load + bulk decode + run a few
+// instructions) without the image cache, on a cold cache (which also
+// writes the entry) and on a warm one, for growing text sizes.
+
+static const std::vector<uint32_t> kProgram = {
+    0x00700513,  // ADDI a0, zero, 7
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit(a0)
+};
+
+// A mix of common encodings to fill the text segment with
+static const uint32_t kFiller[] = {
+    0x00A50533,  // ADD  a0, a0, a0
+    0x0042A503,  // LW   a0, 4(t0)
+    0xFF010113,  // ADDI sp, sp, -16
+    0x00B50463,  // BEQ  a0, a1, +8
+    0x00A2A223,  // SW   a0, 4(t0)
+    0x000102B7,  // LUI  t0, 0x10
+    0x40B50533,  // SUB  a0, a0, a1
+    0x0080006F,  // JAL  zero, +8
+};
+
+static void put32(std::vector<uint8_t>& out, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+// R+X text segment of text_bytes at 0x10000 and a 1 MB R+W data segment
+static void write_elf(const std::string& path, size_t text_bytes) {
+    const uint32_t text_offset = 0x1000, text_addr = 0x10000;
+    const uint32_t data_offset = text_offset + static_cast<uint32_t>(text_bytes);
+    const uint32_t data_addr = text_addr + static_cast<uint32_t>(text_bytes) + 0x100000;
+    const uint32_t data_size = 0x100000;
+    std::vector<uint8_t> file(data_offset + data_size);
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::copy(ident, ident + 16, file.begin());
+    file[16] = 2;                   // ET_EXEC
+    file[18] = 0xF3;                // EM_RISCV
+    put32(file, 20, 1);
+    put32(file, 24, text_addr);     // e_entry
+    put32(file, 28, 52);            // e_phoff
+    file[40] = 52;
+    file[42] = 32;
+    file[44] = 2;                   // e_phnum
+    const uint32_t phdrs[2][8] = {
+        {1, text_offset, text_addr, text_addr, static_cast<uint32_t>(text_bytes),
+         static_cast<uint32_t>(text_bytes), 5, 0x1000},
+        {1, data_offset, data_addr, data_addr, data_size, data_size, 6, 0x1000},
+    };
+    for (int p = 0; p < 2; p++) {
+        for (int f = 0; f < 8; f++) {
+            put32(file, 52 + p * 32 + f * 4, phdrs[p][f]);
+        }
+    }
+    for (size_t i = 0; i < text_bytes / 4; i++) {
+        uint32_t word = i < kProgram.size() ? kProgram[i] : kFiller[i % 8];
+        put32(file, text_offset + i * 4, word);
+    }
+    for (size_t i = data_offset; i < file.size(); i++) {
+        file[i] = static_cast<uint8_t>(i * 13 + 1);
+    }
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+// Milliseconds per startup; clear_cache drops the entry before each one
+static double startup_ms(const std::string& path, const std::string& cache_dir, bool clear_cache,
+                         const std::string& entry, size_t rounds) {
+    LoadOptions options;
+    options.predecode_text = true;
+    options.cache_dir = cache_dir;
+    std::streambuf* saved = std::cout.rdbuf(nullptr);  // Silence the loader
+    double total = 0;
+    for (size_t i = 0; i < rounds; i++) {
+        if (clear_cache) {
+            std::remove(entry.c_str());
+        }
+        auto start = std::chrono::steady_clock::now();
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.get_profiler().disable_profiling();
+        ELFLoader::load(path, cpu, options);
+        interp.run();
+        auto end = std::chrono::steady_clock::now();
+        total += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+    std::cout.rdbuf(saved);
+    return total / rounds;
+}
+
+int main(int argc, char** argv) {
+    size_t rounds = argc > 1 ? std::stoul(argv[1]) : 10;
+    const std::string path = "bench_startup.tmp.elf";
+    const std::string cache_dir = "bench_startup.tmp.d";
+
+    std::cout << "=== Startup Benchmark ===" << std::endl;
+    std::cout << "Rounds per size: " << rounds << " (predecoded text, 1 MB data segment)" << std::endl;
+    std::cout << "\n" << std::left << std::setw(10) << "Text" << std::setw(16) << "No cache (ms)"
+              << std::setw(14) << "Cold (ms)" << std::setw(14) << "Warm (ms)" << "Speedup" << std::endl;
+    std::cout << std::string(62, '-') << std::endl;
+
+    for (size_t mb : {1, 4, 16}) {
+        write_elf(path, mb * 1024 * 1024);
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::string entry = ImageCache::path_for(cache_dir, ImageCache::content_hash(bytes.data(), bytes.size()));
+
+        double uncached = startup_ms(path, "", false, entry, rounds);
+        double cold = startup_ms(path, cache_dir, true, entry, rounds);
+        double warm = startup_ms(path, cache_dir, false, entry, rounds);
+        std::cout << std::left << std::setw(10) << (std::to_string(mb) + " MB") << std::fixed
+                  << std::setprecision(2) << std::setw(16) << uncached << std::setw(14) << cold
+                  << std::setw(14) << warm << std::setprecision(1) << uncached / warm << "x" << std::endl;
+        std::remove(entry.c_str());
+    }
+
+    std::remove(path.c_str());
+    rmdir(cache_dir.c_str());
+    return 0;
+}
@@ -0,0 +1,160 @@
+#include "block_cache.h"
+#include "instruction_table.h"
+
+namespace {
+
+bool ends_block(Operation op) {
+    return operation_has(op, INST_ENDS_BLOCK);
+}
+
+Operation fused_addi_branch(Operation branch) {
+    switch (branch) {
+        case Operation::BEQ:  return Operation::ADDI_BEQ;
+        case Operation::BNE:  return Operation::ADDI_BNE;
+        case Operation::BLT:  return Operation::ADDI_BLT;
+        case Operation::BGE:  return Operation::ADDI_BGE;
+        case Operation::BLTU: return Operation::ADDI_BLTU;
+        case Operation::BGEU: return Operation::ADDI_BGEU;
+        default:              return Operation::NOT_DECODED;
+    }
+}
+
+} // namespace
+
+Operation unfused_operation(Operation op) {
+    switch (op) {
+        case Operation::LUI_ADDI:   return Operation::LUI;
+        case Operation::AUIPC_JALR: return Operation::AUIPC;
+        case Operation::ADDI_BEQ: case Operation::ADDI_BNE: case Operation::ADDI_BLT:
+        case Operation::ADDI_BGE: case Operation::ADDI_BLTU: case Operation::ADDI_BGEU:
+            return Operation::ADDI;
+        default:
+            return op;
+    }
+}
+
+BlockCache::BlockCache(CPU& cpu, DecodeCache& decode_cache)
+    : cpu(cpu), decode_cache(decode_cache), invalidations(0), fused_pairs(0), 
+      fusion_enabled(true) {
+    fast_lookup.fill(nullptr);
+    cpu.add_code_listener(this);
+}
+
+BlockCache::~BlockCache() {
+    cpu.remove_code_listener(this);
+}
+
+const BasicBlock& BlockCache::lookup_slow(uint32_t pc) {
+    // Nothing can still be executing a dropped block once we get here
+    retired.clear();
+    
+    auto& slot = blocks[pc];
+    if (!slot) {
+        slot = build(pc);
+        page_blocks[pc >> PAGE_SHIFT].push_back(pc);
+    }
+    fast_lookup[(pc >> 2) & (FAST_LOOKUP_SIZE - 1)] = slot.get();
+    return *slot;
+}
+
+std::unique_ptr<BasicBlock> BlockCache::build(uint32_t pc) {
+    auto block = std::make_unique<BasicBlock>();
+    block->start_pc = pc;
+    block->instruction_count = 0;
+    block->exit_kind = CallKind::NONE;
+    
+    uint32_t page = pc >> PAGE_SHIFT;
+    uint32_t current = pc;
+    
+    while (block->instruction_count < MAX_BLOCK_INSTRUCTIONS && (current >> PAGE_SHIFT) == page) {
+        DecodedInstruction inst = decode_cache.fetch(current);
+        if (inst.op == Operation::FETCH_FAULT && block->instruction_count > 0) {
+            // Unfetchable PC: fault when execution actually gets there
+            break;
+        }
+        
+        block->ops.push_back(inst);
+        block->instruction_count++;
+        current += 4;
+        
+        if (ends_block(inst.op)) {
+            block->exit_kind = call_kind(inst);
+            break;
+        }
+    }
+    
+    DecodedInstruction end{};
+    end.op = Operation::BLOCK_END;
+    block->ops.push_back(end);
+    
+    if (fusion_enabled) {
+        fuse(*block);
+    }
+    return block;
+}
+
+// Rewrite common pairs into superinstructions. The first slot of a pair
+// takes the fused operation; the second keeps its operands for the
+// handler and is skipped at run time.
+void BlockCache::fuse(BasicBlock& block) {
+    std::vector<DecodedInstruction>& ops = block.ops;
+    
+    for (size_t i = 0; i + 1 < block.instruction_count; i++) {
+        DecodedInstruction& first = ops[i];
+        const DecodedInstruction& second = ops[i + 1];
+        
+        if (first.op == Operation::LUI && second.op == Operation::ADDI &&
+            second.rd == first.rd && second.rs1 == first.rd) {
+            // LUI rd, hi; ADDI rd, rd, lo  =>  rd = hi + lo
+            first.op = Operation::LUI_ADDI;
+            first.imm = static_cast<int32_t>(static_cast<uint32_t>(first.imm) + 
+                                             static_cast<uint32_t>(second.imm));
+            fused_pairs++;
+            i++;
+        } else if (first.op == Operation::AUIPC && second.op == Operation::JALR &&
+                   first.rd != 0 && second.rs1 == first.rd) {
+            // AUIPC t, hi; JALR rd, lo(t). Not through x0: the JALR then
+            // reads zero rather than pc + hi.
+            first.op = Operation::AUIPC_JALR;
+            fused_pairs++;
+            i++;
+        } else if (first.op == Operation::ADDI && fused_addi_branch(second.op) != Operation::NOT_DECODED) {
+            // ADDI; Bcc  (loop counter update or bound materialisation)
+            first.op = fused_addi_branch(second.op);
+            fused_pairs++;
+            i++;
+        }
+    }
+}
+
+void BlockCache::invalidate_code_page(uint32_t page) {
+    auto it = page_blocks.find(page);
+    if (it == page_blocks.end()) {
+        return;
+    }
+    
+    for (uint32_t start : it->second) {
+        auto block_it = blocks.find(start);
+        if (block_it == blocks.end()) {
+            continue;
+        }
+        BasicBlock*& fast = fast_lookup[(start >> 2) & (FAST_LOOKUP_SIZE - 1)];
+        if (fast == block_it->second.get()) {
+            fast = nullptr;
+        }
+        retired.push_back(std::move(block_it->second));
+        blocks.erase(block_it);
+    }
+    page_blocks.erase(it);
+    invalidations++;
+}
+
+void BlockCache::clear() {
+    for (auto& [start, block] : blocks) {
+        retired.push_back(std::move(block));
+    }
+    blocks.clear();
+    page_blocks.clear();
+    fast_lookup.fill(nullptr);
+    invalidations++;
+}
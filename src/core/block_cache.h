@@ -0,0 +1,87 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "cpu.h"
+#include "decoder.h"
+#include "decode_cache.h"
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Straight-line run of predecoded instructions ending at a branch, JAL,
+// JALR, ECALL/EBREAK, an illegal instruction, a page boundary or the
+// length limit. ops holds one slot per guest instruction (fused pairs keep
+// both slots so slot index still maps to PC) plus a BLOCK_END sentinel.
+struct BasicBlock {
+    uint32_t start_pc;
+    uint32_t instruction_count;
+    CallKind exit_kind;  // Whether the terminator is a call or return
+    std::vector<DecodedInstruction> ops;
+    
+    uint32_t end_pc() const { return start_pc + instruction_count * 4; }
+};
+
+// Operation of the first instruction of a fused pair (the second keeps
+// its own slot); any other operation is returned unchanged
+Operation unfused_operation(Operation op);
+
+// Basic blocks keyed by start PC, built from the decode cache on demand.
+// Blocks never span a page, so a code write drops exactly the blocks of
+// that page. Dropped blocks stay alive until the next lookup because the
+// interpreter may still be executing one of them.
+class BlockCache : public CodeWriteListener {
+public:
+    static constexpr uint32_t MAX_BLOCK_INSTRUCTIONS = 64;
+    
+    BlockCache(CPU& cpu, DecodeCache& decode_cache);
+    ~BlockCache() override;
+    
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+    
+    // Return the block starting at pc, building it on a miss
+    const BasicBlock& lookup(uint32_t pc) {
+        BasicBlock* block = fast_lookup[(pc >> 2) & (FAST_LOOKUP_SIZE - 1)];
+        if (block && block->start_pc == pc) {
+            return *block;
+        }
+        return lookup_slow(pc);
+    }
+    
+    // Bumped whenever blocks are dropped, so a running block can notice
+    // that its own code was overwritten
+    uint64_t get_invalidations() const { return invalidations; }
+    
+    // Toggle superinstruction fusion (affects blocks built afterwards)
+    void set_fusion_enabled(bool enabled) { fusion_enabled = enabled; }
+    
+    // CodeWriteListener
+    void invalidate_code_page(uint32_t page) override;
+    
+    // Drop every cached block
+    void clear();
+    
+    // Statistics
+    size_t get_block_count() const { return blocks.size(); }
+    uint64_t get_fused_pairs() const { return fused_pairs; }
+    
+private:
+    static constexpr size_t FAST_LOOKUP_SIZE = 4096;
+    
+    CPU& cpu;
+    DecodeCache& decode_cache;
+    std::unordered_map<uint32_t, std::unique_ptr<BasicBlock>> blocks;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> page_blocks;  // page -> block start PCs
+    std::array<BasicBlock*, FAST_LOOKUP_SIZE> fast_lookup;
+    std::vector<std::unique_ptr<BasicBlock>> retired;
+    uint64_t invalidations;
+    uint64_t fused_pairs;
+    bool fusion_enabled;
+    
+    const BasicBlock& lookup_slow(uint32_t pc);
+    std::unique_ptr<BasicBlock> build(uint32_t pc);
+    void fuse(BasicBlock& block);
+};
+
+#endif // BLOCK_CACHE_H
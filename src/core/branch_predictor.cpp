@@ -0,0 +1,233 @@
+#include "branch_predictor.h"
+#include "timing_model.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+// 2-bit saturating counters: 0-1 predict not taken, 2-3 taken. They
+// start weakly not taken.
+constexpr uint8_t WEAKLY_NOT_TAKEN = 1;
+
+bool predicts_taken(uint8_t counter) {
+    return counter >= 2;
+}
+
+void train(uint8_t& counter, bool taken) {
+    if (taken && counter < 3) {
+        counter++;
+    } else if (!taken && counter > 0) {
+        counter--;
+    }
+}
+
+std::string format_rate(const BranchStats& stats) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2) << stats.misprediction_rate() * 100.0 << "%";
+    return out.str();
+}
+
+} // namespace
+
+BimodalPredictor::BimodalPredictor(uint32_t index_bits)
+    : counters(size_t(1) << index_bits, WEAKLY_NOT_TAKEN), mask((1u << index_bits) - 1) {}
+
+bool BimodalPredictor::predict(uint32_t pc, uint32_t) const {
+    return predicts_taken(counters[(pc >> 2) & mask]);
+}
+
+void BimodalPredictor::update(uint32_t pc, uint32_t, bool taken) {
+    train(counters[(pc >> 2) & mask], taken);
+}
+
+void BimodalPredictor::reset() {
+    std::fill(counters.begin(), counters.end(), WEAKLY_NOT_TAKEN);
+}
+
+GSharePredictor::GSharePredictor(uint32_t index_bits, uint32_t history_bits)
+    : counters(size_t(1) << index_bits, WEAKLY_NOT_TAKEN), mask((1u << index_bits) - 1),
+      history_mask((1u << history_bits) - 1), history(0) {}
+
+bool GSharePredictor::predict(uint32_t pc, uint32_t) const {
+    return predicts_taken(counters[index(pc)]);
+}
+
+void GSharePredictor::update(uint32_t pc, uint32_t, bool taken) {
+    train(counters[index(pc)], taken);
+    history = ((history << 1) | (taken ? 1 : 0)) & history_mask;
+}
+
+void GSharePredictor::reset() {
+    std::fill(counters.begin(), counters.end(), WEAKLY_NOT_TAKEN);
+    history = 0;
+}
+
+TournamentPredictor::TournamentPredictor(uint32_t index_bits)
+    : bimodal(index_bits), gshare(index_bits, index_bits),
+      choosers(size_t(1) << index_bits, WEAKLY_NOT_TAKEN), mask((1u << index_bits) - 1) {}
+
+bool TournamentPredictor::predict(uint32_t pc, uint32_t target) const {
+    return predicts_taken(choosers[(pc >> 2) & mask]) ? gshare.predict(pc, target) : bimodal.predict(pc, target);
+}
+
+void TournamentPredictor::update(uint32_t pc, uint32_t target, bool taken) {
+    bool bimodal_right = bimodal.predict(pc, target) == taken;
+    bool gshare_right = gshare.predict(pc, target) == taken;
+    if (bimodal_right != gshare_right) {
+        train(choosers[(pc >> 2) & mask], gshare_right);
+    }
+    bimodal.update(pc, target, taken);
+    gshare.update(pc, target, taken);
+}
+
+void TournamentPredictor::reset() {
+    bimodal.reset();
+    gshare.reset();
+    std::fill(choosers.begin(), choosers.end(), WEAKLY_NOT_TAKEN);
+}
+
+void ReturnAddressStack::push(uint32_t return_pc) {
+    entries[top] = return_pc;
+    top = (top + 1) % entries.size();
+    size = std::min(size + 1, entries.size());
+}
+
+bool ReturnAddressStack::pop(uint32_t& return_pc) {
+    if (size == 0) {
+        return false;
+    }
+    top = (top + entries.size() - 1) % entries.size();
+    size--;
+    return_pc = entries[top];
+    return true;
+}
+
+BranchSimulator::BranchSimulator(std::unique_ptr<BranchPredictor> predictor, uint32_t ras_depth,
+                                 uint32_t target_bits)
+    : predictor(std::move(predictor)), ras(ras_depth), targets(size_t(1) << target_bits, 0) {}
+
+Prediction BranchSimulator::resolve(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc) {
+    switch (inst.op) {
+        case Operation::BEQ: case Operation::BNE: case Operation::BLT:
+        case Operation::BGE: case Operation::BLTU: case Operation::BGEU: {
+            uint32_t target = pc + static_cast<uint32_t>(inst.imm);
+            bool taken = next_pc != pc + 4;
+            bool correct = predictor->predict(pc, target) == taken;
+            predictor->update(pc, target, taken);
+            return record(conditional, pc, taken, correct);
+        }
+        case Operation::JAL:
+            if (call_kind(inst) == CallKind::CALL) {
+                ras.push(pc + 4);
+            }
+            return Prediction::NONE;
+        case Operation::JALR: {
+            CallKind kind = call_kind(inst);
+            if (kind == CallKind::RETURN) {
+                uint32_t predicted;
+                bool correct = ras.pop(predicted) && predicted == next_pc;
+                return record(returns, pc, true, correct);
+            }
+            uint32_t& last = targets[(pc >> 2) & (targets.size() - 1)];
+            bool correct = last == next_pc;
+            last = next_pc;
+            if (kind == CallKind::CALL) {
+                ras.push(pc + 4);
+            }
+            return record(indirect, pc, true, correct);
+        }
+        default:
+            return Prediction::NONE;
+    }
+}
+
+Prediction BranchSimulator::record(BranchStats& stats, uint32_t pc, bool taken, bool correct) {
+    BranchSite& site = sites[pc];
+    site.executed++;
+    site.taken += taken;
+    stats.executed++;
+    if (correct) {
+        return Prediction::CORRECT;
+    }
+    site.mispredicted++;
+    stats.mispredicted++;
+    return Prediction::MISPREDICTED;
+}
+
+BranchStats BranchSimulator::get_total() const {
+    BranchStats total;
+    for (const BranchStats* stats : {&conditional, &returns, &indirect}) {
+        total.executed += stats->executed;
+        total.mispredicted += stats->mispredicted;
+    }
+    return total;
+}
+
+void BranchSimulator::reset() {
+    predictor->reset();
+    ras.reset();
+    std::fill(targets.begin(), targets.end(), 0);
+    conditional = returns = indirect = BranchStats();
+    sites.clear();
+}
+
+void BranchSimulator::print_report(const SymbolTable& symbols) const {
+    std::cout << "\n=== Branch Prediction (" << predictor->name() << ") ===" << std::endl;
+    std::cout << std::left << std::setw(14) << "Kind"
+              << std::setw(14) << "Executed"
+              << std::setw(14) << "Mispredicted"
+              << "Rate" << std::endl;
+    std::cout << std::string(50, '-') << std::endl;
+    const std::pair<const char*, BranchStats> rows[] = {
+        {"Conditional", conditional}, {"Return", returns}, {"Indirect", indirect}, {"Total", get_total()},
+    };
+    for (const auto& [kind, stats] : rows) {
+        std::cout << std::left << std::setw(14) << kind
+                  << std::setw(14) << stats.executed
+                  << std::setw(14) << stats.mispredicted
+                  << format_rate(stats) << std::endl;
+    }
+
+    std::vector<std::pair<uint32_t, BranchSite>> worst;
+    for (const auto& [pc, site] : sites) {
+        if (site.mispredicted != 0) {
+            worst.emplace_back(pc, site);
+        }
+    }
+    if (worst.empty()) {
+        return;
+    }
+    std::sort(worst.begin(), worst.end(), [](const auto& a, const auto& b) {
+        if (a.second.mispredicted != b.second.mispredicted) {
+            return a.second.mispredicted > b.second.mispredicted;
+        }
+        return a.first < b.first;
+    });
+    if (worst.size() > 10) {
+        worst.resize(10);
+    }
+
+    std::cout << "\n=== Most Mispredicted Branches ===" << std::endl;
+    std::cout << std::left << std::setw(12) << "PC"
+              << std::setw(12) << "Executed"
+              << std::setw(10) << "Taken"
+              << std::setw(14) << "Mispredicted"
+              << std::setw(10) << "Rate"
+              << (symbols.empty() ? "" : "Location") << std::endl;
+    std::cout << std::string(symbols.empty() ? 58 : 82, '-') << std::endl;
+    for (const auto& [pc, site] : worst) {
+        BranchStats stats{site.executed, site.mispredicted};
+        std::cout << "0x" << std::right << std::hex << std::setw(8) << std::setfill('0') << pc
+                  << std::dec << std::setfill(' ') << std::left
+                  << "  " << std::setw(12) << site.executed
+                  << std::setw(10) << site.taken
+                  << std::setw(14) << site.mispredicted
+                  << std::setw(10) << format_rate(stats);
+        if (!symbols.empty()) {
+            std::cout << symbols.describe(pc);
+        }
+        std::cout << std::endl;
+    }
+}
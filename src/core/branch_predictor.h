@@ -0,0 +1,153 @@
+#ifndef BRANCH_PREDICTOR_H
+#define BRANCH_PREDICTOR_H
+
+#include "decoder.h"
+#include "symbol_table.h"
+#include "timing_model.h"
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Direction predictor for conditional branches. predict() has no side
+// effects; update() then trains on the outcome.
+class BranchPredictor {
+public:
+    virtual ~BranchPredictor() = default;
+
+    virtual const char* name() const = 0;
+    virtual bool predict(uint32_t pc, uint32_t target) const = 0;
+    virtual void update(uint32_t pc, uint32_t target, bool taken) = 0;
+    virtual void reset() = 0;
+};
+
+// Backward taken, forward not taken (loops are assumed to loop)
+class StaticPredictor : public BranchPredictor {
+public:
+    const char* name() const override { return "static"; }
+    bool predict(uint32_t pc, uint32_t target) const override { return target <= pc; }
+    void update(uint32_t, uint32_t, bool) override {}
+    void reset() override {}
+};
+
+// Table of 2-bit saturating counters indexed by PC
+class BimodalPredictor : public BranchPredictor {
+public:
+    explicit BimodalPredictor(uint32_t index_bits = 12);
+
+    const char* name() const override { return "bimodal"; }
+    bool predict(uint32_t pc, uint32_t target) const override;
+    void update(uint32_t pc, uint32_t target, bool taken) override;
+    void reset() override;
+
+private:
+    std::vector<uint8_t> counters;
+    uint32_t mask;
+};
+
+// 2-bit counters indexed by PC xor the global outcome history, so one
+// branch can learn different directions in different contexts
+class GSharePredictor : public BranchPredictor {
+public:
+    explicit GSharePredictor(uint32_t index_bits = 12, uint32_t history_bits = 12);
+
+    const char* name() const override { return "gshare"; }
+    bool predict(uint32_t pc, uint32_t target) const override;
+    void update(uint32_t pc, uint32_t target, bool taken) override;
+    void reset() override;
+
+private:
+    std::vector<uint8_t> counters;
+    uint32_t mask;
+    uint32_t history_mask;
+    uint32_t history;
+
+    uint32_t index(uint32_t pc) const { return ((pc >> 2) ^ history) & mask; }
+};
+
+// Bimodal and gshare side by side, with per-PC 2-bit choosers trained
+// towards whichever was right when they disagree
+class TournamentPredictor : public BranchPredictor {
+public:
+    explicit TournamentPredictor(uint32_t index_bits = 12);
+
+    const char* name() const override { return "tournament"; }
+    bool predict(uint32_t pc, uint32_t target) const override;
+    void update(uint32_t pc, uint32_t target, bool taken) override;
+    void reset() override;
+
+private:
+    BimodalPredictor bimodal;
+    GSharePredictor gshare;
+    std::vector<uint8_t> choosers;  // >= 2 selects gshare
+    uint32_t mask;
+};
+
+// Return targets pushed by calls and popped by returns. Overflow
+// overwrites the oldest entry; popping an empty stack predicts nothing.
+class ReturnAddressStack {
+public:
+    explicit ReturnAddressStack(uint32_t depth = 16) : entries(depth ? depth : 1), top(0), size(0) {}
+
+    void push(uint32_t return_pc);
+    bool pop(uint32_t& return_pc);
+    void reset() { top = size = 0; }
+
+private:
+    std::vector<uint32_t> entries;
+    size_t top;   // Next free slot
+    size_t size;
+};
+
+struct BranchStats {
+    uint64_t executed = 0;
+    uint64_t mispredicted = 0;
+
+    double misprediction_rate() const { return executed ? static_cast<double>(mispredicted) / executed : 0.0; }
+};
+
+// One branch or jump instruction
+struct BranchSite {
+    uint64_t executed = 0;
+    uint64_t taken = 0;
+    uint64_t mispredicted = 0;
+};
+
+// Front-end prediction for the interpreter's control transfers: a
+// direction predictor for conditional branches, the return-address
+// stack for returns and a direct-mapped table of last targets for other
+// JALRs. JAL is direct and never mispredicts, but calls through it
+// still push the stack. Attach one with Interpreter::set_branch_simulator;
+// its verdicts replace the timing model's static branch costs.
+class BranchSimulator {
+public:
+    explicit BranchSimulator(std::unique_ptr<BranchPredictor> predictor = std::make_unique<BimodalPredictor>(),
+                             uint32_t ras_depth = 16, uint32_t target_bits = 10);
+
+    // Predict and train on the control transfer inst at pc, which went
+    // on to next_pc; NONE for instructions that are not predicted
+    Prediction resolve(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc);
+
+    const BranchPredictor& get_predictor() const { return *predictor; }
+    const BranchStats& get_conditional() const { return conditional; }
+    const BranchStats& get_returns() const { return returns; }
+    const BranchStats& get_indirect() const { return indirect; }
+    BranchStats get_total() const;
+    const std::unordered_map<uint32_t, BranchSite>& get_sites() const { return sites; }
+
+    void reset();
+    void print_report(const SymbolTable& symbols) const;
+
+private:
+    std::unique_ptr<BranchPredictor> predictor;
+    ReturnAddressStack ras;
+    std::vector<uint32_t> targets;  // Last target per JALR slot
+    BranchStats conditional;
+    BranchStats returns;
+    BranchStats indirect;
+    std::unordered_map<uint32_t, BranchSite> sites;
+
+    Prediction record(BranchStats& stats, uint32_t pc, bool taken, bool correct);
+};
+
+#endif // BRANCH_PREDICTOR_H
@@ -0,0 +1,237 @@
+#include "cache_simulator.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t INVALID = ~0u;
+
+bool is_power_of_two(uint32_t value) {
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+uint32_t log2(uint32_t value) {
+    uint32_t bits = 0;
+    while (value >>= 1) {
+        bits++;
+    }
+    return bits;
+}
+
+std::string describe(const CacheConfig& config) {
+    static const char* const policies[] = {"LRU", "FIFO", "random"};
+    std::ostringstream out;
+    out << config.size / 1024 << " KB, " << config.associativity << "-way, " << config.line_size << " B lines, "
+        << policies[static_cast<int>(config.replacement)];
+    return out.str();
+}
+
+} // namespace
+
+Cache::Cache(std::string name, const CacheConfig& config)
+    : name(std::move(name)), config(config), clock(0), rng(1) {
+    if (!is_power_of_two(config.size) || !is_power_of_two(config.associativity) ||
+        !is_power_of_two(config.line_size) || config.line_size < 4 ||
+        config.size < config.line_size * config.associativity) {
+        throw std::invalid_argument("Invalid cache geometry for " + this->name);
+    }
+    uint32_t sets = config.size / config.line_size / config.associativity;
+    line_shift = log2(config.line_size);
+    set_mask = sets - 1;
+    tags.assign(static_cast<size_t>(sets) * config.associativity, INVALID);
+    stamps.assign(tags.size(), 0);
+}
+
+bool Cache::access(uint32_t addr) {
+    stats.accesses++;
+    clock++;
+    const uint32_t line = addr >> line_shift;
+    const size_t first = static_cast<size_t>(line & set_mask) * config.associativity;
+    const size_t last = first + config.associativity;
+
+    for (size_t way = first; way < last; way++) {
+        if (tags[way] == line) {
+            if (config.replacement == ReplacementPolicy::LRU) {
+                stamps[way] = clock;
+            }
+            return true;
+        }
+    }
+
+    // Miss: fill an empty way, else evict per the policy
+    stats.misses++;
+    size_t victim = first;
+    if (config.replacement == ReplacementPolicy::RANDOM) {
+        victim = last;
+        for (size_t way = first; way < last && victim == last; way++) {
+            if (tags[way] == INVALID) {
+                victim = way;
+            }
+        }
+        if (victim == last) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            victim = first + rng % config.associativity;
+        }
+    } else {
+        // Empty ways carry stamp 0 and so go first
+        for (size_t way = first + 1; way < last; way++) {
+            if (stamps[way] < stamps[victim]) {
+                victim = way;
+            }
+        }
+    }
+    tags[victim] = line;
+    stamps[victim] = clock;
+    return false;
+}
+
+void Cache::reset() {
+    std::fill(tags.begin(), tags.end(), INVALID);
+    std::fill(stamps.begin(), stamps.end(), 0);
+    clock = 0;
+    rng = 1;
+    stats = CacheStats();
+}
+
+CacheSimulator::CacheSimulator(const CacheHierarchyConfig& config)
+    : icache("L1I", config.icache), dcache("L1D", config.dcache),
+      l2("L2", config.l2_enabled ? config.l2 : CacheConfig()), l2_enabled(config.l2_enabled),
+      last_fetch_line(INVALID) {}
+
+void CacheSimulator::fetch_line(uint32_t pc) {
+    if (icache.access(pc)) {
+        return;
+    }
+    CacheMisses& counts = misses[pc];
+    counts.instruction++;
+    if (l2_enabled && !l2.access(pc)) {
+        counts.l2++;
+    }
+}
+
+void CacheSimulator::data_access(uint32_t pc, uint32_t addr, uint32_t size) {
+    data_line(pc, addr);
+    uint32_t last = addr + size - 1;
+    if (dcache.line_of(last) != dcache.line_of(addr)) {
+        data_line(pc, last);
+    }
+}
+
+void CacheSimulator::data_line(uint32_t pc, uint32_t addr) {
+    if (dcache.access(addr)) {
+        return;
+    }
+    CacheMisses& counts = misses[pc];
+    counts.data++;
+    if (l2_enabled && !l2.access(addr)) {
+        counts.l2++;
+    }
+}
+
+std::vector<std::pair<std::string, CacheMisses>> CacheSimulator::get_function_misses(const SymbolTable& symbols) const {
+    std::unordered_map<std::string, CacheMisses> functions;
+    for (const auto& [pc, counts] : misses) {
+        const Symbol* symbol = symbols.lookup(pc);
+        CacheMisses& total = functions[symbol ? symbol->name : "[unknown]"];
+        total.instruction += counts.instruction;
+        total.data += counts.data;
+        total.l2 += counts.l2;
+    }
+
+    std::vector<std::pair<std::string, CacheMisses>> result(functions.begin(), functions.end());
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+        uint64_t a_misses = a.second.instruction + a.second.data;
+        uint64_t b_misses = b.second.instruction + b.second.data;
+        if (a_misses != b_misses) {
+            return a_misses > b_misses;
+        }
+        return a.first < b.first;
+    });
+    return result;
+}
+
+void CacheSimulator::reset() {
+    icache.reset();
+    dcache.reset();
+    l2.reset();
+    last_fetch_line = INVALID;
+    misses.clear();
+}
+
+void CacheSimulator::print_report(const SymbolTable& symbols) const {
+    std::cout << "\n=== Cache Simulation ===" << std::endl;
+    std::cout << std::left << std::setw(6) << "Cache"
+              << std::setw(14) << "Accesses"
+              << std::setw(12) << "Misses"
+              << std::setw(11) << "Miss rate"
+              << "Geometry" << std::endl;
+    std::cout << std::string(80, '-') << std::endl;
+
+    for (const Cache* cache : {&icache, &dcache, get_l2()}) {
+        if (!cache) {
+            continue;
+        }
+        const CacheStats& stats = cache->get_stats();
+        std::ostringstream rate;
+        rate << std::fixed << std::setprecision(2) << stats.miss_rate() * 100.0 << "%";
+        std::cout << std::left << std::setw(6) << cache->get_name()
+                  << std::setw(14) << stats.accesses
+                  << std::setw(12) << stats.misses
+                  << std::setw(11) << rate.str()
+                  << describe(cache->get_config()) << std::endl;
+    }
+
+    // Worst PCs, then functions
+    std::vector<std::pair<uint32_t, CacheMisses>> pcs(misses.begin(), misses.end());
+    std::sort(pcs.begin(), pcs.end(), [](const auto& a, const auto& b) {
+        uint64_t a_misses = a.second.instruction + a.second.data;
+        uint64_t b_misses = b.second.instruction + b.second.data;
+        if (a_misses != b_misses) {
+            return a_misses > b_misses;
+        }
+        return a.first < b.first;
+    });
+    if (pcs.size() > 10) {
+        pcs.resize(10);
+    }
+    if (!pcs.empty()) {
+        std::cout << "\n=== Top Missing PCs ===" << std::endl;
+        std::cout << std::left << std::setw(12) << "PC"
+                  << std::setw(12) << "L1I misses"
+                  << std::setw(12) << "L1D misses"
+                  << std::setw(12) << "L2 misses"
+                  << (symbols.empty() ? "" : "Location") << std::endl;
+        std::cout << std::string(symbols.empty() ? 48 : 72, '-') << std::endl;
+        for (const auto& [pc, counts] : pcs) {
+            std::cout << "0x" << std::right << std::hex << std::setw(8) << std::setfill('0') << pc
+                      << std::dec << std::setfill(' ') << std::left
+                      << "  " << std::setw(12) << counts.instruction
+                      << std::setw(12) << counts.data
+                      << std::setw(12) << counts.l2;
+            if (!symbols.empty()) {
+                std::cout << symbols.describe(pc);
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    if (!symbols.empty() && !misses.empty()) {
+        std::cout << "\n=== Misses by Function ===" << std::endl;
+        std::cout << std::left << std::setw(24) << "Function"
+                  << std::setw(12) << "L1I misses"
+                  << std::setw(12) << "L1D misses"
+                  << "L2 misses" << std::endl;
+        std::cout << std::string(60, '-') << std::endl;
+        for (const auto& [name, counts] : get_function_misses(symbols)) {
+            std::cout << std::left << std::setw(24) << name
+                      << std::setw(12) << counts.instruction
+                      << std::setw(12) << counts.data
+                      << counts.l2 << std::endl;
+        }
+    }
+}
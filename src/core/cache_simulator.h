@@ -0,0 +1,130 @@
+#ifndef CACHE_SIMULATOR_H
+#define CACHE_SIMULATOR_H
+
+#include "symbol_table.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Which way of a full set a miss evicts
+enum class ReplacementPolicy : uint8_t {
+    LRU,     // Least recently used
+    FIFO,    // Oldest fill
+    RANDOM   // Pseudo-random, reproducible
+};
+
+// Geometry of one cache; sizes are powers of two
+struct CacheConfig {
+    uint32_t size = 32 * 1024;   // Bytes
+    uint32_t associativity = 4;  // Ways per set; size / line_size for fully associative
+    uint32_t line_size = 64;     // Bytes
+    ReplacementPolicy replacement = ReplacementPolicy::LRU;
+};
+
+struct CacheStats {
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+
+    uint64_t hits() const { return accesses - misses; }
+    double miss_rate() const { return accesses ? static_cast<double>(misses) / accesses : 0.0; }
+};
+
+// One set-associative cache level. Only tags are kept: it decides hit or
+// miss, the data always comes from guest memory. Misses allocate, for
+// stores too (write-allocate); write-back traffic is not modelled.
+class Cache {
+public:
+    // Throws std::invalid_argument for a geometry that is not a power of
+    // two or does not divide into whole sets
+    Cache(std::string name, const CacheConfig& config);
+
+    // Look up the line holding addr, filling it on a miss; true on a hit
+    bool access(uint32_t addr);
+
+    // Count an access known to hit the most recently used line again;
+    // repeating an access changes no replacement state
+    void repeat_hit() { stats.accesses++; }
+
+    uint32_t line_of(uint32_t addr) const { return addr >> line_shift; }
+
+    const std::string& get_name() const { return name; }
+    const CacheConfig& get_config() const { return config; }
+    const CacheStats& get_stats() const { return stats; }
+    void reset();
+
+private:
+    std::string name;
+    CacheConfig config;
+    uint32_t line_shift;
+    uint32_t set_mask;
+    std::vector<uint32_t> tags;     // sets x ways: line number, or INVALID
+    std::vector<uint64_t> stamps;   // Last use (LRU) or fill (FIFO)
+    uint64_t clock;
+    uint64_t rng;                   // xorshift64 state (RANDOM)
+    CacheStats stats;
+};
+
+// Where a cache hierarchy has missed, per PC
+struct CacheMisses {
+    uint64_t instruction = 0;  // L1I misses fetching this PC
+    uint64_t data = 0;         // L1D misses of the load or store at this PC
+    uint64_t l2 = 0;           // L2 misses of either
+};
+
+struct CacheHierarchyConfig {
+    CacheConfig icache;
+    CacheConfig dcache;
+    bool l2_enabled = true;
+    CacheConfig l2{256 * 1024, 8, 64, ReplacementPolicy::LRU};
+};
+
+// Split L1 instruction and data caches over an optional unified L2,
+// fed by the interpreter: every fetched instruction and every guest load
+// and store. Attach one with Interpreter::set_cache_simulator; without
+// one the interpreter runs code compiled without the hooks.
+class CacheSimulator {
+public:
+    explicit CacheSimulator(const CacheHierarchyConfig& config = CacheHierarchyConfig());
+
+    // Instruction fetch at pc. Runs of fetches from one line take the
+    // shortcut: they hit and leave the replacement state as it was.
+    void fetch(uint32_t pc) {
+        uint32_t line = icache.line_of(pc);
+        if (line == last_fetch_line) {
+            icache.repeat_hit();
+            return;
+        }
+        last_fetch_line = line;
+        fetch_line(pc);
+    }
+
+    // Load or store of size bytes at addr by the instruction at pc; an
+    // access straddling two lines touches both
+    void data_access(uint32_t pc, uint32_t addr, uint32_t size);
+
+    const Cache& get_icache() const { return icache; }
+    const Cache& get_dcache() const { return dcache; }
+    const Cache* get_l2() const { return l2_enabled ? &l2 : nullptr; }
+
+    // Misses by PC, and rolled up into functions ("[unknown]" outside
+    // any symbol), most L1 misses first
+    const std::unordered_map<uint32_t, CacheMisses>& get_misses() const { return misses; }
+    std::vector<std::pair<std::string, CacheMisses>> get_function_misses(const SymbolTable& symbols) const;
+
+    void reset();
+    void print_report(const SymbolTable& symbols) const;
+
+private:
+    Cache icache;
+    Cache dcache;
+    Cache l2;
+    bool l2_enabled;
+    uint32_t last_fetch_line;
+    std::unordered_map<uint32_t, CacheMisses> misses;
+
+    void fetch_line(uint32_t pc);
+    void data_line(uint32_t pc, uint32_t addr);
+};
+
+#endif // CACHE_SIMULATOR_H
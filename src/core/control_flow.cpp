@@ -0,0 +1,307 @@
+#include "control_flow.h"
+#include "profiler.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+constexpr size_t UNDEFINED = ~size_t(0);
+
+} // namespace
+
+ControlFlowGraph::ControlFlowGraph(const Profiler& profiler) {
+    if (profiler.is_sampling()) {
+        return;
+    }
+    build_blocks(profiler);
+    compute_dominators();
+    find_loops();
+}
+
+const CFGBlock* ControlFlowGraph::find_block(uint32_t pc) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), pc,
+                               [](uint32_t value, const CFGBlock& block) { return value < block.start; });
+    if (it == blocks.begin()) {
+        return nullptr;
+    }
+    --it;
+    return pc < it->end() ? &*it : nullptr;
+}
+
+void ControlFlowGraph::build_blocks(const Profiler& profiler) {
+    std::vector<std::pair<uint32_t, uint64_t>> pcs;
+    profiler.for_each_instruction_count([&](uint32_t pc, uint64_t count) { pcs.emplace_back(pc, count); });
+    std::sort(pcs.begin(), pcs.end());
+
+    struct TakenEdge {
+        uint32_t from;
+        uint32_t to;
+        uint64_t count;
+    };
+    std::vector<TakenEdge> taken;
+    std::unordered_set<uint32_t> sources, targets;
+    profiler.for_each_edge([&](uint32_t from, uint32_t to, uint64_t count) {
+        taken.push_back({from, to, count});
+        sources.insert(from);
+        targets.insert(to);
+    });
+
+    // A block starts after a gap, after a transfer, at a transfer target,
+    // or where the count changes (code entered or left some other way,
+    // e.g. a trap); so every instruction of a block has the block's count
+    for (size_t i = 0; i < pcs.size(); i++) {
+        auto [pc, count] = pcs[i];
+        bool leader = i == 0 || pcs[i - 1].first != pc - 4 || sources.count(pc - 4) ||
+                      targets.count(pc) || pcs[i - 1].second != count;
+        if (leader) {
+            blocks.push_back({pc, 0, count, 0, {}, {}});
+        }
+        blocks.back().instruction_count++;
+        blocks.back().instructions += count;
+    }
+
+    auto block_at = [&](uint32_t start) -> size_t {
+        const CFGBlock* block = find_block(start);
+        return block && block->start == start ? static_cast<size_t>(block - blocks.data()) : UNDEFINED;
+    };
+
+    // Taken edges leave a block's last instruction (the next one is a
+    // leader); what is left of its count falls through to the next block
+    std::unordered_map<uint32_t, uint64_t> taken_from;
+    for (const TakenEdge& edge : taken) {
+        const CFGBlock* source = find_block(edge.from);
+        size_t from = source ? static_cast<size_t>(source - blocks.data()) : UNDEFINED;
+        size_t to = block_at(edge.to);
+        if (from == UNDEFINED || to == UNDEFINED) {
+            continue;  // Target never retired (it faulted)
+        }
+        edges.push_back({from, to, edge.count, true, false});
+        taken_from[edge.from] += edge.count;
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+        uint64_t left = blocks[i].count;
+        auto it = taken_from.find(blocks[i].end() - 4);
+        if (it != taken_from.end()) {
+            left = left > it->second ? left - it->second : 0;
+        }
+        if (left > 0 && i + 1 < blocks.size() && blocks[i + 1].start == blocks[i].end()) {
+            edges.push_back({i, i + 1, left, false, false});
+        }
+    }
+
+    for (size_t e = 0; e < edges.size(); e++) {
+        blocks[edges[e].from].successors.push_back(e);
+        blocks[edges[e].to].predecessors.push_back(e);
+    }
+}
+
+// Cooper, Harvey and Kennedy's iterative algorithm over reverse postorder.
+// A virtual root precedes every block entered other than through an edge.
+void ControlFlowGraph::compute_dominators() {
+    const size_t root = blocks.size();
+    std::vector<size_t> entries;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        uint64_t incoming = 0;
+        for (size_t e : blocks[i].predecessors) {
+            incoming += edges[e].count;
+        }
+        if (blocks[i].predecessors.empty() || incoming < blocks[i].count) {
+            entries.push_back(i);
+        }
+    }
+
+    // Depth-first postorder from the root; blocks it cannot reach (only
+    // possible with inconsistent counts) become entries too
+    std::vector<size_t> postorder;
+    std::vector<bool> visited(blocks.size() + 1, false);
+    auto visit_from = [&](size_t start) {
+        std::vector<std::pair<size_t, size_t>> stack{{start, 0}};
+        visited[start] = true;
+        while (!stack.empty()) {
+            auto& [node, next] = stack.back();
+            const std::vector<size_t>* successors = node == root ? nullptr : &blocks[node].successors;
+            size_t count = node == root ? entries.size() : successors->size();
+            if (next < count) {
+                size_t child = node == root ? entries[next] : edges[(*successors)[next]].to;
+                next++;
+                if (!visited[child]) {
+                    visited[child] = true;
+                    stack.push_back({child, 0});
+                }
+            } else {
+                postorder.push_back(node);
+                stack.pop_back();
+            }
+        }
+    };
+    while (true) {
+        std::fill(visited.begin(), visited.end(), false);
+        postorder.clear();
+        visit_from(root);
+        auto unreached = std::find(visited.begin(), visited.begin() + blocks.size(), false);
+        if (unreached == visited.begin() + blocks.size()) {
+            break;
+        }
+        entries.push_back(static_cast<size_t>(unreached - visited.begin()));
+    }
+
+    std::vector<size_t> rpo(postorder.rbegin(), postorder.rend());
+    rpo_index.assign(blocks.size() + 1, 0);
+    for (size_t i = 0; i < rpo.size(); i++) {
+        rpo_index[rpo[i]] = i;
+    }
+
+    std::vector<bool> is_entry(blocks.size(), false);
+    for (size_t entry : entries) {
+        is_entry[entry] = true;
+    }
+
+    idom.assign(blocks.size() + 1, UNDEFINED);
+    idom[root] = root;
+    auto intersect = [&](size_t a, size_t b) {
+        while (a != b) {
+            while (rpo_index[a] > rpo_index[b]) {
+                a = idom[a];
+            }
+            while (rpo_index[b] > rpo_index[a]) {
+                b = idom[b];
+            }
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t node : rpo) {
+            if (node == root) {
+                continue;
+            }
+            size_t new_idom = is_entry[node] ? root : UNDEFINED;
+            for (size_t e : blocks[node].predecessors) {
+                size_t pred = edges[e].from;
+                if (idom[pred] == UNDEFINED) {
+                    continue;
+                }
+                new_idom = new_idom == UNDEFINED ? pred : intersect(pred, new_idom);
+            }
+            if (new_idom != idom[node]) {
+                idom[node] = new_idom;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool ControlFlowGraph::dominates(size_t a, size_t b) const {
+    const size_t root = blocks.size();
+    while (true) {
+        if (b == a) {
+            return true;
+        }
+        if (b == root || b >= idom.size() || idom[b] == UNDEFINED) {
+            return false;
+        }
+        b = idom[b];
+    }
+}
+
+void ControlFlowGraph::find_loops() {
+    std::unordered_map<size_t, std::vector<size_t>> back_edges;  // header -> edges
+    for (size_t e = 0; e < edges.size(); e++) {
+        if (dominates(edges[e].to, edges[e].from)) {
+            edges[e].back_edge = true;
+            back_edges[edges[e].to].push_back(e);
+        }
+    }
+
+    // Body: the header plus everything reaching a back edge's source
+    // backwards without passing through the header
+    std::vector<std::vector<size_t>> bodies;
+    for (const auto& [header, loop_edges] : back_edges) {
+        std::vector<bool> in_body(blocks.size(), false);
+        in_body[header] = true;
+        std::vector<size_t> worklist;
+        NaturalLoop loop{blocks[header].start, {}, 0, blocks[header].count, 0, 0, 0};
+        for (size_t e : loop_edges) {
+            loop.iterations += edges[e].count;
+            worklist.push_back(edges[e].from);
+        }
+        while (!worklist.empty()) {
+            size_t node = worklist.back();
+            worklist.pop_back();
+            if (in_body[node]) {
+                continue;
+            }
+            in_body[node] = true;
+            for (size_t e : blocks[node].predecessors) {
+                worklist.push_back(edges[e].from);
+            }
+        }
+
+        std::vector<size_t> body;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (in_body[i]) {
+                body.push_back(i);
+                loop.blocks.push_back(blocks[i].start);
+                loop.instructions += blocks[i].instructions;
+            }
+        }
+        loop.entries = loop.header_count > loop.iterations ? loop.header_count - loop.iterations : 0;
+        loops.push_back(std::move(loop));
+        bodies.push_back(std::move(body));
+    }
+
+    // Nesting depth: how many loop bodies hold the header
+    for (NaturalLoop& loop : loops) {
+        size_t header = static_cast<size_t>(find_block(loop.header) - blocks.data());
+        for (const std::vector<size_t>& body : bodies) {
+            loop.depth += std::binary_search(body.begin(), body.end(), header);
+        }
+    }
+
+    std::sort(loops.begin(), loops.end(), [](const NaturalLoop& a, const NaturalLoop& b) {
+        if (a.instructions != b.instructions) {
+            return a.instructions > b.instructions;
+        }
+        return a.header < b.header;
+    });
+}
+
+std::vector<uint32_t> ControlFlowGraph::hot_blocks(uint64_t threshold) const {
+    std::vector<uint32_t> result;
+    std::unordered_set<uint32_t> chosen;
+    auto choose = [&](uint32_t start) {
+        if (chosen.insert(start).second) {
+            result.push_back(start);
+        }
+    };
+
+    for (const NaturalLoop& loop : loops) {
+        if (loop.header_count < threshold) {
+            continue;
+        }
+        choose(loop.header);
+        for (uint32_t start : loop.blocks) {
+            choose(start);
+        }
+    }
+
+    std::vector<const CFGBlock*> rest;
+    for (const CFGBlock& block : blocks) {
+        if (block.count >= threshold && !chosen.count(block.start)) {
+            rest.push_back(&block);
+        }
+    }
+    std::sort(rest.begin(), rest.end(), [](const CFGBlock* a, const CFGBlock* b) {
+        if (a->instructions != b->instructions) {
+            return a->instructions > b->instructions;
+        }
+        return a->start < b->start;
+    });
+    for (const CFGBlock* block : rest) {
+        result.push_back(block->start);
+    }
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef CONTROL_FLOW_H
+#define CONTROL_FLOW_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Profiler;
+
+// Straight-line code between control-flow joins and splits, as executed
+struct CFGBlock {
+    uint32_t start;
+    uint32_t instruction_count;
+    uint64_t count;         // Times entered (executions of the first instruction)
+    uint64_t instructions;  // Instructions retired in the block
+    std::vector<size_t> successors;    // Edge indices
+    std::vector<size_t> predecessors;  // Edge indices
+
+    uint32_t end() const { return start + instruction_count * 4; }
+};
+
+// Executed transfer between two blocks (indices into the block list)
+struct CFGEdge {
+    size_t from;
+    size_t to;
+    uint64_t count;
+    bool taken;       // Branch taken or jump; false for fall-through
+    bool back_edge;   // Target dominates the source
+};
+
+// Natural loop: a header block that dominates the source of one or more
+// back edges, and every block that reaches one of them without passing
+// through the header
+struct NaturalLoop {
+    uint32_t header;               // Start PC of the header block
+    std::vector<uint32_t> blocks;  // Start PCs of the body, in address order
+    uint32_t depth;                // 1 for outermost loops
+    uint64_t header_count;         // Header entries
+    uint64_t iterations;           // Back edges taken
+    uint64_t entries;              // Entries from outside the loop
+    uint64_t instructions;         // Instructions retired in the body
+
+    // Header entries per entry from outside
+    double average_trip_count() const {
+        return entries ? static_cast<double>(header_count) / entries : 0.0;
+    }
+};
+
+// Control-flow graph rebuilt from an exact profile: blocks from the per-PC
+// counts and taken edges, fall-through edges from the difference, then
+// dominators, back edges and natural loops. Only executed code appears.
+// Transfers not recorded as edges (e.g. a restart from a snapshot) make
+// a block an entry of the graph. Irreducible cycles have no back edge
+// and are not reported as loops. A sampled profile gives an empty graph.
+class ControlFlowGraph {
+public:
+    explicit ControlFlowGraph(const Profiler& profiler);
+
+    const std::vector<CFGBlock>& get_blocks() const { return blocks; }
+    const std::vector<CFGEdge>& get_edges() const { return edges; }
+
+    // Natural loops, most instructions retired first
+    const std::vector<NaturalLoop>& get_loops() const { return loops; }
+
+    // Block containing pc, or nullptr
+    const CFGBlock* find_block(uint32_t pc) const;
+
+    // Whether block a dominates block b (indices)
+    bool dominates(size_t a, size_t b) const;
+
+    // Candidates for compilation: start PCs of the blocks of loops whose
+    // header was entered at least threshold times, hottest loop first,
+    // then of other blocks entered that often, by instructions retired
+    std::vector<uint32_t> hot_blocks(uint64_t threshold) const;
+
+private:
+    std::vector<CFGBlock> blocks;   // In address order
+    std::vector<CFGEdge> edges;
+    std::vector<NaturalLoop> loops;
+    std::vector<size_t> idom;       // Immediate dominator; the virtual root is blocks.size()
+    std::vector<size_t> rpo_index;  // Reverse postorder number, for dominator walks
+
+    void build_blocks(const Profiler& profiler);
+    void compute_dominators();
+    void find_loops();
+};
+
+#endif // CONTROL_FLOW_H
@@ -1,22 +1,67 @@
 #include "cpu.h"
+#include "text_image.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <mutex>
 
-void CPU::dump_registers() const {
-    std::cout << "=== Register Dump ===" << std::endl;
-    const char* reg_names[] = {
+namespace {
+
+// Fault recovery state of the guest running on this thread
+thread_local CPU* fault_cpu = nullptr;
+thread_local sigjmp_buf* fault_env = nullptr;
+thread_local uint32_t fault_address = 0;
+
+// Dispositions the host-fault handler replaced, for faults that are not ours
+struct sigaction previous_segv;
+struct sigaction previous_bus;
+
+} // namespace
+
+CPU::CPU() : CPU(MemoryConfig()) {}
+
+CPU::CPU(const MemoryConfig& config)
+    : memory(config.size, config.backend, config.huge_pages),
+      flat_base(memory.flat_base()), text_start(0), text_end(0), snapshot_pc(0) {
+    // x0 is hardwired to 0
+    state.registers.fill(0);
+    state.pc = 0;
+    snapshot_registers.fill(0);
+    
+    stack_top = config.stack_top ? config.stack_top
+                                 : static_cast<uint32_t>(config.size - PAGE_SIZE);
+    if (stack_top >= config.size) {
+        throw std::invalid_argument("Stack top outside the guest address space");
+    }
+    
+    if (flat_base) {
+        install_fault_handler();
+        uint32_t stack_size = std::min(config.stack_size, stack_top);
+        memory.commit(stack_top - stack_size, stack_size);
+    }
+}
+
+CPU::~CPU() = default;
+
+const char* CPU::register_name(uint8_t reg) {
+    static const char* const reg_names[] = {
         "zero", "ra", "sp", "gp", "tp", "t0", "t1", "t2",
         "s0", "s1", "a0", "a1", "a2", "a3", "a4", "a5",
         "a6", "a7", "s2", "s3", "s4", "s5", "s6", "s7",
         "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6"
     };
+    return reg < NUM_REGISTERS ? reg_names[reg] : "?";
+}
+
+void CPU::dump_registers() const {
+    std::cout << "=== Register Dump ===" << std::endl;
     
     for (size_t i = 0; i < NUM_REGISTERS; i++) {
-        std::cout << "x" << std::setw(2) << i << " (" << std::setw(4) << reg_names[i] << "): "
+        std::cout << "x" << std::setw(2) << i << " (" << std::setw(4) << register_name(i) << "): "
                   << "0x" << std::hex << std::setw(8) << std::setfill('0') 
-                  << registers[i] << std::dec << std::endl;
+                  << state.registers[i] << std::dec << std::endl;
     }
-    std::cout << "PC: 0x" << std::hex << pc << std::dec << std::endl;
+    std::cout << "PC: 0x" << std::hex << state.pc << std::dec << std::endl;
 }
 
 void CPU::dump_memory(uint32_t start, uint32_t length) const {
@@ -29,8 +74,183 @@ void CPU::dump_memory(uint32_t start, uint32_t length) const {
         
         for (uint32_t j = 0; j < 16 && (i + j) < length; j++) {
             std::cout << std::hex << std::setw(2) << std::setfill('0') 
-                      << static_cast<int>(memory[start + i + j]) << " ";
+                      << static_cast<int>(read_byte(start + i + j)) << " ";
         }
         std::cout << std::dec << std::endl;
     }
-}
\ No newline at end of file
+}
+
+void CPU::add_code_listener(CodeWriteListener* listener) {
+    code_listeners.push_back(listener);
+}
+
+void CPU::remove_code_listener(CodeWriteListener* listener) {
+    code_listeners.erase(std::remove(code_listeners.begin(), code_listeners.end(), listener),
+                         code_listeners.end());
+}
+
+bool CPU::read_slow(uint32_t addr, void* dst, size_t length) const {
+    if (!memory.contains(addr, length)) {
+        return false;
+    }
+    memory.read(addr, dst, length);
+    return true;
+}
+
+bool CPU::write_slow(uint32_t addr, const void* src, size_t length) {
+    if (!memory.contains(addr, length)) {
+        return false;
+    }
+    // Invalidate first: under HOST_MMU this also makes code pages writable
+    notify_code_write(addr, length);
+    memory.write(addr, src, length);
+    return true;
+}
+
+bool CPU::map_file(uint32_t addr, int fd, uint64_t offset, uint64_t length) {
+    if (!memory.contains(addr, static_cast<size_t>(length))) {
+        return false;
+    }
+    notify_code_write(addr, static_cast<size_t>(length));
+    memory.map_file(addr, fd, offset, length);
+    return true;
+}
+
+bool CPU::zero_fill(uint32_t addr, uint64_t length) {
+    if (!memory.contains(addr, static_cast<size_t>(length))) {
+        return false;
+    }
+    notify_code_write(addr, static_cast<size_t>(length));
+    memory.zero(addr, length);
+    return true;
+}
+
+bool CPU::commit_memory(uint32_t addr, uint64_t length) {
+    if (!memory.contains(addr, static_cast<size_t>(length))) {
+        return false;
+    }
+    memory.commit(addr, length);
+    return true;
+}
+
+void CPU::arm_fault_recovery(sigjmp_buf* env) {
+    fault_cpu = env ? this : nullptr;
+    fault_env = env;
+}
+
+uint32_t CPU::last_fault_address() {
+    return fault_address;
+}
+
+// A store hit a write-protected page: it is dirty now, and any code
+// cached from it is stale. Both steps unprotect the page as needed.
+void CPU::handle_write_fault(uint32_t page) {
+    memory.mark_dirty(page);
+    notify_code_write(page << PAGE_SHIFT, 1);
+}
+
+void CPU::take_snapshot() {
+    snapshot_registers = state.registers;
+    snapshot_pc = state.pc;
+    memory.take_snapshot();
+}
+
+void CPU::restore_snapshot() {
+    if (!memory.has_snapshot()) {
+        throw std::logic_error("No snapshot to restore");
+    }
+    // Code cached from pages about to be overwritten goes stale
+    for (uint32_t page : memory.get_dirty_pages()) {
+        notify_code_write(page << PAGE_SHIFT, 1);
+    }
+    memory.restore_snapshot();
+    state.registers = snapshot_registers;
+    state.pc = snapshot_pc;
+}
+
+void CPU::install_fault_handler() {
+    static std::once_flag installed;
+    std::call_once(installed, [] {
+        struct sigaction action;
+        std::memset(&action, 0, sizeof(action));
+        action.sa_sigaction = handle_host_fault;
+        // SA_NODEFER: the handler leaves by siglongjmp without restoring
+        // the signal mask, so SIGSEGV must not stay blocked
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGSEGV, &action, &previous_segv);
+        sigaction(SIGBUS, &action, &previous_bus);  // macOS reports protection faults as SIGBUS
+    });
+}
+
+void CPU::handle_host_fault(int signal, siginfo_t* info, void* context) {
+    (void)context;
+    CPU* cpu = fault_cpu;
+    const uint8_t* host = static_cast<const uint8_t*>(info->si_addr);
+    
+    if (cpu && host >= cpu->flat_base && host < cpu->flat_base + GuestMemory::RESERVATION_SIZE) {
+        uint64_t offset = static_cast<uint64_t>(host - cpu->flat_base);
+        uint32_t page = static_cast<uint32_t>(offset >> PAGE_SHIFT);
+        
+        // A committed page only faults on a store while it is read-only:
+        // record it and let the store retry. The fault is synchronous,
+        // raised by a guest access in our own code, so the listeners and
+        // the dirty list are not re-entered.
+        if (offset < cpu->memory.get_size() && cpu->memory.is_committed(page)) {
+            cpu->handle_write_fault(page);
+            return;
+        }
+        
+        fault_address = static_cast<uint32_t>(offset);
+        siglongjmp(*fault_env, 1);
+    }
+    
+    // Not a guest access: restore the previous disposition and let the
+    // instruction fault again
+    sigaction(signal, signal == SIGBUS ? &previous_bus : &previous_segv, nullptr);
+}
+
+void CPU::notify_code_write(uint32_t addr, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    uint32_t first = addr >> PAGE_SHIFT;
+    uint32_t last = static_cast<uint32_t>((addr + length - 1) >> PAGE_SHIFT);
+    
+    for (uint32_t page = first; page <= last; page++) {
+        if (!memory.is_code_page(page)) {
+            continue;
+        }
+        memory.set_code_page(page, false);
+        if (text_image) {
+            text_image->invalidate_page(page);
+        }
+        for (CodeWriteListener* listener : code_listeners) {
+            listener->invalidate_code_page(page);
+        }
+    }
+}
+
+void CPU::predecode_text(uint32_t start, uint32_t length) {
+    start &= ~0x3u;
+    std::vector<uint32_t> words(length / 4);
+    if (!read_bytes(start, words.data(), words.size() * 4)) {
+        throw std::runtime_error("Text segment outside guest memory");
+    }
+    
+    install_text_image(std::make_unique<TextImage>(start, words.data(), words.size()));
+}
+
+void CPU::install_text_image(std::unique_ptr<TextImage> image) {
+    text_image = std::move(image);
+    
+    // Stores into the image must mark it stale
+    uint32_t start = text_image->get_base();
+    uint32_t end = text_image->get_end();
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        mark_code_page(addr);
+    }
+    if (end > start) {
+        mark_code_page(end - 1);
+    }
+}
@@ -1,14 +1,40 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <cstddef>
 #include <cstdint>
 #include <array>
 #include <vector>
 #include <cstring>
+#include <stdexcept>
+#include <memory>
+#include <type_traits>
+#include <setjmp.h>
+#include <signal.h>
+#include "guest_memory.h"
 
 // RISC-V has 32 general-purpose registers
 constexpr size_t NUM_REGISTERS = 32;
-constexpr size_t MEMORY_SIZE = 128 * 1024 * 1024; // 64MB
+constexpr size_t MEMORY_SIZE = 128 * 1024 * 1024; // Default address space: 128MB
+constexpr uint32_t STACK_SIZE = 8 * 1024 * 1024;   // Default stack region: 8MB
+
+// Guest address-space layout. Memory is allocated on first touch, so a
+// large address space costs nothing until it is used.
+struct MemoryConfig {
+    uint64_t size = MEMORY_SIZE;    // Address space in bytes (page multiple, up to 4 GB)
+    uint32_t stack_top = 0;         // Initial sp for loaded programs; 0 = one page below the top
+    MemoryBackend backend = MemoryBackend::PAGED;
+    uint32_t stack_size = STACK_SIZE;   // HOST_MMU: committed below stack_top
+    bool huge_pages = false;        // HOST_MMU: transparent huge pages for large commits
+};
+
+// Architectural state, laid out for compiled code: x0-x31 at 4 * n and
+// the PC after them
+struct GuestState {
+    std::array<uint32_t, NUM_REGISTERS> registers;
+    uint32_t pc;  // Program counter
+};
+static_assert(offsetof(GuestState, pc) == NUM_REGISTERS * 4, "JIT code addresses the PC after x31");
 
 // Instruction formats
 enum class InstructionType {
@@ -33,79 +59,236 @@ struct Instruction {
     int32_t imm;            // Immediate value (sign-extended)
 };
 
+// Notified when the guest stores into a page holding cached code
+class CodeWriteListener {
+public:
+    virtual ~CodeWriteListener() = default;
+    virtual void invalidate_code_page(uint32_t page) = 0;
+};
+
+class TextImage;
+
 class CPU {
 public:
-    CPU() : pc(0), memory(MEMORY_SIZE, 0) {
-        // x0 is hardwired to 0
-        registers.fill(0);
-    }
+    CPU();
+    explicit CPU(const MemoryConfig& config);
+    ~CPU();
 
     // Register access
     uint32_t get_register(uint8_t reg) const {
-        return registers[reg];
+        return state.registers[reg];
     }
 
     void set_register(uint8_t reg, uint32_t value) {
         if (reg != 0) {  // x0 is always 0
-            registers[reg] = value;
+            state.registers[reg] = value;
         }
     }
 
-    // Memory access
-    uint32_t read_word(uint32_t addr) const {
-        if (addr + 3 >= memory.size()) {
+    // Memory access, templated on access type: T is one of uint8_t,
+    // int8_t, uint16_t, int16_t, uint32_t or int32_t, which fixes width
+    // and signedness at compile time (converting a signed T to a
+    // register value sign-extends it). Accesses need not be aligned.
+
+    // Throwing; for host-side code such as loaders/tests
+    template <typename T>
+    T load(uint32_t addr) const {
+        T value;
+        if (!try_load(addr, value)) {
             throw std::runtime_error("Memory read out of bounds");
         }
-        uint32_t value;
-        std::memcpy(&value, &memory[addr], sizeof(uint32_t));
         return value;
     }
 
-    void write_word(uint32_t addr, uint32_t value) {
-        if (addr + 3 >= memory.size()) {
+    template <typename T>
+    void store(uint32_t addr, T value) {
+        if (!try_store(addr, value)) {
             throw std::runtime_error("Memory write out of bounds");
         }
-        std::memcpy(&memory[addr], &value, sizeof(uint32_t));
     }
 
-    uint8_t read_byte(uint32_t addr) const {
-        if (addr >= memory.size()) {
-            throw std::runtime_error("Memory read out of bounds");
+    uint32_t read_word(uint32_t addr) const { return load<uint32_t>(addr); }
+    void write_word(uint32_t addr, uint32_t value) { store<uint32_t>(addr, value); }
+    uint8_t read_byte(uint32_t addr) const { return load<uint8_t>(addr); }
+    void write_byte(uint32_t addr, uint8_t value) { store<uint8_t>(addr, value); }
+
+    // Non-throwing: returns false on an out-of-bounds access and leaves
+    // memory untouched. The aligned fast path is one TLB compare; the
+    // unaligned one also hits the TLB while the access stays in one
+    // page. Misses, page crossings and code pages go out of line.
+    template <typename T>
+    bool try_load(uint32_t addr, T& value) const {
+        static_assert(is_access_type<T>(), "load of unsupported type");
+        if (const uint8_t* host = memory.read_pointer(addr, sizeof(T))) {
+            std::memcpy(&value, host, sizeof(T));
+            return true;
         }
-        return memory[addr];
+        if constexpr (sizeof(T) > 1) {
+            if (const uint8_t* host = memory.read_pointer_unaligned(addr, sizeof(T))) {
+                std::memcpy(&value, host, sizeof(T));
+                return true;
+            }
+        }
+        return read_slow(addr, &value, sizeof(T));
     }
 
-    void write_byte(uint32_t addr, uint8_t value) {
-        if (addr >= memory.size()) {
-            throw std::runtime_error("Memory write out of bounds");
+    template <typename T>
+    bool try_store(uint32_t addr, T value) {
+        static_assert(is_access_type<T>(), "store of unsupported type");
+        if (uint8_t* host = memory.write_pointer(addr, sizeof(T))) {
+            std::memcpy(host, &value, sizeof(T));
+            return true;
+        }
+        if constexpr (sizeof(T) > 1) {
+            if (uint8_t* host = memory.write_pointer_unaligned(addr, sizeof(T))) {
+                std::memcpy(host, &value, sizeof(T));
+                return true;
+            }
         }
-        memory[addr] = value;
+        return write_slow(addr, &value, sizeof(T));
     }
 
+    // Loads and stores made by executed guest code. Under the HOST_MMU
+    // backend they are a single unchecked host access, aligned or not: a
+    // bad address faults in the host and comes back through
+    // arm_fault_recovery() instead of as a false return.
+    template <typename T>
+    bool guest_load(uint32_t addr, T& value) const {
+        if (flat_base) {
+            std::memcpy(&value, flat_base + addr, sizeof(T));
+            return true;
+        }
+        return try_load(addr, value);
+    }
+
+    template <typename T>
+    bool guest_store(uint32_t addr, T value) {
+        if (flat_base) {
+            std::memcpy(flat_base + addr, &value, sizeof(T));
+            return true;
+        }
+        return try_store(addr, value);
+    }
+
+    bool is_valid_address(uint32_t addr) const { return memory.contains(addr, 1); }
+
+    // Make [addr, addr + length) accessible to guest code (HOST_MMU; a
+    // no-op for PAGED). For loaders and syscalls such as brk/mmap.
+    bool commit_memory(uint32_t addr, uint64_t length);
+
+    // Bulk copies; false if any byte is out of range
+    bool read_bytes(uint32_t addr, void* dst, size_t length) const {
+        return read_slow(addr, dst, length);
+    }
+
+    bool write_bytes(uint32_t addr, const void* src, size_t length) {
+        return write_slow(addr, src, length);
+    }
+
+    // Back [addr, addr + length) with part of a file, copy-on-write, or
+    // zero a range with fresh zero pages (see GuestMemory::map_file/zero).
+    // False if the range is outside guest memory.
+    bool map_file(uint32_t addr, int fd, uint64_t offset, uint64_t length);
+    bool zero_fill(uint32_t addr, uint64_t length);
+
     // Load program into memory
     void load_program(const std::vector<uint8_t>& program, uint32_t start_addr = 0x1000) {
-        if (start_addr + program.size() > memory.size()) {
+        if (!write_bytes(start_addr, program.data(), program.size())) {
             throw std::runtime_error("Program too large for memory");
         }
-        std::memcpy(&memory[start_addr], program.data(), program.size());
-        pc = start_addr;
+        state.pc = start_addr;
+        set_text_range(start_addr, start_addr + static_cast<uint32_t>(program.size()));
     }
 
+    // Extent [start, end) of the loaded program's executable code, set by
+    // the loaders; empty until then. The profiler sizes its per-PC
+    // counters from it.
+    void set_text_range(uint32_t start, uint32_t end) {
+        text_start = start;
+        text_end = end;
+    }
+    uint32_t get_text_start() const { return text_start; }
+    uint32_t get_text_end() const { return text_end; }
+
+    // Address-space layout
+    uint64_t get_memory_size() const { return memory.get_size(); }
+    uint32_t get_stack_top() const { return stack_top; }
+    const GuestMemory& get_memory() const { return memory; }
+    uint8_t* get_flat_base() const { return flat_base; }
+
+    // HOST_MMU fault recovery for guest code running on this thread. While
+    // armed, a host fault inside the reservation is either a store into a
+    // read-only page (code, or clean under a snapshot), which is recorded
+    // and retried, or a guest memory fault, which siglongjmps to env; last_fault_address() then
+    // gives the guest address. Frames between sigsetjmp and the faulting
+    // access must not need destructors. Pass nullptr to disarm.
+    void arm_fault_recovery(sigjmp_buf* env);
+    static uint32_t last_fault_address();
+
+    // Snapshot registers, PC and memory, then restore them as often as
+    // needed, e.g. to re-run a loaded program with different inputs.
+    // Restoring copies back only the pages written since the snapshot,
+    // so it costs in proportion to what the run touched. Taking a new
+    // snapshot replaces the old one.
+    void take_snapshot();
+    void restore_snapshot();
+    bool has_snapshot() const { return memory.has_snapshot(); }
+
+    // Code-page tracking: decoders mark pages they cache, and any guest
+    // store into a marked page invalidates it for every listener
+    void mark_code_page(uint32_t addr) { memory.set_code_page(addr >> PAGE_SHIFT, true); }
+    void add_code_listener(CodeWriteListener* listener);
+    void remove_code_listener(CodeWriteListener* listener);
+
+    // Bulk-decode [start, start + length) of guest memory into a text
+    // image that fetches read instead of decoding on demand. Replaces any
+    // previous image.
+    void predecode_text(uint32_t start, uint32_t length);
+    
+    // Install an already decoded text image, replacing any previous one
+    void install_text_image(std::unique_ptr<TextImage> image);
+    const TextImage* get_text_image() const { return text_image.get(); }
+
     // Program counter
-    uint32_t get_pc() const { return pc; }
-    void set_pc(uint32_t new_pc) { pc = new_pc; }
-    void increment_pc() { pc += 4; }
+    uint32_t get_pc() const { return state.pc; }
+    void set_pc(uint32_t new_pc) { state.pc = new_pc; }
+    void increment_pc() { state.pc += 4; }
 
     // Debug
     void dump_registers() const;
     void dump_memory(uint32_t start, uint32_t length) const;
+    static const char* register_name(uint8_t reg);  // ABI name, e.g. "a0"
     uint32_t* get_register_ptr() {
-        return registers.data();
+        return state.registers.data();
     }
+    
+    // Registers and PC in place, for compiled code
+    GuestState* get_state() { return &state; }
 private:
-    std::array<uint32_t, NUM_REGISTERS> registers;
-    uint32_t pc;  // Program counter
-    std::vector<uint8_t> memory;
+    GuestState state;
+    GuestMemory memory;
+    uint8_t* flat_base;   // memory.flat_base(), nullptr for PAGED
+    uint32_t stack_top;
+    uint32_t text_start;
+    uint32_t text_end;
+    std::vector<CodeWriteListener*> code_listeners;
+    std::unique_ptr<TextImage> text_image;
+    std::array<uint32_t, NUM_REGISTERS> snapshot_registers;
+    uint32_t snapshot_pc;
+
+    bool read_slow(uint32_t addr, void* dst, size_t length) const;
+    bool write_slow(uint32_t addr, const void* src, size_t length);
+    void notify_code_write(uint32_t addr, size_t length);
+    void handle_write_fault(uint32_t page);
+
+    template <typename T>
+    static constexpr bool is_access_type() {
+        return std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+               (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4);
+    }
+
+    static void handle_host_fault(int signal, siginfo_t* info, void* context);
+    static void install_fault_handler();
 };
 
 #endif // CPU_H
\ No newline at end of file
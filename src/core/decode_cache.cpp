@@ -0,0 +1,75 @@
+#include "decode_cache.h"
+#include "text_image.h"
+
+DecodeCache::DecodeCache(CPU& cpu)
+    : cpu(cpu), current_page_num(NO_PAGE), current_page(nullptr), 
+      unaligned_slot(), decodes(0), image_fetches(0) {
+    cpu.add_code_listener(this);
+}
+
+DecodeCache::~DecodeCache() {
+    cpu.remove_code_listener(this);
+}
+
+DecodedInstruction DecodeCache::fetch_slow(uint32_t pc) {
+    const TextImage* image = cpu.get_text_image();
+    DecodedInstruction predecoded;
+    if (image && image->lookup(pc, predecoded)) {
+        image_fetches++;
+        return predecoded;
+    }
+    
+    if (pc & 0x3) {
+        // Not cacheable by slot index; decode on every fetch
+        fill(unaligned_slot, pc);
+        return unaligned_slot;
+    }
+    
+    if (!cpu.is_valid_address(pc)) {
+        // Never cache pages outside guest memory
+        unaligned_slot = DecodedInstruction{};
+        unaligned_slot.op = Operation::FETCH_FAULT;
+        return unaligned_slot;
+    }
+    
+    uint32_t page_num = pc >> PAGE_SHIFT;
+    auto& page = pages[page_num];
+    if (!page) {
+        page = std::make_unique<DecodedPage>();
+        cpu.mark_code_page(pc);
+    }
+    
+    current_page_num = page_num;
+    current_page = page.get();
+    
+    DecodedInstruction& slot = current_page->slots[(pc & (PAGE_SIZE - 1)) >> 2];
+    if (slot.op == Operation::NOT_DECODED) {
+        fill(slot, pc);
+    }
+    return slot;
+}
+
+void DecodeCache::fill(DecodedInstruction& slot, uint32_t pc) {
+    uint32_t raw;
+    if (cpu.try_load(pc, raw)) {
+        slot = Decoder::predecode(raw);
+    } else {
+        slot = DecodedInstruction{};
+        slot.op = Operation::FETCH_FAULT;
+    }
+    decodes++;
+}
+
+void DecodeCache::invalidate_code_page(uint32_t page) {
+    if (page == current_page_num) {
+        current_page_num = NO_PAGE;
+        current_page = nullptr;
+    }
+    pages.erase(page);
+}
+
+void DecodeCache::clear() {
+    current_page_num = NO_PAGE;
+    current_page = nullptr;
+    pages.clear();
+}
@@ -0,0 +1,71 @@
+#ifndef DECODE_CACHE_H
+#define DECODE_CACHE_H
+
+#include "cpu.h"
+#include "decoder.h"
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+// Predecoded instructions keyed by guest PC. Storage is one page of
+// compact records per guest code page; a guest store into a cached page
+// drops that page so self-modifying code is re-decoded on next fetch.
+class DecodeCache : public CodeWriteListener {
+public:
+    explicit DecodeCache(CPU& cpu);
+    ~DecodeCache() override;
+    
+    DecodeCache(const DecodeCache&) = delete;
+    DecodeCache& operator=(const DecodeCache&) = delete;
+    
+    // Return the predecoded instruction at pc, decoding it on a miss.
+    // PCs covered by the CPU's text image are served from the image.
+    // A PC outside guest memory yields Operation::FETCH_FAULT.
+    DecodedInstruction fetch(uint32_t pc) {
+        if ((pc >> PAGE_SHIFT) != current_page_num || (pc & 0x3)) {
+            return fetch_slow(pc);
+        }
+        DecodedInstruction& slot = current_page->slots[(pc & (PAGE_SIZE - 1)) >> 2];
+        if (slot.op == Operation::NOT_DECODED) {
+            fill(slot, pc);
+        }
+        return slot;
+    }
+    
+    // CodeWriteListener
+    void invalidate_code_page(uint32_t page) override;
+    
+    // Drop every cached decode
+    void clear();
+    
+    // Statistics
+    uint64_t get_decodes() const { return decodes; }
+    uint64_t get_image_fetches() const { return image_fetches; }
+    size_t get_cached_pages() const { return pages.size(); }
+    
+private:
+    static constexpr uint32_t SLOTS_PER_PAGE = PAGE_SIZE / 4;
+    static constexpr uint32_t NO_PAGE = ~0u;
+    
+    struct DecodedPage {
+        std::array<DecodedInstruction, SLOTS_PER_PAGE> slots{};
+    };
+    
+    CPU& cpu;
+    std::unordered_map<uint32_t, std::unique_ptr<DecodedPage>> pages;
+    
+    // Last page fetched from; loops almost always hit it
+    uint32_t current_page_num;
+    DecodedPage* current_page;
+    
+    // Misaligned or out-of-range PCs are decoded into this slot instead
+    // of the page array
+    DecodedInstruction unaligned_slot;
+    uint64_t decodes;
+    uint64_t image_fetches;
+    
+    DecodedInstruction fetch_slow(uint32_t pc);
+    void fill(DecodedInstruction& slot, uint32_t pc);
+};
+
+#endif // DECODE_CACHE_H
@@ -1,4 +1,37 @@
 #include "decoder.h"
+#include "instruction_table.h"
+#include <string>
+
+namespace {
+
+// Instruction format per major opcode, -1 for opcodes no row uses
+constexpr std::array<int8_t, 128> build_opcode_types() {
+    std::array<int8_t, 128> types{};
+    for (auto& type : types) {
+        type = -1;
+    }
+    for (size_t row = 0; row < INSTRUCTION_TABLE_SIZE; row++) {
+        const InstructionDesc& desc = INSTRUCTION_TABLE[row];
+        types[desc.match & 0x7F] = static_cast<int8_t>(desc.type);
+    }
+    return types;
+}
+
+constexpr auto OPCODE_TYPES = build_opcode_types();
+
+constexpr ImmFormat format_of(InstructionType type) {
+    switch (type) {
+        case InstructionType::I_TYPE: return ImmFormat::I;
+        case InstructionType::S_TYPE: return ImmFormat::S;
+        case InstructionType::B_TYPE: return ImmFormat::B;
+        case InstructionType::U_TYPE: return ImmFormat::U;
+        case InstructionType::J_TYPE: return ImmFormat::J;
+        case InstructionType::R_TYPE: break;
+    }
+    return ImmFormat::NONE;
+}
+
+} // namespace
 
 Instruction Decoder::decode(uint32_t raw) {
     Instruction inst;
@@ -15,81 +48,40 @@ Instruction Decoder::decode(uint32_t raw) {
     inst.funct7 = (raw >> 25) & 0x7F;
     
     // Determine instruction type
-    inst.type = get_type(inst.opcode);
+    int8_t type = OPCODE_TYPES[inst.opcode];
+    if (type < 0) {
+        throw std::runtime_error("Unknown opcode: " + std::to_string(inst.opcode));
+    }
+    inst.type = static_cast<InstructionType>(type);
     
     // Decode immediate based on type
-    switch (inst.type) {
-        case InstructionType::I_TYPE:
-            // I-type: imm[11:0] = inst[31:20]
-            inst.imm = sign_extend((raw >> 20) & 0xFFF, 12);
-            break;
-            
-        case InstructionType::S_TYPE:
-            // S-type: imm[11:5] = inst[31:25], imm[4:0] = inst[11:7]
-            inst.imm = sign_extend(
-                ((raw >> 25) << 5) | ((raw >> 7) & 0x1F), 
-                12
-            );
-            break;
-            
-        case InstructionType::B_TYPE:
-            // B-type: imm[12|10:5] = inst[31:25], imm[4:1|11] = inst[11:7]
-            inst.imm = sign_extend(
-                ((raw >> 31) << 12) |           // imm[12]
-                (((raw >> 7) & 0x1) << 11) |    // imm[11]
-                (((raw >> 25) & 0x3F) << 5) |   // imm[10:5]
-                (((raw >> 8) & 0xF) << 1),      // imm[4:1]
-                13
-            );
-            break;
-            
-        case InstructionType::U_TYPE:
-            // U-type: imm[31:12] = inst[31:12]
-            inst.imm = raw & 0xFFFFF000;
-            break;
-            
-        case InstructionType::J_TYPE:
-            // J-type: imm[20|10:1|11|19:12] = inst[31:12]
-            inst.imm = sign_extend(
-                ((raw >> 31) << 20) |               // imm[20]
-                (((raw >> 12) & 0xFF) << 12) |      // imm[19:12]
-                (((raw >> 20) & 0x1) << 11) |       // imm[11]
-                (((raw >> 21) & 0x3FF) << 1),       // imm[10:1]
-                21
-            );
-            break;
-            
-        case InstructionType::R_TYPE:
-            inst.imm = 0;  // R-type has no immediate
-            break;
-    }
+    inst.imm = extract_immediate(format_of(inst.type), raw);
     
     return inst;
 }
 
-int32_t Decoder::sign_extend(uint32_t value, int bits) {
-    // Check if sign bit is set
-    uint32_t sign_bit = 1 << (bits - 1);
-    if (value & sign_bit) {
-        // Sign extend by setting upper bits to 1
-        return value | (~0U << bits);
+DecodedInstruction Decoder::predecode(uint32_t raw) {
+    DecodedInstruction decoded;
+    const InstructionDesc* desc = find_instruction(raw);
+    
+    if (!desc) {
+        decoded.imm = static_cast<int32_t>(raw);
+        decoded.op = Operation::ILLEGAL;
+        decoded.rd = decoded.rs1 = decoded.rs2 = 0;
+        return decoded;
     }
-    return value;
+    
+    decoded.op = desc->op;
+    decoded.imm = extract_immediate(desc->format, raw);
+    // Masks rather than branches: operand usage varies instruction to instruction
+    uint32_t flags = desc->flags;
+    decoded.rd = ((raw >> 7) & 0x1F) & -(flags & INST_WRITES_RD);
+    decoded.rs1 = ((raw >> 15) & 0x1F) & -((flags & INST_READS_RS1) >> 1);
+    decoded.rs2 = ((raw >> 20) & 0x1F) & -((flags & INST_READS_RS2) >> 2);
+    return decoded;
 }
 
-InstructionType Decoder::get_type(uint8_t opcode) {
-    switch (opcode) {
-        case 0x33: return InstructionType::R_TYPE;  // ADD, SUB, AND, OR, XOR, etc.
-        case 0x13: return InstructionType::I_TYPE;  // ADDI, SLTI, XORI, etc.
-        case 0x03: return InstructionType::I_TYPE;  // LW, LH, LB
-        case 0x67: return InstructionType::I_TYPE;  // JALR
-        case 0x73: return InstructionType::I_TYPE;  // ECALL, EBREAK, CSR  ← ADD THIS LINE
-        case 0x23: return InstructionType::S_TYPE;  // SW, SH, SB
-        case 0x63: return InstructionType::B_TYPE;  // BEQ, BNE, BLT, BGE
-        case 0x37: return InstructionType::U_TYPE;  // LUI
-        case 0x17: return InstructionType::U_TYPE;  // AUIPC
-        case 0x6F: return InstructionType::J_TYPE;  // JAL
-        default:
-            throw std::runtime_error("Unknown opcode: " + std::to_string(opcode));
-    }
-}
\ No newline at end of file
+Operation Decoder::get_operation(const Instruction& inst) {
+    const InstructionDesc* desc = find_instruction(inst.raw);
+    return desc ? desc->op : Operation::ILLEGAL;
+}
@@ -3,13 +3,94 @@
 
 #include "cpu.h"
 
+// Every executable RV32I operation, in Operation enum order. Dispatch
+// tables in the interpreter are generated from this list.
+#define RV32I_OPERATIONS(X)                                         \
+    /* U/J-type */                                                  \
+    X(LUI) X(AUIPC) X(JAL)                                          \
+    /* I-type jumps and loads */                                    \
+    X(JALR) X(LB) X(LH) X(LW) X(LBU) X(LHU)                         \
+    /* S-type */                                                    \
+    X(SB) X(SH) X(SW)                                               \
+    /* B-type */                                                    \
+    X(BEQ) X(BNE) X(BLT) X(BGE) X(BLTU) X(BGEU)                     \
+    /* I-type arithmetic */                                         \
+    X(ADDI) X(SLTI) X(SLTIU) X(XORI) X(ORI) X(ANDI)                 \
+    X(SLLI) X(SRLI) X(SRAI)                                         \
+    /* R-type arithmetic */                                         \
+    X(ADD) X(SUB) X(SLL) X(SLT) X(SLTU) X(XOR) X(SRL) X(SRA)        \
+    X(OR) X(AND)                                                    \
+    /* SYSTEM: CSR accesses and other encodings execute as NOPs */  \
+    X(ECALL) X(EBREAK) X(CSR) X(SYSTEM)
+
+// Interpreter superinstructions. The decoder never produces these; the
+// basic-block builder rewrites common instruction pairs into them.
+#define FUSED_OPERATIONS(X)                                         \
+    X(LUI_ADDI)      /* li rd, imm32 */                             \
+    X(AUIPC_JALR)    /* call/tail through a PC-relative target */   \
+    X(ADDI_BEQ) X(ADDI_BNE) X(ADDI_BLT) X(ADDI_BGE)                 \
+    X(ADDI_BLTU) X(ADDI_BGEU)                                       \
+    X(BLOCK_END)     /* fall through to the next block */
+
+// Concrete RV32I operation, resolved once when an instruction is predecoded
+enum class Operation : uint8_t {
+    NOT_DECODED = 0,  // Empty decode cache slot
+    ILLEGAL,          // Unknown opcode or encoding (imm holds the raw word)
+    FETCH_FAULT,      // PC outside guest memory
+#define X(name) name,
+    RV32I_OPERATIONS(X)
+    FUSED_OPERATIONS(X)
+#undef X
+    COUNT
+};
+
+// Compact predecoded instruction (8 bytes instead of the 20-byte Instruction)
+struct DecodedInstruction {
+    int32_t imm;            // Sign-extended immediate
+    Operation op;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+};
+
+static_assert(sizeof(DecodedInstruction) == 8, "DecodedInstruction must stay compact");
+
+// Role of a jump under the standard calling convention, per the RAS hints
+// of the ISA manual: linking through ra/t0 is a call, a JALR through
+// ra/t0 that does not link is a return
+enum class CallKind : uint8_t {
+    NONE,
+    CALL,
+    RETURN
+};
+
+inline CallKind call_kind(const DecodedInstruction& inst) {
+    auto is_link = [](uint8_t reg) { return reg == 1 || reg == 5; };
+    if (inst.op == Operation::JAL) {
+        return is_link(inst.rd) ? CallKind::CALL : CallKind::NONE;
+    }
+    if (inst.op == Operation::JALR) {
+        if (is_link(inst.rd)) {
+            return CallKind::CALL;
+        }
+        return is_link(inst.rs1) ? CallKind::RETURN : CallKind::NONE;
+    }
+    return CallKind::NONE;
+}
+
+// Both decoders are driven by the constexpr tables in instruction_table.h
 class Decoder {
 public:
+    // Raw field view; throws on an unknown major opcode
     static Instruction decode(uint32_t raw_instruction);
-    
-private:
-    static int32_t sign_extend(uint32_t value, int bits);
-    static InstructionType get_type(uint8_t opcode);
+
+    // Decode straight to the compact form; never throws (unknown
+    // encodings become Operation::ILLEGAL). Register fields the
+    // operation does not use are zeroed.
+    static DecodedInstruction predecode(uint32_t raw_instruction);
+
+    // Resolve the concrete operation of a decoded instruction
+    static Operation get_operation(const Instruction& inst);
 };
 
-#endif // DECODER_H
\ No newline at end of file
+#endif // DECODER_H
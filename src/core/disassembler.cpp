@@ -0,0 +1,68 @@
+#include "disassembler.h"
+#include "instruction_table.h"
+#include <sstream>
+#include <iomanip>
+
+std::string Disassembler::disassemble(uint32_t raw, uint32_t pc) {
+    std::ostringstream out;
+    const InstructionDesc* desc = find_instruction(raw);
+    
+    if (!desc) {
+        out << ".word 0x" << std::hex << std::setw(8) << std::setfill('0') << raw;
+        return out.str();
+    }
+    
+    const char* rd = CPU::register_name((raw >> 7) & 0x1F);
+    const char* rs1 = CPU::register_name((raw >> 15) & 0x1F);
+    const char* rs2 = CPU::register_name((raw >> 20) & 0x1F);
+    int32_t imm = extract_immediate(desc->format, raw);
+    
+    out << desc->mnemonic;
+    
+    switch (desc->format) {
+        case ImmFormat::NONE:
+            if (desc->flags & INST_READS_RS2) {
+                out << " " << rd << ", " << rs1 << ", " << rs2;
+            }
+            break;
+            
+        case ImmFormat::I:
+            if (desc->flags & (INST_LOAD | INST_JUMP)) {
+                out << " " << rd << ", " << imm << "(" << rs1 << ")";
+            } else {
+                out << " " << rd << ", " << rs1 << ", " << imm;
+            }
+            break;
+            
+        case ImmFormat::SHAMT:
+            out << " " << rd << ", " << rs1 << ", " << imm;
+            break;
+            
+        case ImmFormat::S:
+            out << " " << rs2 << ", " << imm << "(" << rs1 << ")";
+            break;
+            
+        case ImmFormat::B:
+            out << " " << rs1 << ", " << rs2 << ", 0x" << std::hex << pc + imm;
+            break;
+            
+        case ImmFormat::U:
+            out << " " << rd << ", 0x" << std::hex << (static_cast<uint32_t>(imm) >> 12);
+            break;
+            
+        case ImmFormat::J:
+            out << " " << rd << ", 0x" << std::hex << pc + imm;
+            break;
+            
+        case ImmFormat::CSR:
+            out << " " << rd << ", 0x" << std::hex << imm << std::dec << ", ";
+            if (desc->flags & INST_READS_RS1) {
+                out << rs1;
+            } else {
+                out << ((raw >> 15) & 0x1F);  // zimm
+            }
+            break;
+    }
+    
+    return out.str();
+}
@@ -0,0 +1,15 @@
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <cstdint>
+#include <string>
+
+// Renders instructions from the shared instruction table, using ABI
+// register names and absolute branch/jump targets
+class Disassembler {
+public:
+    // pc is the instruction's address, used to resolve PC-relative targets
+    static std::string disassemble(uint32_t raw_instruction, uint32_t pc);
+};
+
+#endif // DISASSEMBLER_H
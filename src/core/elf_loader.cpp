@@ -1,29 +1,117 @@
 #include "elf_loader.h"
-#include <fstream>
+#include "image_cache.h"
+#include "text_image.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-void ELFLoader::load(const std::string& filename, CPU& cpu) {
-    std::ifstream file(filename, std::ios::binary);
-    if (!file) {
-        throw std::runtime_error("Could not open file: " + filename);
+namespace {
+
+// The ELF file mapped read-only for parsing; segment contents are mapped
+// into guest memory from the descriptor
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename) : fd(open(filename.c_str(), O_RDONLY)) {
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0) {
+            close_fd();
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size > 0) {
+            void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                close_fd();
+                throw std::runtime_error("Could not map file: " + filename);
+            }
+            bytes = static_cast<const uint8_t*>(mapping);
+        }
+    }
+    
+    ~MappedFile() {
+        if (bytes) {
+            munmap(const_cast<uint8_t*>(bytes), size);
+        }
+        close_fd();
+    }
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool covers(uint64_t offset, uint64_t length) const { return offset + length <= size; }
+    
+    int fd;
+    const uint8_t* bytes = nullptr;
+    size_t size = 0;
+    
+private:
+    void close_fd() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
+
+// Copy a fixed-size record out of the file, if it is all there
+template <typename T>
+bool read_record(const MappedFile& file, uint64_t offset, T& record) {
+    if (!file.covers(offset, sizeof(T))) {
+        return false;
+    }
+    std::memcpy(&record, file.bytes + offset, sizeof(T));
+    return true;
+}
+
+} // namespace
+
+LoadResult ELFLoader::load(const std::string& filename, CPU& cpu, const LoadOptions& options) {
+    MappedFile file(filename);
+    LoadResult result{0, false, false};
+    
+    // Image cache, keyed by the file's contents
+    uint64_t elf_hash = 0;
+    std::string cache_path;
+    if (!options.cache_dir.empty()) {
+        elf_hash = ImageCache::content_hash(file.bytes, file.size);
+        cache_path = ImageCache::path_for(options.cache_dir, elf_hash);
+        if (ImageCache::load(cache_path, elf_hash, file.size, cpu, options.predecode_text, result.entry)) {
+            result.from_cache = true;
+            cpu.set_pc(result.entry);
+            cpu.set_register(2, cpu.get_stack_top());
+            std::cout << "Loaded ELF file: " << filename << " from cache " << cache_path << std::endl;
+            return result;
+        }
     }
     
     // Read ELF header
     ELF32_Header header;
-    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!read_record(file, 0, header)) {
+        throw std::runtime_error("Not a valid ELF file");
+    }
     
     validate_elf(header);
     
     std::cout << "Loading ELF file: " << filename << std::endl;
     std::cout << "Entry point: 0x" << std::hex << header.e_entry << std::dec << std::endl;
     
-    // Read program headers
-    file.seekg(header.e_phoff);
+    std::vector<ELF32_ProgramHeader> phdrs(header.e_phnum);
+    if (!file.covers(header.e_phoff, phdrs.size() * sizeof(ELF32_ProgramHeader))) {
+        throw std::runtime_error("Truncated program header table");
+    }
+    std::memcpy(phdrs.data(), file.bytes + header.e_phoff, phdrs.size() * sizeof(ELF32_ProgramHeader));
+    
+    // Extent of the executable segments, for text predecode
+    uint32_t text_start = ~0u;
+    uint32_t text_end = 0;
+    std::vector<ImageCache::Segment> segments;
     
     for (int i = 0; i < header.e_phnum; i++) {
-        ELF32_ProgramHeader phdr;
-        file.read(reinterpret_cast<char*>(&phdr), sizeof(phdr));
+        const ELF32_ProgramHeader& phdr = phdrs[i];
         
         // PT_LOAD = 1 (loadable segment)
         if (phdr.p_type == 1) {
@@ -31,30 +119,136 @@ void ELFLoader::load(const std::string& filename, CPU& cpu) {
                       << " at 0x" << std::hex << phdr.p_vaddr 
                       << " (size: " << std::dec << phdr.p_filesz << " bytes)" << std::endl;
             
-            // Read segment data
-            std::vector<uint8_t> data(phdr.p_filesz);
-            file.seekg(phdr.p_offset);
-            file.read(reinterpret_cast<char*>(data.data()), phdr.p_filesz);
+            if (phdr.p_filesz > phdr.p_memsz || !file.covers(phdr.p_offset, phdr.p_filesz)) {
+                throw std::runtime_error("Truncated segment");
+            }
             
-            // Load into memory
-            for (size_t j = 0; j < data.size(); j++) {
-                cpu.write_byte(phdr.p_vaddr + j, data[j]);
+            // File-backed part: mapped copy-on-write, or copied in bulk
+            bool loaded = options.map_segments
+                ? cpu.map_file(phdr.p_vaddr, file.fd, phdr.p_offset, phdr.p_filesz)
+                : cpu.write_bytes(phdr.p_vaddr, file.bytes + phdr.p_offset, phdr.p_filesz);
+            
+            // BSS: fresh zero pages rather than zeroes written byte by byte
+            if (!loaded || !cpu.zero_fill(phdr.p_vaddr + phdr.p_filesz, phdr.p_memsz - phdr.p_filesz)) {
+                throw std::runtime_error("Segment outside guest memory");
             }
             
-            // Zero-fill remaining bytes (BSS section)
-            for (size_t j = phdr.p_filesz; j < phdr.p_memsz; j++) {
-                cpu.write_byte(phdr.p_vaddr + j, 0);
+            segments.push_back({phdr.p_vaddr, phdr.p_memsz, phdr.p_flags,
+                                file.bytes + phdr.p_offset, phdr.p_filesz});
+            
+            // PF_X = 1 (executable)
+            if ((phdr.p_flags & 1) && phdr.p_filesz > 0) {
+                text_start = std::min(text_start, phdr.p_vaddr);
+                text_end = std::max(text_end, phdr.p_vaddr + phdr.p_filesz);
             }
         }
     }
     
+    if (text_start < text_end) {
+        cpu.set_text_range(text_start, text_end);
+    }
+    if (options.predecode_text && text_start < text_end) {
+        cpu.predecode_text(text_start, text_end - text_start);
+        std::cout << "Predecoded " << (text_end - text_start) / 4 << " instructions at 0x"
+                  << std::hex << text_start << std::dec << std::endl;
+    }
+    
     // Set PC to entry point
     cpu.set_pc(header.e_entry);
+    result.entry = header.e_entry;
     
     // Set up stack pointer (x2/sp)
-    cpu.set_register(2, 0x07FFF000);
+    cpu.set_register(2, cpu.get_stack_top());
     
     std::cout << "ELF loaded successfully" << std::endl;
+    
+    if (!cache_path.empty()) {
+        // The cache always carries the predecoded text, even when this
+        // load did not install it
+        std::unique_ptr<TextImage> decoded;
+        const TextImage* text = cpu.get_text_image();
+        if (!options.predecode_text && text_start < text_end) {
+            std::vector<uint32_t> words((text_end - (text_start & ~0x3u)) / 4);
+            cpu.read_bytes(text_start & ~0x3u, words.data(), words.size() * 4);
+            decoded = std::make_unique<TextImage>(text_start & ~0x3u, words.data(), words.size());
+            text = decoded.get();
+        }
+        
+        mkdir(options.cache_dir.c_str(), 0755);
+        ImageCache::Image image{elf_hash, file.size, header.e_entry, segments,
+                                text_start < text_end ? text : nullptr};
+        result.cache_written = ImageCache::store(cache_path, image);
+        if (!result.cache_written) {
+            std::cout << "Warning: could not write image cache " << cache_path << std::endl;
+        }
+    }
+    return result;
+}
+
+SymbolTable ELFLoader::read_symbols(const std::string& filename) {
+    MappedFile file(filename);
+    SymbolTable table;
+    
+    ELF32_Header header;
+    if (!read_record(file, 0, header) || std::memcmp(header.e_ident, "\x7F" "ELF", 4) != 0 ||
+        header.e_ident[4] != 1) {
+        throw std::runtime_error("Not a valid ELF file");
+    }
+    if (header.e_shoff == 0 || header.e_shentsize != sizeof(ELF32_SectionHeader)) {
+        return table;
+    }
+    
+    std::vector<ELF32_SectionHeader> sections(header.e_shnum);
+    for (size_t i = 0; i < sections.size(); i++) {
+        if (!read_record(file, header.e_shoff + i * sizeof(ELF32_SectionHeader), sections[i])) {
+            throw std::runtime_error("Truncated section header table");
+        }
+    }
+    
+    for (const ELF32_SectionHeader& symtab : sections) {
+        // SHT_SYMTAB = 2; sh_link names its string table
+        if (symtab.sh_type != 2 || symtab.sh_link >= sections.size()) {
+            continue;
+        }
+        const ELF32_SectionHeader& strtab = sections[symtab.sh_link];
+        if (!file.covers(symtab.sh_offset, symtab.sh_size) || !file.covers(strtab.sh_offset, strtab.sh_size)) {
+            throw std::runtime_error("Truncated symbol table");
+        }
+        
+        for (uint32_t offset = 0; offset + sizeof(ELF32_Symbol) <= symtab.sh_size;
+             offset += sizeof(ELF32_Symbol)) {
+            ELF32_Symbol symbol;
+            read_record(file, symtab.sh_offset + offset, symbol);
+            
+            // STT_NOTYPE = 0, STT_FUNC = 2; labels only count inside an
+            // executable (SHF_EXECINSTR = 4) section
+            uint8_t type = symbol.st_info & 0xF;
+            if ((type != 0 && type != 2) || symbol.st_shndx == 0 || symbol.st_shndx >= sections.size() ||
+                symbol.st_name >= strtab.sh_size) {
+                continue;
+            }
+            const ELF32_SectionHeader& section = sections[symbol.st_shndx];
+            uint32_t size = symbol.st_size;
+            if (type == 0) {
+                if (!(section.sh_flags & 4) || symbol.st_value < section.sh_addr ||
+                    symbol.st_value >= section.sh_addr + section.sh_size) {
+                    continue;
+                }
+                size = section.sh_addr + section.sh_size - symbol.st_value;
+            }
+            
+            const char* name = reinterpret_cast<const char*>(file.bytes + strtab.sh_offset + symbol.st_name);
+            size_t length = strnlen(name, strtab.sh_size - symbol.st_name);
+            // Skip unnamed symbols and mapping symbols ($x, $d, ...)
+            if (length == 0 || name[0] == '$') {
+                continue;
+            }
+            table.add(symbol.st_value, size, std::string(name, length));
+        }
+    }
+    
+    table.finalize();
+    return table;
 }
 
 void ELFLoader::validate_elf(const ELF32_Header& header) {
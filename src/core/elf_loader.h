@@ -2,12 +2,40 @@
 #define ELF_LOADER_H
 
 #include "cpu.h"
+#include "symbol_table.h"
 #include <string>
 #include <vector>
 
+struct LoadOptions {
+    // Bulk-decode the executable PT_LOAD segments into the CPU's text
+    // image after loading
+    bool predecode_text = false;
+    
+    // Map segment pages from the file copy-on-write instead of copying
+    // them, so loading does not read pages the program never touches
+    bool map_segments = true;
+    
+    // Directory of the predecoded image cache; empty disables it. A hit
+    // replaces parsing, copying and decoding with mapping the cache
+    // entry; a miss loads normally and writes one.
+    std::string cache_dir;
+};
+
+// What load() did
+struct LoadResult {
+    uint32_t entry;
+    bool from_cache;       // Loaded from an image cache hit
+    bool cache_written;    // A cache entry was written for next time
+};
+
 class ELFLoader {
 public:
-    static void load(const std::string& filename, CPU& cpu);
+    static LoadResult load(const std::string& filename, CPU& cpu,
+                           const LoadOptions& options = LoadOptions());
+    
+    // Function symbols from .symtab/.strtab: FUNC symbols plus labels in
+    // executable sections. Empty for stripped files.
+    static SymbolTable read_symbols(const std::string& filename);
     
 private:
     struct ELF32_Header {
@@ -38,6 +66,28 @@ private:
         uint32_t p_align;
     };
     
+    struct ELF32_SectionHeader {
+        uint32_t sh_name;
+        uint32_t sh_type;
+        uint32_t sh_flags;
+        uint32_t sh_addr;
+        uint32_t sh_offset;
+        uint32_t sh_size;
+        uint32_t sh_link;
+        uint32_t sh_info;
+        uint32_t sh_addralign;
+        uint32_t sh_entsize;
+    };
+    
+    struct ELF32_Symbol {
+        uint32_t st_name;
+        uint32_t st_value;
+        uint32_t st_size;
+        uint8_t st_info;
+        uint8_t st_other;
+        uint16_t st_shndx;
+    };
+    
     static void validate_elf(const ELF32_Header& header);
 };
 
@@ -0,0 +1,450 @@
+#include "guest_memory.h"
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+const GuestMemory::Page GuestMemory::zero_page{};
+
+// Transparent huge page size; the reservation is aligned to it so large
+// commits can be backed by huge pages
+static constexpr uint64_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+GuestMemory::GuestMemory(uint64_t size, MemoryBackend backend, bool huge_pages)
+    : size(size), backend(backend), huge_pages(huge_pages), base(nullptr),
+      mapping(nullptr), mapping_size(0), allocated_pages(0), tracking_dirty(false) {
+    if (size == 0 || size > (uint64_t(1) << 32) || (size & (PAGE_SIZE - 1))) {
+        throw std::invalid_argument("Guest address space must be a non-zero page multiple up to 4 GB");
+    }
+    read_tlb.fill(TlbEntry{NO_TAG, 0});
+    write_tlb.fill(TlbEntry{NO_TAG, 0});
+    
+    if (backend == MemoryBackend::HOST_MMU) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+        flags |= MAP_NORESERVE;
+#endif
+        mapping_size = static_cast<size_t>(RESERVATION_SIZE + HUGE_PAGE_SIZE);
+        mapping = mmap(nullptr, mapping_size, PROT_NONE, flags, -1, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            throw std::runtime_error("Failed to reserve the guest address space");
+        }
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(mapping) + HUGE_PAGE_SIZE - 1) &
+                            ~static_cast<uintptr_t>(HUGE_PAGE_SIZE - 1);
+        base = reinterpret_cast<uint8_t*>(aligned);
+    }
+}
+
+GuestMemory::~GuestMemory() {
+    for (const auto& file_mapping : file_mappings) {
+        munmap(file_mapping.first, file_mapping.second);
+    }
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+GuestMemory::Page* GuestMemory::find_page(uint32_t page) const {
+    const Leaf* leaf = directory[page >> LEAF_BITS].get();
+    return leaf ? leaf->pages[page & (LEAF_ENTRIES - 1)] : nullptr;
+}
+
+GuestMemory::Leaf& GuestMemory::leaf_for(uint32_t page) {
+    std::unique_ptr<Leaf>& leaf = directory[page >> LEAF_BITS];
+    if (!leaf) {
+        leaf = std::make_unique<Leaf>();
+    }
+    return *leaf;
+}
+
+uint8_t GuestMemory::page_flags(uint32_t page) const {
+    const Leaf* leaf = directory[page >> LEAF_BITS].get();
+    return leaf ? leaf->flags[page & (LEAF_ENTRIES - 1)] : 0;
+}
+
+GuestMemory::Page* GuestMemory::allocate_page(uint32_t page) {
+    Page*& slot = leaf_for(page).pages[page & (LEAF_ENTRIES - 1)];
+    if (!slot) {
+        slot = new Page();
+        allocated_pages++;
+        
+        // The read TLB may still map this page to the zero page
+        TlbEntry& entry = read_tlb[page & (TLB_ENTRIES - 1)];
+        if (entry.tag == page << PAGE_SHIFT) {
+            entry.tag = NO_TAG;
+        }
+    }
+    return slot;
+}
+
+void GuestMemory::read(uint32_t addr, void* dst, size_t length) const {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    while (length > 0) {
+        uint32_t page = addr >> PAGE_SHIFT;
+        uint32_t offset = addr & (PAGE_SIZE - 1);
+        size_t chunk = std::min<size_t>(length, PAGE_SIZE - offset);
+        
+        if (base) {
+            // Uncommitted pages are PROT_NONE; they read as zeros here
+            if (is_committed(page)) {
+                std::memcpy(out, base + addr, chunk);
+            } else {
+                std::memset(out, 0, chunk);
+            }
+        } else {
+            const Page* host = find_page(page);
+            if (!host) {
+                host = &zero_page;
+            }
+            read_tlb[page & (TLB_ENTRIES - 1)] = make_entry(page, host->bytes);
+            std::memcpy(out, host->bytes + offset, chunk);
+        }
+        
+        out += chunk;
+        addr += static_cast<uint32_t>(chunk);
+        length -= chunk;
+    }
+}
+
+void GuestMemory::write(uint32_t addr, const void* src, size_t length) {
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    while (length > 0) {
+        uint32_t page = addr >> PAGE_SHIFT;
+        uint32_t offset = addr & (PAGE_SIZE - 1);
+        size_t chunk = std::min<size_t>(length, PAGE_SIZE - offset);
+        
+        if (base) {
+            if (!is_committed(page)) {
+                commit(page << PAGE_SHIFT, PAGE_SIZE);
+            }
+            mark_dirty(page);
+            std::memcpy(base + addr, in, chunk);
+        } else {
+            Page* host = allocate_page(page);
+            mark_dirty(page);
+            if (!is_code_page(page)) {
+                write_tlb[page & (TLB_ENTRIES - 1)] = make_entry(page, host->bytes);
+            }
+            std::memcpy(host->bytes + offset, in, chunk);
+        }
+        
+        in += chunk;
+        addr += static_cast<uint32_t>(chunk);
+        length -= chunk;
+    }
+}
+
+void GuestMemory::commit(uint32_t addr, uint64_t length) {
+    if (!base || length == 0) {
+        return;
+    }
+    uint32_t first = addr >> PAGE_SHIFT;
+    uint32_t last = static_cast<uint32_t>((addr + length - 1) >> PAGE_SHIFT);
+    uint8_t* start = base + (uint64_t(first) << PAGE_SHIFT);
+    size_t bytes = static_cast<size_t>((uint64_t(last - first) + 1) << PAGE_SHIFT);
+    
+    if (mprotect(start, bytes, PROT_READ | PROT_WRITE) != 0) {
+        throw std::runtime_error("Failed to commit guest memory");
+    }
+#ifdef MADV_HUGEPAGE
+    // Opt-in: only worth it for large regions such as heaps
+    if (huge_pages && bytes >= HUGE_PAGE_SIZE) {
+        madvise(start, bytes, MADV_HUGEPAGE);
+    }
+#endif
+    
+    for (uint32_t page = first; page <= last; page++) {
+        uint8_t& flags = leaf_for(page).flags[page & (LEAF_ENTRIES - 1)];
+        if (!(flags & PAGE_COMMITTED)) {
+            flags |= PAGE_COMMITTED;
+            allocated_pages++;
+            // Not in the snapshot: a restore has to zero it
+            if (tracking_dirty) {
+                flags |= PAGE_DIRTY;
+                dirty_pages.push_back(page);
+            }
+        }
+        if ((flags & PAGE_CODE) || (tracking_dirty && !(flags & PAGE_DIRTY))) {
+            protect_page(page);
+        }
+    }
+}
+
+bool GuestMemory::is_committed(uint32_t page) const {
+    return page_flags(page) & PAGE_COMMITTED;
+}
+
+bool GuestMemory::is_code_page(uint32_t page) const {
+    return page_flags(page) & PAGE_CODE;
+}
+
+void GuestMemory::set_code_page(uint32_t page, bool code) {
+    if (!code && !directory[page >> LEAF_BITS]) {
+        return;
+    }
+    uint8_t& flags = leaf_for(page).flags[page & (LEAF_ENTRIES - 1)];
+    flags = code ? (flags | PAGE_CODE) : (flags & ~PAGE_CODE);
+    
+    if (base) {
+        protect_page(page);
+        return;
+    }
+    
+    // Writes to a code page must reach the slow path
+    TlbEntry& entry = write_tlb[page & (TLB_ENTRIES - 1)];
+    if (code && entry.tag == page << PAGE_SHIFT) {
+        entry.tag = NO_TAG;
+    }
+}
+
+// HOST_MMU: committed code pages, and clean pages while a snapshot is
+// tracked, are read-only so guest stores into them fault; other
+// committed pages are read/write
+void GuestMemory::protect_page(uint32_t page) const {
+    uint8_t flags = page_flags(page);
+    if (!(flags & PAGE_COMMITTED)) {
+        return;
+    }
+    bool read_only = (flags & PAGE_CODE) || (tracking_dirty && !(flags & PAGE_DIRTY));
+    int protection = read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+    if (mprotect(base + (uint64_t(page) << PAGE_SHIFT), PAGE_SIZE, protection) != 0) {
+        throw std::runtime_error("Failed to protect guest code page");
+    }
+}
+
+uint8_t* GuestMemory::page_bytes(uint32_t page) const {
+    if (base) {
+        return is_committed(page) ? base + (uint64_t(page) << PAGE_SHIFT) : nullptr;
+    }
+    Page* host = find_page(page);
+    return host ? host->bytes : nullptr;
+}
+
+// Visit allocated (PAGED) or committed (HOST_MMU) pages in address order
+template <typename Visit>
+void GuestMemory::for_each_resident_page(Visit&& visit) const {
+    for (uint32_t dir = 0; dir < DIRECTORY_ENTRIES; dir++) {
+        const Leaf* leaf = directory[dir].get();
+        if (!leaf) {
+            continue;
+        }
+        for (uint32_t i = 0; i < LEAF_ENTRIES; i++) {
+            if (base ? (leaf->flags[i] & PAGE_COMMITTED) : leaf->pages[i] != nullptr) {
+                visit((dir << LEAF_BITS) | i);
+            }
+        }
+    }
+}
+
+void GuestMemory::take_snapshot() {
+    // Zero pages need no copy: restoring a page without one zeroes it
+    snapshot_pages.clear();
+    for_each_resident_page([this](uint32_t page) {
+        const uint8_t* bytes = page_bytes(page);
+        if (std::memcmp(bytes, zero_page.bytes, PAGE_SIZE) != 0) {
+            std::unique_ptr<Page> copy(new Page);
+            std::memcpy(copy->bytes, bytes, PAGE_SIZE);
+            snapshot_pages.emplace(page, std::move(copy));
+        }
+    });
+    
+    for (uint32_t page : dirty_pages) {
+        leaf_for(page).flags[page & (LEAF_ENTRIES - 1)] &= ~PAGE_DIRTY;
+    }
+    dirty_pages.clear();
+    tracking_dirty = true;
+    
+    if (!base) {
+        // First writes must reach write() to be recorded
+        write_tlb.fill(TlbEntry{NO_TAG, 0});
+        return;
+    }
+    
+    // Write-protect every committed page, one mprotect per contiguous run
+    uint64_t run_start = 0, run_end = 0;
+    auto protect_run = [this](uint64_t start, uint64_t end) {
+        if (end > start && mprotect(base + (start << PAGE_SHIFT),
+                                    static_cast<size_t>((end - start) << PAGE_SHIFT), PROT_READ) != 0) {
+            throw std::runtime_error("Failed to write-protect guest memory");
+        }
+    };
+    for_each_resident_page([&](uint32_t page) {
+        if (page != run_end) {
+            protect_run(run_start, run_end);
+            run_start = page;
+        }
+        run_end = uint64_t(page) + 1;
+    });
+    protect_run(run_start, run_end);
+}
+
+void GuestMemory::restore_snapshot() {
+    for (uint32_t page : dirty_pages) {
+        // Dirty pages are writable once callers dropped their code flags;
+        // under PAGED, zero() may have released them
+        uint8_t* bytes = page_bytes(page);
+        auto saved = snapshot_pages.find(page);
+        if (saved != snapshot_pages.end()) {
+            if (!bytes) {
+                bytes = allocate_page(page)->bytes;
+            }
+            std::memcpy(bytes, saved->second->bytes, PAGE_SIZE);
+        } else if (bytes) {
+            std::memset(bytes, 0, PAGE_SIZE);
+        }
+        leaf_for(page).flags[page & (LEAF_ENTRIES - 1)] &= ~PAGE_DIRTY;
+        if (base) {
+            protect_page(page);
+        }
+    }
+    dirty_pages.clear();
+    if (!base) {
+        write_tlb.fill(TlbEntry{NO_TAG, 0});
+    }
+}
+
+void GuestMemory::mark_dirty(uint32_t page) {
+    if (!tracking_dirty) {
+        return;
+    }
+    uint8_t& flags = leaf_for(page).flags[page & (LEAF_ENTRIES - 1)];
+    if (flags & PAGE_DIRTY) {
+        return;
+    }
+    flags |= PAGE_DIRTY;
+    dirty_pages.push_back(page);
+    if (base) {
+        protect_page(page);
+    }
+}
+
+// Host pages must match guest pages for whole-page file mappings
+static bool host_page_size_matches() {
+    static const bool matches = sysconf(_SC_PAGESIZE) == static_cast<long>(PAGE_SIZE);
+    return matches;
+}
+
+void GuestMemory::map_file(uint32_t addr, int fd, uint64_t offset, uint64_t length) {
+    uint64_t end = uint64_t(addr) + length;
+    uint64_t first_full = (uint64_t(addr) + PAGE_SIZE - 1) & ~uint64_t(PAGE_SIZE - 1);
+    uint64_t last_full = end & ~uint64_t(PAGE_SIZE - 1);
+    if (first_full >= last_full || !host_page_size_matches() ||
+        ((offset - addr) & (PAGE_SIZE - 1)) != 0) {
+        copy_from_file(addr, fd, offset, length);
+        return;
+    }
+    
+    copy_from_file(addr, fd, offset, first_full - addr);
+    
+    uint64_t file_offset = offset + (first_full - addr);
+    size_t bytes = static_cast<size_t>(last_full - first_full);
+    uint32_t first_page = static_cast<uint32_t>(first_full >> PAGE_SHIFT);
+    uint32_t page_count = static_cast<uint32_t>(bytes >> PAGE_SHIFT);
+    if (base) {
+        void* target = base + first_full;
+        if (mmap(target, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd,
+                 static_cast<off_t>(file_offset)) == MAP_FAILED) {
+            throw std::runtime_error("Failed to map file into guest memory");
+        }
+        for (uint32_t i = 0; i < page_count; i++) {
+            replace_page(first_page + i, nullptr);
+        }
+    } else {
+        void* host = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd,
+                          static_cast<off_t>(file_offset));
+        if (host == MAP_FAILED) {
+            throw std::runtime_error("Failed to map file into guest memory");
+        }
+        file_mappings.emplace_back(host, bytes);
+        Page* pages = static_cast<Page*>(host);
+        for (uint32_t i = 0; i < page_count; i++) {
+            replace_page(first_page + i, &pages[i]);
+        }
+    }
+    
+    copy_from_file(static_cast<uint32_t>(last_full), fd, offset + (last_full - addr), end - last_full);
+}
+
+void GuestMemory::zero(uint32_t addr, uint64_t length) {
+    uint64_t end = uint64_t(addr) + length;
+    uint64_t first_full = (uint64_t(addr) + PAGE_SIZE - 1) & ~uint64_t(PAGE_SIZE - 1);
+    uint64_t last_full = end & ~uint64_t(PAGE_SIZE - 1);
+    if (first_full >= last_full) {
+        // No whole page: at most the ends of two pages
+        uint64_t split = std::min(end, first_full);
+        write(addr, zero_page.bytes, static_cast<size_t>(split - addr));
+        write(static_cast<uint32_t>(split), zero_page.bytes, static_cast<size_t>(end - split));
+        return;
+    }
+    
+    write(addr, zero_page.bytes, static_cast<size_t>(first_full - addr));
+    
+    if (base) {
+        // Fresh anonymous memory replaces whatever was committed there
+        if (mmap(base + first_full, static_cast<size_t>(last_full - first_full), PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+            throw std::runtime_error("Failed to zero guest memory");
+        }
+    }
+    for (uint64_t at = first_full; at < last_full; at += PAGE_SIZE) {
+        replace_page(static_cast<uint32_t>(at >> PAGE_SHIFT), nullptr);
+    }
+    
+    write(static_cast<uint32_t>(last_full), zero_page.bytes, static_cast<size_t>(end - last_full));
+}
+
+// A page's contents were just replaced wholesale: PAGED points it at host
+// (a file-mapped page, or nullptr to read as zeros again), HOST_MMU has
+// already remapped it. Either way it counts as written.
+void GuestMemory::replace_page(uint32_t page, Page* host) {
+    Leaf& leaf = leaf_for(page);
+    uint32_t index = page & (LEAF_ENTRIES - 1);
+    uint8_t& flags = leaf.flags[index];
+    
+    if (base) {
+        if (!(flags & PAGE_COMMITTED)) {
+            flags |= PAGE_COMMITTED;
+            allocated_pages++;
+        }
+    } else {
+        Page*& slot = leaf.pages[index];
+        if (slot) {
+            if (!(flags & PAGE_MAPPED)) {
+                delete slot;
+            }
+            allocated_pages--;
+        }
+        slot = host;
+        flags = host ? (flags | PAGE_MAPPED) : (flags & ~PAGE_MAPPED);
+        if (host) {
+            allocated_pages++;
+        }
+        evict_tlb(page);
+    }
+    
+    mark_dirty(page);
+}
+
+void GuestMemory::evict_tlb(uint32_t page) {
+    for (TlbEntry* entry : {&read_tlb[page & (TLB_ENTRIES - 1)], &write_tlb[page & (TLB_ENTRIES - 1)]}) {
+        if (entry->tag == page << PAGE_SHIFT) {
+            entry->tag = NO_TAG;
+        }
+    }
+}
+
+void GuestMemory::copy_from_file(uint32_t addr, int fd, uint64_t offset, uint64_t length) {
+    uint8_t buffer[16 * PAGE_SIZE];
+    while (length > 0) {
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(length, sizeof(buffer)));
+        ssize_t got = pread(fd, buffer, chunk, static_cast<off_t>(offset));
+        if (got <= 0) {
+            throw std::runtime_error("Failed to read file into guest memory");
+        }
+        write(addr, buffer, static_cast<size_t>(got));
+        addr += static_cast<uint32_t>(got);
+        offset += static_cast<uint64_t>(got);
+        length -= static_cast<uint64_t>(got);
+    }
+}
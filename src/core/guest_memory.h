@@ -0,0 +1,241 @@
+#ifndef GUEST_MEMORY_H
+#define GUEST_MEMORY_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Guest page granularity: allocation, code-write tracking and the TLBs
+constexpr uint32_t PAGE_SHIFT = 12;
+constexpr uint32_t PAGE_SIZE = 1u << PAGE_SHIFT;
+
+// How guest memory is backed
+enum class MemoryBackend {
+    PAGED,     // Software page table and TLBs; every access is checked
+    HOST_MMU   // Flat 4 GB host reservation; the host MMU checks accesses
+};
+
+// Sparse guest address space. Pages are 4 KB, found through a two-level
+// page table and allocated (zeroed) on first write; reading a page that
+// was never written returns zeros without allocating it. Unused parts of
+// the address space therefore cost nothing.
+//
+// Each page carries a "code" flag set by decoders. Writes to a code page
+// take the slow path so the owner can invalidate cached decodes; the
+// write TLB only ever holds non-code pages.
+//
+// The HOST_MMU backend instead reserves the whole 4 GB guest space (plus
+// a guard page) as one PROT_NONE host mapping, so guest address a lives
+// at flat_base() + a. Regions are committed read/write on demand and the
+// kernel supplies zero pages lazily; everything else stays inaccessible,
+// so executed code can use unchecked host accesses and let the host fault
+// on bad addresses (see CPU::arm_fault_recovery). Code pages are mapped
+// read-only to catch stores into them. The TLBs stay empty.
+//
+// ELF segments can be mapped straight from the file with MAP_PRIVATE, so
+// loading costs nothing until pages are touched and guest writes are
+// copy-on-write in the host; zeroed ranges become fresh zero pages.
+//
+// A snapshot copies the resident pages once and then tracks which pages
+// are written: PAGED routes the first write to each page through the
+// slow path by flushing the write TLB, HOST_MMU write-protects clean
+// pages and takes one host fault per page. Restoring copies back only
+// the dirty pages.
+class GuestMemory {
+public:
+    // size is the address space in bytes (page multiple, at most 4 GB).
+    // huge_pages asks for transparent huge pages on large commits.
+    explicit GuestMemory(uint64_t size, MemoryBackend backend = MemoryBackend::PAGED,
+                         bool huge_pages = false);
+    ~GuestMemory();
+
+    GuestMemory(const GuestMemory&) = delete;
+    GuestMemory& operator=(const GuestMemory&) = delete;
+
+    uint64_t get_size() const { return size; }
+    MemoryBackend get_backend() const { return backend; }
+    bool contains(uint32_t addr, size_t length) const {
+        return static_cast<uint64_t>(addr) + length <= size;
+    }
+
+    // Host pointer for reading length bytes at addr, or nullptr when the
+    // access is not covered by the read TLB. One compare checks both the
+    // page tag and natural alignment, so misaligned (possibly page
+    // crossing) accesses take the slow path.
+    const uint8_t* read_pointer(uint32_t addr, size_t length) const {
+        const TlbEntry& entry = read_tlb[(addr >> PAGE_SHIFT) & (TLB_ENTRIES - 1)];
+        if ((addr & (~(PAGE_SIZE - 1) | static_cast<uint32_t>(length - 1))) != entry.tag) {
+            return nullptr;
+        }
+        return reinterpret_cast<const uint8_t*>(entry.addend + addr);
+    }
+
+    // Host pointer for writing length bytes at addr, or nullptr when the
+    // page is not in the write TLB (unallocated, code page or miss)
+    uint8_t* write_pointer(uint32_t addr, size_t length) {
+        const TlbEntry& entry = write_tlb[(addr >> PAGE_SHIFT) & (TLB_ENTRIES - 1)];
+        if ((addr & (~(PAGE_SIZE - 1) | static_cast<uint32_t>(length - 1))) != entry.tag) {
+            return nullptr;
+        }
+        return reinterpret_cast<uint8_t*>(entry.addend + addr);
+    }
+
+    // Unaligned variants: the access only has to stay inside one page
+    // that is in the TLB
+    const uint8_t* read_pointer_unaligned(uint32_t addr, size_t length) const {
+        const TlbEntry& entry = read_tlb[(addr >> PAGE_SHIFT) & (TLB_ENTRIES - 1)];
+        if ((addr & (PAGE_SIZE - 1)) > PAGE_SIZE - length || (addr & ~(PAGE_SIZE - 1)) != entry.tag) {
+            return nullptr;
+        }
+        return reinterpret_cast<const uint8_t*>(entry.addend + addr);
+    }
+
+    uint8_t* write_pointer_unaligned(uint32_t addr, size_t length) {
+        const TlbEntry& entry = write_tlb[(addr >> PAGE_SHIFT) & (TLB_ENTRIES - 1)];
+        if ((addr & (PAGE_SIZE - 1)) > PAGE_SIZE - length || (addr & ~(PAGE_SIZE - 1)) != entry.tag) {
+            return nullptr;
+        }
+        return reinterpret_cast<uint8_t*>(entry.addend + addr);
+    }
+
+    // Bulk copies, also the TLB refill path; callers check contains()
+    // first. write() does not report code pages and, under HOST_MMU,
+    // needs them cleared first; see CPU::write_slow.
+    void read(uint32_t addr, void* dst, size_t length) const;
+    void write(uint32_t addr, const void* src, size_t length);
+
+    // Back [addr, addr + length) with bytes [offset, offset + length) of
+    // file fd, copy-on-write. Whole pages are mmapped MAP_PRIVATE and read
+    // from disk only when touched; partial pages at either end are
+    // copied. Falls back to copying everything when the file and guest
+    // offsets disagree modulo the page size. Callers check contains()
+    // first and drop code pages in the range (see CPU::map_file).
+    void map_file(uint32_t addr, int fd, uint64_t offset, uint64_t length);
+
+    // Zero [addr, addr + length): whole pages are replaced by fresh zero
+    // pages (released under PAGED, new anonymous memory under HOST_MMU).
+    // Same caller obligations as map_file().
+    void zero(uint32_t addr, uint64_t length);
+
+    // HOST_MMU: base of the flat reservation, nullptr for PAGED
+    uint8_t* flat_base() const { return base; }
+
+    // Make [addr, addr + length) accessible to unchecked guest accesses.
+    // Writes commit the pages they touch; the ELF loader and syscalls
+    // commit ahead of guest code. No-op for PAGED. Callers check
+    // contains() first.
+    void commit(uint32_t addr, uint64_t length);
+    bool is_committed(uint32_t page) const;
+
+    // Code-page flags (page = addr >> PAGE_SHIFT)
+    bool is_code_page(uint32_t page) const;
+    void set_code_page(uint32_t page, bool code);
+
+    // Snapshot of every resident page; starts dirty tracking and replaces
+    // any previous snapshot
+    void take_snapshot();
+    bool has_snapshot() const { return tracking_dirty; }
+
+    // Copy back the pages written since the snapshot (pages that did not
+    // exist then are zeroed) and mark everything clean again. Callers
+    // invalidate code in get_dirty_pages() first, see CPU::restore_snapshot.
+    void restore_snapshot();
+
+    // Pages written since the snapshot, in order of first write
+    const std::vector<uint32_t>& get_dirty_pages() const { return dirty_pages; }
+    size_t get_snapshot_pages() const { return snapshot_pages.size(); }
+
+    // Record a write to page; HOST_MMU unprotects it. Called by write()
+    // and by the CPU's fault handler.
+    void mark_dirty(uint32_t page);
+
+    // Statistics: allocated (PAGED) or committed (HOST_MMU) pages
+    size_t get_allocated_pages() const { return allocated_pages; }
+
+    // Host bytes reserved for the HOST_MMU backend: 4 GB plus a guard page
+    // for accesses that start just below 4 GB
+    static constexpr uint64_t RESERVATION_SIZE = (uint64_t(1) << 32) + PAGE_SIZE;
+
+private:
+    static constexpr uint32_t LEAF_BITS = 10;
+    static constexpr uint32_t LEAF_ENTRIES = 1u << LEAF_BITS;
+    static constexpr uint32_t DIRECTORY_ENTRIES = 1u << (32 - PAGE_SHIFT - LEAF_BITS);
+    static constexpr uint32_t TLB_ENTRIES = 256;
+    static constexpr uint32_t NO_TAG = ~0u;     // Low bits set: never matches
+
+    struct Page {
+        uint8_t bytes[PAGE_SIZE];
+    };
+
+    // Per-page flags
+    static constexpr uint8_t PAGE_CODE = 1;
+    static constexpr uint8_t PAGE_COMMITTED = 2;     // HOST_MMU only
+    static constexpr uint8_t PAGE_DIRTY = 4;         // Written since the snapshot
+    static constexpr uint8_t PAGE_MAPPED = 8;        // PAGED: lives in a file mapping
+
+    // Second level: 1024 pages (4 MB of address space). Pages are owned
+    // unless PAGE_MAPPED.
+    struct Leaf {
+        std::array<Page*, LEAF_ENTRIES> pages{};
+        std::array<uint8_t, LEAF_ENTRIES> flags{};
+        
+        Leaf() = default;
+        Leaf(const Leaf&) = delete;
+        Leaf& operator=(const Leaf&) = delete;
+        ~Leaf() {
+            for (uint32_t i = 0; i < LEAF_ENTRIES; i++) {
+                if (!(flags[i] & PAGE_MAPPED)) {
+                    delete pages[i];
+                }
+            }
+        }
+    };
+
+    // tag is the guest page address; host = addend + guest address
+    struct TlbEntry {
+        uint32_t tag;
+        uintptr_t addend;
+    };
+
+    static TlbEntry make_entry(uint32_t page, const uint8_t* host) {
+        return TlbEntry{page << PAGE_SHIFT,
+                        reinterpret_cast<uintptr_t>(host) - (uintptr_t(page) << PAGE_SHIFT)};
+    }
+
+    uint64_t size;
+    MemoryBackend backend;
+    bool huge_pages;
+    uint8_t* base;                  // HOST_MMU: guest address 0
+    void* mapping;                  // HOST_MMU: the whole host mapping
+    size_t mapping_size;
+    std::vector<std::pair<void*, size_t>> file_mappings;   // PAGED: mapped segments
+    std::array<std::unique_ptr<Leaf>, DIRECTORY_ENTRIES> directory;
+    size_t allocated_pages;
+
+    // Snapshot contents of pages that were non-zero when it was taken
+    bool tracking_dirty;
+    std::unordered_map<uint32_t, std::unique_ptr<Page>> snapshot_pages;
+    std::vector<uint32_t> dirty_pages;
+
+    mutable std::array<TlbEntry, TLB_ENTRIES> read_tlb;
+    std::array<TlbEntry, TLB_ENTRIES> write_tlb;
+
+    // Shared zero page backing reads of unallocated pages
+    static const Page zero_page;
+
+    Page* find_page(uint32_t page) const;
+    Page* allocate_page(uint32_t page);
+    uint8_t page_flags(uint32_t page) const;
+    Leaf& leaf_for(uint32_t page);
+    void protect_page(uint32_t page) const;
+    void replace_page(uint32_t page, Page* host);
+    void evict_tlb(uint32_t page);
+    void copy_from_file(uint32_t addr, int fd, uint64_t offset, uint64_t length);
+    uint8_t* page_bytes(uint32_t page) const;      // nullptr if not resident
+    template <typename Visit> void for_each_resident_page(Visit&& visit) const;
+};
+
+#endif // GUEST_MEMORY_H
@@ -0,0 +1,308 @@
+#include "image_cache.h"
+#include "text_image.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'R', 'V', 'I', 'M', 'A', 'G', 'E', 0};
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t operation_count;   // Operation::COUNT of the decoder that wrote it
+    uint64_t elf_hash;
+    uint64_t elf_size;
+    uint64_t file_size;
+    uint64_t checksum;          // Over [sizeof(CacheHeader), data_offset)
+    uint64_t data_offset;       // First byte of segment data
+    uint32_t entry;
+    uint32_t segment_count;
+    uint32_t text_base;
+    uint32_t text_count;
+};
+
+struct CacheSegment {
+    uint32_t vaddr;
+    uint32_t filesz;
+    uint32_t memsz;
+    uint32_t flags;
+    uint64_t offset;
+    uint64_t hash;              // content_hash of its filesz bytes
+};
+
+uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+
+uint64_t mix(uint64_t lane, uint64_t word) {
+    return rotl(lane + word * PRIME2, 31) * PRIME1;
+}
+
+uint64_t round_up(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Byte offsets of the text field arrays relative to the text section
+struct TextLayout {
+    uint64_t rd, rs1, rs2, imm, end;
+
+    explicit TextLayout(uint64_t count)
+        : rd(count), rs1(2 * count), rs2(3 * count), imm(round_up(4 * count, 4)),
+          end(round_up(4 * count, 4) + 4 * count) {}
+};
+
+bool write_all(int fd, const void* data, size_t length, uint64_t offset) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        ssize_t written = pwrite(fd, bytes, length, static_cast<off_t>(offset));
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        length -= static_cast<size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
+}
+
+// Cache file open for a load. Only the metadata (everything before the
+// segment bytes) is mapped here, populated up front since all of it is
+// read; segment pages are mapped into guest memory from fd separately.
+// A text image adopts its field arrays from this mapping in place.
+class CacheFile {
+public:
+    explicit CacheFile(const std::string& path) : fd(open(path.c_str(), O_RDONLY)) {
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) != 0 ||
+            pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) {
+            return;
+        }
+        size = static_cast<uint64_t>(info.st_size);
+        if (header.data_offset < sizeof(header) || header.data_offset > size) {
+            return;
+        }
+        void* mapping = mmap(nullptr, header.data_offset, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            metadata = static_cast<const uint8_t*>(mapping);
+        }
+    }
+
+    ~CacheFile() {
+        if (metadata) {
+            munmap(const_cast<uint8_t*>(metadata), header.data_offset);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    CacheFile(const CacheFile&) = delete;
+    CacheFile& operator=(const CacheFile&) = delete;
+
+    int fd;
+    CacheHeader header{};
+    const uint8_t* metadata = nullptr;
+    uint64_t size = 0;
+};
+
+// content_hash of size bytes of fd at offset, read through a temporary
+// mapping; false if they cannot be mapped
+bool hash_file_range(int fd, uint64_t offset, uint64_t size, uint64_t& hash) {
+    const uint64_t start = offset & ~uint64_t(PAGE_SIZE - 1);
+    const uint64_t length = offset - start + size;
+    if (length == 0) {
+        hash = ImageCache::content_hash(nullptr, 0);
+        return true;
+    }
+    void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(start));
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    hash = ImageCache::content_hash(static_cast<const uint8_t*>(mapping) + (offset - start), size);
+    munmap(mapping, length);
+    return true;
+}
+
+} // namespace
+
+// XXH64-style: four independent lanes over 32-byte stripes, then a tail
+uint64_t ImageCache::content_hash(const uint8_t* data, size_t size) {
+    uint64_t lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; lane++) {
+            uint64_t word;
+            std::memcpy(&word, data + i + lane * 8, 8);
+            lanes[lane] = mix(lanes[lane], word);
+        }
+    }
+
+    uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    hash += size;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        hash = rotl(hash ^ mix(0, word), 27) * PRIME1 + PRIME3;
+    }
+    for (; i < size; i++) {
+        hash = rotl(hash ^ (data[i] * PRIME3), 11) * PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    return hash ^ (hash >> 32);
+}
+
+std::string ImageCache::path_for(const std::string& directory, uint64_t elf_hash) {
+    static const char digits[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; i--, elf_hash >>= 4) {
+        name[i] = digits[elf_hash & 0xF];
+    }
+    return directory + "/" + name + ".rvimg";
+}
+
+bool ImageCache::load(const std::string& path, uint64_t elf_hash, uint64_t elf_size,
+                      CPU& cpu, bool install_text, uint32_t& entry) {
+    auto file = std::make_shared<CacheFile>(path);
+    if (!file->metadata) {
+        return false;
+    }
+
+    // Header: right format, right decoder, right ELF, whole file present
+    const CacheHeader& header = file->header;
+    if (std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != VERSION ||
+        header.operation_count != static_cast<uint32_t>(Operation::COUNT) ||
+        header.elf_hash != elf_hash || header.elf_size != elf_size || header.file_size != file->size) {
+        return false;
+    }
+
+    // Metadata: in bounds and intact. The checksum stands in for
+    // validating each predecoded field.
+    const uint64_t segments_offset = sizeof(CacheHeader);
+    const uint64_t text_offset = segments_offset + uint64_t(header.segment_count) * sizeof(CacheSegment);
+    const TextLayout text(header.text_count);
+    if (text_offset + text.end > header.data_offset ||
+        content_hash(file->metadata + segments_offset, header.data_offset - segments_offset) != header.checksum) {
+        return false;
+    }
+
+    std::vector<CacheSegment> segments(header.segment_count);
+    std::memcpy(segments.data(), file->metadata + segments_offset, segments.size() * sizeof(CacheSegment));
+    for (const CacheSegment& segment : segments) {
+        if (segment.filesz > segment.memsz || segment.offset < header.data_offset ||
+            segment.offset + segment.filesz > file->size ||
+            !cpu.get_memory().contains(segment.vaddr, segment.memsz)) {
+            return false;
+        }
+    }
+
+    // Segment bytes: intact, or the guest would run whatever a damaged
+    // file holds and disagree with the predecoded text
+    for (const CacheSegment& segment : segments) {
+        uint64_t hash;
+        if (!hash_file_range(file->fd, segment.offset, segment.filesz, hash) || hash != segment.hash) {
+            return false;
+        }
+    }
+
+    // Valid: map the segments and adopt the predecoded text in place
+    uint32_t text_start = ~0u;
+    uint32_t text_end = 0;
+    for (const CacheSegment& segment : segments) {
+        cpu.map_file(segment.vaddr, file->fd, segment.offset, segment.filesz);
+        cpu.zero_fill(segment.vaddr + segment.filesz, segment.memsz - segment.filesz);
+        if ((segment.flags & 1) && segment.filesz > 0) {  // PF_X
+            text_start = std::min(text_start, segment.vaddr);
+            text_end = std::max(text_end, segment.vaddr + segment.filesz);
+        }
+    }
+    if (text_start < text_end) {
+        cpu.set_text_range(text_start, text_end);
+    }
+    if (install_text && header.text_count > 0) {
+        const uint8_t* fields = file->metadata + text_offset;
+        cpu.install_text_image(std::make_unique<TextImage>(
+            header.text_base, header.text_count, reinterpret_cast<const Operation*>(fields),
+            fields + text.rd, fields + text.rs1, fields + text.rs2,
+            reinterpret_cast<const int32_t*>(fields + text.imm), file));
+    }
+    entry = header.entry;
+    return true;
+}
+
+bool ImageCache::store(const std::string& path, const Image& image) {
+    const uint32_t text_count = image.text ? static_cast<uint32_t>(image.text->get_instruction_count()) : 0;
+    const TextLayout text(text_count);
+    const uint64_t text_offset = sizeof(CacheHeader) + image.segments.size() * sizeof(CacheSegment);
+
+    CacheHeader header{};
+    std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = VERSION;
+    header.operation_count = static_cast<uint32_t>(Operation::COUNT);
+    header.elf_hash = image.elf_hash;
+    header.elf_size = image.elf_size;
+    header.data_offset = round_up(text_offset + text.end, PAGE_SIZE);
+    header.entry = image.entry;
+    header.segment_count = static_cast<uint32_t>(image.segments.size());
+    header.text_base = image.text ? image.text->get_base() : 0;
+    header.text_count = text_count;
+
+    // Metadata block: segment table and text fields
+    std::vector<uint8_t> metadata(header.data_offset - sizeof(CacheHeader));
+    uint64_t data_end = header.data_offset;
+    for (size_t i = 0; i < image.segments.size(); i++) {
+        const Segment& segment = image.segments[i];
+        CacheSegment entry{segment.vaddr, segment.filesz, segment.memsz, segment.flags,
+                           round_up(data_end, PAGE_SIZE) + (segment.vaddr & (PAGE_SIZE - 1)),
+                           content_hash(segment.data, segment.filesz)};
+        data_end = entry.offset + entry.filesz;
+        std::memcpy(metadata.data() + i * sizeof(CacheSegment), &entry, sizeof(entry));
+    }
+    if (image.text) {
+        uint8_t* fields = metadata.data() + (text_offset - sizeof(CacheHeader));
+        std::memcpy(fields, image.text->get_ops(), text_count);
+        std::memcpy(fields + text.rd, image.text->get_rd(), text_count);
+        std::memcpy(fields + text.rs1, image.text->get_rs1(), text_count);
+        std::memcpy(fields + text.rs2, image.text->get_rs2(), text_count);
+        std::memcpy(fields + text.imm, image.text->get_imm(), text_count * sizeof(int32_t));
+    }
+    header.checksum = content_hash(metadata.data(), metadata.size());
+    header.file_size = data_end;
+
+    // Write beside the final name and rename over it, so readers never
+    // see a partial file
+    std::string temp = path + ".tmp." + std::to_string(getpid());
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write_all(fd, &header, sizeof(header), 0) &&
+              write_all(fd, metadata.data(), metadata.size(), sizeof(header));
+    uint64_t data_offset = header.data_offset;
+    for (const Segment& segment : image.segments) {
+        data_offset = round_up(data_offset, PAGE_SIZE) + (segment.vaddr & (PAGE_SIZE - 1));
+        ok = ok && write_all(fd, segment.data, segment.filesz, data_offset);
+        data_offset += segment.filesz;
+    }
+    ok = ok && ftruncate(fd, static_cast<off_t>(data_end)) == 0;
+    ok = close(fd) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        unlink(temp.c_str());
+        return false;
+    }
+    return true;
+}
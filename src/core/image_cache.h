@@ -0,0 +1,63 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include "cpu.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TextImage;
+
+// On-disk cache of a loaded ELF: its PT_LOAD layout, the segment bytes
+// and the predecoded text, keyed by a content hash of the ELF file. A
+// cache file is mapped on load and its segment pages are mapped into
+// guest memory copy-on-write, so a hit skips ELF parsing, copying and
+// decoding.
+//
+// File layout: CacheHeader, the segment table, the text image's field
+// arrays (ops, rd, rs1, rs2, imm), then each segment's bytes at a file
+// offset congruent to its address mod PAGE_SIZE. The checksum covers
+// everything between the header and the segment bytes, and each segment
+// table entry holds a hash of its segment's bytes, checked before they
+// are mapped.
+class ImageCache {
+public:
+    // Loadable segment of the image
+    struct Segment {
+        uint32_t vaddr;
+        uint32_t memsz;
+        uint32_t flags;
+        const uint8_t* data;    // filesz bytes
+        uint32_t filesz;
+    };
+
+    // Everything a cache entry records about a loaded ELF
+    struct Image {
+        uint64_t elf_hash;
+        uint64_t elf_size;
+        uint32_t entry;
+        std::vector<Segment> segments;
+        const TextImage* text;  // May be null
+    };
+
+    // 64-bit content hash of a file image
+    static uint64_t content_hash(const uint8_t* data, size_t size);
+
+    // Cache file for an ELF with the given hash
+    static std::string path_for(const std::string& directory, uint64_t elf_hash);
+
+    // Load a cache entry into cpu if it exists, matches the ELF and is
+    // intact; false otherwise (the CPU is then untouched). The text
+    // image is installed when install_text is set.
+    static bool load(const std::string& path, uint64_t elf_hash, uint64_t elf_size,
+                     CPU& cpu, bool install_text, uint32_t& entry);
+
+    // Write an entry, replacing any previous one atomically; false if
+    // the file could not be written
+    static bool store(const std::string& path, const Image& image);
+
+    // Bumped whenever the file layout or the decoder output changes
+    static constexpr uint32_t VERSION = 2;
+};
+
+#endif // IMAGE_CACHE_H
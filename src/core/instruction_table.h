@@ -0,0 +1,292 @@
+#ifndef INSTRUCTION_TABLE_H
+#define INSTRUCTION_TABLE_H
+
+#include "decoder.h"
+#include <array>
+#include <cstddef>
+
+// Declarative RV32I instruction description table. The decoder's lookup
+// tables, the interpreter's per-operation traits, the JIT and the
+// disassembler are all derived from INSTRUCTION_TABLE at compile time.
+
+// How the immediate is scattered through the instruction word
+enum class ImmFormat : uint8_t {
+    NONE,   // No immediate (R-type, ECALL/EBREAK)
+    I,      // inst[31:20], sign-extended
+    S,      // inst[31:25] | inst[11:7], sign-extended
+    B,      // 13-bit branch offset, sign-extended
+    U,      // inst[31:12] << 12
+    J,      // 21-bit jump offset, sign-extended
+    SHAMT,  // inst[24:20] shift amount
+    CSR     // inst[31:20] CSR number, zero-extended
+};
+
+// Operand usage and behaviour flags
+enum InstructionFlags : uint16_t {
+    INST_WRITES_RD   = 1 << 0,
+    INST_READS_RS1   = 1 << 1,
+    INST_READS_RS2   = 1 << 2,
+    INST_LOAD        = 1 << 3,
+    INST_STORE       = 1 << 4,
+    INST_BRANCH      = 1 << 5,  // Conditional, PC-relative
+    INST_JUMP        = 1 << 6,  // Unconditional (JAL, JALR)
+    INST_ENDS_BLOCK  = 1 << 7,  // Next PC is not simply pc + 4
+    INST_MAY_TRAP    = 1 << 8   // Handler may raise a stop
+};
+
+struct InstructionDesc {
+    Operation op;
+    const char* mnemonic;
+    InstructionType type;
+    ImmFormat format;
+    uint16_t flags;
+    uint32_t match;         // (raw & mask) == match selects this row
+    uint32_t mask;
+};
+
+namespace instruction_table_detail {
+
+constexpr uint16_t NO_OPERANDS    = 0;
+constexpr uint16_t WRITES_RD_ONLY = INST_WRITES_RD;
+constexpr uint16_t ALU_RR = INST_WRITES_RD | INST_READS_RS1 | INST_READS_RS2;
+constexpr uint16_t ALU_RI = INST_WRITES_RD | INST_READS_RS1;
+constexpr uint16_t LOAD   = ALU_RI | INST_LOAD | INST_MAY_TRAP;
+constexpr uint16_t STORE  = INST_READS_RS1 | INST_READS_RS2 | INST_STORE | INST_MAY_TRAP;
+constexpr uint16_t BRANCH = INST_READS_RS1 | INST_READS_RS2 | INST_BRANCH | INST_ENDS_BLOCK;
+constexpr uint16_t JUMP_DIRECT   = INST_WRITES_RD | INST_JUMP | INST_ENDS_BLOCK;
+constexpr uint16_t JUMP_INDIRECT = JUMP_DIRECT | INST_READS_RS1;
+constexpr uint16_t TRAP   = INST_ENDS_BLOCK | INST_MAY_TRAP;
+
+constexpr uint32_t MASK_OPCODE  = 0x0000007F;
+constexpr uint32_t MASK_FUNCT3  = 0x0000707F;
+constexpr uint32_t MASK_FUNCT7  = 0xFE00707F;
+constexpr uint32_t MASK_IMM12   = 0xFFF0707F;
+
+} // namespace instruction_table_detail
+
+// Rows are matched in order, so more specific encodings come first
+// (ECALL/EBREAK before the catch-all SYSTEM row).
+inline constexpr InstructionDesc INSTRUCTION_TABLE[] = {
+#define T(op, mnemonic, type, format, flags, match, mask)                       \
+    {Operation::op, mnemonic, InstructionType::type, ImmFormat::format,         \
+     instruction_table_detail::flags, match, instruction_table_detail::mask}
+    T(LUI,    "lui",    U_TYPE, U,     WRITES_RD_ONLY, 0x00000037, MASK_OPCODE),
+    T(AUIPC,  "auipc",  U_TYPE, U,     WRITES_RD_ONLY, 0x00000017, MASK_OPCODE),
+    T(JAL,    "jal",    J_TYPE, J,     JUMP_DIRECT,    0x0000006F, MASK_OPCODE),
+    T(JALR,   "jalr",   I_TYPE, I,     JUMP_INDIRECT,  0x00000067, MASK_FUNCT3),
+
+    T(LB,     "lb",     I_TYPE, I,     LOAD,           0x00000003, MASK_FUNCT3),
+    T(LH,     "lh",     I_TYPE, I,     LOAD,           0x00001003, MASK_FUNCT3),
+    T(LW,     "lw",     I_TYPE, I,     LOAD,           0x00002003, MASK_FUNCT3),
+    T(LBU,    "lbu",    I_TYPE, I,     LOAD,           0x00004003, MASK_FUNCT3),
+    T(LHU,    "lhu",    I_TYPE, I,     LOAD,           0x00005003, MASK_FUNCT3),
+
+    T(SB,     "sb",     S_TYPE, S,     STORE,          0x00000023, MASK_FUNCT3),
+    T(SH,     "sh",     S_TYPE, S,     STORE,          0x00001023, MASK_FUNCT3),
+    T(SW,     "sw",     S_TYPE, S,     STORE,          0x00002023, MASK_FUNCT3),
+
+    T(BEQ,    "beq",    B_TYPE, B,     BRANCH,         0x00000063, MASK_FUNCT3),
+    T(BNE,    "bne",    B_TYPE, B,     BRANCH,         0x00001063, MASK_FUNCT3),
+    T(BLT,    "blt",    B_TYPE, B,     BRANCH,         0x00004063, MASK_FUNCT3),
+    T(BGE,    "bge",    B_TYPE, B,     BRANCH,         0x00005063, MASK_FUNCT3),
+    T(BLTU,   "bltu",   B_TYPE, B,     BRANCH,         0x00006063, MASK_FUNCT3),
+    T(BGEU,   "bgeu",   B_TYPE, B,     BRANCH,         0x00007063, MASK_FUNCT3),
+
+    T(ADDI,   "addi",   I_TYPE, I,     ALU_RI,         0x00000013, MASK_FUNCT3),
+    T(SLTI,   "slti",   I_TYPE, I,     ALU_RI,         0x00002013, MASK_FUNCT3),
+    T(SLTIU,  "sltiu",  I_TYPE, I,     ALU_RI,         0x00003013, MASK_FUNCT3),
+    T(XORI,   "xori",   I_TYPE, I,     ALU_RI,         0x00004013, MASK_FUNCT3),
+    T(ORI,    "ori",    I_TYPE, I,     ALU_RI,         0x00006013, MASK_FUNCT3),
+    T(ANDI,   "andi",   I_TYPE, I,     ALU_RI,         0x00007013, MASK_FUNCT3),
+    T(SLLI,   "slli",   I_TYPE, SHAMT, ALU_RI,         0x00001013, MASK_FUNCT7),
+    T(SRLI,   "srli",   I_TYPE, SHAMT, ALU_RI,         0x00005013, MASK_FUNCT7),
+    T(SRAI,   "srai",   I_TYPE, SHAMT, ALU_RI,         0x40005013, MASK_FUNCT7),
+
+    T(ADD,    "add",    R_TYPE, NONE,  ALU_RR,         0x00000033, MASK_FUNCT7),
+    T(SUB,    "sub",    R_TYPE, NONE,  ALU_RR,         0x40000033, MASK_FUNCT7),
+    T(SLL,    "sll",    R_TYPE, NONE,  ALU_RR,         0x00001033, MASK_FUNCT7),
+    T(SLT,    "slt",    R_TYPE, NONE,  ALU_RR,         0x00002033, MASK_FUNCT7),
+    T(SLTU,   "sltu",   R_TYPE, NONE,  ALU_RR,         0x00003033, MASK_FUNCT7),
+    T(XOR,    "xor",    R_TYPE, NONE,  ALU_RR,         0x00004033, MASK_FUNCT7),
+    T(SRL,    "srl",    R_TYPE, NONE,  ALU_RR,         0x00005033, MASK_FUNCT7),
+    T(SRA,    "sra",    R_TYPE, NONE,  ALU_RR,         0x40005033, MASK_FUNCT7),
+    T(OR,     "or",     R_TYPE, NONE,  ALU_RR,         0x00006033, MASK_FUNCT7),
+    T(AND,    "and",    R_TYPE, NONE,  ALU_RR,         0x00007033, MASK_FUNCT7),
+
+    T(ECALL,  "ecall",  I_TYPE, NONE,  TRAP,           0x00000073, MASK_IMM12),
+    T(EBREAK, "ebreak", I_TYPE, NONE,  TRAP,           0x00100073, MASK_IMM12),
+    T(SYSTEM, "system", I_TYPE, NONE,  NO_OPERANDS,    0x00000073, MASK_FUNCT3),
+    T(CSR,    "csrrw",  I_TYPE, CSR,   ALU_RI,         0x00001073, MASK_FUNCT3),
+    T(CSR,    "csrrs",  I_TYPE, CSR,   ALU_RI,         0x00002073, MASK_FUNCT3),
+    T(CSR,    "csrrc",  I_TYPE, CSR,   ALU_RI,         0x00003073, MASK_FUNCT3),
+    T(CSR,    "csrrwi", I_TYPE, CSR,   WRITES_RD_ONLY, 0x00005073, MASK_FUNCT3),
+    T(CSR,    "csrrsi", I_TYPE, CSR,   WRITES_RD_ONLY, 0x00006073, MASK_FUNCT3),
+    T(CSR,    "csrrci", I_TYPE, CSR,   WRITES_RD_ONLY, 0x00007073, MASK_FUNCT3),
+#undef T
+};
+
+constexpr size_t INSTRUCTION_TABLE_SIZE = sizeof(INSTRUCTION_TABLE) / sizeof(INSTRUCTION_TABLE[0]);
+
+// Sentinel in DECODE_INDEX for index values no row can match
+constexpr uint8_t NO_INSTRUCTION = 0xFF;
+static_assert(INSTRUCTION_TABLE_SIZE < NO_INSTRUCTION, "row numbers must fit in a byte");
+
+// The lookup index is built from the bits that select an operation:
+// opcode[6:2], funct3, funct7 and inst[20] (ECALL vs EBREAK). Rows are
+// confirmed against their full mask, which also rejects compressed
+// (opcode[1:0] != 11) encodings.
+constexpr size_t DECODE_INDEX_BITS = 16;
+
+constexpr uint32_t decode_index(uint32_t raw) {
+    return ((raw >> 2) & 0x1F) |            // opcode[6:2] -> index[4:0]
+           (((raw >> 12) & 0x7) << 5) |     // funct3      -> index[7:5]
+           (((raw >> 25) & 0x7F) << 8) |    // funct7      -> index[14:8]
+           (((raw >> 20) & 0x1) << 15);     // inst[20]    -> index[15]
+}
+
+namespace instruction_table_detail {
+
+constexpr std::array<uint8_t, size_t(1) << DECODE_INDEX_BITS> build_decode_index() {
+    std::array<uint8_t, size_t(1) << DECODE_INDEX_BITS> index{};
+    for (auto& entry : index) {
+        entry = NO_INSTRUCTION;
+    }
+
+    // Fill in reverse so earlier (more specific) rows win
+    for (size_t row = INSTRUCTION_TABLE_SIZE; row-- > 0;) {
+        const InstructionDesc& desc = INSTRUCTION_TABLE[row];
+        uint32_t fixed = decode_index(desc.match);
+        uint32_t free_bits = ~decode_index(desc.mask) & ((1u << DECODE_INDEX_BITS) - 1);
+
+        // Visit every index value that agrees with the row's fixed bits
+        uint32_t sub = free_bits;
+        while (true) {
+            index[fixed | sub] = static_cast<uint8_t>(row);
+            if (sub == 0) {
+                break;
+            }
+            sub = (sub - 1) & free_bits;
+        }
+    }
+    return index;
+}
+
+struct OperationInfo {
+    const char* mnemonic;
+    ImmFormat format;
+    uint16_t flags;
+};
+
+constexpr std::array<OperationInfo, static_cast<size_t>(Operation::COUNT)> build_operation_info() {
+    std::array<OperationInfo, static_cast<size_t>(Operation::COUNT)> info{};
+    for (auto& entry : info) {
+        entry = OperationInfo{"", ImmFormat::NONE, 0};
+    }
+
+    // First row of each operation describes it (CSR rows share traits)
+    for (size_t row = INSTRUCTION_TABLE_SIZE; row-- > 0;) {
+        const InstructionDesc& desc = INSTRUCTION_TABLE[row];
+        info[static_cast<size_t>(desc.op)] = OperationInfo{desc.mnemonic, desc.format, desc.flags};
+    }
+
+    info[static_cast<size_t>(Operation::ILLEGAL)] =
+        OperationInfo{"illegal", ImmFormat::NONE, INST_ENDS_BLOCK | INST_MAY_TRAP};
+    info[static_cast<size_t>(Operation::FETCH_FAULT)] =
+        OperationInfo{"fetch-fault", ImmFormat::NONE, INST_ENDS_BLOCK | INST_MAY_TRAP};
+    return info;
+}
+
+constexpr bool rows_are_well_formed() {
+    for (size_t row = 0; row < INSTRUCTION_TABLE_SIZE; row++) {
+        const InstructionDesc& desc = INSTRUCTION_TABLE[row];
+        if ((desc.match & ~desc.mask) != 0 || (desc.match & 0x3) != 0x3) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace instruction_table_detail
+
+static_assert(instruction_table_detail::rows_are_well_formed(),
+              "every row must be a 32-bit encoding with match bits inside its mask");
+
+// 64K-entry map from decode_index() to the first candidate row
+inline constexpr auto DECODE_INDEX = instruction_table_detail::build_decode_index();
+
+// Per-operation mnemonic, immediate format and flags
+inline constexpr auto OPERATION_INFO = instruction_table_detail::build_operation_info();
+
+constexpr uint16_t operation_flags(Operation op) {
+    return OPERATION_INFO[static_cast<size_t>(op)].flags;
+}
+
+constexpr bool operation_has(Operation op, uint16_t flags) {
+    return (operation_flags(op) & flags) != 0;
+}
+
+constexpr int32_t sign_extend_bits(uint32_t value, int bits) {
+    uint32_t sign_bit = 1u << (bits - 1);
+    return static_cast<int32_t>((value ^ sign_bit) - sign_bit);
+}
+
+// Every format is a handful of shifts and masks, so all of them are
+// computed and the result selected by index: decoding a mixed stream
+// then costs no mispredicted branches.
+constexpr int32_t extract_immediate(ImmFormat format, uint32_t raw) {
+    const int32_t immediates[] = {
+        0,                                                          // NONE
+        static_cast<int32_t>(raw) >> 20,                            // I
+        sign_extend_bits(((raw >> 25) << 5) | ((raw >> 7) & 0x1F), 12),  // S
+        sign_extend_bits(
+            ((raw >> 31) << 12) |               // imm[12]
+            (((raw >> 7) & 0x1) << 11) |        // imm[11]
+            (((raw >> 25) & 0x3F) << 5) |       // imm[10:5]
+            (((raw >> 8) & 0xF) << 1),          // imm[4:1]
+            13),                                                    // B
+        static_cast<int32_t>(raw & 0xFFFFF000),                     // U
+        sign_extend_bits(
+            ((raw >> 31) << 20) |               // imm[20]
+            (((raw >> 12) & 0xFF) << 12) |      // imm[19:12]
+            (((raw >> 20) & 0x1) << 11) |       // imm[11]
+            (((raw >> 21) & 0x3FF) << 1),       // imm[10:1]
+            21),                                                    // J
+        static_cast<int32_t>((raw >> 20) & 0x1F),                   // SHAMT
+        static_cast<int32_t>(raw >> 20)                             // CSR
+    };
+    return immediates[static_cast<size_t>(format)];
+}
+
+// Row describing raw, or nullptr for an illegal encoding
+constexpr const InstructionDesc* find_instruction(uint32_t raw) {
+    uint8_t row = DECODE_INDEX[decode_index(raw)];
+    if (row == NO_INSTRUCTION) {
+        return nullptr;
+    }
+    if ((raw & INSTRUCTION_TABLE[row].mask) == INSTRUCTION_TABLE[row].match) {
+        return &INSTRUCTION_TABLE[row];
+    }
+
+    // Index bits agree but the full mask does not (e.g. SYSTEM encodings
+    // that only look like ECALL); try the remaining candidates in order
+    for (size_t next = row + 1u; next < INSTRUCTION_TABLE_SIZE; next++) {
+        if ((raw & INSTRUCTION_TABLE[next].mask) == INSTRUCTION_TABLE[next].match) {
+            return &INSTRUCTION_TABLE[next];
+        }
+    }
+    return nullptr;
+}
+
+// Compile-time spot checks of the generated tables
+static_assert(find_instruction(0x00000073)->op == Operation::ECALL, "ecall");
+static_assert(find_instruction(0x00100073)->op == Operation::EBREAK, "ebreak");
+static_assert(find_instruction(0x30200073)->op == Operation::SYSTEM, "mret");
+static_assert(find_instruction(0x40A55513)->op == Operation::SRAI, "srai");
+static_assert(find_instruction(0x40B50533)->op == Operation::SUB, "sub");
+static_assert(find_instruction(0x34102573)->op == Operation::CSR, "csrrs");
+static_assert(find_instruction(0xFFFFFFFF) == nullptr, "all ones is illegal");
+static_assert(find_instruction(0x00004501) == nullptr, "compressed encodings are illegal");
+static_assert(extract_immediate(ImmFormat::B, 0xFE561AE3) == -12, "branch offset");
+static_assert(extract_immediate(ImmFormat::J, 0xFF1FF06F) == -16, "jump offset");
+
+#endif // INSTRUCTION_TABLE_H
@@ -1,262 +1,618 @@
 #include "interpreter.h"
+#include "instruction_table.h"
 #include <iostream>
 #include <cstdlib>
 
-void Interpreter::step() {
+// Computed goto ("labels as values") is a GCC/Clang extension; other
+// compilers fall back to the switch dispatcher.
+#if defined(__GNUC__) || defined(__clang__)
+#define INTERPRETER_COMPUTED_GOTO 1
+#else
+#define INTERPRETER_COMPUTED_GOTO 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define INTERPRETER_ALWAYS_INLINE inline __attribute__((always_inline))
+#define INTERPRETER_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define INTERPRETER_ALWAYS_INLINE inline
+#define INTERPRETER_UNLIKELY(x) (x)
+#endif
+
+namespace {
+
+// Operations that leave a basic block (the block builder ends blocks on
+// them, and fused branch pairs inherit that)
+constexpr bool is_block_terminator(Operation op) {
+    switch (op) {
+        case Operation::AUIPC_JALR:
+        case Operation::ADDI_BEQ: case Operation::ADDI_BNE: case Operation::ADDI_BLT:
+        case Operation::ADDI_BGE: case Operation::ADDI_BLTU: case Operation::ADDI_BGEU:
+        case Operation::BLOCK_END:
+            return true;
+        default:
+            return operation_has(op, INST_ENDS_BLOCK);
+    }
+}
+
+// Guest instructions covered by one slot's handler
+constexpr uint32_t op_width(Operation op) {
+    switch (op) {
+        case Operation::LUI_ADDI: case Operation::AUIPC_JALR:
+        case Operation::ADDI_BEQ: case Operation::ADDI_BNE: case Operation::ADDI_BLT:
+        case Operation::ADDI_BGE: case Operation::ADDI_BLTU: case Operation::ADDI_BGEU:
+            return 2;
+        case Operation::BLOCK_END:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Width and signedness of each load and store
+template <Operation Op> struct AccessType;
+template <> struct AccessType<Operation::LB>  { using type = int8_t; };
+template <> struct AccessType<Operation::LH>  { using type = int16_t; };
+template <> struct AccessType<Operation::LW>  { using type = uint32_t; };
+template <> struct AccessType<Operation::LBU> { using type = uint8_t; };
+template <> struct AccessType<Operation::LHU> { using type = uint16_t; };
+template <> struct AccessType<Operation::SB>  { using type = uint8_t; };
+template <> struct AccessType<Operation::SH>  { using type = uint16_t; };
+template <> struct AccessType<Operation::SW>  { using type = uint32_t; };
+
+constexpr bool is_store(Operation op) {
+    return operation_has(op, INST_STORE);
+}
+
+// Operations whose handler may raise a trap
+constexpr bool may_trap(Operation op) {
+    return operation_has(op, INST_MAY_TRAP);
+}
+
+// Traps after which the stopping instruction counts as retired
+bool stop_retires(StopReason reason) {
+    return reason == StopReason::EXIT || reason == StopReason::BREAKPOINT;
+}
+
+} // namespace
+
+bool Interpreter::threaded_dispatch_available() {
+    return INTERPRETER_COMPUTED_GOTO;
+}
+
+void Interpreter::set_dispatch_mode(DispatchMode mode) {
+    if (mode == DispatchMode::THREADED && !threaded_dispatch_available()) {
+        mode = DispatchMode::SWITCH;
+    }
+    dispatch_mode = mode;
+}
+
+const char* stop_reason_name(StopReason reason) {
+    switch (reason) {
+        case StopReason::NONE:                return "none";
+        case StopReason::INSTRUCTION_LIMIT:   return "instruction limit";
+        case StopReason::EXIT:                return "exit";
+        case StopReason::BREAKPOINT:          return "breakpoint";
+        case StopReason::ILLEGAL_INSTRUCTION: return "illegal instruction";
+        case StopReason::MEMORY_FAULT:        return "memory fault";
+    }
+    return "unknown";
+}
+
+void Interpreter::set_timing_model(std::unique_ptr<TimingModel> model) {
+    timing_model = std::move(model);
+}
+
+void Interpreter::set_cache_simulator(std::unique_ptr<CacheSimulator> simulator) {
+    cache_simulator = std::move(simulator);
+}
+
+void Interpreter::set_branch_simulator(std::unique_ptr<BranchSimulator> simulator) {
+    branch_simulator = std::move(simulator);
+}
+
+void Interpreter::reset_stats() {
+    instructions_executed = 0;
+    cycles = 0;
+    if (timing_model) {
+        timing_model->reset();
+    }
+}
+
+void Interpreter::take_snapshot() {
+    cpu.take_snapshot();
+    snapshot_instructions = instructions_executed;
+    snapshot_cycles = cycles;
+}
+
+void Interpreter::restore_snapshot() {
+    cpu.restore_snapshot();
+    instructions_executed = snapshot_instructions;
+    cycles = snapshot_cycles;
+    if (timing_model) {
+        timing_model->reset();
+    }
+    pending_stop = StopReason::NONE;
+    profiler.unwind_call_stack();
+}
+
+ExecResult Interpreter::step() {
+    pending_stop = StopReason::NONE;
+    uint64_t start = instructions_executed;
+    profiler.set_text_range(cpu.get_text_start(), cpu.get_text_end());
+    
+    with_fault_recovery([this] { step_instruction(); });
+    
+    return take_result(instructions_executed - start);
+}
+
+void Interpreter::step_instruction() {
     // Fetch instruction
     uint32_t pc = cpu.get_pc();
     
-    // PROFILE: Record this PC
-    profiler.record_instruction(pc);
+    // Fetch + decode through the predecode cache. Copy the 8-byte record:
+    // a store in this instruction may invalidate the cached page.
+    DecodedInstruction inst = decode_cache.fetch(pc);
+    
+    if (cache_simulator) {
+        execute<true>(inst);
+    } else {
+        execute<false>(inst);
+    }
     
-    uint32_t raw_inst = cpu.read_word(pc);
+    if (pending_stop == StopReason::NONE || stop_retires(pending_stop)) {
+        // PROFILE: Record this PC
+        profiler.record_instruction(pc);
+        if (cpu.get_pc() != pc + 4 && pending_stop == StopReason::NONE) {
+            profiler.record_branch(pc, cpu.get_pc());
+        }
+        Prediction prediction = Prediction::NONE;
+        if (branch_simulator && pending_stop == StopReason::NONE) {
+            prediction = branch_simulator->resolve(inst, pc, cpu.get_pc());
+        }
+        if (timing_model) {
+            charge_cycles(inst, pc, cpu.get_pc(), prediction);
+        }
+        profiler.record_transfer(call_kind(inst), pc, cpu.get_pc());
+        instructions_executed++;
+    }
+}
+
+ExecResult Interpreter::run(uint64_t max_instructions) {
+    pending_stop = StopReason::NONE;
+    uint64_t start = instructions_executed;
+    profiler.set_text_range(cpu.get_text_start(), cpu.get_text_end());
     
-    // Decode
-    Instruction inst = Decoder::decode(raw_inst);
+    dispatch_blocks(max_instructions, false);
     
-    // Execute based on type
-    switch (inst.type) {
-        case InstructionType::R_TYPE:
-            execute_r_type(inst);
-            break;
-        case InstructionType::I_TYPE:
-            execute_i_type(inst);
-            break;
-        case InstructionType::S_TYPE:
-            execute_s_type(inst);
-            break;
-        case InstructionType::B_TYPE:
-            execute_b_type(inst);
-            break;
-        case InstructionType::U_TYPE:
-            execute_u_type(inst);
-            break;
-        case InstructionType::J_TYPE:
-            execute_j_type(inst);
-            break;
+    if (pending_stop == StopReason::NONE) {
+        raise_stop(StopReason::INSTRUCTION_LIMIT, cpu.get_pc(), cpu.get_pc());
     }
+    return take_result(instructions_executed - start);
+}
+
+ExecResult Interpreter::run_block(uint64_t max_instructions) {
+    pending_stop = StopReason::NONE;
+    uint64_t start = instructions_executed;
+    profiler.set_text_range(cpu.get_text_start(), cpu.get_text_end());
+    
+    dispatch_blocks(max_instructions, true);
     
-    instructions_executed++;
+    return take_result(instructions_executed - start);
 }
 
-void Interpreter::run(uint64_t max_instructions) {
-    try {
-        while (instructions_executed < max_instructions) {
-            step();
+void Interpreter::dispatch_blocks(uint64_t max_instructions, bool single_block) {
+    with_fault_recovery([this, max_instructions, single_block] {
+        if (dispatch_mode == DispatchMode::THREADED) {
+            if (cache_simulator) {
+                run_blocks<true, true>(max_instructions, single_block);
+            } else {
+                run_blocks<true, false>(max_instructions, single_block);
+            }
+        } else {
+            if (cache_simulator) {
+                run_blocks<false, true>(max_instructions, single_block);
+            } else {
+                run_blocks<false, false>(max_instructions, single_block);
+            }
         }
-        std::cout << "Reached max instruction limit" << std::endl;
-    } catch (const std::exception& e) {
-        std::cout << "Execution stopped: " << e.what() << std::endl;
+    });
+}
+
+// Under the HOST_MMU backend guest loads and stores are unchecked, so a
+// bad address faults in the host and the signal handler jumps back here.
+// No frame between here and the faulting access owns anything that needs
+// destroying.
+template <typename Body>
+void Interpreter::with_fault_recovery(Body&& body) {
+    if (!cpu.get_flat_base()) {
+        body();
+        return;
     }
+    if (sigsetjmp(fault_env, 0) != 0) {
+        cpu.arm_fault_recovery(nullptr);
+        recover_host_fault();
+        return;
+    }
+    cpu.arm_fault_recovery(&fault_env);
+    body();
+    cpu.arm_fault_recovery(nullptr);
 }
 
-void Interpreter::execute_r_type(const Instruction& inst) {
-    uint32_t rs1_val = cpu.get_register(inst.rs1);
-    uint32_t rs2_val = cpu.get_register(inst.rs2);
-    uint32_t result = 0;
-    
-    // Opcode 0x33 = R-type arithmetic
-    if (inst.opcode == 0x33) {
-        switch (inst.funct3) {
-            case 0x0: // ADD/SUB
-                if (inst.funct7 == 0x00) {
-                    result = rs1_val + rs2_val; // ADD
-                } else if (inst.funct7 == 0x20) {
-                    result = rs1_val - rs2_val; // SUB
-                }
-                break;
-            case 0x4: // XOR
-                result = rs1_val ^ rs2_val;
-                break;
-            case 0x6: // OR
-                result = rs1_val | rs2_val;
-                break;
-            case 0x7: // AND
-                result = rs1_val & rs2_val;
-                break;
-            case 0x1: // SLL (shift left logical)
-                result = rs1_val << (rs2_val & 0x1F);
-                break;
-            case 0x5: // SRL/SRA
-                if (inst.funct7 == 0x00) {
-                    result = rs1_val >> (rs2_val & 0x1F); // SRL
-                } else if (inst.funct7 == 0x20) {
-                    result = static_cast<int32_t>(rs1_val) >> (rs2_val & 0x1F); // SRA
-                }
-                break;
-            case 0x2: // SLT (set less than)
-                result = static_cast<int32_t>(rs1_val) < static_cast<int32_t>(rs2_val) ? 1 : 0;
-                break;
-            case 0x3: // SLTU (set less than unsigned)
-                result = rs1_val < rs2_val ? 1 : 0;
-                break;
-        }
+// Turn a host fault into the MEMORY_FAULT stop the checked path raises:
+// the faulting instruction does not retire, those before it in its
+// block do
+void Interpreter::recover_host_fault() {
+    uint32_t pc = access_pc;
+    if (const BasicBlock* block = active_block) {
+        retire_block(*block, (pc - block->start_pc) / 4);
+        active_block = nullptr;
     }
-    
-    cpu.set_register(inst.rd, result);
-    cpu.increment_pc();
+    cpu.set_pc(pc);
+    raise_stop(StopReason::MEMORY_FAULT, pc, pc, CPU::last_fault_address());
+}
+
+uint32_t Interpreter::raise_stop(StopReason reason, uint32_t pc, uint32_t resume_pc, uint32_t fault_addr) {
+    pending_stop = reason;
+    stop_pc = pc;
+    stop_fault_addr = fault_addr;
+    return resume_pc;
+}
+
+ExecResult Interpreter::take_result(uint64_t retired) {
+    ExecResult result;
+    result.reason = pending_stop;
+    result.exit_code = pending_stop == StopReason::EXIT ? stop_exit_code : 0;
+    result.pc = pending_stop == StopReason::NONE ? cpu.get_pc() : stop_pc;
+    result.fault_addr = pending_stop == StopReason::MEMORY_FAULT ? stop_fault_addr : 0;
+    result.instructions_retired = retired;
+    pending_stop = StopReason::NONE;
+    return result;
 }
 
-void Interpreter::execute_i_type(const Instruction& inst) {
-    uint32_t rs1_val = cpu.get_register(inst.rs1);
-    uint32_t result = 0;
+// Semantics of a single operation; returns the next PC. Shared by the
+// switch and threaded dispatchers so each is instantiated per operation.
+// Fused operations read their second instruction from the next slot.
+template <Operation Op, bool Simulated>
+INTERPRETER_ALWAYS_INLINE uint32_t Interpreter::execute_op(const DecodedInstruction& inst, uint32_t pc) {
+    const uint32_t rs1_val = cpu.get_register(inst.rs1);
+    const uint32_t rs2_val = cpu.get_register(inst.rs2);
+    const uint32_t imm = static_cast<uint32_t>(inst.imm);
     
-    if (inst.opcode == 0x13) {
-        // I-type arithmetic
-        switch (inst.funct3) {
-            case 0x0: // ADDI
-                result = rs1_val + inst.imm;
-                break;
-            case 0x4: // XORI
-                result = rs1_val ^ inst.imm;
-                break;
-            case 0x6: // ORI
-                result = rs1_val | inst.imm;
-                break;
-            case 0x7: // ANDI
-                result = rs1_val & inst.imm;
-                break;
-            case 0x1: // SLLI
-                result = rs1_val << (inst.imm & 0x1F);
-                break;
-            case 0x5: // SRLI/SRAI
-                if ((inst.imm & 0x400) == 0) {
-                    result = rs1_val >> (inst.imm & 0x1F); // SRLI
-                } else {
-                    result = static_cast<int32_t>(rs1_val) >> (inst.imm & 0x1F); // SRAI
-                }
-                break;
-            case 0x2: // SLTI
-                result = static_cast<int32_t>(rs1_val) < inst.imm ? 1 : 0;
-                break;
-            case 0x3: // SLTIU
-                result = rs1_val < static_cast<uint32_t>(inst.imm) ? 1 : 0;
-                break;
+    // Every instruction reaching its handler was fetched, faulting ones too
+    if constexpr (Simulated && Op != Operation::FETCH_FAULT && Op != Operation::BLOCK_END) {
+        cache_simulator->fetch(pc);
+        if constexpr (op_width(Op) == 2) {
+            cache_simulator->fetch(pc + 4);
         }
-        cpu.set_register(inst.rd, result);
-        cpu.increment_pc();
+    }
+    
+    // === Upper immediates and jumps ===
+    if constexpr (Op == Operation::LUI) {
+        cpu.set_register(inst.rd, imm);
+    } else if constexpr (Op == Operation::AUIPC) {
+        cpu.set_register(inst.rd, pc + imm);
+    } else if constexpr (Op == Operation::JAL) {
+        cpu.set_register(inst.rd, pc + 4);
+        return pc + imm;
+    } else if constexpr (Op == Operation::JALR) {
+        uint32_t target = (rs1_val + imm) & ~1u;
+        cpu.set_register(inst.rd, pc + 4);
+        return target;
         
-    } else if (inst.opcode == 0x03) {
-        // Load instructions
-        uint32_t addr = rs1_val + inst.imm;
+    // === Branches ===
+    } else if constexpr (Op == Operation::BEQ) {
+        return rs1_val == rs2_val ? pc + imm : pc + 4;
+    } else if constexpr (Op == Operation::BNE) {
+        return rs1_val != rs2_val ? pc + imm : pc + 4;
+    } else if constexpr (Op == Operation::BLT) {
+        return static_cast<int32_t>(rs1_val) < static_cast<int32_t>(rs2_val) ? pc + imm : pc + 4;
+    } else if constexpr (Op == Operation::BGE) {
+        return static_cast<int32_t>(rs1_val) >= static_cast<int32_t>(rs2_val) ? pc + imm : pc + 4;
+    } else if constexpr (Op == Operation::BLTU) {
+        return rs1_val < rs2_val ? pc + imm : pc + 4;
+    } else if constexpr (Op == Operation::BGEU) {
+        return rs1_val >= rs2_val ? pc + imm : pc + 4;
         
-        switch (inst.funct3) {
-            case 0x0: // LB (load byte)
-                result = static_cast<int8_t>(cpu.read_byte(addr));
-                break;
-            case 0x1: // LH (load halfword)
-                result = static_cast<int16_t>(cpu.read_word(addr) & 0xFFFF);
-                break;
-            case 0x2: // LW (load word)
-                result = cpu.read_word(addr);
-                break;
-            case 0x4: // LBU (load byte unsigned)
-                result = cpu.read_byte(addr);
-                break;
-            case 0x5: // LHU (load halfword unsigned)
-                result = cpu.read_word(addr) & 0xFFFF;
-                break;
+    // === Loads and stores ===
+    } else if constexpr (operation_has(Op, INST_LOAD)) {
+        begin_access(pc);
+        typename AccessType<Op>::type value;
+        if (!cpu.guest_load(rs1_val + imm, value)) {
+            return raise_stop(StopReason::MEMORY_FAULT, pc, pc, rs1_val + imm);
+        }
+        if constexpr (Simulated) {
+            cache_simulator->data_access(pc, rs1_val + imm, sizeof(value));
+        }
+        cpu.set_register(inst.rd, static_cast<uint32_t>(static_cast<int32_t>(value)));
+    } else if constexpr (operation_has(Op, INST_STORE)) {
+        begin_access(pc);
+        using T = typename AccessType<Op>::type;
+        if (!cpu.guest_store(rs1_val + imm, static_cast<T>(rs2_val))) {
+            return raise_stop(StopReason::MEMORY_FAULT, pc, pc, rs1_val + imm);
+        }
+        if constexpr (Simulated) {
+            cache_simulator->data_access(pc, rs1_val + imm, sizeof(T));
         }
-        cpu.set_register(inst.rd, result);
-        cpu.increment_pc();
         
-    } else if (inst.opcode == 0x67) {
-        // JALR (jump and link register)
-        uint32_t target = (rs1_val + inst.imm) & ~1;
-        cpu.set_register(inst.rd, cpu.get_pc() + 4);
-        cpu.set_pc(target);
+    // === I-type arithmetic ===
+    } else if constexpr (Op == Operation::ADDI) {
+        cpu.set_register(inst.rd, rs1_val + imm);
+    } else if constexpr (Op == Operation::SLTI) {
+        cpu.set_register(inst.rd, static_cast<int32_t>(rs1_val) < inst.imm ? 1 : 0);
+    } else if constexpr (Op == Operation::SLTIU) {
+        cpu.set_register(inst.rd, rs1_val < imm ? 1 : 0);
+    } else if constexpr (Op == Operation::XORI) {
+        cpu.set_register(inst.rd, rs1_val ^ imm);
+    } else if constexpr (Op == Operation::ORI) {
+        cpu.set_register(inst.rd, rs1_val | imm);
+    } else if constexpr (Op == Operation::ANDI) {
+        cpu.set_register(inst.rd, rs1_val & imm);
+    } else if constexpr (Op == Operation::SLLI) {
+        cpu.set_register(inst.rd, rs1_val << (imm & 0x1F));
+    } else if constexpr (Op == Operation::SRLI) {
+        cpu.set_register(inst.rd, rs1_val >> (imm & 0x1F));
+    } else if constexpr (Op == Operation::SRAI) {
+        cpu.set_register(inst.rd, static_cast<int32_t>(rs1_val) >> (imm & 0x1F));
         
-    } else if (inst.opcode == 0x73) {
-    // SYSTEM instructions
-    if (inst.funct3 == 0) {
-        if (inst.imm == 0) {
-            handle_ecall();
-        } else if (inst.imm == 1) {
-            // EBREAK - treat as breakpoint/halt
-            std::cout << "EBREAK encountered at PC: 0x" << std::hex << cpu.get_pc() << std::dec << std::endl;
-            throw std::runtime_error("EBREAK");
-        }
-    } else {
+    // === R-type arithmetic ===
+    } else if constexpr (Op == Operation::ADD) {
+        cpu.set_register(inst.rd, rs1_val + rs2_val);
+    } else if constexpr (Op == Operation::SUB) {
+        cpu.set_register(inst.rd, rs1_val - rs2_val);
+    } else if constexpr (Op == Operation::SLL) {
+        cpu.set_register(inst.rd, rs1_val << (rs2_val & 0x1F));
+    } else if constexpr (Op == Operation::SLT) {
+        cpu.set_register(inst.rd, static_cast<int32_t>(rs1_val) < static_cast<int32_t>(rs2_val) ? 1 : 0);
+    } else if constexpr (Op == Operation::SLTU) {
+        cpu.set_register(inst.rd, rs1_val < rs2_val ? 1 : 0);
+    } else if constexpr (Op == Operation::XOR) {
+        cpu.set_register(inst.rd, rs1_val ^ rs2_val);
+    } else if constexpr (Op == Operation::SRL) {
+        cpu.set_register(inst.rd, rs1_val >> (rs2_val & 0x1F));
+    } else if constexpr (Op == Operation::SRA) {
+        cpu.set_register(inst.rd, static_cast<int32_t>(rs1_val) >> (rs2_val & 0x1F));
+    } else if constexpr (Op == Operation::OR) {
+        cpu.set_register(inst.rd, rs1_val | rs2_val);
+    } else if constexpr (Op == Operation::AND) {
+        cpu.set_register(inst.rd, rs1_val & rs2_val);
+        
+    // === SYSTEM ===
+    } else if constexpr (Op == Operation::ECALL) {
+        handle_ecall(pc);
+    } else if constexpr (Op == Operation::EBREAK) {
+        // EBREAK - stop as a breakpoint; resuming continues after it
+        return raise_stop(StopReason::BREAKPOINT, pc, pc + 4);
+    } else if constexpr (Op == Operation::CSR) {
         // CSR instructions (CSRRW, CSRRS, CSRRC, etc.)
         // For now, just NOP them
-        std::cout << "Warning: CSR instruction not implemented (funct3: " 
-                  << static_cast<int>(inst.funct3) << ")" << std::endl;
+        std::cout << "Warning: CSR instruction not implemented" << std::endl;
+    } else if constexpr (Op == Operation::SYSTEM) {
+        // Other SYSTEM encodings are ignored
+        
+    // === Superinstructions ===
+    } else if constexpr (Op == Operation::LUI_ADDI) {
+        // imm already holds hi + lo
+        cpu.set_register(inst.rd, imm);
+        return pc + 8;
+    } else if constexpr (Op == Operation::AUIPC_JALR) {
+        const DecodedInstruction& jalr = (&inst)[1];
+        uint32_t base = pc + imm;
+        cpu.set_register(inst.rd, base);
+        cpu.set_register(jalr.rd, pc + 8);
+        return (base + static_cast<uint32_t>(jalr.imm)) & ~1u;
+    } else if constexpr (Op == Operation::ADDI_BEQ || Op == Operation::ADDI_BNE ||
+                         Op == Operation::ADDI_BLT || Op == Operation::ADDI_BGE ||
+                         Op == Operation::ADDI_BLTU || Op == Operation::ADDI_BGEU) {
+        const DecodedInstruction& branch = (&inst)[1];
+        cpu.set_register(inst.rd, rs1_val + imm);
+        const uint32_t a = cpu.get_register(branch.rs1);
+        const uint32_t b = cpu.get_register(branch.rs2);
+        bool taken;
+        if constexpr (Op == Operation::ADDI_BEQ) taken = a == b;
+        else if constexpr (Op == Operation::ADDI_BNE) taken = a != b;
+        else if constexpr (Op == Operation::ADDI_BLT) taken = static_cast<int32_t>(a) < static_cast<int32_t>(b);
+        else if constexpr (Op == Operation::ADDI_BGE) taken = static_cast<int32_t>(a) >= static_cast<int32_t>(b);
+        else if constexpr (Op == Operation::ADDI_BLTU) taken = a < b;
+        else taken = a >= b;
+        return taken ? pc + 4 + static_cast<uint32_t>(branch.imm) : pc + 8;
+    } else if constexpr (Op == Operation::BLOCK_END) {
+        // Sentinel slot sits at the fall-through PC
+        return pc;
+        
+    // === Traps ===
+    } else if constexpr (Op == Operation::FETCH_FAULT) {
+        return raise_stop(StopReason::MEMORY_FAULT, pc, pc, pc);
+    } else {
+        return raise_stop(StopReason::ILLEGAL_INSTRUCTION, pc, pc);
     }
-    cpu.increment_pc();
-}
+    
+    return pc + 4;
 }
 
-void Interpreter::execute_s_type(const Instruction& inst) {
-    uint32_t rs1_val = cpu.get_register(inst.rs1);
-    uint32_t rs2_val = cpu.get_register(inst.rs2);
-    uint32_t addr = rs1_val + inst.imm;
+template <bool Simulated>
+void Interpreter::execute(const DecodedInstruction& inst) {
+    uint32_t pc = cpu.get_pc();
+    uint32_t next_pc;
     
-    switch (inst.funct3) {
-        case 0x0: // SB (store byte)
-            cpu.write_byte(addr, rs2_val & 0xFF);
-            break;
-        case 0x1: // SH (store halfword)
-            cpu.write_word(addr, rs2_val & 0xFFFF);
+    switch (inst.op) {
+#define X(name) \
+        case Operation::name: next_pc = execute_op<Operation::name, Simulated>(inst, pc); break;
+        RV32I_OPERATIONS(X)
+#undef X
+        case Operation::FETCH_FAULT:
+            next_pc = execute_op<Operation::FETCH_FAULT, Simulated>(inst, pc);
             break;
-        case 0x2: // SW (store word)
-            cpu.write_word(addr, rs2_val);
+        default:
+            next_pc = execute_op<Operation::ILLEGAL, Simulated>(inst, pc);
             break;
     }
     
-    cpu.increment_pc();
+    cpu.set_pc(next_pc);
 }
 
-void Interpreter::execute_b_type(const Instruction& inst) {
-    int32_t rs1_val = cpu.get_register(inst.rs1);
-    int32_t rs2_val = cpu.get_register(inst.rs2);
-    bool take_branch = false;
-    
-    switch (inst.funct3) {
-        case 0x0: // BEQ
-            take_branch = (rs1_val == rs2_val);
-            break;
-        case 0x1: // BNE
-            take_branch = (rs1_val != rs2_val);
-            break;
-        case 0x4: // BLT
-            take_branch = (rs1_val < rs2_val);
-            break;
-        case 0x5: // BGE
-            take_branch = (rs1_val >= rs2_val);
-            break;
-        case 0x6: // BLTU
-            take_branch = (static_cast<uint32_t>(rs1_val) < static_cast<uint32_t>(rs2_val));
-            break;
-        case 0x7: // BGEU
-            take_branch = (static_cast<uint32_t>(rs1_val) >= static_cast<uint32_t>(rs2_val));
+// Block loop used by run() and, for one iteration, run_block(). Blocks
+// are only entered when the whole block fits in the remaining budget, so
+// the instruction limit stays exact; the tail of the budget is
+// single-stepped.
+template <bool Threaded, bool Simulated>
+void Interpreter::run_blocks(uint64_t max_instructions, bool single_block) {
+    while (instructions_executed < max_instructions && pending_stop == StopReason::NONE) {
+        const BasicBlock& block = block_cache.lookup(cpu.get_pc());
+        if (block.instruction_count > max_instructions - instructions_executed) {
+            step_instruction();
+        } else {
+            execute_block<Threaded, Simulated>(block);
+        }
+        if (single_block) {
             break;
+        }
     }
+}
+
+// Execute one basic block. The switch flavour funnels every instruction
+// through one indirect jump; the threaded flavour ends each handler with
+// its own jump through a per-operation label table, which gives the host
+// branch predictor one history per handler. Instruction count and
+// profile are updated once per block; traps are checked only after the
+// operations that can raise them.
+template <bool Threaded, bool Simulated>
+void Interpreter::execute_block(const BasicBlock& block) {
+    const DecodedInstruction* const base = block.ops.data();
+    const DecodedInstruction* ip = base;
+    const uint64_t invalidations = block_cache.get_invalidations();
+    uint32_t next_pc;
+    active_block = &block;
     
-    if (take_branch) {
-        cpu.set_pc(cpu.get_pc() + inst.imm);
-    } else {
-        cpu.increment_pc();
+#if INTERPRETER_COMPUTED_GOTO
+    static void* const dispatch_table[static_cast<size_t>(Operation::COUNT)] = {
+        &&op_ILLEGAL,  // NOT_DECODED never reaches dispatch
+        &&op_ILLEGAL,
+        &&op_FETCH_FAULT,
+#define X(name) &&op_##name,
+        RV32I_OPERATIONS(X)
+        FUSED_OPERATIONS(X)
+#undef X
+    };
+    
+#define INTERPRETER_DISPATCH()                                                  \
+    do {                                                                        \
+        if constexpr (Threaded) {                                               \
+            goto *dispatch_table[static_cast<size_t>(ip->op)];                  \
+        } else {                                                                \
+            goto dispatch_switch;                                               \
+        }                                                                       \
+    } while (0)
+#else
+#define INTERPRETER_DISPATCH() goto dispatch_switch
+#endif
+    
+#define INTERPRETER_PC() (block.start_pc + static_cast<uint32_t>(ip - base) * 4)
+    
+#define INTERPRETER_HANDLER(name)                                               \
+    op_##name:                                                                  \
+        if constexpr (is_block_terminator(Operation::name)) {                   \
+            next_pc = execute_op<Operation::name, Simulated>(                   \
+                *ip, INTERPRETER_PC());                                         \
+            if constexpr (may_trap(Operation::name)) {                          \
+                if (INTERPRETER_UNLIKELY(pending_stop != StopReason::NONE)) {   \
+                    goto trapped;                                               \
+                }                                                               \
+            }                                                                   \
+            goto block_done;                                                    \
+        } else {                                                                \
+            next_pc = execute_op<Operation::name, Simulated>(                   \
+                *ip, INTERPRETER_PC());                                         \
+            if constexpr (may_trap(Operation::name)) {                          \
+                if (INTERPRETER_UNLIKELY(pending_stop != StopReason::NONE)) {   \
+                    goto trapped;                                               \
+                }                                                               \
+            }                                                                   \
+            ip += op_width(Operation::name);                                    \
+            if constexpr (is_store(Operation::name)) {                          \
+                if (block_cache.get_invalidations() != invalidations) {         \
+                    goto code_modified;                                         \
+                }                                                               \
+            }                                                                   \
+            INTERPRETER_DISPATCH();                                             \
+        }
+    
+dispatch_switch:
+#if INTERPRETER_COMPUTED_GOTO
+    __attribute__((unused));  // Only reached by goto in the switch flavour
+#endif
+    switch (ip->op) {
+#define X(name)                                                                 \
+        case Operation::name:                                                   \
+        INTERPRETER_HANDLER(name)
+        RV32I_OPERATIONS(X)
+        FUSED_OPERATIONS(X)
+#undef X
+        case Operation::FETCH_FAULT:
+        INTERPRETER_HANDLER(FETCH_FAULT)
+        default:
+        INTERPRETER_HANDLER(ILLEGAL)
     }
+    
+trapped:
+    // Faulting instructions do not retire and leave the PC on themselves;
+    // EXIT/BREAKPOINT end the block and retire it fully
+    cpu.set_pc(next_pc);
+    retire_block(block, stop_retires(pending_stop) ? block.instruction_count
+                                                   : static_cast<uint32_t>(ip - base));
+    active_block = nullptr;
+    return;
+    
+code_modified:
+    // A store overwrote code in this page; the rest of the block may be stale
+    cpu.set_pc(INTERPRETER_PC());
+    retire_block(block, static_cast<uint32_t>(ip - base));
+    active_block = nullptr;
+    return;
+    
+block_done:
+    cpu.set_pc(next_pc);
+    retire_block(block, block.instruction_count);
+    if (next_pc != block.end_pc()) {
+        profiler.record_branch(block.end_pc() - 4, next_pc);
+    }
+    if (block.exit_kind != CallKind::NONE) {
+        profiler.record_transfer(block.exit_kind, block.end_pc() - 4, next_pc);
+    }
+    active_block = nullptr;
+    
+#undef INTERPRETER_HANDLER
+#undef INTERPRETER_PC
+#undef INTERPRETER_DISPATCH
 }
 
-void Interpreter::execute_u_type(const Instruction& inst) {
-    if (inst.opcode == 0x37) {
-        // LUI (load upper immediate)
-        cpu.set_register(inst.rd, inst.imm);
-    } else if (inst.opcode == 0x17) {
-        // AUIPC (add upper immediate to PC)
-        cpu.set_register(inst.rd, cpu.get_pc() + inst.imm);
+void Interpreter::retire_block(const BasicBlock& block, uint32_t retired) {
+    instructions_executed += retired;
+    profiler.record_block(block.start_pc, retired);
+    
+    // Only a block's last instruction can leave it other than by falling
+    // through, and it retires only when the block completes, with the PC
+    // already moved to its successor
+    Prediction prediction = Prediction::NONE;
+    if (branch_simulator && retired == block.instruction_count && pending_stop == StopReason::NONE) {
+        prediction = branch_simulator->resolve(block.ops[retired - 1], block.end_pc() - 4, cpu.get_pc());
+    }
+    if (timing_model) {
+        charge_block(block, retired, prediction);
     }
-    cpu.increment_pc();
 }
 
-void Interpreter::execute_j_type(const Instruction& inst) {
-    // JAL (jump and link)
-    cpu.set_register(inst.rd, cpu.get_pc() + 4);
-    cpu.set_pc(cpu.get_pc() + inst.imm);
+void Interpreter::charge_block(const BasicBlock& block, uint32_t retired, Prediction prediction) {
+    for (uint32_t i = 0; i < retired; i++) {
+        DecodedInstruction inst = block.ops[i];
+        inst.op = unfused_operation(inst.op);
+        uint32_t pc = block.start_pc + i * 4;
+        bool last = i + 1 == block.instruction_count;
+        charge_cycles(inst, pc, last ? cpu.get_pc() : pc + 4, last ? prediction : Prediction::NONE);
+    }
 }
 
-void Interpreter::handle_ecall() {
+void Interpreter::handle_ecall(uint32_t pc) {
     // System call convention:
     // a7 (x17) = syscall number
     // a0-a6 (x10-x16) = arguments
@@ -269,15 +625,20 @@ void Interpreter::handle_ecall() {
     
     switch (syscall_num) {
         case 93: // exit
-            std::cout << "Program exited with code " << arg0 << std::endl;
-            throw std::runtime_error("Exit syscall");
+            stop_exit_code = static_cast<int32_t>(arg0);
+            raise_stop(StopReason::EXIT, pc, pc + 4);
             break;
             
         case 64: // write
             if (arg0 == 1) { // stdout
                 // arg1 = buffer address, arg2 = length
                 for (uint32_t i = 0; i < arg2; i++) {
-                    std::cout << static_cast<char>(cpu.read_byte(arg1 + i));
+                    uint8_t c;
+                    if (!cpu.try_load(arg1 + i, c)) {
+                        cpu.set_register(10, static_cast<uint32_t>(-14)); // -EFAULT
+                        return;
+                    }
+                    std::cout << static_cast<char>(c);
                 }
                 cpu.set_register(10, arg2); // Return bytes written
             }
@@ -287,4 +648,4 @@ void Interpreter::handle_ecall() {
             std::cout << "Unknown syscall: " << syscall_num << std::endl;
             break;
     }
-}
\ No newline at end of file
+}
@@ -3,40 +3,189 @@
 
 #include "cpu.h"
 #include "decoder.h"
+#include "decode_cache.h"
+#include "block_cache.h"
 #include <unordered_map>
 #include "profiler.h"
+#include "timing_model.h"
+#include "branch_predictor.h"
+#include "cache_simulator.h"
+#include <atomic>
+#include <memory>
+#include <setjmp.h>
+
+// Why step()/run() returned
+enum class StopReason {
+    NONE,                 // step() retired its instruction normally
+    INSTRUCTION_LIMIT,    // run() used up its instruction budget
+    EXIT,                 // Guest called exit (ecall 93)
+    BREAKPOINT,           // EBREAK
+    ILLEGAL_INSTRUCTION,  // Unknown or unsupported encoding
+    MEMORY_FAULT          // Load, store or fetch outside guest memory
+};
+
+const char* stop_reason_name(StopReason reason);
+
+// Outcome of step()/run(). Traps leave the CPU resumable: faulting
+// instructions do not retire and the PC stays on them, while EXIT and
+// BREAKPOINT retire and the PC moves past them.
+struct ExecResult {
+    StopReason reason;
+    int32_t exit_code;              // a0 at exit (EXIT only)
+    uint32_t pc;                    // PC of the stopping instruction
+    uint32_t fault_addr;            // Faulting address (MEMORY_FAULT only)
+    uint64_t instructions_retired;  // Retired during this call
+};
+
+// How run() dispatches predecoded instructions to their handlers
+enum class DispatchMode {
+    SWITCH,    // One switch on the operation per instruction
+    THREADED   // Computed-goto jump from handler to handler (GCC/Clang)
+};
 
 class Interpreter {
 public:
-    explicit Interpreter(CPU& cpu) : cpu(cpu), instructions_executed(0) {}
+    explicit Interpreter(CPU& cpu)
+        : cpu(cpu), instructions_executed(0), decode_cache(cpu), block_cache(cpu, decode_cache),
+          dispatch_mode(threaded_dispatch_available() ? DispatchMode::THREADED
+                                                      : DispatchMode::SWITCH),
+          pending_stop(StopReason::NONE), stop_exit_code(0), stop_pc(0), stop_fault_addr(0),
+          access_pc(0), active_block(nullptr), cycles(0), snapshot_instructions(0), snapshot_cycles(0) {}
     
     // Execute one instruction at PC
-    void step();
+    ExecResult step();
     
-    // Execute until halt or error
-    void run(uint64_t max_instructions = 1000000);
+    // Execute until a stop condition or until the total instruction count
+    // reaches max_instructions, a basic block at a time
+    ExecResult run(uint64_t max_instructions = 1000000);
+    
+    // Execute the basic block at PC, or only its first instruction when
+    // the whole block would take the total instruction count past
+    // max_instructions; reason is NONE unless it trapped. Lets a caller
+    // such as ExecutionEngine pick the next block itself.
+    ExecResult run_block(uint64_t max_instructions);
+    
+    // Snapshot the CPU (see CPU::take_snapshot) together with the retired
+    // instruction and cycle counts, and restore them for a fresh re-run.
+    // Caches stay warm across restores; profiles keep accumulating, with
+    // the shadow call stack unwound and the timing model reset at each
+    // restore.
+    void take_snapshot();
+    void restore_snapshot();
+    
+    // Dispatch mode; THREADED falls back to SWITCH where unsupported
+    void set_dispatch_mode(DispatchMode mode);
+    DispatchMode get_dispatch_mode() const { return dispatch_mode; }
+    static bool threaded_dispatch_available();
+    
+    // Cycle estimate: with a timing model every retired instruction is
+    // charged its cycles, in total and per PC in the profile. nullptr
+    // (the default) turns cycle accounting off.
+    void set_timing_model(std::unique_ptr<TimingModel> model);
+    TimingModel* get_timing_model() const { return timing_model.get(); }
+    
+    // Cache simulation: with a simulator attached every instruction fetch
+    // and guest load/store goes through it. Execution switches to
+    // instantiations compiled with the hooks, so without one (the
+    // default) nothing is paid. nullptr detaches.
+    void set_cache_simulator(std::unique_ptr<CacheSimulator> simulator);
+    CacheSimulator* get_cache_simulator() const { return cache_simulator.get(); }
+    
+    // Branch prediction: with a simulator attached every conditional
+    // branch, return and indirect jump is predicted and scored, and a
+    // timing model charges mispredictions instead of taken branches.
+    // nullptr (the default) detaches.
+    void set_branch_simulator(std::unique_ptr<BranchSimulator> simulator);
+    BranchSimulator* get_branch_simulator() const { return branch_simulator.get(); }
     
     // Statistics
     uint64_t get_instructions_executed() const { return instructions_executed; }
-    void reset_stats() { instructions_executed = 0; }
+    uint64_t get_cycles() const { return cycles; }
+    void reset_stats();
     const Profiler& get_profiler() const { return profiler; }
     Profiler& get_profiler() { return profiler; }
+    const DecodeCache& get_decode_cache() const { return decode_cache; }
+    BlockCache& get_block_cache() { return block_cache; }
     
 private:
     CPU& cpu;
     uint64_t instructions_executed;
     Profiler profiler;
+    DecodeCache decode_cache;
+    BlockCache block_cache;
+    DispatchMode dispatch_mode;
+    
+    // Trap raised by the instruction being executed; checked after
+    // operations that can trap instead of unwinding
+    StopReason pending_stop;
+    int32_t stop_exit_code;
+    uint32_t stop_pc;
+    uint32_t stop_fault_addr;
+    
+    // HOST_MMU fault recovery: the PC of the load/store in flight and the
+    // block being executed, read after the signal handler jumps back
+    sigjmp_buf fault_env;
+    uint32_t access_pc;
+    const BasicBlock* active_block;
+    
+    // Note the PC of a load/store before its (possibly faulting) access;
+    // the fence keeps the compiler from moving the access above it
+    void begin_access(uint32_t pc) {
+        access_pc = pc;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    }
+    
+    std::unique_ptr<TimingModel> timing_model;
+    uint64_t cycles;
+    std::unique_ptr<CacheSimulator> cache_simulator;
+    std::unique_ptr<BranchSimulator> branch_simulator;
+    
+    uint64_t snapshot_instructions;
+    uint64_t snapshot_cycles;
+    
+    template <typename Body>
+    void with_fault_recovery(Body&& body);
+    void recover_host_fault();
+    
+    // Record a trap and return the PC execution resumes at
+    uint32_t raise_stop(StopReason reason, uint32_t pc, uint32_t resume_pc, uint32_t fault_addr = 0);
+    ExecResult take_result(uint64_t retired);
+    
+    // step() without result bookkeeping; leaves pending_stop set
+    void step_instruction();
+    
+    // Execute one predecoded instruction (switch dispatch)
+    template <bool Simulated>
+    void execute(const DecodedInstruction& inst);
+    
+    // Semantics of one operation; returns the next PC. Simulated adds
+    // the cache simulator hooks.
+    template <Operation Op, bool Simulated>
+    uint32_t execute_op(const DecodedInstruction& inst, uint32_t pc);
+    
+    // run_blocks() for the dispatch mode and simulator, under fault recovery
+    void dispatch_blocks(uint64_t max_instructions, bool single_block);
+    
+    // Block loop used by run(); run_block() takes one iteration
+    template <bool Threaded, bool Simulated>
+    void run_blocks(uint64_t max_instructions, bool single_block = false);
+    
+    template <bool Threaded, bool Simulated>
+    void execute_block(const BasicBlock& block);
+    
+    // Count a block's retired instructions and profile it
+    void retire_block(const BasicBlock& block, uint32_t retired);
     
-    // Instruction handlers
-    void execute_r_type(const Instruction& inst);
-    void execute_i_type(const Instruction& inst);
-    void execute_s_type(const Instruction& inst);
-    void execute_b_type(const Instruction& inst);
-    void execute_u_type(const Instruction& inst);
-    void execute_j_type(const Instruction& inst);
+    // Run retired instructions through the timing model
+    void charge_cycles(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc, Prediction prediction) {
+        uint32_t spent = timing_model->retire(inst, pc, next_pc, prediction);
+        cycles += spent;
+        profiler.record_cycles(pc, spent);
+    }
+    void charge_block(const BasicBlock& block, uint32_t retired, Prediction prediction);
     
     // Helper for system calls
-    void handle_ecall();
+    void handle_ecall(uint32_t pc);
     
 };
 
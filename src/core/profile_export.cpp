@@ -0,0 +1,229 @@
+#include "profile_export.h"
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+const char* const UNKNOWN_FUNCTION = "[unknown]";
+
+// Minimal protobuf writer: varints and length-delimited fields, enough
+// for profile.proto
+class ProtoWriter {
+public:
+    void varint(uint32_t field, uint64_t value) {
+        raw_varint(static_cast<uint64_t>(field) << 3);
+        raw_varint(value);
+    }
+
+    void bytes(uint32_t field, const std::string& value) {
+        raw_varint((static_cast<uint64_t>(field) << 3) | 2);
+        raw_varint(value.size());
+        data += value;
+    }
+
+    void message(uint32_t field, const ProtoWriter& value) { bytes(field, value.data); }
+
+    void packed(uint32_t field, const std::vector<uint64_t>& values) {
+        ProtoWriter payload;
+        for (uint64_t value : values) {
+            payload.raw_varint(value);
+        }
+        bytes(field, payload.data);
+    }
+
+    const std::string& get_data() const { return data; }
+
+private:
+    std::string data;
+
+    void raw_varint(uint64_t value) {
+        while (value >= 0x80) {
+            data += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        data += static_cast<char>(value);
+    }
+};
+
+std::string gzip(const std::string& data) {
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("Failed to initialise gzip compression");
+    }
+    std::string compressed(deflateBound(&stream, data.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    int status = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        throw std::runtime_error("Failed to gzip the profile");
+    }
+    return compressed;
+}
+
+std::string json_escape(const std::string& text) {
+    static const char* const hex = "0123456789abcdef";
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += "\\u00";
+            escaped += hex[(c >> 4) & 0xF];
+            escaped += hex[c & 0xF];
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+void write_collapsed_stacks(const Profiler& profiler, std::ostream& out, StackWeight weight) {
+    const SymbolTable& symbols = profiler.get_symbols();
+    profiler.for_each_call_stack([&](const std::vector<uint32_t>& frames, uint64_t instructions, uint64_t cycles) {
+        uint64_t value = weight == StackWeight::CYCLES ? cycles : instructions;
+        if (value == 0) {
+            return;
+        }
+        if (frames.empty()) {
+            out << UNKNOWN_FUNCTION;
+        }
+        for (size_t i = 0; i < frames.size(); i++) {
+            out << (i ? ";" : "") << symbols.describe(frames[i]);
+        }
+        out << " " << value << "\n";
+    });
+}
+
+void write_pprof(const Profiler& profiler, std::ostream& out) {
+    const SymbolTable& symbols = profiler.get_symbols();
+    const bool timed = profiler.get_total_cycles() != 0;
+
+    std::vector<std::string> strings = {""};
+    std::unordered_map<std::string, uint64_t> string_ids;
+    auto string_id = [&](const std::string& text) {
+        auto [it, inserted] = string_ids.try_emplace(text, strings.size());
+        if (inserted) {
+            strings.push_back(text);
+        }
+        return it->second;
+    };
+
+    // One function and one location per function key, sharing ids;
+    // key ~0 stands for instructions outside any frame
+    const uint32_t unknown_key = ~0u;
+    std::unordered_map<uint32_t, uint64_t> location_ids;
+    std::vector<uint32_t> functions;
+    auto location_id = [&](uint32_t key) {
+        auto [it, inserted] = location_ids.try_emplace(key, functions.size() + 1);
+        if (inserted) {
+            functions.push_back(key);
+        }
+        return it->second;
+    };
+
+    ProtoWriter profile;
+    auto value_type = [&](const char* type, const char* unit) {
+        ProtoWriter message;
+        message.varint(1, string_id(type));
+        message.varint(2, string_id(unit));
+        return message;
+    };
+    profile.message(1, value_type("instructions", "count"));
+    if (timed) {
+        profile.message(1, value_type("cycles", "count"));
+    }
+
+    profiler.for_each_call_stack([&](const std::vector<uint32_t>& frames, uint64_t instructions, uint64_t cycles) {
+        std::vector<uint64_t> locations;  // Innermost first
+        for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+            locations.push_back(location_id(*it));
+        }
+        if (frames.empty()) {
+            locations.push_back(location_id(unknown_key));
+        }
+        std::vector<uint64_t> values = {instructions};
+        if (timed) {
+            values.push_back(cycles);
+        }
+        ProtoWriter sample;
+        sample.packed(1, locations);
+        sample.packed(2, values);
+        profile.message(2, sample);
+    });
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        uint32_t key = functions[i];
+        ProtoWriter line;
+        line.varint(1, i + 1);
+        ProtoWriter location;
+        location.varint(1, i + 1);
+        if (key != unknown_key) {
+            location.varint(3, key);
+        }
+        location.message(4, line);
+        profile.message(4, location);
+    }
+    for (size_t i = 0; i < functions.size(); i++) {
+        uint32_t key = functions[i];
+        uint64_t name = string_id(key == unknown_key ? UNKNOWN_FUNCTION : symbols.describe(key));
+        ProtoWriter function;
+        function.varint(1, i + 1);
+        function.varint(2, name);
+        function.varint(3, name);
+        profile.message(5, function);
+    }
+    for (const std::string& text : strings) {
+        profile.bytes(6, text);
+    }
+    profile.message(11, value_type("instructions", "count"));
+    profile.varint(12, 1);
+
+    std::string compressed = gzip(profile.get_data());
+    out.write(compressed.data(), static_cast<std::streamsize>(compressed.size()));
+}
+
+void write_chrome_trace(const Profiler& profiler, std::ostream& out) {
+    const SymbolTable& symbols = profiler.get_symbols();
+    const std::vector<CallTraceEvent>& trace = profiler.get_call_trace();
+    const bool timed = profiler.get_total_cycles() != 0;
+    auto timestamp = [&](uint64_t instructions, uint64_t cycles) { return timed ? cycles : instructions; };
+
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    auto event = [&](const char* phase, uint32_t function, uint64_t time) {
+        out << (first ? "\n" : ",\n") << "{\"name\":\"" << json_escape(symbols.describe(function))
+            << "\",\"ph\":\"" << phase << "\",\"ts\":" << time << ",\"pid\":1,\"tid\":1}";
+        first = false;
+    };
+
+    std::vector<uint32_t> open;
+    for (const CallTraceEvent& call : trace) {
+        if (call.enter) {
+            open.push_back(call.function);
+            event("B", call.function, timestamp(call.instructions, call.cycles));
+        } else if (!open.empty()) {
+            open.pop_back();
+            event("E", call.function, timestamp(call.instructions, call.cycles));
+        }
+    }
+    uint64_t end = timestamp(profiler.get_total_instructions(), profiler.get_total_cycles());
+    if (profiler.is_call_trace_truncated() && !trace.empty()) {
+        end = timestamp(trace.back().instructions, trace.back().cycles);
+    }
+    while (!open.empty()) {
+        event("E", open.back(), end);
+        open.pop_back();
+    }
+    out << "\n],\"otherData\":{\"clock\":\""
+        << (timed ? "cycles" : "instructions") << "\"}}\n";
+}
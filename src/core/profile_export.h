@@ -0,0 +1,32 @@
+#ifndef PROFILE_EXPORT_H
+#define PROFILE_EXPORT_H
+
+#include "profiler.h"
+#include <ostream>
+
+// What a stack export weighs each call path by
+enum class StackWeight : uint8_t {
+    INSTRUCTIONS,
+    CYCLES        // From the timing model; all zero if none ran
+};
+
+// Collapsed stacks for flamegraph.pl, inferno or speedscope: one line
+// per call path, "outer;inner;innermost count", in path order. Functions
+// are named by symbol, or by hex address without one; instructions
+// retired outside any frame are listed as "[unknown]".
+void write_collapsed_stacks(const Profiler& profiler, std::ostream& out,
+                            StackWeight weight = StackWeight::INSTRUCTIONS);
+
+// The same call paths as a gzipped pprof profile (profile.proto), with
+// one location per function. Sample values are instructions, plus
+// cycles when a timing model ran.
+void write_pprof(const Profiler& profiler, std::ostream& out);
+
+// The call trace (Profiler::set_call_trace_limit) as Chrome trace-event
+// JSON, for chrome://tracing or Perfetto: a B/E event pair per call,
+// timestamped in cycles when a timing model ran, else in instructions,
+// shown as microseconds. Frames still open (or whose return was
+// truncated away) end at the last timestamp.
+void write_chrome_trace(const Profiler& profiler, std::ostream& out);
+
+#endif // PROFILE_EXPORT_H
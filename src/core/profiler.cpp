@@ -1,37 +1,393 @@
 #include "profiler.h"
+#include "control_flow.h"
 #include <iostream>
 #include <iomanip>
+#include <sstream>
+#include <unordered_set>
+
+std::unordered_map<uint32_t, uint64_t> Profiler::collect_fallback_counts() const {
+    std::unordered_map<uint32_t, uint64_t> counts = instruction_counts;
+    
+    for (const auto& [key, count] : block_counts) {
+        uint32_t start = static_cast<uint32_t>(key);
+        uint32_t length = static_cast<uint32_t>(key >> 32);
+        for (uint32_t i = 0; i < length; i++) {
+            counts[start + i * 4] += count;
+        }
+    }
+    
+    return counts;
+}
+
+void Profiler::materialise_counts() const {
+    slot_counts.resize(text_bytes / 4);
+    int64_t count = 0;
+    for (size_t i = 0; i < slot_counts.size(); i++) {
+        count += deltas[i];
+        slot_counts[i] = static_cast<uint64_t>(count);
+    }
+    fallback_counts = collect_fallback_counts();
+    counts_current = true;
+}
+
+uint64_t Profiler::get_instruction_count(uint32_t pc) const {
+    if (!counts_current) {
+        materialise_counts();
+    }
+    uint32_t offset = pc - text_base;
+    if (offset < text_bytes && (offset & 3) == 0) {
+        return estimate(slot_counts[offset >> 2]);
+    }
+    auto it = fallback_counts.find(pc);
+    return estimate(it != fallback_counts.end() ? it->second : 0);
+}
+
+uint64_t Profiler::get_cycles(uint32_t pc) const {
+    uint32_t offset = pc - text_base;
+    if (offset < text_bytes && (offset & 3) == 0) {
+        return cycle_counts[offset >> 2];
+    }
+    auto it = other_cycles.find(pc);
+    return it != other_cycles.end() ? it->second : 0;
+}
+
+void Profiler::change_text_range(uint32_t start, uint32_t end) {
+    range_start = start;
+    range_end = end;
+    uint32_t base = start & ~(PAGE_SIZE - 1);
+    uint64_t limit = (static_cast<uint64_t>(end) + PAGE_SIZE - 1) & ~static_cast<uint64_t>(PAGE_SIZE - 1);
+    uint64_t span = end > start ? limit - base : 0;
+    uint32_t bytes = span <= MAX_DENSE_TEXT ? static_cast<uint32_t>(span) : 0;
+    if (base == text_base && bytes == text_bytes) {
+        return;
+    }
+    
+    // Re-file the counts gathered so far under the new range
+    std::vector<std::pair<uint32_t, uint64_t>> counts;
+    for_each_raw_count([&](uint32_t pc, uint64_t count) { counts.emplace_back(pc, count); });
+    std::vector<std::pair<uint64_t, uint64_t>> edges;
+    for_each_edge([&](uint32_t from, uint32_t to, uint64_t count) {
+        edges.emplace_back((static_cast<uint64_t>(from) << 32) | to, count);
+    });
+    std::unordered_map<uint32_t, uint64_t> cycles = std::move(other_cycles);
+    for (size_t i = 0; i < cycle_counts.size(); i++) {
+        if (cycle_counts[i] != 0) {
+            cycles[text_base + static_cast<uint32_t>(i * 4)] += cycle_counts[i];
+        }
+    }
+    
+    text_base = base;
+    text_bytes = bytes;
+    counts_current = false;
+    deltas.assign(bytes ? bytes / 4 + 1 : 0, 0);
+    edge_targets.assign(bytes / 4, 0);
+    edge_counts.assign(bytes / 4, 0);
+    cycle_counts.assign(bytes / 4, 0);
+    instruction_counts.clear();
+    block_counts.clear();
+    other_edges.clear();
+    other_cycles.clear();
+    for (const auto& [pc, count] : counts) {
+        uint32_t offset = pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0) {
+            deltas[offset >> 2] += static_cast<int64_t>(count);
+            deltas[(offset >> 2) + 1] -= static_cast<int64_t>(count);
+        } else {
+            instruction_counts[pc] += count;
+        }
+    }
+    for (const auto& [key, count] : edges) {
+        uint32_t from = static_cast<uint32_t>(key >> 32);
+        uint32_t offset = from - text_base;
+        if (offset < text_bytes && (offset & 3) == 0 && edge_counts[offset >> 2] == 0) {
+            edge_targets[offset >> 2] = static_cast<uint32_t>(key);
+            edge_counts[offset >> 2] = count;
+        } else {
+            other_edges[key] += count;
+        }
+    }
+    for (const auto& [pc, count] : cycles) {
+        uint32_t offset = pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0) {
+            cycle_counts[offset >> 2] += count;
+        } else {
+            other_cycles[pc] += count;
+        }
+    }
+}
+
+std::vector<uint32_t> Profiler::detect_hot_loops(uint64_t threshold) const {
+    ControlFlowGraph cfg(*this);
+    std::vector<uint32_t> headers;
+    for (const NaturalLoop& loop : cfg.get_loops()) {
+        if (loop.header_count >= threshold) {
+            headers.push_back(loop.header);
+        }
+    }
+    return headers;
+}
+
+void Profiler::set_sampling(uint32_t period, uint64_t seed) {
+    sample_period = period;
+    sample_rng = seed ? seed : 1;
+    reset();
+}
+
+void Profiler::take_samples(uint32_t pc, uint32_t length) {
+    // The countdown hit zero on instruction length + countdown - 1 of the
+    // run; short gaps can put several samples in one run
+    do {
+        uint32_t sample_pc = pc + static_cast<uint32_t>(length + sample_countdown - 1) * 4;
+        uint32_t offset = sample_pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0) {
+            count_run(offset >> 2, 1);
+        } else {
+            instruction_counts[sample_pc]++;
+        }
+        sample_count++;
+        sample_countdown += next_sample_gap();
+    } while (sample_countdown <= 0);
+}
+
+int64_t Profiler::next_sample_gap() {
+    sample_rng ^= sample_rng << 13;
+    sample_rng ^= sample_rng >> 7;
+    sample_rng ^= sample_rng << 17;
+    return 1 + static_cast<int64_t>(sample_rng % (2 * uint64_t(sample_period) - 1));
+}
+
+uint64_t Profiler::estimate(uint64_t samples) const {
+    if (sample_period == 0 || sample_count == 0) {
+        return samples;
+    }
+    return static_cast<uint64_t>(static_cast<double>(samples) * total_instructions / sample_count + 0.5);
+}
+
+namespace {
+
+std::string format_percent(uint64_t count, uint64_t total) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << (total ? static_cast<double>(count) / total * 100.0 : 0.0) << "%";
+    return out.str();
+}
+
+} // namespace
+
+void Profiler::track_transfer(CallKind kind, uint32_t from_pc, uint32_t target) {
+    // The caller of the first call (or the function returning to code
+    // that never called it) becomes the outermost frame
+    if (call_stack.empty()) {
+        push_frame(function_key(from_pc), root_entry);
+    }
+    
+    if (kind == CallKind::CALL) {
+        uint32_t callee = function_key(target);
+        push_frame(callee, total_instructions);
+        call_counts[callee]++;
+    } else {
+        pop_frame();
+        if (call_stack.empty()) {
+            root_entry = total_instructions;
+        }
+    }
+}
+
+void Profiler::unwind_call_stack() {
+    while (!call_stack.empty()) {
+        pop_frame();
+    }
+    root_entry = total_instructions;
+}
+
+void Profiler::push_frame(uint32_t function, uint64_t entry) {
+    call_stack.push_back({function, entry});
+    frame_depth[function]++;
+    
+    trace_call(entry, current_node == 0 ? node_cycles : total_cycles, function, true);
+    auto [it, inserted] = stack_children.try_emplace((static_cast<uint64_t>(current_node) << 32) | function,
+                                                     static_cast<uint32_t>(stack_nodes.size()));
+    if (inserted) {
+        stack_nodes.push_back({function, current_node, 0, 0});
+    }
+    enter_stack_node(it->second);
+}
+
+void Profiler::pop_frame() {
+    CallFrame frame = call_stack.back();
+    call_stack.pop_back();
+    if (--frame_depth[frame.function] == 0) {
+        inclusive_counts[frame.function] += total_instructions - frame.entry;
+    }
+    
+    trace_call(total_instructions, total_cycles, frame.function, false);
+    enter_stack_node(stack_nodes[current_node].parent);
+}
+
+// What retired while the stack was empty belongs to the outermost frame
+// opened next, so leaving node 0 keeps the running totals
+void Profiler::enter_stack_node(uint32_t node) {
+    if (current_node != 0) {
+        stack_nodes[current_node].instructions += total_instructions - node_instructions;
+        stack_nodes[current_node].cycles += total_cycles - node_cycles;
+        node_instructions = total_instructions;
+        node_cycles = total_cycles;
+    }
+    current_node = node;
+}
+
+void Profiler::trace_call(uint64_t instructions, uint64_t cycles, uint32_t function, bool enter) {
+    if (call_trace.size() < call_trace_limit) {
+        call_trace.push_back({instructions, cycles, function, enter});
+    } else if (call_trace_limit != 0) {
+        call_trace_truncated = true;
+    }
+}
+
+void Profiler::set_call_trace_limit(size_t max_events) {
+    call_trace_limit = max_events;
+    call_trace.clear();
+    call_trace_truncated = false;
+}
+
+std::vector<FunctionProfile> Profiler::get_function_profile() const {
+    std::unordered_map<uint32_t, FunctionProfile> functions;
+    auto function_for = [&](uint32_t pc) -> FunctionProfile& {
+        const Symbol* symbol = symbols.lookup(pc);
+        uint32_t start = symbol ? symbol->start : 0;
+        auto [it, inserted] = functions.try_emplace(start);
+        if (inserted) {
+            it->second = {symbol ? symbol->name : "[unknown]", start, 0, 0, 0};
+        }
+        return it->second;
+    };
+    
+    for_each_instruction_count([&](uint32_t pc, uint64_t count) {
+        function_for(pc).exclusive += count;
+    });
+    for (const auto& [function, count] : inclusive_counts) {
+        function_for(function).inclusive += count;
+    }
+    for (const auto& [function, count] : call_counts) {
+        function_for(function).calls += count;
+    }
+    
+    // Frames still open count up to now, once per function
+    std::unordered_set<uint32_t> open;
+    for (const CallFrame& frame : call_stack) {
+        if (open.insert(frame.function).second) {
+            function_for(frame.function).inclusive += total_instructions - frame.entry;
+        }
+    }
+    
+    std::vector<FunctionProfile> result;
+    for (auto& [start, function] : functions) {
+        function.inclusive = std::max(function.inclusive, function.exclusive);
+        result.push_back(function);
+    }
+    std::sort(result.begin(), result.end(), [](const FunctionProfile& a, const FunctionProfile& b) {
+        if (a.exclusive != b.exclusive) {
+            return a.exclusive > b.exclusive;
+        }
+        return a.start < b.start;
+    });
+    return result;
+}
 
 void Profiler::print_profile() const {
     std::cout << "\n=== Execution Profile ===" << std::endl;
     std::cout << "Total instructions: " << total_instructions << std::endl;
-    std::cout << "Unique PCs: " << instruction_counts.size() << std::endl;
+    if (total_cycles != 0) {
+        std::cout << "Total cycles: " << total_cycles << " (CPI " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(total_cycles) / total_instructions << std::defaultfloat << ")"
+                  << std::endl;
+    }
+    if (sample_period != 0) {
+        std::cout << "Sampling: 1 in ~" << sample_period << " instructions, " << sample_count
+                  << " samples (per-PC counts are estimates)" << std::endl;
+        std::cout << "Sampled PCs: " << get_unique_instructions() << std::endl;
+    } else {
+        std::cout << "Unique PCs: " << get_unique_instructions() << std::endl;
+    }
     
     auto hot_instructions = get_hot_instructions(20);
     
+    if (!symbols.empty()) {
+        std::cout << "\n=== Functions ===" << std::endl;
+        std::cout << std::left << std::setw(24) << "Function"
+                  << std::setw(10) << "Calls"
+                  << std::setw(15) << "Exclusive"
+                  << std::setw(10) << "Excl %"
+                  << std::setw(15) << "Inclusive"
+                  << "Incl %" << std::endl;
+        std::cout << std::string(80, '-') << std::endl;
+        
+        for (const auto& function : get_function_profile()) {
+            std::cout << std::left << std::setw(24) << function.name
+                      << std::setw(10) << function.calls
+                      << std::setw(15) << function.exclusive
+                      << std::setw(10) << format_percent(function.exclusive, total_instructions)
+                      << std::setw(15) << function.inclusive
+                      << format_percent(function.inclusive, total_instructions) << std::endl;
+        }
+    }
+    
     std::cout << "\n=== Top 20 Hottest Instructions ===" << std::endl;
+    const bool timed = total_cycles != 0;
     std::cout << std::left << std::setw(12) << "PC"
               << std::setw(15) << "Count"
-              << std::setw(12) << "Percentage" << std::endl;
-    std::cout << std::string(40, '-') << std::endl;
+              << std::setw(12) << "Percentage"
+              << (timed ? "Cycles         " : "")
+              << (symbols.empty() ? "" : "Location") << std::endl;
+    std::cout << std::string((symbols.empty() ? 40 : 64) + (timed ? 15 : 0), '-') << std::endl;
     
     for (const auto& entry : hot_instructions) {
-        double percentage = (static_cast<double>(entry.count) / total_instructions) * 100.0;
-        std::cout << "0x" << std::hex << std::setw(8) << std::setfill('0') << entry.pc
-                  << std::dec << std::setfill(' ')
+        std::cout << "0x" << std::right << std::hex << std::setw(8) << std::setfill('0') << entry.pc
+                  << std::dec << std::setfill(' ') << std::left
                   << "  " << std::setw(13) << entry.count
-                  << "  " << std::fixed << std::setprecision(2) << std::setw(10) << percentage << "%"
-                  << std::endl;
+                  << std::setw(12) << format_percent(entry.count, total_instructions);
+        if (timed) {
+            std::cout << std::setw(15) << entry.total_cycles;
+        }
+        if (!symbols.empty()) {
+            std::cout << symbols.describe(entry.pc);
+        }
+        std::cout << std::endl;
     }
     
-    // Detect hot loops
-    auto hot_loops = detect_hot_loops(100);
-    if (!hot_loops.empty()) {
-        std::cout << "\n=== Hot Loops (>100 executions) ===" << std::endl;
-        for (uint32_t pc : hot_loops) {
-            std::cout << "0x" << std::hex << std::setw(8) << std::setfill('0') << pc
-                      << std::dec << " - executed " << instruction_counts.at(pc) << " times"
-                      << std::endl;
+    // Natural loops from the reconstructed control-flow graph
+    ControlFlowGraph cfg(*this);
+    bool header_printed = false;
+    for (const NaturalLoop& loop : cfg.get_loops()) {
+        if (loop.header_count < 100) {
+            continue;
+        }
+        if (!header_printed) {
+            std::cout << "\n=== Hot Loops (header entered >= 100 times) ===" << std::endl;
+            std::cout << std::left << std::setw(12) << "Header"
+                      << std::setw(7) << "Depth"
+                      << std::setw(8) << "Blocks"
+                      << std::setw(12) << "Iterations"
+                      << std::setw(10) << "Avg trip"
+                      << std::setw(15) << "Instructions"
+                      << std::setw(10) << "Percent"
+                      << (symbols.empty() ? "" : "Location") << std::endl;
+            std::cout << std::string(symbols.empty() ? 74 : 98, '-') << std::endl;
+            header_printed = true;
+        }
+        std::ostringstream trip;
+        trip << std::fixed << std::setprecision(1) << loop.average_trip_count();
+        std::cout << "0x" << std::right << std::hex << std::setw(8) << std::setfill('0') << loop.header
+                  << std::dec << std::setfill(' ') << std::left
+                  << "  " << std::setw(7) << loop.depth
+                  << std::setw(8) << loop.blocks.size()
+                  << std::setw(12) << loop.iterations
+                  << std::setw(10) << trip.str()
+                  << std::setw(15) << loop.instructions
+                  << std::setw(10) << format_percent(loop.instructions, total_instructions);
+        if (!symbols.empty()) {
+            std::cout << symbols.describe(loop.header);
         }
+        std::cout << std::endl;
     }
 }
\ No newline at end of file
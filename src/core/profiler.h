@@ -1,7 +1,10 @@
 #ifndef PROFILER_H
 #define PROFILER_H
 
+#include "decoder.h"
+#include "symbol_table.h"
 #include <cstdint>
+#include <string>
 #include <unordered_map>
 #include <vector>
 #include <algorithm>
@@ -9,86 +12,440 @@
 struct ProfileEntry {
     uint32_t pc;
     uint64_t count;
-    uint64_t total_cycles;
+    uint64_t total_cycles;  // From the timing model; count if none ran
     ProfileEntry() : pc(0), count(0), total_cycles(0) {}
     ProfileEntry(uint32_t p, uint64_t c, uint64_t tc) 
         : pc(p), count(c), total_cycles(tc) {}
 };
 
+// Instructions attributed to one function. Exclusive counts the
+// function's own instructions; inclusive also counts its callees, from
+// the shadow call stack (recursive calls count once). Functions entered
+// without a call (tail jumps, the entry point) get at least their
+// exclusive count.
+struct FunctionProfile {
+    std::string name;
+    uint32_t start;
+    uint64_t calls;
+    uint64_t exclusive;
+    uint64_t inclusive;
+};
+
+// A frame opening (call) or closing (return) on the shadow call stack,
+// stamped with the instruction and cycle totals at that point
+struct CallTraceEvent {
+    uint64_t instructions;
+    uint64_t cycles;
+    uint32_t function;  // Symbol start, or the raw PC without symbols
+    bool enter;
+};
+
 class Profiler {
 public:
-    Profiler() : total_instructions(0), profiling_enabled(true) {}
+    Profiler()
+        : range_start(0), range_end(0), text_base(0), text_bytes(0), counts_current(false),
+          total_instructions(0), total_cycles(0), profiling_enabled(true), sample_period(0), sample_countdown(0),
+          sample_count(0), sample_rng(1), root_entry(0), stack_nodes(1, StackNode{0, 0, 0, 0}), current_node(0),
+          node_instructions(0), node_cycles(0), call_trace_limit(0), call_trace_truncated(false) {}
     
     // Record instruction execution
     void record_instruction(uint32_t pc) {
         if (!profiling_enabled) return;
         
-        instruction_counts[pc]++;
+        counts_current = false;
+        if (sample_period != 0) {
+            total_instructions++;
+            if (--sample_countdown <= 0) {
+                take_samples(pc, 1);
+            }
+            return;
+        }
+        uint32_t offset = pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0) {
+            count_run(offset >> 2, 1);
+        } else {
+            instruction_counts[pc]++;
+        }
         total_instructions++;
     }
     
-    // Get hot instructions (executed most frequently)
-    std::vector<ProfileEntry> get_hot_instructions(size_t top_n = 10) const {
-        std::vector<ProfileEntry> entries;
+    // Record a straight-line run of `length` instructions starting at pc.
+    // A constant number of counter updates per basic block; per-PC
+    // counts are expanded on the first query after a record.
+    void record_block(uint32_t pc, uint32_t length) {
+        if (!profiling_enabled || length == 0) return;
         
-        for (const auto& [pc, count] : instruction_counts) {
-            entries.emplace_back(pc, count, count); // cycles = count for now
+        counts_current = false;
+        if (sample_period != 0) {
+            total_instructions += length;
+            sample_countdown -= length;
+            if (sample_countdown <= 0) {
+                take_samples(pc, length);
+            }
+            return;
         }
-        
-        // Sort by execution count
-        std::sort(entries.begin(), entries.end(), 
-                  [](const ProfileEntry& a, const ProfileEntry& b) {
-                      return a.count > b.count;
-                  });
-        
-        // Return top N
-        if (entries.size() > top_n) {
-            entries.resize(top_n);
+        uint32_t offset = pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0 && length <= (text_bytes - offset) >> 2) {
+            count_run(offset >> 2, length);
+        } else {
+            block_counts[(static_cast<uint64_t>(length) << 32) | pc]++;
         }
+        total_instructions += length;
+    }
+    
+    // Record a taken control transfer: a branch, jump or return at
+    // from_pc that continued at to_pc rather than from_pc + 4. Fall-
+    // through counts follow from the per-PC counts, so only taken edges
+    // are counted. Exact mode only; sampled profiles keep no edges.
+    void record_branch(uint32_t from_pc, uint32_t to_pc) {
+        if (!profiling_enabled || sample_period != 0) return;
         
-        return entries;
+        uint32_t offset = from_pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0) {
+            uint32_t slot = offset >> 2;
+            if (edge_counts[slot] == 0 || edge_targets[slot] == to_pc) {
+                edge_targets[slot] = to_pc;
+                edge_counts[slot]++;
+                return;
+            }
+        }
+        other_edges[(static_cast<uint64_t>(from_pc) << 32) | to_pc]++;
     }
     
-    // Detect hot loops (basic block that jumps back to itself)
-    std::vector<uint32_t> detect_hot_loops(uint64_t threshold = 100) const {
-        std::vector<uint32_t> hot_loops;
+    // Charge cycles from the timing model to the instruction at pc.
+    // Always exact, also while sampling.
+    void record_cycles(uint32_t pc, uint64_t cycles) {
+        if (!profiling_enabled) return;
         
-        for (const auto& [pc, count] : instruction_counts) {
-            if (count >= threshold) {
-                hot_loops.push_back(pc);
+        uint32_t offset = pc - text_base;
+        if (offset < text_bytes && (offset & 3) == 0) {
+            cycle_counts[offset >> 2] += cycles;
+        } else {
+            other_cycles[pc] += cycles;
+        }
+        total_cycles += cycles;
+    }
+    
+    // Executable range [start, end) whose PCs get dense counters; PCs
+    // outside it fall back to hash maps. The range is widened to whole
+    // pages, so blocks (which never cross a page) fit in it whole. Ranges
+    // over MAX_DENSE_TEXT bytes (e.g. code segments far apart) get no
+    // dense counters. Counts recorded so far are kept. Cheap when the
+    // range is unchanged.
+    void set_text_range(uint32_t start, uint32_t end) {
+        if (start != range_start || end != range_end) {
+            change_text_range(start, end);
+        }
+    }
+    
+    // Sampling: instead of counting every instruction, record the PC of
+    // one retired instruction in about every `period`. The gap to the
+    // next sample is drawn uniformly from [1, 2 * period - 1] (seeded by
+    // `seed`), so samples do not lock onto a loop whose length divides
+    // the period. Per-PC counts are then estimates: samples scaled by
+    // the exact instruction total over the sample count. The unique PC
+    // count only covers sampled PCs. Period 0 counts every instruction. Changing
+    // the mode clears the profile.
+    void set_sampling(uint32_t period, uint64_t seed = 1);
+    uint32_t get_sampling_period() const { return sample_period; }
+    bool is_sampling() const { return sample_period != 0; }
+    uint64_t get_sample_count() const { return sample_count; }
+    
+    // Track a call or return retired at from_pc (after its block and
+    // cycles were recorded) on the shadow call stack
+    void record_transfer(CallKind kind, uint32_t from_pc, uint32_t target) {
+        if (profiling_enabled && kind != CallKind::NONE) {
+            track_transfer(kind, from_pc, target);
+        }
+    }
+    
+    // Close every open frame as if it returned now, e.g. when execution
+    // restarts from a snapshot
+    void unwind_call_stack();
+    
+    // Call paths: call visit(frames, instructions, cycles) for every path
+    // of the shadow call stack that retired instructions in its innermost
+    // frame. frames holds function keys (symbol start, or the raw PC
+    // without symbols), outermost first; instructions retired after the
+    // outermost frame returned come with no frames. Counts are exact,
+    // also while sampling, and cycles are zero without a timing model.
+    template <typename Visit>
+    void for_each_call_stack(Visit&& visit) const {
+        std::vector<uint32_t> frames;
+        for (uint32_t node = 0; node < stack_nodes.size(); node++) {
+            uint64_t instructions = stack_nodes[node].instructions;
+            uint64_t cycles = stack_nodes[node].cycles;
+            if (node == current_node) {
+                instructions += total_instructions - node_instructions;
+                cycles += total_cycles - node_cycles;
             }
+            if (instructions == 0 && cycles == 0) {
+                continue;
+            }
+            frames.clear();
+            for (uint32_t at = node; at != 0; at = stack_nodes[at].parent) {
+                frames.push_back(stack_nodes[at].function);
+            }
+            std::reverse(frames.begin(), frames.end());
+            visit(frames, instructions, cycles);
         }
+    }
+    
+    // Call trace: record every frame opening and closing, up to
+    // max_events events (0, the default, records none). Later events are
+    // dropped and the trace marked truncated. Changing the limit clears
+    // the trace.
+    void set_call_trace_limit(size_t max_events);
+    const std::vector<CallTraceEvent>& get_call_trace() const { return call_trace; }
+    bool is_call_trace_truncated() const { return call_trace_truncated; }
+    
+    // Symbols used to roll PCs up into functions
+    void set_symbols(SymbolTable table) { symbols = std::move(table); }
+    const SymbolTable& get_symbols() const { return symbols; }
+    
+    // Per-function totals, hottest (exclusive) first. PCs outside every
+    // symbol are pooled under "[unknown]".
+    std::vector<FunctionProfile> get_function_profile() const;
+    
+    // Call visit(pc, count) for every executed PC: the text range in
+    // address order, then PCs outside it. Streams the counters without
+    // building a per-PC copy. Counts are estimates when sampling.
+    template <typename Visit>
+    void for_each_instruction_count(Visit&& visit) const {
+        if (sample_period == 0) {
+            for_each_raw_count(visit);
+            return;
+        }
+        for_each_raw_count([&](uint32_t pc, uint64_t samples) { visit(pc, estimate(samples)); });
+    }
+    
+    // Call visit(from_pc, to_pc, count) for every taken edge
+    template <typename Visit>
+    void for_each_edge(Visit&& visit) const {
+        for (size_t i = 0; i < edge_counts.size(); i++) {
+            if (edge_counts[i] != 0) {
+                visit(text_base + static_cast<uint32_t>(i * 4), edge_targets[i], edge_counts[i]);
+            }
+        }
+        for (const auto& [key, count] : other_edges) {
+            visit(static_cast<uint32_t>(key >> 32), static_cast<uint32_t>(key), count);
+        }
+    }
+    
+    // Get hot instructions (executed most frequently), ties by address
+    std::vector<ProfileEntry> get_hot_instructions(size_t top_n = 10) const {
+        // Min-heap of the top_n hottest so far, coldest at the front
+        auto hotter = [](const ProfileEntry& a, const ProfileEntry& b) {
+            return a.count != b.count ? a.count > b.count : a.pc < b.pc;
+        };
+        std::vector<ProfileEntry> entries;
+        if (top_n == 0) {
+            return entries;
+        }
+        entries.reserve(top_n);
         
-        return hot_loops;
+        for_each_instruction_count([&](uint32_t pc, uint64_t count) {
+            ProfileEntry entry(pc, count, 0);
+            if (entries.size() < top_n) {
+                entries.push_back(entry);
+                std::push_heap(entries.begin(), entries.end(), hotter);
+            } else if (hotter(entry, entries.front())) {
+                std::pop_heap(entries.begin(), entries.end(), hotter);
+                entries.back() = entry;
+                std::push_heap(entries.begin(), entries.end(), hotter);
+            }
+        });
+        
+        std::sort_heap(entries.begin(), entries.end(), hotter);
+        for (ProfileEntry& entry : entries) {
+            entry.total_cycles = total_cycles ? get_cycles(entry.pc) : entry.count;
+        }
+        return entries;
     }
     
+    // Headers of the natural loops whose header block was entered at
+    // least threshold times, hottest first (see ControlFlowGraph)
+    std::vector<uint32_t> detect_hot_loops(uint64_t threshold = 100) const;
+    
     // Statistics
     uint64_t get_total_instructions() const { return total_instructions; }
-    uint64_t get_unique_instructions() const { return instruction_counts.size(); }
+    uint64_t get_unique_instructions() const {
+        uint64_t unique = 0;
+        for_each_instruction_count([&](uint32_t, uint64_t) { unique++; });
+        return unique;
+    }
+    
+    // Execution count of a single PC. Constant time once the counts are
+    // materialised, which the first lookup after a record does.
+    uint64_t get_instruction_count(uint32_t pc) const;
+    
+    // Cycles charged by the timing model, in total and to a single PC;
+    // zero when no timing model ran
+    uint64_t get_total_cycles() const { return total_cycles; }
+    uint64_t get_cycles(uint32_t pc) const;
     
     double get_instruction_percentage(uint32_t pc) const {
-        auto it = instruction_counts.find(pc);
-        if (it == instruction_counts.end() || total_instructions == 0) {
+        if (total_instructions == 0) {
             return 0.0;
         }
-        return (static_cast<double>(it->second) / total_instructions) * 100.0;
+        return (static_cast<double>(get_instruction_count(pc)) / total_instructions) * 100.0;
     }
     
     // Control
     void enable_profiling() { profiling_enabled = true; }
     void disable_profiling() { profiling_enabled = false; }
     void reset() {
+        std::fill(deltas.begin(), deltas.end(), 0);
         instruction_counts.clear();
+        block_counts.clear();
+        counts_current = false;
+        std::fill(edge_counts.begin(), edge_counts.end(), 0);
+        other_edges.clear();
+        std::fill(cycle_counts.begin(), cycle_counts.end(), 0);
+        other_cycles.clear();
         total_instructions = 0;
+        total_cycles = 0;
+        sample_count = 0;
+        sample_countdown = sample_period ? next_sample_gap() : 0;
+        call_stack.clear();
+        frame_depth.clear();
+        inclusive_counts.clear();
+        call_counts.clear();
+        root_entry = 0;
+        stack_nodes.resize(1);
+        stack_nodes[0].instructions = stack_nodes[0].cycles = 0;
+        stack_children.clear();
+        current_node = 0;
+        node_instructions = node_cycles = 0;
+        call_trace.clear();
+        call_trace_truncated = false;
     }
     
     // Display results
     void print_profile() const;
     
 private:
+    // Per-PC counters (sample counts when sampling), unscaled
+    template <typename Visit>
+    void for_each_raw_count(Visit&& visit) const {
+        int64_t count = 0;
+        for (size_t i = 0; i + 1 < deltas.size(); i++) {
+            count += deltas[i];
+            if (count != 0) {
+                visit(text_base + static_cast<uint32_t>(i * 4), static_cast<uint64_t>(count));
+            }
+        }
+        if (!instruction_counts.empty() || !block_counts.empty()) {
+            for (const auto& [pc, outside_count] : collect_fallback_counts()) {
+                visit(pc, outside_count);
+            }
+        }
+    }
+    
+    // Per-PC counts outside the text range: single-stepped instructions
+    // plus expanded blocks
+    std::unordered_map<uint32_t, uint64_t> collect_fallback_counts() const;
+    void change_text_range(uint32_t start, uint32_t end);
+    void materialise_counts() const;
+    void track_transfer(CallKind kind, uint32_t from_pc, uint32_t target);
+    
+    // Record the samples due in a run of `length` instructions at pc
+    // whose retirement took the countdown to zero or below
+    void take_samples(uint32_t pc, uint32_t length);
+    int64_t next_sample_gap();
+    uint64_t estimate(uint64_t samples) const;
+    
+    // Dense counters over the text range, one per instruction slot, as a
+    // difference array: a run of n instructions from slot i adds one at
+    // i and subtracts one at i + n, so recording costs two updates
+    // whatever the block length, and a slot's count is the prefix sum up
+    // to it. One extra slot past the end absorbs the final subtraction.
+    void count_run(uint32_t slot, uint32_t length) {
+        deltas[slot]++;
+        deltas[slot + length]--;
+    }
+    
+    std::vector<int64_t> deltas;
+    static constexpr uint64_t MAX_DENSE_TEXT = 64u << 20;
+    uint32_t range_start;  // As last passed to set_text_range
+    uint32_t range_end;
+    uint32_t text_base;
+    uint32_t text_bytes;  // 4 * (deltas.size() - 1)
+    
+    // Fallback for PCs outside the text range
     std::unordered_map<uint32_t, uint64_t> instruction_counts;
+    std::unordered_map<uint64_t, uint64_t> block_counts;  // (length << 32 | start) -> count
+    
+    // Per-PC counts for single lookups: the prefix sums of deltas, one per
+    // slot, and the fallback counts with blocks expanded and keyed by PC.
+    // Stale once anything is recorded; rebuilt by the next lookup.
+    mutable std::vector<uint64_t> slot_counts;
+    mutable std::unordered_map<uint32_t, uint64_t> fallback_counts;
+    mutable bool counts_current;
+    
+    // Taken edges: per text-range slot, the first target seen and its
+    // count; further targets of the same slot (indirect jumps) and edges
+    // from outside the range go to other_edges
+    std::vector<uint32_t> edge_targets;
+    std::vector<uint64_t> edge_counts;
+    std::unordered_map<uint64_t, uint64_t> other_edges;   // (from << 32 | to) -> count
+    
+    // Cycles per text-range slot, and per PC outside the range
+    std::vector<uint64_t> cycle_counts;
+    std::unordered_map<uint32_t, uint64_t> other_cycles;
     uint64_t total_instructions;
+    uint64_t total_cycles;
     bool profiling_enabled;
+    
+    // Sampling state: the countdown reaches zero on the retired
+    // instruction to sample
+    uint32_t sample_period;  // Mean gap, 0 when counting exactly
+    int64_t sample_countdown;
+    uint64_t sample_count;
+    uint64_t sample_rng;     // xorshift64 state
+    
+    // Shadow call stack. Frames are keyed by function (symbol start, or
+    // the raw PC without symbols); the outermost frame is the function
+    // that made the first call, live since root_entry.
+    struct CallFrame {
+        uint32_t function;
+        uint64_t entry;  // total_instructions when the frame opened
+    };
+    std::vector<CallFrame> call_stack;
+    std::unordered_map<uint32_t, uint32_t> frame_depth;       // function -> live frames
+    std::unordered_map<uint32_t, uint64_t> inclusive_counts;  // function -> closed outermost frames
+    std::unordered_map<uint32_t, uint64_t> call_counts;       // function -> calls
+    uint64_t root_entry;
+    SymbolTable symbols;
+    
+    // Every call path seen, as a tree: node 0 is the empty stack, each
+    // other node one frame under its parent (parents come first). The
+    // instructions and cycles retired since the current node was entered
+    // are added to it when it is left.
+    struct StackNode {
+        uint32_t function;
+        uint32_t parent;
+        uint64_t instructions;
+        uint64_t cycles;
+    };
+    std::vector<StackNode> stack_nodes;
+    std::unordered_map<uint64_t, uint32_t> stack_children;  // (parent << 32 | function) -> node
+    uint32_t current_node;
+    uint64_t node_instructions;  // Totals when current_node was entered
+    uint64_t node_cycles;
+    
+    size_t call_trace_limit;
+    bool call_trace_truncated;
+    std::vector<CallTraceEvent> call_trace;
+    
+    uint32_t function_key(uint32_t pc) const {
+        const Symbol* symbol = symbols.lookup(pc);
+        return symbol ? symbol->start : pc;
+    }
+    void push_frame(uint32_t function, uint64_t entry);
+    void pop_frame();
+    void enter_stack_node(uint32_t node);
+    void trace_call(uint64_t instructions, uint64_t cycles, uint32_t function, bool enter);
 };
 
 #endif // PROFILER_H
\ No newline at end of file
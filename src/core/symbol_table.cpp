@@ -0,0 +1,62 @@
+#include "symbol_table.h"
+#include <algorithm>
+#include <sstream>
+
+void SymbolTable::add(uint32_t start, uint32_t size, std::string name) {
+    symbols.push_back({start, size, std::move(name)});
+}
+
+void SymbolTable::finalize() {
+    // Among symbols sharing an address the tightest sized one wins, so a
+    // function beats a label spanning the rest of its section
+    std::stable_sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) {
+        if (a.start != b.start) {
+            return a.start < b.start;
+        }
+        return a.size != 0 && (b.size == 0 || a.size < b.size);
+    });
+    symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                              [](const Symbol& a, const Symbol& b) { return a.start == b.start; }),
+                  symbols.end());
+
+    // Ranges never overlap: a symbol ends where the next one starts, and
+    // open-ended symbols (size 0) run up to it
+    for (size_t i = 0; i + 1 < symbols.size(); i++) {
+        uint32_t gap = symbols[i + 1].start - symbols[i].start;
+        if (symbols[i].size == 0 || symbols[i].size > gap) {
+            symbols[i].size = gap;
+        }
+    }
+}
+
+const Symbol* SymbolTable::lookup(uint32_t pc) const {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), pc,
+                               [](uint32_t value, const Symbol& symbol) { return value < symbol.start; });
+    if (it == symbols.begin()) {
+        return nullptr;
+    }
+    --it;
+    return pc - it->start < it->size ? &*it : nullptr;
+}
+
+const Symbol* SymbolTable::find(const std::string& name) const {
+    for (const Symbol& symbol : symbols) {
+        if (symbol.name == name) {
+            return &symbol;
+        }
+    }
+    return nullptr;
+}
+
+std::string SymbolTable::describe(uint32_t pc) const {
+    std::ostringstream out;
+    if (const Symbol* symbol = lookup(pc)) {
+        out << symbol->name;
+        if (pc != symbol->start) {
+            out << "+0x" << std::hex << (pc - symbol->start);
+        }
+    } else {
+        out << "0x" << std::hex << pc;
+    }
+    return out.str();
+}
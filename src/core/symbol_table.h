@@ -0,0 +1,44 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A named code range [start, start + size)
+struct Symbol {
+    uint32_t start;
+    uint32_t size;
+    std::string name;
+
+    uint32_t end() const { return start + size; }
+};
+
+// Function symbols sorted by address, for mapping PCs back to functions.
+// Filled by ELFLoader::read_symbols or by hand with add() + finalize().
+class SymbolTable {
+public:
+    void add(uint32_t start, uint32_t size, std::string name);
+
+    // Sort by address, drop duplicates, and end each symbol no later than
+    // the next one starts; zero-sized symbols get the whole gap
+    void finalize();
+
+    // Symbol whose range covers pc, or nullptr
+    const Symbol* lookup(uint32_t pc) const;
+
+    // Symbol by name, or nullptr
+    const Symbol* find(const std::string& name) const;
+
+    // "name+0x1c", or the bare hex address when nothing covers pc
+    std::string describe(uint32_t pc) const;
+
+    bool empty() const { return symbols.empty(); }
+    size_t size() const { return symbols.size(); }
+    const std::vector<Symbol>& get_symbols() const { return symbols; }
+
+private:
+    std::vector<Symbol> symbols;
+};
+
+#endif // SYMBOL_TABLE_H
@@ -0,0 +1,328 @@
+#include "text_image.h"
+#include "instruction_table.h"
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define TEXT_IMAGE_X86 1
+#include <immintrin.h>
+#else
+#define TEXT_IMAGE_X86 0
+#endif
+
+namespace {
+
+// Per-row tables for the vector paths. Row NO_INSTRUCTION can never
+// match (mask 0, match ~0), so illegal words fail validation and are
+// patched by the scalar decoder like any other rare encoding.
+struct RowTables {
+    uint32_t mask[256];
+    uint32_t match[256];
+    uint32_t info[256];     // op | format << 8 | flags << 16
+};
+
+constexpr RowTables build_row_tables() {
+    RowTables tables{};
+    for (size_t row = 0; row < 256; row++) {
+        tables.mask[row] = 0;
+        tables.match[row] = ~0u;
+        tables.info[row] = 0;
+    }
+    for (size_t row = 0; row < INSTRUCTION_TABLE_SIZE; row++) {
+        const InstructionDesc& desc = INSTRUCTION_TABLE[row];
+        tables.mask[row] = desc.mask;
+        tables.match[row] = desc.match;
+        tables.info[row] = static_cast<uint32_t>(desc.op) |
+                           static_cast<uint32_t>(desc.format) << 8 |
+                           static_cast<uint32_t>(desc.flags) << 16;
+    }
+    return tables;
+}
+
+alignas(64) constexpr RowTables ROW_TABLES = build_row_tables();
+
+#if TEXT_IMAGE_X86
+
+// DECODE_INDEX with slack at the end: the AVX2 path gathers 32 bits at
+// byte granularity and keeps the low byte
+struct PaddedIndex {
+    uint8_t rows[(size_t(1) << DECODE_INDEX_BITS) + 3];
+};
+
+constexpr PaddedIndex build_padded_index() {
+    PaddedIndex padded{};
+    for (size_t i = 0; i < DECODE_INDEX.size(); i++) {
+        padded.rows[i] = DECODE_INDEX[i];
+    }
+    return padded;
+}
+
+alignas(64) constexpr PaddedIndex PADDED_INDEX = build_padded_index();
+
+#endif
+
+} // namespace
+
+TextImage::Path TextImage::best_path() {
+#if TEXT_IMAGE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return Path::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Path::SSE2;
+    }
+#endif
+    return Path::SCALAR;
+}
+
+const char* TextImage::path_name(Path path) {
+    switch (path) {
+        case Path::SCALAR: return "scalar";
+        case Path::SSE2:   return "sse2";
+        case Path::AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+TextImage::TextImage(uint32_t base, const uint32_t* words, size_t count, Path path)
+    : base(base), first_page(base >> PAGE_SHIFT), count(count),
+      storage(new int32_t[count * 2]) {
+    // imm first for alignment, then the byte arrays
+    imm = storage.get();
+    ops = reinterpret_cast<Operation*>(imm + count);
+    rd = reinterpret_cast<uint8_t*>(ops + count);
+    rs1 = rd + count;
+    rs2 = rs1 + count;
+    init_pages();
+
+    size_t done = 0;
+    if (path == Path::AVX2) {
+        done = decode_avx2(words, count);
+    } else if (path == Path::SSE2) {
+        done = decode_sse2(words, count);
+    }
+    decode_scalar(words, done, count);
+}
+
+TextImage::TextImage(uint32_t base, size_t count, const Operation* ops, const uint8_t* rd,
+                     const uint8_t* rs1, const uint8_t* rs2, const int32_t* imm,
+                     std::shared_ptr<const void> backing)
+    : base(base), first_page(base >> PAGE_SHIFT), count(count),
+      ops(const_cast<Operation*>(ops)), rd(const_cast<uint8_t*>(rd)), rs1(const_cast<uint8_t*>(rs1)),
+      rs2(const_cast<uint8_t*>(rs2)), imm(const_cast<int32_t*>(imm)), backing(std::move(backing)) {
+    init_pages();
+}
+
+void TextImage::init_pages() {
+    uint32_t last_page = count ? (base + static_cast<uint32_t>(count * 4) - 1) >> PAGE_SHIFT
+                               : first_page;
+    stale_pages.assign(last_page - first_page + 1, 0);
+}
+
+void TextImage::invalidate_page(uint32_t page) {
+    if (page >= first_page && page - first_page < stale_pages.size()) {
+        stale_pages[page - first_page] = 1;
+    }
+}
+
+void TextImage::decode_scalar(const uint32_t* words, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        DecodedInstruction decoded = Decoder::predecode(words[i]);
+        ops[i] = decoded.op;
+        rd[i] = decoded.rd;
+        rs1[i] = decoded.rs1;
+        rs2[i] = decoded.rs2;
+        imm[i] = decoded.imm;
+    }
+}
+
+#if TEXT_IMAGE_X86
+
+size_t TextImage::decode_sse2(const uint32_t* words, size_t count) {
+    const __m128i mask5 = _mm_set1_epi32(0x1F);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + i));
+
+        // Row lookup and validation stay scalar: SSE2 has no gather
+        alignas(16) uint32_t raw[4];
+        alignas(16) uint32_t info[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(raw), w);
+        int invalid = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            uint8_t row = DECODE_INDEX[decode_index(raw[lane])];
+            info[lane] = ROW_TABLES.info[row];
+            if ((raw[lane] & ROW_TABLES.mask[row]) != ROW_TABLES.match[row]) {
+                invalid |= 1 << lane;
+            }
+        }
+        __m128i info_v = _mm_load_si128(reinterpret_cast<const __m128i*>(info));
+        __m128i format = _mm_and_si128(_mm_srli_epi32(info_v, 8), _mm_set1_epi32(0xFF));
+        __m128i flags = _mm_srli_epi32(info_v, 16);
+
+        // Every immediate format, then keep the one each lane needs
+        __m128i imm_i = _mm_srai_epi32(w, 20);
+        __m128i imm_s = _mm_or_si128(_mm_slli_epi32(_mm_srai_epi32(w, 25), 5),
+                                     _mm_and_si128(_mm_srli_epi32(w, 7), mask5));
+        __m128i imm_b = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(_mm_srai_epi32(w, 31), 12),
+                         _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 7), _mm_set1_epi32(0x1)), 11)),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 25), _mm_set1_epi32(0x3F)), 5),
+                         _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 8), _mm_set1_epi32(0xF)), 1)));
+        __m128i imm_u = _mm_and_si128(w, _mm_set1_epi32(static_cast<int>(0xFFFFF000)));
+        __m128i imm_j = _mm_or_si128(
+            _mm_or_si128(_mm_slli_epi32(_mm_srai_epi32(w, 31), 20),
+                         _mm_and_si128(w, _mm_set1_epi32(0xFF000))),
+            _mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 20), _mm_set1_epi32(0x1)), 11),
+                         _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(w, 21), _mm_set1_epi32(0x3FF)), 1)));
+        __m128i imm_shamt = _mm_and_si128(_mm_srli_epi32(w, 20), mask5);
+        __m128i imm_csr = _mm_srli_epi32(w, 20);
+
+#define SELECT_FORMAT(value, fmt)                                                   \
+        _mm_and_si128(value, _mm_cmpeq_epi32(format, _mm_set1_epi32(static_cast<int>(ImmFormat::fmt))))
+        __m128i imm_v = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(SELECT_FORMAT(imm_i, I), SELECT_FORMAT(imm_s, S)),
+                         _mm_or_si128(SELECT_FORMAT(imm_b, B), SELECT_FORMAT(imm_u, U))),
+            _mm_or_si128(_mm_or_si128(SELECT_FORMAT(imm_j, J), SELECT_FORMAT(imm_shamt, SHAMT)),
+                         SELECT_FORMAT(imm_csr, CSR)));
+#undef SELECT_FORMAT
+
+        // Register fields, zeroed where the operation does not use them
+#define USED_FIELD(shift, flag)                                                     \
+        _mm_and_si128(_mm_and_si128(_mm_srli_epi32(w, shift), mask5),               \
+                      _mm_cmpeq_epi32(_mm_and_si128(flags, _mm_set1_epi32(flag)),   \
+                                      _mm_set1_epi32(flag)))
+        __m128i rd_v = USED_FIELD(7, INST_WRITES_RD);
+        __m128i rs1_v = USED_FIELD(15, INST_READS_RS1);
+        __m128i rs2_v = USED_FIELD(20, INST_READS_RS2);
+#undef USED_FIELD
+        __m128i op_v = _mm_and_si128(info_v, _mm_set1_epi32(0xFF));
+
+        // Narrow 4 x 32-bit lanes to bytes (all values fit in 0..255)
+#define STORE_BYTES(dst, v)                                                         \
+        {                                                                           \
+            __m128i words16 = _mm_packs_epi32(v, v);                                \
+            __m128i packed = _mm_packus_epi16(words16, words16);                    \
+            int bytes = _mm_cvtsi128_si32(packed);                                  \
+            std::memcpy(dst, &bytes, 4);                                            \
+        }
+        STORE_BYTES(&ops[i], op_v)
+        STORE_BYTES(&rd[i], rd_v)
+        STORE_BYTES(&rs1[i], rs1_v)
+        STORE_BYTES(&rs2[i], rs2_v)
+#undef STORE_BYTES
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&imm[i]), imm_v);
+
+        // Illegal words and encodings needing a second candidate row
+        if (invalid) {
+            for (int lane = 0; lane < 4; lane++) {
+                if (invalid & (1 << lane)) {
+                    decode_scalar(words, i + lane, i + lane + 1);
+                }
+            }
+        }
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+size_t TextImage::decode_avx2(const uint32_t* words, size_t count) {
+    const __m256i mask5 = _mm256_set1_epi32(0x1F);
+    const __m256i byte_mask = _mm256_set1_epi32(0xFF);
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+
+        // decode_index(): opcode[6:2] | funct3 << 5 | funct7 << 8 | inst[20] << 15
+        __m256i index = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 2), mask5),
+                            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 12), _mm256_set1_epi32(0x7)), 5)),
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(w, 25), 8),
+                            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x1)), 15)));
+
+        __m256i row = _mm256_and_si256(
+            _mm256_i32gather_epi32(reinterpret_cast<const int*>(PADDED_INDEX.rows), index, 1), byte_mask);
+        __m256i row_mask = _mm256_i32gather_epi32(reinterpret_cast<const int*>(ROW_TABLES.mask), row, 4);
+        __m256i row_match = _mm256_i32gather_epi32(reinterpret_cast<const int*>(ROW_TABLES.match), row, 4);
+        __m256i info = _mm256_i32gather_epi32(reinterpret_cast<const int*>(ROW_TABLES.info), row, 4);
+
+        __m256i valid = _mm256_cmpeq_epi32(_mm256_and_si256(w, row_mask), row_match);
+        int valid_lanes = _mm256_movemask_ps(_mm256_castsi256_ps(valid));
+
+        __m256i format = _mm256_and_si256(_mm256_srli_epi32(info, 8), byte_mask);
+        __m256i flags = _mm256_srli_epi32(info, 16);
+
+        __m256i imm_i = _mm256_srai_epi32(w, 20);
+        __m256i imm_s = _mm256_or_si256(_mm256_slli_epi32(_mm256_srai_epi32(w, 25), 5),
+                                        _mm256_and_si256(_mm256_srli_epi32(w, 7), mask5));
+        __m256i imm_b = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_srai_epi32(w, 31), 12),
+                            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 7), _mm256_set1_epi32(0x1)), 11)),
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 25), _mm256_set1_epi32(0x3F)), 5),
+                            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 8), _mm256_set1_epi32(0xF)), 1)));
+        __m256i imm_u = _mm256_and_si256(w, _mm256_set1_epi32(static_cast<int>(0xFFFFF000)));
+        __m256i imm_j = _mm256_or_si256(
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_srai_epi32(w, 31), 20),
+                            _mm256_and_si256(w, _mm256_set1_epi32(0xFF000))),
+            _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x1)), 11),
+                            _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(w, 21), _mm256_set1_epi32(0x3FF)), 1)));
+        __m256i imm_shamt = _mm256_and_si256(_mm256_srli_epi32(w, 20), mask5);
+        __m256i imm_csr = _mm256_srli_epi32(w, 20);
+
+#define SELECT_FORMAT(value, fmt)                                                   \
+        _mm256_and_si256(value, _mm256_cmpeq_epi32(format, _mm256_set1_epi32(static_cast<int>(ImmFormat::fmt))))
+        __m256i imm_v = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(SELECT_FORMAT(imm_i, I), SELECT_FORMAT(imm_s, S)),
+                            _mm256_or_si256(SELECT_FORMAT(imm_b, B), SELECT_FORMAT(imm_u, U))),
+            _mm256_or_si256(_mm256_or_si256(SELECT_FORMAT(imm_j, J), SELECT_FORMAT(imm_shamt, SHAMT)),
+                            SELECT_FORMAT(imm_csr, CSR)));
+#undef SELECT_FORMAT
+
+#define USED_FIELD(shift, flag)                                                             \
+        _mm256_and_si256(_mm256_and_si256(_mm256_srli_epi32(w, shift), mask5),              \
+                         _mm256_cmpeq_epi32(_mm256_and_si256(flags, _mm256_set1_epi32(flag)), \
+                                            _mm256_set1_epi32(flag)))
+        __m256i rd_v = USED_FIELD(7, INST_WRITES_RD);
+        __m256i rs1_v = USED_FIELD(15, INST_READS_RS1);
+        __m256i rs2_v = USED_FIELD(20, INST_READS_RS2);
+#undef USED_FIELD
+        __m256i op_v = _mm256_and_si256(info, byte_mask);
+
+        // Narrow 8 x 32-bit lanes to bytes (all values fit in 0..255)
+#define STORE_BYTES(dst, v)                                                         \
+        {                                                                           \
+            __m128i words16 = _mm_packs_epi32(_mm256_castsi256_si128(v),            \
+                                              _mm256_extracti128_si256(v, 1));      \
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst),                       \
+                             _mm_packus_epi16(words16, words16));                   \
+        }
+        STORE_BYTES(&ops[i], op_v)
+        STORE_BYTES(&rd[i], rd_v)
+        STORE_BYTES(&rs1[i], rs1_v)
+        STORE_BYTES(&rs2[i], rs2_v)
+#undef STORE_BYTES
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&imm[i]), imm_v);
+
+        if (valid_lanes != 0xFF) {
+            for (int lane = 0; lane < 8; lane++) {
+                if (!(valid_lanes & (1 << lane))) {
+                    decode_scalar(words, i + lane, i + lane + 1);
+                }
+            }
+        }
+    }
+    return i;
+}
+
+#else
+
+size_t TextImage::decode_sse2(const uint32_t*, size_t) {
+    return 0;
+}
+
+size_t TextImage::decode_avx2(const uint32_t*, size_t) {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef TEXT_IMAGE_H
+#define TEXT_IMAGE_H
+
+#include "decoder.h"
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A text segment predecoded in bulk at load time. Fields are kept in
+// separate arrays (structure of arrays) indexed by (pc - base) >> 2, so
+// fetches need no decode at all. Field extraction is vectorised with
+// AVX2 or SSE2 when the host supports it.
+//
+// A guest store into one of the image's pages marks that page stale;
+// fetches there fall back to the on-demand decode cache.
+class TextImage {
+public:
+    enum class Path { SCALAR, SSE2, AVX2 };
+
+    // Fastest path the host CPU supports
+    static Path best_path();
+    static const char* path_name(Path path);
+
+    // Decode count words that live at guest address base
+    TextImage(uint32_t base, const uint32_t* words, size_t count, Path path = best_path());
+
+    // Adopt count instructions already decoded into field arrays that
+    // live in backing (e.g. a read-only mapped image cache entry),
+    // without copying; the image keeps backing alive
+    TextImage(uint32_t base, size_t count, const Operation* ops, const uint8_t* rd,
+              const uint8_t* rs1, const uint8_t* rs2, const int32_t* imm,
+              std::shared_ptr<const void> backing);
+
+    // Predecoded instruction at pc; false if pc is outside the image,
+    // misaligned or on a stale page
+    bool lookup(uint32_t pc, DecodedInstruction& out) const {
+        uint32_t index = (pc - base) >> 2;
+        if ((pc & 0x3) || index >= count ||
+            stale_pages[(pc >> PAGE_SHIFT) - first_page]) {
+            return false;
+        }
+        out.op = ops[index];
+        out.rd = rd[index];
+        out.rs1 = rs1[index];
+        out.rs2 = rs2[index];
+        out.imm = imm[index];
+        return true;
+    }
+
+    // Called by the CPU when a store lands in a page of the image
+    void invalidate_page(uint32_t page);
+
+    uint32_t get_base() const { return base; }
+    uint32_t get_end() const { return base + static_cast<uint32_t>(count * 4); }
+    size_t get_instruction_count() const { return count; }
+
+    // Raw field arrays
+    const Operation* get_ops() const { return ops; }
+    const uint8_t* get_rd() const { return rd; }
+    const uint8_t* get_rs1() const { return rs1; }
+    const uint8_t* get_rs2() const { return rs2; }
+    const int32_t* get_imm() const { return imm; }
+
+private:
+    uint32_t base;
+    uint32_t first_page;
+    size_t count;
+
+    // Written only while decoding into owned storage; adopted arrays are
+    // never written
+    Operation* ops;
+    uint8_t* rd;
+    uint8_t* rs1;
+    uint8_t* rs2;
+    int32_t* imm;
+    std::vector<uint8_t> stale_pages;
+
+    // Field storage: decoded images own one block holding every array,
+    // adopted ones keep their backing alive
+    std::unique_ptr<int32_t[]> storage;
+    std::shared_ptr<const void> backing;
+
+    void init_pages();
+
+    // Decode words[begin, end) into the field arrays
+    void decode_scalar(const uint32_t* words, size_t begin, size_t end);
+    size_t decode_sse2(const uint32_t* words, size_t count);
+    size_t decode_avx2(const uint32_t* words, size_t count);
+};
+
+#endif // TEXT_IMAGE_H
@@ -0,0 +1,92 @@
+#include "timing_model.h"
+#include "instruction_table.h"
+
+InstructionClass instruction_class(Operation op) {
+    uint16_t flags = operation_flags(op);
+    if (flags & INST_LOAD) {
+        return InstructionClass::LOAD;
+    }
+    if (flags & INST_STORE) {
+        return InstructionClass::STORE;
+    }
+    if (flags & INST_BRANCH) {
+        return InstructionClass::BRANCH;
+    }
+    if (flags & INST_JUMP) {
+        return InstructionClass::JUMP;
+    }
+    switch (op) {
+        case Operation::ECALL: case Operation::EBREAK:
+        case Operation::CSR: case Operation::SYSTEM:
+            return InstructionClass::SYSTEM;
+        default:
+            return InstructionClass::ALU;
+    }
+}
+
+uint32_t LatencyModel::retire(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc,
+                              Prediction prediction) {
+    switch (instruction_class(inst.op)) {
+        case InstructionClass::ALU:    return latencies.alu;
+        case InstructionClass::LOAD:   return latencies.load;
+        case InstructionClass::STORE:  return latencies.store;
+        case InstructionClass::BRANCH:
+            if (prediction == Prediction::NONE) {
+                return next_pc != pc + 4 ? latencies.branch_taken : latencies.branch;
+            }
+            return prediction == Prediction::MISPREDICTED ? latencies.branch_mispredicted : latencies.branch;
+        case InstructionClass::JUMP:
+            return prediction == Prediction::MISPREDICTED ? latencies.jump_mispredicted : latencies.jump;
+        case InstructionClass::SYSTEM: return latencies.system;
+    }
+    return latencies.alu;
+}
+
+uint32_t PipelineModel::retire(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc,
+                               Prediction prediction) {
+    uint32_t cycles = 1;
+    if (!filled) {
+        cycles += config.fill;
+        filled = true;
+    }
+    
+    // Forwarding covers everything but a load feeding the next instruction
+    uint16_t flags = operation_flags(inst.op);
+    if (load_rd != 0 && (((flags & INST_READS_RS1) && inst.rs1 == load_rd) ||
+                         ((flags & INST_READS_RS2) && inst.rs2 == load_rd))) {
+        cycles += config.load_use;
+    }
+    
+    InstructionClass kind = instruction_class(inst.op);
+    switch (kind) {
+        case InstructionClass::LOAD:
+        case InstructionClass::STORE:
+            cycles += config.memory;
+            break;
+        case InstructionClass::BRANCH:
+            if (prediction == Prediction::NONE ? next_pc != pc + 4 : prediction == Prediction::MISPREDICTED) {
+                cycles += config.branch_taken;
+            }
+            break;
+        case InstructionClass::JUMP:
+            if (inst.op == Operation::JAL) {
+                cycles += config.jal;
+            } else if (prediction != Prediction::CORRECT) {
+                cycles += config.jalr;
+            }
+            break;
+        case InstructionClass::SYSTEM:
+            cycles += config.system;
+            break;
+        case InstructionClass::ALU:
+            break;
+    }
+    
+    load_rd = kind == InstructionClass::LOAD ? inst.rd : 0;
+    return cycles;
+}
+
+void PipelineModel::reset() {
+    filled = false;
+    load_rd = 0;
+}
@@ -0,0 +1,103 @@
+#ifndef TIMING_MODEL_H
+#define TIMING_MODEL_H
+
+#include "decoder.h"
+#include <cstdint>
+
+// Coarse instruction classes the timing models charge by
+enum class InstructionClass : uint8_t {
+    ALU,     // Register and immediate arithmetic, LUI, AUIPC
+    LOAD,
+    STORE,
+    BRANCH,  // Conditional branches
+    JUMP,    // JAL, JALR
+    SYSTEM   // ECALL, EBREAK, CSR accesses and other SYSTEM encodings
+};
+
+InstructionClass instruction_class(Operation op);
+
+// Verdict of a branch simulator on a retired instruction
+enum class Prediction : uint8_t {
+    NONE,          // Not predicted (no simulator, or not a predicted transfer)
+    CORRECT,
+    MISPREDICTED
+};
+
+// Estimates the cycles a core would spend on the instruction stream.
+// The interpreter feeds it every retired instruction in program order
+// (superinstructions split back into their halves) with the PC it
+// continued at, so models may keep state between calls. Without a
+// prediction, models assume static not-taken fetch; with one, only
+// mispredicted transfers pay the redirect.
+class TimingModel {
+public:
+    virtual ~TimingModel() = default;
+
+    virtual const char* name() const = 0;
+
+    // Cycles charged to inst, retired at pc and followed by next_pc
+    virtual uint32_t retire(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc,
+                            Prediction prediction) = 0;
+
+    // Forget state carried between instructions (execution restarted)
+    virtual void reset() {}
+};
+
+// Fixed cost per instruction class, taken or mispredicted transfers
+// paying extra
+struct InstructionLatencies {
+    uint32_t alu = 1;
+    uint32_t load = 2;
+    uint32_t store = 1;
+    uint32_t branch = 1;
+    uint32_t branch_taken = 3;         // Replaces branch when taken (no prediction)
+    uint32_t branch_mispredicted = 3;  // Replaces branch when mispredicted
+    uint32_t jump = 2;
+    uint32_t jump_mispredicted = 4;    // Replaces jump when mispredicted
+    uint32_t system = 5;
+};
+
+class LatencyModel : public TimingModel {
+public:
+    explicit LatencyModel(const InstructionLatencies& latencies = InstructionLatencies())
+        : latencies(latencies) {}
+
+    const char* name() const override { return "latency"; }
+    uint32_t retire(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc,
+                    Prediction prediction) override;
+
+private:
+    InstructionLatencies latencies;
+};
+
+// Classic in-order IF/ID/EX/MEM/WB pipeline with full forwarding and
+// fetch predicting not-taken. Each instruction issues one cycle after
+// the one before unless it stalls; the first after a reset also waits
+// for the pipeline to fill. Penalties are in cycles lost.
+struct PipelineConfig {
+    uint32_t fill = 4;            // Stages before the first instruction completes
+    uint32_t load_use = 1;        // Load result needed by the next instruction
+    uint32_t branch_taken = 2;    // Branches resolve in EX: taken, or mispredicted
+    uint32_t jal = 1;             // Direct jump target known in ID
+    uint32_t jalr = 2;            // Indirect jump target known in EX: always, or mispredicted
+    uint32_t memory = 0;          // Extra MEM cycles of a load or store
+    uint32_t system = 4;          // SYSTEM instructions drain the pipeline
+};
+
+class PipelineModel : public TimingModel {
+public:
+    explicit PipelineModel(const PipelineConfig& config = PipelineConfig())
+        : config(config), filled(false), load_rd(0) {}
+
+    const char* name() const override { return "pipeline"; }
+    uint32_t retire(const DecodedInstruction& inst, uint32_t pc, uint32_t next_pc,
+                    Prediction prediction) override;
+    void reset() override;
+
+private:
+    PipelineConfig config;
+    bool filled;
+    uint8_t load_rd;  // Destination of the previous instruction if a load, else 0
+};
+
+#endif // TIMING_MODEL_H
@@ -65,6 +65,24 @@ void ARM64Assembler::eor_reg_reg_reg(ARM64Reg dst, ARM64Reg src1, ARM64Reg src2)
     buffer.emit_uint32(inst);
 }
 
+void ARM64Assembler::mov_reg_imm64(ARM64Reg dst, uint64_t imm) {
+    // MOVZ Xd, #imm16, LSL #0, then MOVK Xd, #imm16, LSL #16/#32/#48
+    // Encodings: 1101 0010 100 imm16 Rd, 1111 0010 1 hw imm16 Rd
+    buffer.emit_uint32(0xD2800000 | ((imm & 0xFFFF) << 5) | reg_num(dst));
+    for (uint32_t hw = 1; hw < 4; hw++) {
+        uint32_t part = (imm >> (16 * hw)) & 0xFFFF;
+        buffer.emit_uint32(0xF2800000 | (hw << 21) | (part << 5) | reg_num(dst));
+    }
+}
+
+void ARM64Assembler::add_reg_reg_lsl64(ARM64Reg dst, ARM64Reg src1, ARM64Reg src2, uint8_t shift) {
+    // ADD Xd, Xn, Xm, LSL #shift
+    // Encoding: 1000 1011 000 Rm imm6 Rn Rd
+    uint32_t inst = 0x8B000000 | (reg_num(src2) << 16) | ((shift & 0x3F) << 10) | (reg_num(src1) << 5) |
+                    reg_num(dst);
+    buffer.emit_uint32(inst);
+}
+
 void ARM64Assembler::cmp_reg_reg(ARM64Reg left, ARM64Reg right) {
     // CMP Wn, Wm = SUBS WZR, Wn, Wm
     // Encoding: 0110 1011 000 Rm 000000 Rn 11111
@@ -89,6 +107,24 @@ void ARM64Assembler::b(int32_t offset) {
     buffer.emit_uint32(inst);
 }
 
+void ARM64Assembler::patch_branch(size_t branch, size_t target) {
+    // Offsets are in instructions from the branch itself
+    int32_t offset = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(branch)) / 4;
+    uint32_t inst = buffer.read_uint32(branch);
+    if ((inst & 0xFC000000) == 0x14000000) {
+        inst = (inst & 0xFC000000) | (offset & 0x3FFFFFF);            // B: imm26
+    } else {
+        inst = (inst & 0xFF00001F) | ((offset & 0x7FFFF) << 5);       // B.cond: imm19
+    }
+    buffer.patch_uint32(branch, inst);
+}
+
+void ARM64Assembler::br(ARM64Reg target) {
+    // BR Xn
+    // Encoding: 1101 0110 0001 1111 0000 00 Rn 00000
+    buffer.emit_uint32(0xD61F0000 | (reg_num(target) << 5));
+}
+
 void ARM64Assembler::ret() {
     // RET (return to address in X30/LR, but default is RET which uses X30)
     // Encoding: 1101 0110 0101 1111 0000 00 11110 00000
@@ -132,5 +168,15 @@ void ARM64Assembler::str_reg_mem(ARM64Reg src, ARM64Reg base, int32_t offset) {
     inst |= (reg_num(base) & 0x1F) << 5;
     inst |= (reg_num(src) & 0x1F);
     
+    buffer.emit_uint32(inst);
+}
+
+void ARM64Assembler::ldr_reg_mem64(ARM64Reg dst, ARM64Reg base, int32_t offset) {
+    // LDR Xt, [Xn, #offset]
+    // Encoding: 1111 1001 01 imm12 Rn Rt, imm12 = offset / 8
+    if (offset < 0 || offset > 32760 || (offset % 8 != 0)) {
+        throw std::runtime_error("LDR offset must be 0-32760 and 8-byte aligned");
+    }
+    uint32_t inst = 0xF9400000 | ((offset / 8) << 10) | (reg_num(base) << 5) | reg_num(dst);
     buffer.emit_uint32(inst);
 }
\ No newline at end of file
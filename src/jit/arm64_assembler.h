@@ -13,13 +13,16 @@ enum class ARM64Reg : uint8_t {
     X16 = 16, X17 = 17, X18 = 18, X19 = 19,
     X20 = 20, X21 = 21, X22 = 22, X23 = 23,
     X24 = 24, X25 = 25, X26 = 26, X27 = 27,
-    X28 = 28, X29 = 29, X30 = 30, SP = 31
+    X28 = 28, X29 = 29, X30 = 30, SP = 31,
+    XZR = 31  // Register 31 reads as zero in data-processing operands
 };
 
 // ARM64 condition codes
 enum class ARM64Cond : uint8_t {
     EQ = 0b0000,  // Equal
     NE = 0b0001,  // Not equal
+    HS = 0b0010,  // Higher or same (unsigned)
+    LO = 0b0011,  // Lower (unsigned)
     LT = 0b1011,  // Less than (signed)
     GE = 0b1010,  // Greater or equal (signed)
     GT = 0b1100,  // Greater than (signed)
@@ -54,6 +57,12 @@ public:
     // EOR Wd, Wn, Wm (32-bit XOR)
     void eor_reg_reg_reg(ARM64Reg dst, ARM64Reg src1, ARM64Reg src2);
     
+    // MOV Xd, #imm64 (MOVZ + 3 MOVK, host addresses)
+    void mov_reg_imm64(ARM64Reg dst, uint64_t imm);
+    
+    // ADD Xd, Xn, Xm, LSL #shift (64-bit address arithmetic)
+    void add_reg_reg_lsl64(ARM64Reg dst, ARM64Reg src1, ARM64Reg src2, uint8_t shift);
+    
     // === Compare and Branch ===
     
     // CMP Wn, Wm (compare 32-bit)
@@ -65,6 +74,9 @@ public:
     // B label (unconditional branch)
     void b(int32_t offset);
     
+    // BR Xn (to a host address)
+    void br(ARM64Reg target);
+    
     // RET (return)
     void ret();
     
@@ -76,9 +88,15 @@ public:
     // STR Wt, [Xn, #offset] (store 32-bit)
     void str_reg_mem(ARM64Reg src, ARM64Reg base, int32_t offset);
     
+    // LDR Xt, [Xn, #offset] (load 64-bit)
+    void ldr_reg_mem64(ARM64Reg dst, ARM64Reg base, int32_t offset);
+    
     // Get current position (for calculating branch offsets)
     size_t get_position() const { return buffer.get_position(); }
     
+    // Retarget the B or B.cond at branch to target
+    void patch_branch(size_t branch, size_t target);
+    
 private:
     CodeBuffer& buffer;
     
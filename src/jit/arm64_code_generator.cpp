@@ -0,0 +1,263 @@
+#include "arm64_code_generator.h"
+
+static const ARM64Reg HOST_POOL[] = {
+    ARM64Reg::X9, ARM64Reg::X10, ARM64Reg::X11, ARM64Reg::X12, ARM64Reg::X13,
+    ARM64Reg::X14, ARM64Reg::X15, ARM64Reg::X2, ARM64Reg::X3, ARM64Reg::X4,
+    ARM64Reg::X5, ARM64Reg::X6, ARM64Reg::X7
+};
+static const ARM64Reg STATE = ARM64Reg::X0;
+static const ARM64Reg FUEL = ARM64Reg::X1;
+static const ARM64Reg SCRATCH1 = ARM64Reg::X16;
+static const ARM64Reg SCRATCH2 = ARM64Reg::X17;
+static const int32_t PC_OFFSET = NUM_REGISTERS * 4;
+
+size_t ARM64CodeGenerator::host_registers() const {
+    return sizeof(HOST_POOL) / sizeof(HOST_POOL[0]);
+}
+
+bool ARM64CodeGenerator::supports(const DecodedInstruction& inst) const {
+    switch (inst.op) {
+        case Operation::ADD:
+        case Operation::SUB:
+        case Operation::XOR:
+        case Operation::OR:
+        case Operation::AND:
+        case Operation::ADDI:
+        case Operation::BEQ:
+        case Operation::BNE:
+        case Operation::BLT:
+        case Operation::BGE:
+        case Operation::BLTU:
+        case Operation::BGEU:
+        case Operation::JAL:
+        case Operation::JALR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+ARM64Reg ARM64CodeGenerator::host_reg(uint8_t riscv_reg) const {
+    return HOST_POOL[allocation.host[riscv_reg]];
+}
+
+ARM64Reg ARM64CodeGenerator::read_reg(uint8_t riscv_reg, ARM64Reg scratch) {
+    if (riscv_reg == 0) {
+        return ARM64Reg::XZR;
+    }
+    if (allocation.in_host(riscv_reg)) {
+        return host_reg(riscv_reg);
+    }
+    asm_.ldr_reg_mem(scratch, STATE, riscv_reg * 4);
+    return scratch;
+}
+
+void ARM64CodeGenerator::write_reg(uint8_t riscv_reg, ARM64Reg value) {
+    if (!allocation.in_host(riscv_reg)) {
+        asm_.str_reg_mem(value, STATE, riscv_reg * 4);
+    }
+}
+
+void ARM64CodeGenerator::write_reg_imm(uint8_t riscv_reg, uint32_t value) {
+    if (riscv_reg == 0) {
+        return;
+    }
+    ARM64Reg rd = allocation.in_host(riscv_reg) ? host_reg(riscv_reg) : SCRATCH2;
+    asm_.mov_reg_imm(rd, value);
+    write_reg(riscv_reg, rd);
+}
+
+void ARM64CodeGenerator::emit_stubs(const BlockTableEntry* table) {
+    // Exit: PC in W16, registers already stored
+    exit_stub = asm_.get_position();
+    asm_.str_reg_mem(SCRATCH1, STATE, PC_OFFSET);
+    asm_.mov_reg_reg(ARM64Reg::X0, SCRATCH1);
+    asm_.ret();
+    
+    // Lookup: X17 = &table[block_table_slot(W16)], chain to its block
+    // when it holds W16, otherwise exit. The pool registers are free:
+    // exits have stored them.
+    lookup_stub = asm_.get_position();
+    asm_.mov_reg_imm(ARM64Reg::X8, static_cast<uint32_t>((BLOCK_TABLE_SIZE - 1) << 2));
+    asm_.and_reg_reg_reg(ARM64Reg::X8, SCRATCH1, ARM64Reg::X8);
+    asm_.mov_reg_imm64(SCRATCH2, reinterpret_cast<uint64_t>(table));
+    asm_.add_reg_reg_lsl64(SCRATCH2, SCRATCH2, ARM64Reg::X8, 2);
+    asm_.ldr_reg_mem(ARM64Reg::X8, SCRATCH2, offsetof(BlockTableEntry, pc));
+    asm_.cmp_reg_reg(ARM64Reg::X8, SCRATCH1);
+    asm_.b_cond(ARM64Cond::NE, 0);
+    asm_.patch_branch(asm_.get_position() - 4, exit_stub);
+    asm_.ldr_reg_mem64(SCRATCH2, SCRATCH2, offsetof(BlockTableEntry, code));
+    asm_.br(SCRATCH2);
+}
+
+void ARM64CodeGenerator::begin_block(const RegisterAllocation& block_allocation, uint32_t block_start,
+                                     uint32_t block_instructions) {
+    // X0 = guest state, X1 = fuel
+    allocation = block_allocation;
+    start_pc = block_start;
+    instructions = block_instructions;
+    jumped = false;
+    code = BlockCode{};
+    
+    // Chain entry: *fuel -= instructions, if it covers them
+    code.chain = asm_.get_position();
+    asm_.ldr_reg_mem(SCRATCH2, FUEL, 0);
+    asm_.mov_reg_imm(ARM64Reg::X8, instructions);
+    asm_.cmp_reg_reg(SCRATCH2, ARM64Reg::X8);
+    exhausted = asm_.get_position();
+    asm_.b_cond(ARM64Cond::LO, 0);
+    asm_.sub_reg_reg_reg(SCRATCH2, SCRATCH2, ARM64Reg::X8);
+    asm_.str_reg_mem(SCRATCH2, FUEL, 0);
+    
+    // Entry: load the allocated registers the block reads before
+    // writing
+    code.entry = asm_.get_position();
+    for (uint8_t i = 1; i < 32; i++) {
+        if (allocation.in_host(i) && allocation.is_loaded(i)) {
+            asm_.ldr_reg_mem(host_reg(i), STATE, i * 4);
+        }
+    }
+    loop_top = asm_.get_position();
+}
+
+void ARM64CodeGenerator::emit(const DecodedInstruction& inst, uint32_t pc) {
+    ARM64Reg rd = allocation.in_host(inst.rd) ? host_reg(inst.rd) : SCRATCH1;
+    
+    switch (inst.op) {
+        case Operation::ADD:
+        case Operation::SUB:
+        case Operation::XOR:
+        case Operation::OR:
+        case Operation::AND: {
+            ARM64Reg rs1 = read_reg(inst.rs1, SCRATCH1);
+            ARM64Reg rs2 = read_reg(inst.rs2, SCRATCH2);
+            
+            switch (inst.op) {
+                case Operation::ADD: asm_.add_reg_reg_reg(rd, rs1, rs2); break;
+                case Operation::SUB: asm_.sub_reg_reg_reg(rd, rs1, rs2); break;
+                case Operation::XOR: asm_.eor_reg_reg_reg(rd, rs1, rs2); break;
+                case Operation::OR:  asm_.orr_reg_reg_reg(rd, rs1, rs2); break;
+                default:             asm_.and_reg_reg_reg(rd, rs1, rs2); break;
+            }
+            break;
+        }
+        
+        case Operation::ADDI: {
+            // MOVZ (+ MOVK for negative immediates) into the scratch
+            ARM64Reg rs1 = read_reg(inst.rs1, SCRATCH1);
+            asm_.mov_reg_imm(ARM64Reg::X8, static_cast<uint32_t>(inst.imm));
+            asm_.add_reg_reg_reg(rd, rs1, ARM64Reg::X8);
+            break;
+        }
+        
+        case Operation::BEQ:
+        case Operation::BNE:
+        case Operation::BLT:
+        case Operation::BGE:
+        case Operation::BLTU:
+        case Operation::BGEU: {
+            // Skip the taken path on the opposite condition; the fall
+            // through continues to end_block()'s exit
+            ARM64Cond skip;
+            switch (inst.op) {
+                case Operation::BEQ:  skip = ARM64Cond::NE; break;
+                case Operation::BNE:  skip = ARM64Cond::EQ; break;
+                case Operation::BLT:  skip = ARM64Cond::GE; break;
+                case Operation::BGE:  skip = ARM64Cond::LT; break;
+                case Operation::BLTU: skip = ARM64Cond::HS; break;
+                default:              skip = ARM64Cond::LO; break;
+            }
+            asm_.cmp_reg_reg(read_reg(inst.rs1, SCRATCH1), read_reg(inst.rs2, SCRATCH2));
+            size_t not_taken = asm_.get_position();
+            asm_.b_cond(skip, 0);
+            jump_to(pc + inst.imm);
+            asm_.patch_branch(not_taken, asm_.get_position());
+            return;
+        }
+        
+        case Operation::JAL:
+            write_reg_imm(inst.rd, pc + 4);
+            jump_to(pc + inst.imm);
+            jumped = true;
+            return;
+        
+        case Operation::JALR: {
+            // Target first: rd may be rs1
+            ARM64Reg rs1 = read_reg(inst.rs1, SCRATCH1);
+            asm_.mov_reg_imm(ARM64Reg::X8, static_cast<uint32_t>(inst.imm));
+            asm_.add_reg_reg_reg(SCRATCH1, rs1, ARM64Reg::X8);
+            asm_.mov_reg_imm(ARM64Reg::X8, ~1u);
+            asm_.and_reg_reg_reg(SCRATCH1, SCRATCH1, ARM64Reg::X8);
+            write_reg_imm(inst.rd, pc + 4);
+            store_registers();
+            b_to(lookup_stub);
+            jumped = true;
+            return;
+        }
+        
+        default:
+            return;
+    }
+    write_reg(inst.rd, rd);
+}
+
+void ARM64CodeGenerator::store_registers() {
+    for (uint8_t i = 1; i < 32; i++) {
+        if (allocation.in_host(i) && allocation.is_stored(i)) {
+            asm_.str_reg_mem(host_reg(i), STATE, i * 4);
+        }
+    }
+}
+
+void ARM64CodeGenerator::b_to(size_t target) {
+    asm_.b(static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(asm_.get_position())));
+}
+
+void ARM64CodeGenerator::exit_to(uint32_t target) {
+    store_registers();
+    asm_.mov_reg_imm(SCRATCH1, target);
+    code.exits.push_back(BlockExit{asm_.get_position(), target});
+    b_to(lookup_stub);
+}
+
+void ARM64CodeGenerator::jump_to(uint32_t target) {
+    if (target == start_pc) {
+        // *fuel -= instructions and go round again, if it covers a pass;
+        // otherwise return to the caller, which cannot run the block
+        // either
+        asm_.ldr_reg_mem(SCRATCH2, FUEL, 0);
+        asm_.mov_reg_imm(ARM64Reg::X8, instructions);
+        asm_.cmp_reg_reg(SCRATCH2, ARM64Reg::X8);
+        size_t loop_exhausted = asm_.get_position();
+        asm_.b_cond(ARM64Cond::LO, 0);
+        asm_.sub_reg_reg_reg(SCRATCH2, SCRATCH2, ARM64Reg::X8);
+        asm_.str_reg_mem(SCRATCH2, FUEL, 0);
+        b_to(loop_top);
+        asm_.patch_branch(loop_exhausted, asm_.get_position());
+        store_registers();
+        asm_.mov_reg_imm(SCRATCH1, target);
+        b_to(exit_stub);
+        return;
+    }
+    exit_to(target);
+}
+
+BlockCode ARM64CodeGenerator::end_block(uint32_t next_pc) {
+    if (!jumped) {
+        exit_to(next_pc);
+    }
+    
+    // Out of fuel at the chain entry: nothing loaded yet
+    asm_.patch_branch(exhausted, asm_.get_position());
+    asm_.mov_reg_imm(SCRATCH1, start_pc);
+    b_to(exit_stub);
+    return code;
+}
+
+void ARM64CodeGenerator::link_exit(size_t jump, size_t chain) {
+    asm_.patch_branch(jump, chain);
+}
+
+void ARM64CodeGenerator::unlink_exit(size_t jump) {
+    asm_.patch_branch(jump, lookup_stub);
+}
@@ -0,0 +1,65 @@
+#ifndef ARM64_CODE_GENERATOR_H
+#define ARM64_CODE_GENERATOR_H
+
+#include "code_generator.h"
+#include "arm64_assembler.h"
+
+// ARM64 blocks. X0 holds the guest state pointer, X1 the fuel pointer,
+// and allocated guest registers live in the caller-saved X9-X15 and
+// X2-X7, so blocks need no stack frame and chained blocks jump straight
+// to each other. x0 reads as WZR, X16/X17 are scratch for spilled
+// operands (W16 carries the next PC to an exit) and X8 is scratch for
+// immediates.
+class ARM64CodeGenerator : public CodeGenerator {
+public:
+    explicit ARM64CodeGenerator(CodeBuffer& buffer) : asm_(buffer) {}
+
+    JITBackend backend() const override { return JITBackend::ARM64; }
+    size_t host_registers() const override;
+    bool supports(const DecodedInstruction& inst) const override;
+    void emit_stubs(const BlockTableEntry* table) override;
+    void begin_block(const RegisterAllocation& allocation, uint32_t start_pc, uint32_t instructions) override;
+    void emit(const DecodedInstruction& inst, uint32_t pc) override;
+    BlockCode end_block(uint32_t next_pc) override;
+    void link_exit(size_t jump, size_t chain) override;
+    void unlink_exit(size_t jump) override;
+
+private:
+    ARM64Assembler asm_;
+    size_t exit_stub = 0;       // Store the PC in W16 and return it
+    size_t lookup_stub = 0;     // Chain to the table's block for W16
+    RegisterAllocation allocation;
+    BlockCode code;
+    uint32_t start_pc = 0;
+    uint32_t instructions = 0;
+    size_t exhausted = 0;       // Chain check's branch when out of fuel
+    size_t loop_top = 0;        // Code after the entry loads
+    bool jumped = false;        // Block ended with a jump
+
+    ARM64Reg host_reg(uint8_t riscv_reg) const;
+
+    // Register holding guest riscv_reg: WZR for x0, its host register,
+    // or scratch loaded with it
+    ARM64Reg read_reg(uint8_t riscv_reg, ARM64Reg scratch);
+
+    // Store value to a spilled rd; allocated ones are stored at the exits
+    void write_reg(uint8_t riscv_reg, ARM64Reg value);
+
+    // rd = value for JAL/JALR links (nothing for x0)
+    void write_reg_imm(uint8_t riscv_reg, uint32_t value);
+
+    // Store the allocated registers the block wrote
+    void store_registers();
+
+    // B to the buffer offset target
+    void b_to(size_t target);
+
+    // Leave the block for guest target through a linkable exit
+    void exit_to(uint32_t target);
+
+    // Continue at guest target: loop back for the block's own start
+    // while fuel lasts, otherwise exit
+    void jump_to(uint32_t target);
+};
+
+#endif // ARM64_CODE_GENERATOR_H
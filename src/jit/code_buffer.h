@@ -2,6 +2,7 @@
 #define CODE_BUFFER_H
 
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <sys/mman.h>
 #include <stdexcept>
@@ -65,10 +66,23 @@ public:
         emit_uint32(value >> 32);
     }
     
-    // Get function pointer to generated code
+    // Read or overwrite 32 bits already emitted at offset (branch patching)
+    uint32_t read_uint32(size_t offset) const {
+        uint32_t value;
+        std::memcpy(&value, buffer + offset, sizeof(value));
+        return value;
+    }
+    void patch_uint32(size_t offset, uint32_t value) {
+        if (offset + sizeof(value) > position) {
+            throw std::runtime_error("Patch outside emitted code");
+        }
+        std::memcpy(buffer + offset, &value, sizeof(value));
+    }
+    
+    // Get function pointer to generated code (at offset)
     template<typename Func>
-    Func get_function() const {
-        return reinterpret_cast<Func>(buffer);
+    Func get_function(size_t offset = 0) const {
+        return reinterpret_cast<Func>(buffer + offset);
     }
     
     // Get current position
@@ -81,13 +95,21 @@ public:
     
     // Reset buffer
     void reset() { position = 0; }
+    // Make buffer writable again, to emit or patch more code (call
+    // make_executable() afterwards)
+void make_writable() {
+    #ifdef __APPLE__
+        if (mprotect(buffer, capacity, PROT_READ | PROT_WRITE) != 0) {
+            throw std::runtime_error("Failed to make buffer writable");
+        }
+    #endif
+}
     // Make buffer executable (call after writing code)
 void make_executable() {
-    #ifdef __APPLE__
-        // On Apple Silicon, we need to flush instruction cache
-        // Use pthread_jit_write_protect_np if available
+        // ARM64 instruction caches are not coherent with data writes, on
+        // Linux as on macOS; on x86-64 this compiles to nothing
         __builtin___clear_cache((char*)buffer, (char*)(buffer + position));
-        
+    #ifdef __APPLE__
         if (mprotect(buffer, capacity, PROT_READ | PROT_EXEC) != 0) {
             throw std::runtime_error("Failed to make buffer executable");
         }
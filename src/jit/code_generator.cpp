@@ -0,0 +1,21 @@
+#include "code_generator.h"
+#include "arm64_code_generator.h"
+#include "x64_code_generator.h"
+
+const char* jit_backend_name(JITBackend backend) {
+    switch (backend) {
+        case JITBackend::NONE:   return "none";
+        case JITBackend::ARM64:  return "arm64";
+        case JITBackend::X86_64: return "x86-64";
+    }
+    return "unknown";
+}
+
+std::unique_ptr<CodeGenerator> make_code_generator(JITBackend backend, CodeBuffer& buffer) {
+    switch (backend) {
+        case JITBackend::ARM64:  return std::make_unique<ARM64CodeGenerator>(buffer);
+        case JITBackend::X86_64: return std::make_unique<X64CodeGenerator>(buffer);
+        case JITBackend::NONE:   break;
+    }
+    return nullptr;
+}
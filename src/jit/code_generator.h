@@ -0,0 +1,122 @@
+#ifndef CODE_GENERATOR_H
+#define CODE_GENERATOR_H
+
+#include "../core/cpu.h"
+#include "../core/decoder.h"
+#include "code_buffer.h"
+#include "register_allocator.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Host instruction sets the JIT can emit
+enum class JITBackend : uint8_t {
+    NONE,    // No code generator for this host
+    ARM64,
+    X86_64
+};
+
+// The backend whose code runs on this host, picked at build time
+#if defined(__aarch64__) || defined(__arm64__)
+constexpr JITBackend HOST_JIT_BACKEND = JITBackend::ARM64;
+#elif defined(__x86_64__)
+constexpr JITBackend HOST_JIT_BACKEND = JITBackend::X86_64;
+#else
+constexpr JITBackend HOST_JIT_BACKEND = JITBackend::NONE;
+#endif
+
+const char* jit_backend_name(JITBackend backend);
+
+// One slot of the block table the lookup stub searches for the next PC
+// of an exit that is not linked: the start PC of a compiled block (odd
+// when the slot is free) and the host address of its chain entry.
+// Direct-mapped, indexed by block_table_slot().
+struct BlockTableEntry {
+    uint32_t pc;
+    uint32_t reserved;
+    uint64_t code;
+};
+static_assert(sizeof(BlockTableEntry) == 16 && offsetof(BlockTableEntry, code) == 8,
+              "the lookup stubs index and load table slots at these offsets");
+
+constexpr size_t BLOCK_TABLE_SIZE = 4096;  // Slots, a power of two
+constexpr uint32_t BLOCK_TABLE_FREE = 1;   // PC of a free slot
+
+inline size_t block_table_slot(uint32_t pc) {
+    return (pc >> 2) & (BLOCK_TABLE_SIZE - 1);
+}
+
+// An exit of a compiled block to a guest PC known at compile time: a
+// jump at offset jump in the buffer, to the lookup stub until it is
+// linked to the chain entry of the block compiled for target
+struct BlockExit {
+    size_t jump;
+    uint32_t target;
+};
+
+// Where end_block() left a block in the buffer
+struct BlockCode {
+    size_t entry;                  // Called as the block function
+    size_t chain;                  // Jumped to from other blocks
+    std::vector<BlockExit> exits;  // Exits that can be linked
+};
+
+// Emits compiled blocks for one host instruction set into one buffer,
+// after the shared stubs from emit_stubs(). A block is a function
+// uint32_t (*)(GuestState* state, uint32_t* fuel) over the CPU's
+// registers and PC: begin_block() loads the block's allocated registers,
+// emit() translates guest instructions in order (spilled registers are
+// read and written in the state) and the block leaves through an exit
+// that stores the allocated registers it wrote and continues at the next
+// PC. A taken branch or a jump exits from emit(), and end_block() adds
+// the exit after the last instruction. A branch or JAL back to the
+// block's own start loops in native code instead, as long as *fuel
+// covers another pass, which it is charged.
+//
+// Exits go to the lookup stub, which jumps to the chain entry of the
+// block the table holds for the next PC, or returns the PC from the
+// function when there is none. Exits to PCs known at compile time can be
+// linked to jump to a chain entry directly. A chain entry charges *fuel
+// the block's instructions and returns the block's start PC instead when
+// *fuel does not cover them, so chained blocks run for as long as the
+// caller's fuel lasts. JITCompiler decides what goes into a block, where
+// its registers live and which exits are linked; backends only
+// translate.
+class CodeGenerator {
+public:
+    virtual ~CodeGenerator() = default;
+
+    virtual JITBackend backend() const = 0;
+
+    // Host registers available to the register allocator
+    virtual size_t host_registers() const = 0;
+
+    // Whether emit() can translate inst
+    virtual bool supports(const DecodedInstruction& inst) const = 0;
+
+    // Emit the exit and lookup stubs the blocks jump to, searching table
+    // (BLOCK_TABLE_SIZE slots); first in the buffer and again after it
+    // is reset
+    virtual void emit_stubs(const BlockTableEntry* table) = 0;
+
+    // Start a block of instructions guest instructions (a pass) at start_pc
+    virtual void begin_block(const RegisterAllocation& allocation, uint32_t start_pc, uint32_t instructions) = 0;
+
+    // Translate a supported inst at pc; rd is x0 only for jumps
+    virtual void emit(const DecodedInstruction& inst, uint32_t pc) = 0;
+
+    // Exit to next_pc, unless the block ended with a jump, and finish
+    // the block
+    virtual BlockCode end_block(uint32_t next_pc) = 0;
+
+    // Point the exit jump at offset jump to the chain entry at chain, or
+    // back to the lookup stub
+    virtual void link_exit(size_t jump, size_t chain) = 0;
+    virtual void unlink_exit(size_t jump) = 0;
+};
+
+// Code generator for backend writing into buffer; nullptr for NONE
+std::unique_ptr<CodeGenerator> make_code_generator(JITBackend backend, CodeBuffer& buffer);
+
+#endif // CODE_GENERATOR_H
@@ -0,0 +1,111 @@
+#include "execution_engine.h"
+#include "../core/guest_memory.h"
+#include <algorithm>
+#include <cstdint>
+
+const char* execution_mode_name(ExecutionMode mode) {
+    switch (mode) {
+        case ExecutionMode::INTERPRETER: return "interpreter";
+        case ExecutionMode::JIT:         return "jit";
+        case ExecutionMode::TIERED:      return "tiered";
+    }
+    return "unknown";
+}
+
+ExecutionEngine::ExecutionEngine(CPU& cpu, ExecutionMode mode, size_t code_cache_size)
+    : cpu(cpu), interpreter(cpu), jit(code_cache_size), mode(mode), flushes_seen(0), native_instructions(0),
+      native_blocks(0), rejected_blocks(0) {
+    jit.set_verbose(false);
+    cpu.add_code_listener(this);
+}
+
+ExecutionEngine::~ExecutionEngine() {
+    cpu.remove_code_listener(this);
+}
+
+void ExecutionEngine::invalidate_code_page(uint32_t page) {
+    jit.invalidate_code_page(page);
+    for (auto it = blocks.begin(); it != blocks.end();) {
+        if ((it->first >> PAGE_SHIFT) == page) {
+            it = blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ExecutionEngine::reset_stats() {
+    interpreter.reset_stats();
+    native_instructions = 0;
+    native_blocks = 0;
+}
+
+void ExecutionEngine::forget_flushed_blocks() {
+    if (jit.get_cache_flushes() != flushes_seen) {
+        blocks.clear();
+        flushes_seen = jit.get_cache_flushes();
+    }
+}
+
+const CompiledBlock* ExecutionEngine::enter_block(uint32_t pc) {
+    if (mode == ExecutionMode::INTERPRETER) {
+        return nullptr;
+    }
+    forget_flushed_blocks();
+    BlockEntry& entry = blocks[pc];
+    if (entry.compiled || entry.rejected) {
+        return entry.compiled;
+    }
+    
+    // Compile on the entry that reaches the threshold; blocks the JIT
+    // turns down are not offered again until their page is written or
+    // the cache is flushed
+    uint64_t threshold = mode == ExecutionMode::JIT ? 1 : jit.get_threshold();
+    if (++entry.entries < threshold) {
+        return nullptr;
+    }
+    jit.compile_basic_block(cpu, pc);
+    const CompiledBlock* compiled = jit.get_compiled_block(pc);
+    
+    // Making room may have flushed the cache, and the blocks with it
+    forget_flushed_blocks();
+    BlockEntry& result = blocks[pc];
+    result.compiled = compiled;
+    result.rejected = !compiled;
+    rejected_blocks += !compiled;
+    return compiled;
+}
+
+ExecResult ExecutionEngine::run(uint64_t max_instructions) {
+    uint64_t start = get_instructions_executed();
+    
+    while (get_instructions_executed() < max_instructions) {
+        uint32_t pc = cpu.get_pc();
+        uint64_t budget = max_instructions - get_instructions_executed();
+        
+        const CompiledBlock* compiled = enter_block(pc);
+        if (compiled && compiled->instructions <= budget) {
+            // Native loops and chained blocks may take the rest of the
+            // budget as fuel
+            uint64_t spare = budget - compiled->instructions;
+            uint32_t fuel = static_cast<uint32_t>(std::min<uint64_t>(spare, UINT32_MAX));
+            uint32_t initial_fuel = fuel;
+            compiled->code(cpu.get_state(), &fuel);
+            native_instructions += compiled->instructions + (initial_fuel - fuel);
+            native_blocks++;
+            continue;
+        }
+        
+        ExecResult result = interpreter.run_block(interpreter.get_instructions_executed() + budget);
+        if (result.reason != StopReason::NONE) {
+            result.instructions_retired = get_instructions_executed() - start;
+            return result;
+        }
+    }
+    
+    ExecResult result = {};
+    result.reason = StopReason::INSTRUCTION_LIMIT;
+    result.pc = cpu.get_pc();
+    result.instructions_retired = get_instructions_executed() - start;
+    return result;
+}
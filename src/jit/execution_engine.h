@@ -0,0 +1,96 @@
+#ifndef EXECUTION_ENGINE_H
+#define EXECUTION_ENGINE_H
+
+#include "../core/cpu.h"
+#include "../core/interpreter.h"
+#include "jit_compiler.h"
+#include <cstdint>
+#include <unordered_map>
+
+// Who runs guest code under ExecutionEngine
+enum class ExecutionMode {
+    INTERPRETER,  // Interpreter only; nothing is compiled
+    JIT,          // Compile every block on its first entry
+    TIERED        // Interpret blocks until they have been entered the
+                  // JIT's threshold times, then compile them
+};
+
+const char* execution_mode_name(ExecutionMode mode);
+
+// Runs a guest a basic block at a time, choosing between the interpreter
+// and compiled code. At every block entry compiled code for the PC runs
+// natively if there is any; otherwise the entry is counted and, once the
+// block is hot for the mode, handed to the JIT. Whatever the JIT cannot
+// compile (or a compiled block leaves off at) is run by the interpreter,
+// so every mode gives the same results. A block the JIT turns down is
+// remembered as such and not counted or offered again, so an entry costs
+// one lookup whatever the block's state.
+//
+// A native call continues through chained compiled blocks for as long
+// as the remaining instruction budget lasts. Only interpreted
+// instructions reach the interpreter's profiler, timing model and
+// simulators; instructions run natively are counted here.
+// Guest stores into compiled code drop it and restart its entry counts,
+// and so does a full code cache for every block it evicts.
+class ExecutionEngine : public CodeWriteListener {
+public:
+    explicit ExecutionEngine(CPU& cpu, ExecutionMode mode = ExecutionMode::TIERED,
+                             size_t code_cache_size = JITCompiler::DEFAULT_CODE_CACHE_SIZE);
+    ~ExecutionEngine() override;
+    
+    ExecutionEngine(const ExecutionEngine&) = delete;
+    ExecutionEngine& operator=(const ExecutionEngine&) = delete;
+    
+    void set_mode(ExecutionMode new_mode) { mode = new_mode; }
+    ExecutionMode get_mode() const { return mode; }
+    
+    // Execute until a stop condition or until the total instruction count
+    // (interpreted and native) reaches max_instructions, like
+    // Interpreter::run()
+    ExecResult run(uint64_t max_instructions = 1000000);
+    
+    Interpreter& get_interpreter() { return interpreter; }
+    // For settings and statistics: the engine keeps its own record of the
+    // blocks it compiled
+    JITCompiler& get_jit() { return jit; }
+    
+    // Statistics
+    uint64_t get_instructions_executed() const {
+        return interpreter.get_instructions_executed() + native_instructions;
+    }
+    uint64_t get_native_instructions() const { return native_instructions; }
+    uint64_t get_native_blocks() const { return native_blocks; }  // Compiled block runs
+    uint64_t get_rejected_blocks() const { return rejected_blocks; }  // Blocks the JIT turned down
+    void reset_stats();
+    
+    // CodeWriteListener
+    void invalidate_code_page(uint32_t page) override;
+    
+private:
+    CPU& cpu;
+    Interpreter interpreter;
+    JITCompiler jit;
+    ExecutionMode mode;
+    
+    // What the engine knows of a block start: its compiled code, or how
+    // often it was entered without any, or that the JIT turned it down
+    struct BlockEntry {
+        const CompiledBlock* compiled = nullptr;
+        uint64_t entries = 0;
+        bool rejected = false;
+    };
+    std::unordered_map<uint32_t, BlockEntry> blocks;
+    uint64_t flushes_seen;  // The JIT's cache flushes when blocks was last cleared
+    uint64_t native_instructions;
+    uint64_t native_blocks;
+    uint64_t rejected_blocks;
+    
+    // Compiled block for pc, compiling it when this entry makes it hot
+    const CompiledBlock* enter_block(uint32_t pc);
+    
+    // Forget every block if the JIT has flushed its code cache since the
+    // last call: their code is gone and their counts are past the threshold
+    void forget_flushed_blocks();
+};
+
+#endif // EXECUTION_ENGINE_H
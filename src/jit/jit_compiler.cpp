@@ -1,142 +1,222 @@
 #include "jit_compiler.h"
+#include "../core/guest_memory.h"
+#include "../core/instruction_table.h"
+#include "../core/text_image.h"
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
-ARM64Reg JITCompiler::map_riscv_reg(uint8_t riscv_reg) {
-    if (riscv_reg >= 8) {
-        throw std::runtime_error("Only x0-x7 supported in JIT for now");
+// Room left in the code cache for the next block: more than a block of
+// 10 instructions with every register spilled and three exits needs
+static const size_t MAX_BLOCK_CODE = 4096;
+
+// Direct branches must reach across the whole cache (B is +/-128MB)
+static const size_t MAX_CODE_CACHE_SIZE = 128 * 1024 * 1024;
+
+JITCompiler::JITCompiler(size_t code_cache_size)
+    : cache(code_cache_size), linked_exits(0), cache_flushes(0), compilation_threshold(50), verbose(true) {
+    if (code_cache_size < 2 * MAX_BLOCK_CODE || code_cache_size > MAX_CODE_CACHE_SIZE) {
+        throw std::runtime_error("Code cache size out of range");
+    }
+    block_table.assign(BLOCK_TABLE_SIZE, BlockTableEntry{BLOCK_TABLE_FREE, 0, 0});
+    generator = make_code_generator(get_backend(), cache);
+    if (generator) {
+        cache.make_writable();
+        generator->emit_stubs(block_table.data());
+        cache.make_executable();
     }
-    return static_cast<ARM64Reg>(9 + riscv_reg);  // X9-X16
 }
 
 void JITCompiler::compile_basic_block(CPU& cpu, uint32_t start_pc) {
-    std::cout << "JIT: Compiling basic block at 0x" << std::hex << start_pc << std::dec << std::endl;
-    
-    auto buffer = std::make_unique<CodeBuffer>();
-    ARM64Assembler asm_(*buffer);
-    
-    // X0 = pointer to register array - USE IT DIRECTLY (don't save to X19!)
-    
-    // Load RISC-V registers x0-x7
-    asm_.mov_reg_imm(ARM64Reg::X9, 0);  // x0 = 0
+    if (verbose) {
+        std::cout << "JIT: Compiling basic block at 0x" << std::hex << start_pc << std::dec << std::endl;
+    }
     
-    // Load x1-x7 from memory using X0 as base
-    for (int i = 1; i < 8; i++) {
-        ARM64Reg arm_reg = map_riscv_reg(i);
-        asm_.ldr_reg_mem(arm_reg, ARM64Reg::X0, i * 4);
+    if (!generator) {
+        if (verbose) {
+            std::cout << "JIT: No code generator for this host" << std::endl;
+        }
+        return;
     }
     
+    // Gather the block first: the register allocation depends on every
+    // instruction in it
+    std::vector<DecodedInstruction> block;
+    std::vector<uint32_t> block_pcs;
     uint32_t pc = start_pc;
     int instructions_compiled = 0;
     
     while (instructions_compiled < 10) {
-        try {
-            uint32_t raw_inst = cpu.read_word(pc);
-            Instruction inst = Decoder::decode(raw_inst);
-            
-            bool regs_ok = true;
-            if (inst.rd < 32 && inst.rd >= 8) regs_ok = false;
-            
-            if (inst.type == InstructionType::R_TYPE || 
-                inst.type == InstructionType::I_TYPE ||
-                inst.type == InstructionType::S_TYPE ||
-                inst.type == InstructionType::B_TYPE) {
-                if (inst.rs1 >= 8) regs_ok = false;
-            }
-            
-            if (inst.type == InstructionType::R_TYPE ||
-                inst.type == InstructionType::S_TYPE ||
-                inst.type == InstructionType::B_TYPE) {
-                if (inst.rs2 >= 8) regs_ok = false;
-            }
-            
-            if (!regs_ok) {
-                break;
-            }
-            
-            if (!compile_instruction(asm_, inst)) {
+        // Text predecoded at load time needs no decode here
+        DecodedInstruction inst;
+        const TextImage* image = cpu.get_text_image();
+        if (!image || !image->lookup(pc, inst)) {
+            uint32_t raw_inst;
+            if (!cpu.try_load(pc, raw_inst)) {
+                if (verbose) {
+                    std::cout << "JIT: Fetch outside guest memory" << std::endl;
+                }
                 break;
             }
-            
-            instructions_compiled++;
-            pc += 4;
-            
-            if (inst.type == InstructionType::B_TYPE || 
-                inst.type == InstructionType::J_TYPE ||
-                inst.opcode == 0x67 || inst.opcode == 0x73) {
+            inst = Decoder::predecode(raw_inst);
+        }
+        uint16_t flags = operation_flags(inst.op);
+        
+        // Writes to x0 are discarded: an ALU operation targeting it is a
+        // no-op and needs no code
+        const uint16_t side_effects = INST_LOAD | INST_STORE | INST_ENDS_BLOCK | INST_MAY_TRAP;
+        bool no_op = (flags & INST_WRITES_RD) && inst.rd == 0 && (flags & side_effects) == 0;
+        
+        if (!no_op) {
+            if (!generator->supports(inst)) {
                 break;
             }
-            
-        } catch (const std::exception& e) {
-            std::cout << "JIT: " << e.what() << std::endl;
+            block.push_back(inst);
+            block_pcs.push_back(pc);
+        }
+        
+        instructions_compiled++;
+        pc += 4;
+        
+        if ((flags & INST_ENDS_BLOCK) || (pc & (PAGE_SIZE - 1)) == 0) {
             break;
         }
     }
     
     if (instructions_compiled == 0) {
-        std::cout << "JIT: No instructions compiled" << std::endl;
+        if (verbose) {
+            std::cout << "JIT: No instructions compiled" << std::endl;
+        }
         return;
     }
+    cpu.mark_code_page(start_pc);
     
-    // Store x1-x7 back using X0 as base
-    for (int i = 1; i < 8; i++) {
-        ARM64Reg arm_reg = map_riscv_reg(i);
-        asm_.str_reg_mem(arm_reg, ARM64Reg::X0, i * 4);
+    if (cache.get_capacity() - cache.get_position() < MAX_BLOCK_CODE) {
+        if (verbose) {
+            std::cout << "JIT: Code cache full, evicting every block" << std::endl;
+        }
+        flush();
+    }
+    cache.make_writable();
+    if (has_compiled_code(start_pc)) {
+        drop_block(start_pc);
     }
     
-    asm_.ret();
+    RegisterAllocation allocation = allocate_registers(block, generator->host_registers());
+    generator->begin_block(allocation, start_pc, static_cast<uint32_t>(instructions_compiled));
+    for (size_t i = 0; i < block.size(); i++) {
+        generator->emit(block[i], block_pcs[i]);
+    }
+    add_block(start_pc, static_cast<uint32_t>(instructions_compiled), generator->end_block(pc));
+    cache.make_executable();
     
-    buffer->make_executable();
+    if (verbose) {
+        std::cout << "JIT: Successfully compiled " << instructions_compiled << " instructions ("
+                  << allocation.allocated << " registers in host registers, " << allocation.spilled << " spilled)"
+                  << std::endl;
+    }
+}
+
+size_t JITCompiler::compile_hot_blocks(CPU& cpu, const ControlFlowGraph& cfg) {
+    // Counted one by one: a cache flush on the way drops blocks
+    size_t compiled = 0;
+    for (uint32_t start : cfg.hot_blocks(compilation_threshold)) {
+        if (!has_compiled_code(start)) {
+            compile_basic_block(cpu, start);
+            compiled += has_compiled_code(start);
+        }
+    }
+    return compiled;
+}
+
+void JITCompiler::add_block(uint32_t start_pc, uint32_t instructions, BlockCode code) {
+    compiled_cache[start_pc] = CompiledBlock{cache.get_function<CompiledFunc>(code.entry), instructions};
     
-    CompiledFunc func = buffer->get_function<CompiledFunc>();
-    compiled_cache[start_pc] = func;
-    buffers.push_back(std::move(buffer));
+    // Exits of other blocks into this one first, then its own (including
+    // any back to itself)
+    auto incoming = exits_to.find(start_pc);
+    if (incoming != exits_to.end()) {
+        for (size_t jump : incoming->second) {
+            generator->link_exit(jump, code.chain);
+            linked_exits++;
+        }
+    }
+    for (const BlockExit& exit : code.exits) {
+        exits_to[exit.target].push_back(exit.jump);
+        auto target = block_code.find(exit.target);
+        if (exit.target == start_pc || target != block_code.end()) {
+            generator->link_exit(exit.jump, exit.target == start_pc ? code.chain : target->second.chain);
+            linked_exits++;
+        }
+    }
     
-    std::cout << "JIT: Successfully compiled " << instructions_compiled << " instructions" << std::endl;
+    block_table[block_table_slot(start_pc)] =
+        BlockTableEntry{start_pc, 0, reinterpret_cast<uint64_t>(cache.get_function<const uint8_t*>(code.chain))};
+    block_code[start_pc] = std::move(code);
 }
 
-bool JITCompiler::compile_instruction(ARM64Assembler& asm_, const Instruction& inst) {
-    if (inst.type == InstructionType::R_TYPE && inst.opcode == 0x33) {
-        ARM64Reg rd = map_riscv_reg(inst.rd);
-        ARM64Reg rs1 = map_riscv_reg(inst.rs1);
-        ARM64Reg rs2 = map_riscv_reg(inst.rs2);
-        
-        switch (inst.funct3) {
-            case 0x0:
-                if (inst.funct7 == 0x00) {
-                    asm_.add_reg_reg_reg(rd, rs1, rs2);
-                } else if (inst.funct7 == 0x20) {
-                    asm_.sub_reg_reg_reg(rd, rs1, rs2);
-                } else {
-                    return false;
-                }
-                break;
-            case 0x4:
-                asm_.eor_reg_reg_reg(rd, rs1, rs2);
-                break;
-            case 0x6:
-                asm_.orr_reg_reg_reg(rd, rs1, rs2);
-                break;
-            case 0x7:
-                asm_.and_reg_reg_reg(rd, rs1, rs2);
-                break;
-            default:
-                return false;
+void JITCompiler::drop_block(uint32_t start_pc) {
+    auto it = block_code.find(start_pc);
+    
+    // The block's own exits go with it: its code is never run again
+    for (const BlockExit& exit : it->second.exits) {
+        std::vector<size_t>& jumps = exits_to[exit.target];
+        jumps.erase(std::find(jumps.begin(), jumps.end(), exit.jump));
+        if (jumps.empty()) {
+            exits_to.erase(exit.target);
+        }
+        if (block_code.count(exit.target)) {
+            linked_exits--;
         }
-        return true;
     }
     
-    if (inst.type == InstructionType::I_TYPE && inst.opcode == 0x13 && inst.funct3 == 0x0) {
-        ARM64Reg rd = map_riscv_reg(inst.rd);
-        ARM64Reg rs1 = map_riscv_reg(inst.rs1);
-        
-        uint32_t imm_unsigned = static_cast<uint32_t>(inst.imm);
-        
-        if (imm_unsigned <= 0xFFFF || (inst.imm >= 0 && inst.imm <= 65535)) {
-            asm_.mov_reg_imm(ARM64Reg::X8, imm_unsigned & 0xFFFF);
-            asm_.add_reg_reg_reg(rd, rs1, ARM64Reg::X8);
-            return true;
+    // Exits into it go back to the lookup stub, to be linked again if it
+    // is recompiled
+    auto incoming = exits_to.find(start_pc);
+    if (incoming != exits_to.end()) {
+        for (size_t jump : incoming->second) {
+            generator->unlink_exit(jump);
+            linked_exits--;
+        }
+    }
+    
+    BlockTableEntry& slot = block_table[block_table_slot(start_pc)];
+    if (slot.pc == start_pc) {
+        slot = BlockTableEntry{BLOCK_TABLE_FREE, 0, 0};
+    }
+    block_code.erase(it);
+    compiled_cache.erase(start_pc);
+}
+
+void JITCompiler::invalidate_code_page(uint32_t page) {
+    std::vector<uint32_t> dropped;
+    for (const auto& entry : compiled_cache) {
+        if ((entry.first >> PAGE_SHIFT) == page) {
+            dropped.push_back(entry.first);
         }
     }
+    if (dropped.empty()) {
+        return;
+    }
+    cache.make_writable();
+    for (uint32_t start : dropped) {
+        drop_block(start);
+    }
+    cache.make_executable();
+}
+
+void JITCompiler::flush() {
+    compiled_cache.clear();
+    block_code.clear();
+    exits_to.clear();
+    block_table.assign(BLOCK_TABLE_SIZE, BlockTableEntry{BLOCK_TABLE_FREE, 0, 0});
+    linked_exits = 0;
+    cache_flushes++;
     
-    return false;
-}
\ No newline at end of file
+    cache.make_writable();
+    cache.reset();
+    if (generator) {
+        generator->emit_stubs(block_table.data());
+    }
+    cache.make_executable();
+}
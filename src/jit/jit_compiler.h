@@ -3,18 +3,55 @@
 
 #include "../core/cpu.h"
 #include "../core/decoder.h"
+#include "../core/control_flow.h"
 #include "code_buffer.h"
-#include "arm64_assembler.h"
+#include "code_generator.h"
 #include <unordered_map>
 #include <memory>
 #include <cstdint>
+#include <vector>
 
-// Compiled function signature: void (*)(uint32_t* registers)
-typedef void (*CompiledFunc)(uint32_t*);
+// Compiled function signature: uint32_t (*)(GuestState* state, uint32_t* fuel).
+// Runs on the CPU's registers and PC in place and returns the next PC,
+// which it also stores in state->pc.
+typedef uint32_t (*CompiledFunc)(GuestState*, uint32_t*);
 
-class JITCompiler {
+// A compiled block from its start PC, up to and including a branch or
+// jump when it could be compiled. One pass executes instructions guest
+// instructions; a block that branches back to its own start runs more
+// passes natively, and one whose exit leads to another compiled block
+// continues in it, each pass or block taking its instructions off *fuel
+// while it covers them, so a call retires instructions + (fuel before -
+// fuel after).
+struct CompiledBlock {
+    CompiledFunc code;
+    uint32_t instructions;  // Guest instructions per pass
+};
+
+// Translates guest basic blocks to host code through the code generator
+// of the host's backend (HOST_JIT_BACKEND); on hosts without one nothing
+// is compiled. Compiled blocks never span a page and mark their page as
+// code, so a listener registered with the CPU drops them when the guest
+// overwrites it.
+//
+// Blocks are emitted one after another into a single code cache and
+// chained: an exit to a PC known at compile time is patched to jump
+// straight to the block compiled for it, as soon as both exist, and the
+// other exits look the next PC up in a direct-mapped block table in
+// native code, so compiled code only returns to the caller for a PC
+// without a block or when the fuel runs out. Dropping a block unlinks
+// the exits into it and frees its table slot. When the cache has no room
+// for another block, every block is evicted and the cache starts over.
+class JITCompiler : public CodeWriteListener {
 public:
-    JITCompiler() : compilation_threshold(50) {}
+    static constexpr size_t DEFAULT_CODE_CACHE_SIZE = 4 * 1024 * 1024;
+    
+    explicit JITCompiler(size_t code_cache_size = DEFAULT_CODE_CACHE_SIZE);
+    
+    JITCompiler(const JITCompiler&) = delete;
+    JITCompiler& operator=(const JITCompiler&) = delete;
+    
+    JITBackend get_backend() const { return HOST_JIT_BACKEND; }
     
     // Check if a PC has compiled code
     bool has_compiled_code(uint32_t pc) const {
@@ -25,30 +62,65 @@ public:
     CompiledFunc get_compiled_code(uint32_t pc) const {
         auto it = compiled_cache.find(pc);
         if (it != compiled_cache.end()) {
-            return it->second;
+            return it->second.code;
         }
         return nullptr;
     }
     
+    // Compiled block starting at PC, or nullptr
+    const CompiledBlock* get_compiled_block(uint32_t pc) const {
+        auto it = compiled_cache.find(pc);
+        return it != compiled_cache.end() ? &it->second : nullptr;
+    }
+    
     // Compile a basic block starting at PC
     void compile_basic_block(CPU& cpu, uint32_t start_pc);
     
-    // Set compilation threshold
+    // Compile the hot blocks of a profiled control-flow graph (loop bodies
+    // first) not already compiled; returns how many were compiled
+    size_t compile_hot_blocks(CPU& cpu, const ControlFlowGraph& cfg);
+    
+    // Block entries before a block is hot enough to compile
     void set_threshold(uint64_t threshold) { compilation_threshold = threshold; }
+    uint64_t get_threshold() const { return compilation_threshold; }
+    
+    // Progress messages on stdout for every compilation (the default)
+    void set_verbose(bool enabled) { verbose = enabled; }
+    
+    // CodeWriteListener: drop the compiled blocks of an overwritten page.
+    // Their code stays in the cache until it is flushed.
+    void invalidate_code_page(uint32_t page) override;
+    
+    // Evict every compiled block and start the code cache over
+    void flush();
     
     // Statistics
     size_t get_compiled_blocks() const { return compiled_cache.size(); }
+    size_t get_linked_exits() const { return linked_exits; }   // Exits jumping straight to a block
+    uint64_t get_cache_flushes() const { return cache_flushes; }
+    size_t get_code_cache_used() const { return cache.get_position(); }
     
 private:
-    std::unordered_map<uint32_t, CompiledFunc> compiled_cache;
-    std::vector<std::unique_ptr<CodeBuffer>> buffers;
+    CodeBuffer cache;
+    std::unique_ptr<CodeGenerator> generator;
+    std::vector<BlockTableEntry> block_table;
+    std::unordered_map<uint32_t, CompiledBlock> compiled_cache;
+    std::unordered_map<uint32_t, BlockCode> block_code;
+    
+    // Offsets of the linkable exits of compiled blocks, by target PC:
+    // linked exactly when the target is compiled
+    std::unordered_map<uint32_t, std::vector<size_t>> exits_to;
+    size_t linked_exits;
+    uint64_t cache_flushes;
     uint64_t compilation_threshold;
+    bool verbose;
     
-    // Compile a single RISC-V instruction to ARM64
-    bool compile_instruction(ARM64Assembler& asm_, const Instruction& inst);
+    // Add a block just emitted to the cache: link the exits into it and
+    // its own exits to blocks already compiled, and fill its table slot
+    void add_block(uint32_t start_pc, uint32_t instructions, BlockCode code);
     
-    // Register mapping
-    static ARM64Reg map_riscv_reg(uint8_t riscv_reg);
+    // Drop a compiled block, unlinking the exits into it
+    void drop_block(uint32_t start_pc);
 };
 
 #endif // JIT_COMPILER_H
\ No newline at end of file
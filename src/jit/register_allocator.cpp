@@ -0,0 +1,46 @@
+#include "register_allocator.h"
+#include "../core/instruction_table.h"
+#include <algorithm>
+
+RegisterAllocation allocate_registers(const std::vector<DecodedInstruction>& block, size_t host_registers) {
+    RegisterAllocation allocation;
+    std::array<uint32_t, 32> uses = {};
+    uint32_t written = 0;
+
+    auto read = [&](uint8_t reg) {
+        uses[reg]++;
+        if (!((written >> reg) & 1)) {
+            allocation.loaded |= 1u << reg;
+        }
+    };
+
+    for (const DecodedInstruction& inst : block) {
+        uint16_t flags = operation_flags(inst.op);
+        if (flags & INST_READS_RS1) read(inst.rs1);
+        if (flags & INST_READS_RS2) read(inst.rs2);
+        if (flags & INST_WRITES_RD) {
+            uses[inst.rd]++;
+            written |= 1u << inst.rd;
+        }
+    }
+    allocation.loaded &= ~1u;
+    allocation.stored = written & ~1u;
+
+    std::vector<uint8_t> order;
+    for (uint8_t reg = 1; reg < 32; reg++) {
+        if (uses[reg]) {
+            order.push_back(reg);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&uses](uint8_t a, uint8_t b) { return uses[a] > uses[b]; });
+
+    for (uint8_t reg : order) {
+        if (allocation.allocated == host_registers) {
+            allocation.spilled++;
+            continue;
+        }
+        allocation.host[reg] = static_cast<uint8_t>(allocation.allocated++);
+    }
+    return allocation;
+}
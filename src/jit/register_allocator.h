@@ -0,0 +1,39 @@
+#ifndef REGISTER_ALLOCATOR_H
+#define REGISTER_ALLOCATOR_H
+
+#include "../core/decoder.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Where each guest register lives while a compiled block runs. The most
+// used registers of the block get one of the backend's host registers
+// for the whole block; the rest stay spilled in the CPU register file
+// and are read and written there by each instruction. x0 is never
+// allocated: backends read it as zero and blocks never write it.
+struct RegisterAllocation {
+    static constexpr uint8_t SPILLED = 0xFF;
+
+    // Index into the backend's pool of host registers, or SPILLED
+    std::array<uint8_t, 32> host;
+
+    // Guest registers (bit n = xn) the block reads before writing them,
+    // loaded on entry when allocated, and those it writes, stored on exit
+    uint32_t loaded = 0;
+    uint32_t stored = 0;
+
+    size_t allocated = 0;  // Guest registers given a host register
+    size_t spilled = 0;    // Guest registers used but left in memory
+
+    RegisterAllocation() { host.fill(SPILLED); }
+
+    bool in_host(uint8_t reg) const { return host[reg] != SPILLED; }
+    bool is_loaded(uint8_t reg) const { return (loaded >> reg) & 1; }
+    bool is_stored(uint8_t reg) const { return (stored >> reg) & 1; }
+};
+
+// Give up to host_registers of the guest registers used by block a host
+// register, busiest first (ties to the lower register number)
+RegisterAllocation allocate_registers(const std::vector<DecodedInstruction>& block, size_t host_registers);
+
+#endif // REGISTER_ALLOCATOR_H
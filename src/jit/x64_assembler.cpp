@@ -0,0 +1,185 @@
+#include "x64_assembler.h"
+
+void X64Assembler::rex(uint8_t reg, uint8_t rm) {
+    // REX: 0100 W R X B, with W = 0 for 32-bit operands
+    if (reg >= 8 || rm >= 8) {
+        buffer.emit_byte(0x40 | ((reg >> 3) << 2) | (rm >> 3));
+    }
+}
+
+void X64Assembler::op_reg_reg(uint8_t opcode, X64Reg reg, X64Reg rm) {
+    // ModRM: mod 11 (register direct), reg, rm
+    rex(reg_num(reg), reg_num(rm));
+    buffer.emit_byte(opcode);
+    buffer.emit_byte(0xC0 | ((reg_num(reg) & 7) << 3) | (reg_num(rm) & 7));
+}
+
+void X64Assembler::op_reg_mem(uint8_t opcode, X64Reg reg, X64Reg base, int32_t offset) {
+    // ModRM mod 01 (disp8) or 10 (disp32); never mod 00, so RBP/R13 as
+    // base need no special case. RSP/R12 as base need a SIB byte.
+    rex(reg_num(reg), reg_num(base));
+    buffer.emit_byte(opcode);
+    bool short_offset = offset >= -128 && offset <= 127;
+    buffer.emit_byte((short_offset ? 0x40 : 0x80) | ((reg_num(reg) & 7) << 3) | (reg_num(base) & 7));
+    if ((reg_num(base) & 7) == 4) {
+        buffer.emit_byte(0x24);  // SIB: no index, base
+    }
+    if (short_offset) {
+        buffer.emit_byte(static_cast<uint8_t>(offset));
+    } else {
+        buffer.emit_uint32(static_cast<uint32_t>(offset));
+    }
+}
+
+void X64Assembler::mov_reg_imm(X64Reg dst, uint32_t imm) {
+    // MOV r32, imm32: [REX.B] B8+rd id
+    rex(0, reg_num(dst));
+    buffer.emit_byte(0xB8 | (reg_num(dst) & 7));
+    buffer.emit_uint32(imm);
+}
+
+void X64Assembler::mov_reg_reg(X64Reg dst, X64Reg src) {
+    // MOV r/m32, r32: 89 /r
+    op_reg_reg(0x89, src, dst);
+}
+
+void X64Assembler::add_reg_reg(X64Reg dst, X64Reg src) {
+    // ADD r/m32, r32: 01 /r
+    op_reg_reg(0x01, src, dst);
+}
+
+void X64Assembler::op_reg_imm(uint8_t ext, X64Reg rm, int32_t imm) {
+    bool short_imm = imm >= -128 && imm <= 127;
+    rex(0, reg_num(rm));
+    buffer.emit_byte(short_imm ? 0x83 : 0x81);
+    buffer.emit_byte(0xC0 | (ext << 3) | (reg_num(rm) & 7));
+    if (short_imm) {
+        buffer.emit_byte(static_cast<uint8_t>(imm));
+    } else {
+        buffer.emit_uint32(static_cast<uint32_t>(imm));
+    }
+}
+
+void X64Assembler::add_reg_imm(X64Reg dst, int32_t imm) {
+    // ADD r/m32, imm8: 83 /0 ib; ADD r/m32, imm32: 81 /0 id
+    op_reg_imm(0, dst, imm);
+}
+
+void X64Assembler::and_reg_imm(X64Reg dst, int32_t imm) {
+    // AND r/m32, imm8: 83 /4 ib; AND r/m32, imm32: 81 /4 id
+    op_reg_imm(4, dst, imm);
+}
+
+void X64Assembler::sub_reg_reg(X64Reg dst, X64Reg src) {
+    // SUB r/m32, r32: 29 /r
+    op_reg_reg(0x29, src, dst);
+}
+
+void X64Assembler::and_reg_reg(X64Reg dst, X64Reg src) {
+    // AND r/m32, r32: 21 /r
+    op_reg_reg(0x21, src, dst);
+}
+
+void X64Assembler::or_reg_reg(X64Reg dst, X64Reg src) {
+    // OR r/m32, r32: 09 /r
+    op_reg_reg(0x09, src, dst);
+}
+
+void X64Assembler::xor_reg_reg(X64Reg dst, X64Reg src) {
+    // XOR r/m32, r32: 31 /r
+    op_reg_reg(0x31, src, dst);
+}
+
+void X64Assembler::neg_reg(X64Reg dst) {
+    // NEG r/m32: F7 /3
+    rex(0, reg_num(dst));
+    buffer.emit_byte(0xF7);
+    buffer.emit_byte(0xD8 | (reg_num(dst) & 7));
+}
+
+void X64Assembler::shl_reg_imm(X64Reg dst, uint8_t shift) {
+    // SHL r/m32, imm8: C1 /4 ib
+    rex(0, reg_num(dst));
+    buffer.emit_byte(0xC1);
+    buffer.emit_byte(0xE0 | (reg_num(dst) & 7));
+    buffer.emit_byte(shift);
+}
+
+void X64Assembler::mov_reg_imm64(X64Reg dst, uint64_t imm) {
+    // MOV r64, imm64: REX.W [+B] B8+rd io
+    buffer.emit_byte(0x48 | (reg_num(dst) >> 3));
+    buffer.emit_byte(0xB8 | (reg_num(dst) & 7));
+    buffer.emit_uint64(imm);
+}
+
+void X64Assembler::add_reg_reg64(X64Reg dst, X64Reg src) {
+    // ADD r/m64, r64: REX.W 01 /r
+    buffer.emit_byte(0x48 | ((reg_num(src) >> 3) << 2) | (reg_num(dst) >> 3));
+    buffer.emit_byte(0x01);
+    buffer.emit_byte(0xC0 | ((reg_num(src) & 7) << 3) | (reg_num(dst) & 7));
+}
+
+void X64Assembler::cmp_reg_reg(X64Reg left, X64Reg right) {
+    // CMP r/m32, r32: 39 /r
+    op_reg_reg(0x39, right, left);
+}
+
+void X64Assembler::cmp_reg_imm(X64Reg left, int32_t imm) {
+    // CMP r/m32, imm8: 83 /7 ib; CMP r/m32, imm32: 81 /7 id
+    op_reg_imm(7, left, imm);
+}
+
+void X64Assembler::cmp_reg_mem(X64Reg left, X64Reg base, int32_t offset) {
+    // CMP r32, r/m32: 3B /r
+    op_reg_mem(0x3B, left, base, offset);
+}
+
+void X64Assembler::jcc(X64Cond cond, int32_t offset) {
+    // Jcc rel32: 0F 80+cc cd
+    buffer.emit_byte(0x0F);
+    buffer.emit_byte(0x80 | static_cast<uint8_t>(cond));
+    buffer.emit_uint32(static_cast<uint32_t>(offset));
+}
+
+void X64Assembler::jmp(int32_t offset) {
+    // JMP rel32: E9 cd
+    buffer.emit_byte(0xE9);
+    buffer.emit_uint32(static_cast<uint32_t>(offset));
+}
+
+void X64Assembler::jmp_mem(X64Reg base, int32_t offset) {
+    // JMP r/m64: FF /4 (64-bit operand by default); RSP encodes /4
+    op_reg_mem(0xFF, X64Reg::RSP, base, offset);
+}
+
+void X64Assembler::patch_jump(size_t jump_end, size_t target) {
+    // rel32 is the last four bytes of both forms
+    int64_t offset = static_cast<int64_t>(target) - static_cast<int64_t>(jump_end);
+    buffer.patch_uint32(jump_end - 4, static_cast<uint32_t>(offset));
+}
+
+void X64Assembler::ret() {
+    buffer.emit_byte(0xC3);
+}
+
+void X64Assembler::push_reg(X64Reg reg) {
+    // PUSH r64: [REX.B] 50+rd
+    rex(0, reg_num(reg));
+    buffer.emit_byte(0x50 | (reg_num(reg) & 7));
+}
+
+void X64Assembler::pop_reg(X64Reg reg) {
+    // POP r64: [REX.B] 58+rd
+    rex(0, reg_num(reg));
+    buffer.emit_byte(0x58 | (reg_num(reg) & 7));
+}
+
+void X64Assembler::mov_reg_mem(X64Reg dst, X64Reg base, int32_t offset) {
+    // MOV r32, r/m32: 8B /r
+    op_reg_mem(0x8B, dst, base, offset);
+}
+
+void X64Assembler::mov_mem_reg(X64Reg base, int32_t offset, X64Reg src) {
+    // MOV r/m32, r32: 89 /r
+    op_reg_mem(0x89, src, base, offset);
+}
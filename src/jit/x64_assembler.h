@@ -0,0 +1,135 @@
+#ifndef X64_ASSEMBLER_H
+#define X64_ASSEMBLER_H
+
+#include "code_buffer.h"
+#include <cstdint>
+
+// x86-64 general-purpose register encoding
+enum class X64Reg : uint8_t {
+    RAX = 0,  RCX = 1,  RDX = 2,  RBX = 3,
+    RSP = 4,  RBP = 5,  RSI = 6,  RDI = 7,
+    R8 = 8,   R9 = 9,   R10 = 10, R11 = 11,
+    R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+// x86-64 condition codes (low nibble of Jcc)
+enum class X64Cond : uint8_t {
+    E = 0x4,   // Equal
+    NE = 0x5,  // Not equal
+    B = 0x2,   // Below (unsigned)
+    AE = 0x3,  // Above or equal (unsigned)
+    L = 0xC,   // Less than (signed)
+    GE = 0xD,  // Greater or equal (signed)
+    G = 0xF,   // Greater than (signed)
+    LE = 0xE   // Less or equal (signed)
+};
+
+// Simple x86-64 assembler. Arithmetic is on the 32-bit registers (EAX,
+// R8D, ...), which zero the upper halves; memory operands are
+// [base + disp32].
+class X64Assembler {
+public:
+    X64Assembler(CodeBuffer& buffer) : buffer(buffer) {}
+
+    // === Data Processing Instructions ===
+
+    // MOV r32, imm32
+    void mov_reg_imm(X64Reg dst, uint32_t imm);
+
+    // MOV r32, r32
+    void mov_reg_reg(X64Reg dst, X64Reg src);
+
+    // ADD r32, r32 (dst += src)
+    void add_reg_reg(X64Reg dst, X64Reg src);
+
+    // ADD r32, imm32 (imm8 form when it fits)
+    void add_reg_imm(X64Reg dst, int32_t imm);
+    
+    // AND r32, imm32 (imm8 form when it fits)
+    void and_reg_imm(X64Reg dst, int32_t imm);
+
+    // SUB r32, r32 (dst -= src)
+    void sub_reg_reg(X64Reg dst, X64Reg src);
+
+    // AND r32, r32
+    void and_reg_reg(X64Reg dst, X64Reg src);
+
+    // OR r32, r32
+    void or_reg_reg(X64Reg dst, X64Reg src);
+
+    // XOR r32, r32
+    void xor_reg_reg(X64Reg dst, X64Reg src);
+
+    // NEG r32
+    void neg_reg(X64Reg dst);
+
+    // SHL r32, imm8
+    void shl_reg_imm(X64Reg dst, uint8_t shift);
+
+    // MOV r64, imm64 and ADD r64, r64 (host addresses)
+    void mov_reg_imm64(X64Reg dst, uint64_t imm);
+    void add_reg_reg64(X64Reg dst, X64Reg src);
+
+    // === Compare and Branch ===
+
+    // CMP r32, r32 (flags from left - right)
+    void cmp_reg_reg(X64Reg left, X64Reg right);
+    
+    // CMP r32, imm32 (imm8 form when it fits)
+    void cmp_reg_imm(X64Reg left, int32_t imm);
+
+    // CMP r32, [base + offset]
+    void cmp_reg_mem(X64Reg left, X64Reg base, int32_t offset);
+
+    // Jcc rel32; offset is from the end of the instruction
+    void jcc(X64Cond cond, int32_t offset);
+
+    // JMP rel32; offset is from the end of the instruction
+    void jmp(int32_t offset);
+
+    // JMP qword [base + offset] (to a host address held in memory)
+    void jmp_mem(X64Reg base, int32_t offset);
+
+    // RET
+    void ret();
+
+    // PUSH r64 / POP r64 (saving callee-saved registers)
+    void push_reg(X64Reg reg);
+    void pop_reg(X64Reg reg);
+
+    // === Memory Operations ===
+
+    // MOV r32, [base + offset] (load 32-bit)
+    void mov_reg_mem(X64Reg dst, X64Reg base, int32_t offset);
+
+    // MOV [base + offset], r32 (store 32-bit)
+    void mov_mem_reg(X64Reg base, int32_t offset, X64Reg src);
+
+    // Get current position (for calculating branch offsets)
+    size_t get_position() const { return buffer.get_position(); }
+    
+    // Retarget the Jcc/JMP rel32 ending at jump_end to target
+    void patch_jump(size_t jump_end, size_t target);
+
+private:
+    CodeBuffer& buffer;
+
+    static uint8_t reg_num(X64Reg reg) {
+        return static_cast<uint8_t>(reg);
+    }
+
+    // REX prefix for a 32-bit operation, only when an extended register
+    // (R8-R15) is involved: reg goes in ModRM.reg, rm in ModRM.rm
+    void rex(uint8_t reg, uint8_t rm);
+
+    // opcode /r with both operands in registers
+    void op_reg_reg(uint8_t opcode, X64Reg reg, X64Reg rm);
+    
+    // 83 /ext ib or 81 /ext id on a register (ADD /0, AND /4, CMP /7)
+    void op_reg_imm(uint8_t ext, X64Reg rm, int32_t imm);
+
+    // opcode /r with a [base + offset] memory operand
+    void op_reg_mem(uint8_t opcode, X64Reg reg, X64Reg base, int32_t offset);
+};
+
+#endif // X64_ASSEMBLER_H
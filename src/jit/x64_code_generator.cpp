@@ -0,0 +1,294 @@
+#include "x64_code_generator.h"
+#include "../core/instruction_table.h"
+
+static const X64Reg HOST_POOL[] = {
+    X64Reg::RAX, X64Reg::RCX, X64Reg::RDX, X64Reg::R8,  X64Reg::R9,
+    X64Reg::RBX, X64Reg::RBP, X64Reg::R12, X64Reg::R13, X64Reg::R14, X64Reg::R15
+};
+static const X64Reg CALLEE_SAVED[] = {
+    X64Reg::RBX, X64Reg::RBP, X64Reg::R12, X64Reg::R13, X64Reg::R14, X64Reg::R15
+};
+static const X64Reg STATE = X64Reg::RDI;
+static const X64Reg FUEL = X64Reg::RSI;
+static const X64Reg SCRATCH1 = X64Reg::R10;
+static const X64Reg SCRATCH2 = X64Reg::R11;
+static const int32_t PC_OFFSET = NUM_REGISTERS * 4;
+
+size_t X64CodeGenerator::host_registers() const {
+    return sizeof(HOST_POOL) / sizeof(HOST_POOL[0]);
+}
+
+bool X64CodeGenerator::supports(const DecodedInstruction& inst) const {
+    switch (inst.op) {
+        case Operation::ADD:
+        case Operation::SUB:
+        case Operation::XOR:
+        case Operation::OR:
+        case Operation::AND:
+        case Operation::ADDI:
+        case Operation::BEQ:
+        case Operation::BNE:
+        case Operation::BLT:
+        case Operation::BGE:
+        case Operation::BLTU:
+        case Operation::BGEU:
+        case Operation::JAL:
+        case Operation::JALR:
+            return true;
+        default:
+            return false;
+    }
+}
+
+X64Reg X64CodeGenerator::host_reg(uint8_t riscv_reg) const {
+    return HOST_POOL[allocation.host[riscv_reg]];
+}
+
+X64Reg X64CodeGenerator::read_reg(uint8_t riscv_reg, X64Reg scratch) {
+    if (allocation.in_host(riscv_reg)) {
+        return host_reg(riscv_reg);
+    }
+    copy_reg(scratch, riscv_reg);
+    return scratch;
+}
+
+void X64CodeGenerator::copy_reg(X64Reg dst, uint8_t riscv_reg) {
+    if (riscv_reg == 0) {
+        asm_.xor_reg_reg(dst, dst);
+    } else if (!allocation.in_host(riscv_reg)) {
+        asm_.mov_reg_mem(dst, STATE, riscv_reg * 4);
+    } else if (host_reg(riscv_reg) != dst) {
+        asm_.mov_reg_reg(dst, host_reg(riscv_reg));
+    }
+}
+
+void X64CodeGenerator::write_reg(uint8_t riscv_reg, X64Reg value) {
+    if (!allocation.in_host(riscv_reg)) {
+        asm_.mov_mem_reg(STATE, riscv_reg * 4, value);
+    }
+}
+
+void X64CodeGenerator::write_reg_imm(uint8_t riscv_reg, uint32_t value) {
+    if (riscv_reg == 0) {
+        return;
+    }
+    X64Reg rd = allocation.in_host(riscv_reg) ? host_reg(riscv_reg) : SCRATCH2;
+    asm_.mov_reg_imm(rd, value);
+    write_reg(riscv_reg, rd);
+}
+
+void X64CodeGenerator::emit_stubs(const BlockTableEntry* table) {
+    // Exit: PC in R10D, registers already stored
+    exit_stub = asm_.get_position();
+    asm_.mov_mem_reg(STATE, PC_OFFSET, SCRATCH1);
+    asm_.mov_reg_reg(X64Reg::RAX, SCRATCH1);
+    for (size_t i = sizeof(CALLEE_SAVED) / sizeof(CALLEE_SAVED[0]); i-- > 0;) {
+        asm_.pop_reg(CALLEE_SAVED[i]);
+    }
+    asm_.ret();
+    
+    // Lookup: R11 = &table[block_table_slot(R10D)], chain to its block
+    // when it holds R10D, otherwise exit. The pool registers are free:
+    // exits have stored them.
+    lookup_stub = asm_.get_position();
+    asm_.mov_reg_reg(X64Reg::RAX, SCRATCH1);
+    asm_.and_reg_imm(X64Reg::RAX, static_cast<int32_t>((BLOCK_TABLE_SIZE - 1) << 2));
+    asm_.shl_reg_imm(X64Reg::RAX, 2);
+    asm_.mov_reg_imm64(SCRATCH2, reinterpret_cast<uint64_t>(table));
+    asm_.add_reg_reg64(SCRATCH2, X64Reg::RAX);
+    asm_.cmp_reg_mem(SCRATCH1, SCRATCH2, offsetof(BlockTableEntry, pc));
+    asm_.jcc(X64Cond::NE, 0);
+    asm_.patch_jump(asm_.get_position(), exit_stub);
+    asm_.jmp_mem(SCRATCH2, offsetof(BlockTableEntry, code));
+}
+
+void X64CodeGenerator::begin_block(const RegisterAllocation& block_allocation, uint32_t block_start,
+                                   uint32_t block_instructions) {
+    // RDI = guest state, RSI = fuel
+    allocation = block_allocation;
+    start_pc = block_start;
+    instructions = block_instructions;
+    jumped = false;
+    code = BlockCode{};
+    
+    // Entry: save the callee-saved registers for the exit stub to
+    // restore, then skip the chain entry's fuel check
+    code.entry = asm_.get_position();
+    for (X64Reg reg : CALLEE_SAVED) {
+        asm_.push_reg(reg);
+    }
+    asm_.jmp(0);
+    entry_jump = asm_.get_position();
+    
+    // Chain entry: *fuel -= instructions, if it covers them
+    code.chain = asm_.get_position();
+    asm_.mov_reg_mem(SCRATCH2, FUEL, 0);
+    asm_.cmp_reg_imm(SCRATCH2, static_cast<int32_t>(instructions));
+    asm_.jcc(X64Cond::B, 0);
+    exhausted = asm_.get_position();
+    asm_.add_reg_imm(SCRATCH2, -static_cast<int32_t>(instructions));
+    asm_.mov_mem_reg(FUEL, 0, SCRATCH2);
+    asm_.patch_jump(entry_jump, asm_.get_position());
+    
+    for (uint8_t i = 1; i < 32; i++) {
+        if (allocation.in_host(i) && allocation.is_loaded(i)) {
+            asm_.mov_reg_mem(host_reg(i), STATE, i * 4);
+        }
+    }
+    loop_top = asm_.get_position();
+}
+
+void X64CodeGenerator::emit(const DecodedInstruction& inst, uint32_t pc) {
+    X64Reg rd = allocation.in_host(inst.rd) ? host_reg(inst.rd) : SCRATCH1;
+    
+    switch (inst.op) {
+        case Operation::ADD:
+        case Operation::SUB:
+        case Operation::XOR:
+        case Operation::OR:
+        case Operation::AND: {
+            X64Reg rs2 = read_reg(inst.rs2, SCRATCH2);
+            
+            // Two-operand form: rd = rs1, then rd op= rs2. When rd is rs2
+            // (and not rs1) that would clobber rs2 first, so commutative
+            // operations apply rs1 instead and SUB becomes -rs2 + rs1.
+            if (rd == rs2 && inst.rs1 != inst.rs2) {
+                X64Reg rs1 = read_reg(inst.rs1, SCRATCH2);
+                switch (inst.op) {
+                    case Operation::ADD: asm_.add_reg_reg(rd, rs1); break;
+                    case Operation::SUB: asm_.neg_reg(rd); asm_.add_reg_reg(rd, rs1); break;
+                    case Operation::XOR: asm_.xor_reg_reg(rd, rs1); break;
+                    case Operation::OR:  asm_.or_reg_reg(rd, rs1); break;
+                    default:             asm_.and_reg_reg(rd, rs1); break;
+                }
+                break;
+            }
+            copy_reg(rd, inst.rs1);
+            switch (inst.op) {
+                case Operation::ADD: asm_.add_reg_reg(rd, rs2); break;
+                case Operation::SUB: asm_.sub_reg_reg(rd, rs2); break;
+                case Operation::XOR: asm_.xor_reg_reg(rd, rs2); break;
+                case Operation::OR:  asm_.or_reg_reg(rd, rs2); break;
+                default:             asm_.and_reg_reg(rd, rs2); break;
+            }
+            break;
+        }
+        
+        case Operation::ADDI: {
+            copy_reg(rd, inst.rs1);
+            if (inst.imm != 0) {
+                asm_.add_reg_imm(rd, inst.imm);
+            }
+            break;
+        }
+        
+        case Operation::BEQ:
+        case Operation::BNE:
+        case Operation::BLT:
+        case Operation::BGE:
+        case Operation::BLTU:
+        case Operation::BGEU: {
+            // Skip the taken path on the opposite condition; the fall
+            // through continues to end_block()'s exit
+            X64Cond skip;
+            switch (inst.op) {
+                case Operation::BEQ:  skip = X64Cond::NE; break;
+                case Operation::BNE:  skip = X64Cond::E; break;
+                case Operation::BLT:  skip = X64Cond::GE; break;
+                case Operation::BGE:  skip = X64Cond::L; break;
+                case Operation::BLTU: skip = X64Cond::AE; break;
+                default:              skip = X64Cond::B; break;
+            }
+            asm_.cmp_reg_reg(read_reg(inst.rs1, SCRATCH1), read_reg(inst.rs2, SCRATCH2));
+            asm_.jcc(skip, 0);
+            size_t not_taken = asm_.get_position();
+            jump_to(pc + inst.imm);
+            asm_.patch_jump(not_taken, asm_.get_position());
+            return;
+        }
+        
+        case Operation::JAL:
+            write_reg_imm(inst.rd, pc + 4);
+            jump_to(pc + inst.imm);
+            jumped = true;
+            return;
+        
+        case Operation::JALR:
+            // Target first: rd may be rs1
+            copy_reg(SCRATCH1, inst.rs1);
+            if (inst.imm != 0) {
+                asm_.add_reg_imm(SCRATCH1, inst.imm);
+            }
+            asm_.and_reg_imm(SCRATCH1, -2);
+            write_reg_imm(inst.rd, pc + 4);
+            store_registers();
+            jmp_to(lookup_stub);
+            jumped = true;
+            return;
+        
+        default:
+            return;
+    }
+    write_reg(inst.rd, rd);
+}
+
+void X64CodeGenerator::store_registers() {
+    for (uint8_t i = 1; i < 32; i++) {
+        if (allocation.in_host(i) && allocation.is_stored(i)) {
+            asm_.mov_mem_reg(STATE, i * 4, host_reg(i));
+        }
+    }
+}
+
+void X64CodeGenerator::jmp_to(size_t target) {
+    asm_.jmp(0);
+    asm_.patch_jump(asm_.get_position(), target);
+}
+
+void X64CodeGenerator::exit_to(uint32_t target) {
+    store_registers();
+    asm_.mov_reg_imm(SCRATCH1, target);
+    code.exits.push_back(BlockExit{asm_.get_position(), target});
+    jmp_to(lookup_stub);
+}
+
+void X64CodeGenerator::jump_to(uint32_t target) {
+    if (target == start_pc) {
+        // *fuel -= instructions and go round again, if it covers a pass;
+        // otherwise return to the caller, which cannot run the block
+        // either
+        asm_.mov_reg_mem(SCRATCH2, FUEL, 0);
+        asm_.cmp_reg_imm(SCRATCH2, static_cast<int32_t>(instructions));
+        asm_.jcc(X64Cond::B, 0);
+        size_t loop_exhausted = asm_.get_position();
+        asm_.add_reg_imm(SCRATCH2, -static_cast<int32_t>(instructions));
+        asm_.mov_mem_reg(FUEL, 0, SCRATCH2);
+        jmp_to(loop_top);
+        asm_.patch_jump(loop_exhausted, asm_.get_position());
+        store_registers();
+        asm_.mov_reg_imm(SCRATCH1, target);
+        jmp_to(exit_stub);
+        return;
+    }
+    exit_to(target);
+}
+
+BlockCode X64CodeGenerator::end_block(uint32_t next_pc) {
+    if (!jumped) {
+        exit_to(next_pc);
+    }
+    
+    // Out of fuel at the chain entry: nothing loaded yet
+    asm_.patch_jump(exhausted, asm_.get_position());
+    asm_.mov_reg_imm(SCRATCH1, start_pc);
+    jmp_to(exit_stub);
+    return code;
+}
+
+void X64CodeGenerator::link_exit(size_t jump, size_t chain) {
+    asm_.patch_jump(jump + 5, chain);
+}
+
+void X64CodeGenerator::unlink_exit(size_t jump) {
+    asm_.patch_jump(jump + 5, lookup_stub);
+}
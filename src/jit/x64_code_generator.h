@@ -0,0 +1,70 @@
+#ifndef X64_CODE_GENERATOR_H
+#define X64_CODE_GENERATOR_H
+
+#include "code_generator.h"
+#include "x64_assembler.h"
+
+// x86-64 blocks (System V calling convention). RDI holds the guest state
+// pointer and RSI the fuel pointer. Allocated guest registers live in
+// EAX, ECX, EDX, R8D and R9D (caller-saved) and then EBX, EBP and
+// R12D-R15D: a block's entry pushes all six callee-saved registers and
+// the shared exit stub pops them, so chained blocks share one frame.
+// R10D and R11D are scratch for spilled operands; R10D carries the next
+// PC to an exit.
+class X64CodeGenerator : public CodeGenerator {
+public:
+    explicit X64CodeGenerator(CodeBuffer& buffer) : asm_(buffer) {}
+
+    JITBackend backend() const override { return JITBackend::X86_64; }
+    size_t host_registers() const override;
+    bool supports(const DecodedInstruction& inst) const override;
+    void emit_stubs(const BlockTableEntry* table) override;
+    void begin_block(const RegisterAllocation& allocation, uint32_t start_pc, uint32_t instructions) override;
+    void emit(const DecodedInstruction& inst, uint32_t pc) override;
+    BlockCode end_block(uint32_t next_pc) override;
+    void link_exit(size_t jump, size_t chain) override;
+    void unlink_exit(size_t jump) override;
+
+private:
+    X64Assembler asm_;
+    size_t exit_stub = 0;       // Store the PC in R10D, pop, return it
+    size_t lookup_stub = 0;     // Chain to the table's block for R10D
+    RegisterAllocation allocation;
+    BlockCode code;
+    uint32_t start_pc = 0;
+    uint32_t instructions = 0;
+    size_t entry_jump = 0;      // From the entry over the chain check
+    size_t exhausted = 0;       // Chain check's jump when out of fuel
+    size_t loop_top = 0;        // Code after the entry loads
+    bool jumped = false;        // Block ended with a jump
+
+    X64Reg host_reg(uint8_t riscv_reg) const;
+
+    // Register holding guest riscv_reg: its host register, or scratch
+    // loaded with it (zeroed for x0)
+    X64Reg read_reg(uint8_t riscv_reg, X64Reg scratch);
+
+    // dst = guest riscv_reg
+    void copy_reg(X64Reg dst, uint8_t riscv_reg);
+
+    // Store value to a spilled rd; allocated ones are stored at the exits
+    void write_reg(uint8_t riscv_reg, X64Reg value);
+
+    // rd = value for JAL/JALR links (nothing for x0)
+    void write_reg_imm(uint8_t riscv_reg, uint32_t value);
+
+    // Store the allocated registers the block wrote
+    void store_registers();
+
+    // JMP rel32 to the buffer offset target
+    void jmp_to(size_t target);
+
+    // Leave the block for guest target through a linkable exit
+    void exit_to(uint32_t target);
+
+    // Continue at guest target: loop back for the block's own start
+    // while fuel lasts, otherwise exit
+    void jump_to(uint32_t target);
+};
+
+#endif // X64_CODE_GENERATOR_H
@@ -0,0 +1,125 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+// Runs the same program block-at-a-time (with superinstructions) and
+// single-stepped, and checks both end in the same state.
+
+static const std::vector<uint32_t> kProgram = {
+    0x12345537,  // LUI  a0, 0x12345        # LUI+ADDI  -> li a0, 0x12345678
+    0x67850513,  // ADDI a0, a0, 0x678
+    0x00000593,  // ADDI a1, zero, 0
+    0x00000613,  // ADDI a2, zero, 0
+    0x00C585B3,  // loop: ADD a1, a1, a2
+    0x00160613,  // ADDI a2, a2, 1
+    0x00A00293,  // ADDI t0, zero, 10       # ADDI+BNE loop tail
+    0xFE561AE3,  // BNE  a2, t0, loop
+    0x00000097,  // AUIPC ra, 0             # AUIPC+JALR call
+    0x010080E7,  // JALR ra, 16(ra)
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073,  // ECALL                   # exit
+    0x06458693,  // func: ADDI a3, a1, 100
+    0x00008067   // JALR zero, 0(ra)
+};
+
+// AUIPC into x0 followed by a JALR through x0: the jump is absolute
+// (to 0x100), not PC-relative, so the pair must not be fused
+static const std::vector<uint32_t> kZeroBaseProgram = {
+    0x00150513,  // 0x100: ADDI a0, a0, 1
+    0x00300293,  //        ADDI t0, zero, 3
+    0x00550663,  //        BEQ  a0, t0, done
+    0x00001017,  //        AUIPC zero, 0x1
+    0x100000E7,  //        JALR ra, 0x100(zero)
+    0x05D00893,  // done:  ADDI a7, zero, 93
+    0x00000073   //        ECALL
+};
+
+static void load(CPU& cpu, const std::vector<uint32_t>& program = kProgram, uint32_t base = 0x1000) {
+    cpu.load_program(to_bytes(program), base);
+}
+
+int main() {
+    std::cout << "=== RISC-V Basic Block Test ===" << std::endl;
+
+    CPU block_cpu;
+    Interpreter block_interp(block_cpu);
+    load(block_cpu);
+    ExecResult block_result = block_interp.run(1000);
+
+    CPU step_cpu;
+    Interpreter step_interp(step_cpu);
+    load(step_cpu);
+    ExecResult step_result{};
+    for (int i = 0; i < 1000; i++) {
+        step_result = step_interp.step();
+        if (step_result.reason != StopReason::NONE) {
+            break;
+        }
+    }
+
+    bool ok = true;
+    for (uint8_t reg = 0; reg < NUM_REGISTERS; reg++) {
+        if (block_cpu.get_register(reg) != step_cpu.get_register(reg)) {
+            std::cout << "x" << static_cast<int>(reg) << " differs: block=0x" << std::hex
+                      << block_cpu.get_register(reg) << " step=0x" << step_cpu.get_register(reg)
+                      << std::dec << std::endl;
+            ok = false;
+        }
+    }
+
+    std::cout << "a0 = 0x" << std::hex << block_cpu.get_register(10) << std::dec
+              << " (expected 0x12345678)" << std::endl;
+    std::cout << "a1 = " << block_cpu.get_register(11) << " (expected 45)" << std::endl;
+    std::cout << "a3 = " << block_cpu.get_register(13) << " (expected 145)" << std::endl;
+    ok = ok && block_cpu.get_register(10) == 0x12345678 &&
+         block_cpu.get_register(11) == 45 && block_cpu.get_register(13) == 145;
+
+    std::cout << "Stop: block=" << stop_reason_name(block_result.reason) << " (exit "
+              << block_result.exit_code << "), step=" << stop_reason_name(step_result.reason)
+              << " (exit " << step_result.exit_code << ")" << std::endl;
+    ok = ok && block_result.reason == StopReason::EXIT && step_result.reason == StopReason::EXIT &&
+         block_result.exit_code == 0x12345678 && step_result.exit_code == 0x12345678;
+
+    std::cout << "PC: block=0x" << std::hex << block_cpu.get_pc()
+              << " step=0x" << step_cpu.get_pc() << std::dec << std::endl;
+    ok = ok && block_cpu.get_pc() == step_cpu.get_pc();
+
+    std::cout << "Instructions: block=" << block_interp.get_instructions_executed()
+              << " step=" << step_interp.get_instructions_executed() << std::endl;
+    ok = ok && block_interp.get_instructions_executed() == step_interp.get_instructions_executed();
+    ok = ok && block_interp.get_profiler().get_total_instructions() ==
+               block_interp.get_instructions_executed();
+
+    std::cout << "Blocks built: " << block_interp.get_block_cache().get_block_count()
+              << ", fused pairs: " << block_interp.get_block_cache().get_fused_pairs() << std::endl;
+    // Entry block: LUI+ADDI and ADDI+BNE; loop block: ADDI+BNE; AUIPC+JALR
+    ok = ok && block_interp.get_block_cache().get_fused_pairs() == 4;
+
+    // Budget must stay exact even when it ends inside a block
+    CPU budget_cpu;
+    Interpreter budget_interp(budget_cpu);
+    load(budget_cpu);
+    ExecResult budget_result = budget_interp.run(7);
+    std::cout << "Budget of 7 executed " << budget_result.instructions_retired
+              << " (" << stop_reason_name(budget_result.reason) << ")" << std::endl;
+    ok = ok && budget_result.instructions_retired == 7 &&
+         budget_result.reason == StopReason::INSTRUCTION_LIMIT;
+
+    CPU zero_cpu;
+    Interpreter zero_interp(zero_cpu);
+    load(zero_cpu, kZeroBaseProgram, 0x100);
+    ExecResult zero_result = zero_interp.run(1000);
+    std::cout << "AUIPC/JALR through x0: " << stop_reason_name(zero_result.reason) << " (exit "
+              << zero_result.exit_code << ", expected 3), fused pairs: "
+              << zero_interp.get_block_cache().get_fused_pairs() << std::endl;
+    ok = ok && zero_result.reason == StopReason::EXIT && zero_result.exit_code == 3;
+
+    if (ok) {
+        std::cout << "\n✅ Block execution matches single-stepping!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Block execution diverged" << std::endl;
+    return 1;
+}
@@ -0,0 +1,172 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "branch_predictor.h"
+#include "timing_model.h"
+#include "test_util.h"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Branch simulation: predictors and the return-address stack on their
+// own, then a loop with an alternating branch and two calls, whose
+// predictions must come out the same in block and single-step execution
+// and turn into the expected pipeline cycles.
+
+static const std::vector<uint32_t> kProgram = {
+    0x06400413,  // ADDI s0, zero, 100
+    0x00000313,  // ADDI t1, zero, 0
+    0x00134313,  // loop: XORI t1, t1, 1
+    0x00030463,  // BEQ  t1, zero, skip     # taken every other iteration
+    0x00138393,  // ADDI t2, t2, 1
+    0xFFF40413,  // skip: ADDI s0, s0, -1
+    0xFE0418E3,  // BNE  s0, zero, loop
+    0x010000EF,  // JAL  ra, func
+    0x00C000EF,  // JAL  ra, func
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073,  // ECALL                    # exit
+    0x00008067   // func: JALR zero, 0(ra)
+};
+
+static constexpr uint32_t kAlternating = 0x100C;
+static constexpr uint32_t kLoopBranch = 0x1018;
+
+static std::unique_ptr<BranchPredictor> make_predictor(int kind) {
+    switch (kind) {
+        case 0:  return std::make_unique<StaticPredictor>();
+        case 1:  return std::make_unique<BimodalPredictor>();
+        case 2:  return std::make_unique<GSharePredictor>();
+        default: return std::make_unique<TournamentPredictor>();
+    }
+}
+
+// Mispredictions of a branch at pc alternating taken and not taken
+static uint64_t alternating_misses(BranchPredictor& predictor, int iterations) {
+    uint64_t misses = 0;
+    for (int i = 0; i < iterations; i++) {
+        bool taken = i % 2 == 1;
+        misses += predictor.predict(0x100, 0x80) != taken;
+        predictor.update(0x100, 0x80, taken);
+    }
+    return misses;
+}
+
+int main() {
+    std::cout << "=== RISC-V Branch Predictor Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[Predictors]" << std::endl;
+    {
+        StaticPredictor fixed;
+        ok &= check(fixed.predict(0x100, 0x80) && !fixed.predict(0x100, 0x180), "static: backward taken, forward not");
+
+        BimodalPredictor bimodal;
+        bimodal.update(0x100, 0x80, true);
+        ok &= check(bimodal.predict(0x100, 0x80) && !bimodal.predict(0x104, 0x80), "bimodal learns per PC");
+
+        BimodalPredictor bimodal_alternating;
+        GSharePredictor gshare;
+        TournamentPredictor tournament;
+        ok &= check(alternating_misses(bimodal_alternating, 100) >= 50, "bimodal cannot learn alternation");
+        ok &= check(alternating_misses(gshare, 100) < 10, "gshare learns alternation from history");
+        ok &= check(alternating_misses(tournament, 100) < 20, "tournament switches to gshare");
+        gshare.reset();
+        ok &= check(!gshare.predict(0x100, 0x80), "reset forgets");
+
+        ReturnAddressStack ras(2);
+        uint32_t target = 0;
+        ras.push(0x10);
+        ras.push(0x20);
+        ras.push(0x30);  // Overwrites 0x10
+        bool first = ras.pop(target) && target == 0x30;
+        bool second = ras.pop(target) && target == 0x20;
+        ok &= check(first && second && !ras.pop(target), "return-address stack keeps the newest entries");
+    }
+
+    std::cout << "\n[Program]" << std::endl;
+    uint64_t reference_cycles = 0;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.set_timing_model(std::make_unique<PipelineModel>());
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        ok &= check(interp.run().reason == StopReason::EXIT, "runs without a simulator");
+        reference_cycles = interp.get_cycles();
+    }
+
+    const char* predictor_names[] = {"static", "bimodal", "gshare", "tournament"};
+    for (int kind = 0; kind < 4; kind++) {
+        std::vector<BranchStats> conditional;
+        for (int mode = 0; mode < 3; mode++) {
+            const char* mode_name[] = {"run", "run, no fusion", "step"};
+            std::cout << "\n[" << predictor_names[kind] << ", " << mode_name[mode] << "]" << std::endl;
+            CPU cpu;
+            Interpreter interp(cpu);
+            interp.get_block_cache().set_fusion_enabled(mode != 1);
+            interp.set_timing_model(std::make_unique<PipelineModel>());
+            interp.set_branch_simulator(std::make_unique<BranchSimulator>(make_predictor(kind)));
+            cpu.load_program(to_bytes(kProgram), 0x1000);
+            ExecResult result;
+            if (mode == 2) {
+                do {
+                    result = interp.step();
+                } while (result.reason == StopReason::NONE);
+            } else {
+                result = interp.run();
+            }
+
+            const BranchSimulator& simulator = *interp.get_branch_simulator();
+            ok &= check(result.reason == StopReason::EXIT && std::string(simulator.get_predictor().name()) ==
+                        predictor_names[kind], "program ran");
+            ok &= check(simulator.get_conditional().executed == 200, "every conditional branch predicted");
+            ok &= check(simulator.get_returns().executed == 2 && simulator.get_returns().mispredicted == 0,
+                        "returns predicted by the stack");
+            ok &= check(simulator.get_indirect().executed == 0, "no indirect jumps");
+
+            const auto& sites = simulator.get_sites();
+            ok &= check(sites.size() == 3 && sites.at(kAlternating).taken == 50 && sites.at(kLoopBranch).taken == 99,
+                        "outcomes by PC");
+            uint64_t alternating = sites.at(kAlternating).mispredicted;
+            uint64_t loop = sites.at(kLoopBranch).mispredicted;
+            if (kind == 0) {
+                ok &= check(alternating == 50 && loop == 1, "static: forward branch misses when taken, loop exit misses");
+            } else if (kind == 1) {
+                ok &= check(alternating >= 49 && loop <= 3, "bimodal: alternation defeats it, loop does not");
+            } else {
+                ok &= check(alternating < 20, "history learns alternation");
+            }
+
+            // Correct predictions save the pipeline's redirect penalty
+            // over static not-taken fetch: 149 taken branches, 2 returns
+            PipelineConfig config;
+            uint64_t saved = config.branch_taken * (149 - simulator.get_conditional().mispredicted) +
+                             config.jalr * 2;
+            ok &= check(interp.get_cycles() == reference_cycles - saved, "mispredictions priced into cycles");
+            conditional.push_back(simulator.get_conditional());
+        }
+        ok &= check(conditional[0].mispredicted == conditional[1].mispredicted &&
+                    conditional[0].mispredicted == conditional[2].mispredicted, "run and step agree");
+    }
+
+    std::cout << "\n[Reset]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.set_branch_simulator(std::make_unique<BranchSimulator>());
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        interp.run();
+        interp.get_branch_simulator()->reset();
+        ok &= check(interp.get_branch_simulator()->get_total().executed == 0 &&
+                    interp.get_branch_simulator()->get_sites().empty(), "statistics cleared");
+        interp.set_branch_simulator(nullptr);
+        cpu.set_pc(0x1000);
+        ok &= check(interp.run().reason == StopReason::EXIT, "runs detached");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Branch predictors score the expected mispredictions!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Branch predictor test failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,142 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "cache_simulator.h"
+#include "test_util.h"
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+// Cache simulator: replacement policies on a single set, then a program
+// storing to 64 consecutive lines twice, whose misses must come out the
+// same in block and single-step execution, with and without
+// superinstructions, and land on the store's PC.
+
+static const std::vector<uint32_t> kProgram = {
+    0x00200493,  // ADDI s1, zero, 2
+    0x00010437,  // outer: LUI s0, 0x10
+    0x04000293,  // ADDI t0, zero, 64
+    0x00542023,  // inner: SW t0, 0(s0)
+    0x04040413,  // ADDI s0, s0, 64
+    0xFFF28293,  // ADDI t0, t0, -1
+    0xFE029AE3,  // BNE  t0, zero, inner
+    0xFFF48493,  // ADDI s1, s1, -1
+    0xFE0492E3,  // BNE  s1, zero, outer
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                    # exit
+};
+
+// Misses of A B A C A on one two-way set
+static uint64_t two_way_misses(ReplacementPolicy policy) {
+    Cache cache("test", {32, 2, 16, policy});
+    for (uint32_t addr : {0x000u, 0x100u, 0x000u, 0x200u, 0x000u}) {
+        cache.access(addr);
+    }
+    return cache.get_stats().misses;
+}
+
+int main() {
+    std::cout << "=== RISC-V Cache Simulator Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[Single cache]" << std::endl;
+    {
+        Cache direct("direct", {256, 1, 16, ReplacementPolicy::LRU});
+        for (int i = 0; i < 4; i++) {
+            direct.access(0x000);
+            direct.access(0x100);  // Same set
+        }
+        direct.access(0x104);      // Same line as 0x100
+        ok &= check(direct.get_stats().accesses == 9 && direct.get_stats().misses == 8, "direct-mapped conflicts");
+        ok &= check(two_way_misses(ReplacementPolicy::LRU) == 3, "LRU keeps the recently used line");
+        ok &= check(two_way_misses(ReplacementPolicy::FIFO) == 4, "FIFO evicts the oldest fill");
+        uint64_t random = two_way_misses(ReplacementPolicy::RANDOM);
+        ok &= check(random == 3 || random == 4, "random evicts one of the two");
+
+        bool threw = false;
+        try {
+            Cache bad("bad", {3000, 4, 64, ReplacementPolicy::LRU});
+        } catch (const std::invalid_argument&) {
+            threw = true;
+        }
+        ok &= check(threw, "invalid geometry rejected");
+
+        CacheSimulator simulator;
+        simulator.data_access(0x2000, 0x103E, 4);
+        ok &= check(simulator.get_dcache().get_stats().accesses == 2 &&
+                    simulator.get_misses().at(0x2000).data == 2, "straddling access touches two lines");
+    }
+
+    for (int mode = 0; mode < 3; mode++) {
+        const char* mode_name[] = {"run", "run, no fusion", "step"};
+        for (bool small : {false, true}) {
+            std::cout << "\n[" << (small ? "1 KB direct-mapped L1D" : "Default caches") << ", "
+                      << mode_name[mode] << "]" << std::endl;
+            CacheHierarchyConfig config;
+            if (small) {
+                config.dcache = {1024, 1, 64, ReplacementPolicy::LRU};
+            }
+            CPU cpu;
+            Interpreter interp(cpu);
+            interp.get_block_cache().set_fusion_enabled(mode != 1);
+            interp.set_cache_simulator(std::make_unique<CacheSimulator>(config));
+            cpu.load_program(to_bytes(kProgram), 0x1000);
+            ExecResult result;
+            if (mode == 2) {
+                do {
+                    result = interp.step();
+                } while (result.reason == StopReason::NONE);
+            } else {
+                result = interp.run();
+            }
+
+            const CacheSimulator& simulator = *interp.get_cache_simulator();
+            const CacheStats& icache = simulator.get_icache().get_stats();
+            const CacheStats& dcache = simulator.get_dcache().get_stats();
+            const CacheStats& l2 = simulator.get_l2()->get_stats();
+            ok &= check(result.reason == StopReason::EXIT && interp.get_instructions_executed() == 523,
+                        "program ran");
+            ok &= check(icache.accesses == 523 && icache.misses == 1, "one fetch per instruction, code fits a line");
+            ok &= check(dcache.accesses == 128 && dcache.misses == (small ? 128u : 64u),
+                        small ? "second pass misses again in L1" : "second pass hits in L1");
+            ok &= check(l2.accesses == 1 + dcache.misses && l2.misses == 65, "L2 holds both passes");
+
+            const auto& misses = simulator.get_misses();
+            ok &= check(misses.size() == 2 && misses.at(0x1000).instruction == 1 &&
+                        misses.at(0x100C).data == dcache.misses && misses.at(0x100C).l2 == 64,
+                        "misses by PC");
+
+            SymbolTable symbols;
+            symbols.add(0x1000, 0x0C, "setup");
+            symbols.add(0x100C, 0x20, "fill");
+            symbols.finalize();
+            auto functions = simulator.get_function_misses(symbols);
+            ok &= check(functions.size() == 2 && functions[0].first == "fill" &&
+                        functions[0].second.data == dcache.misses && functions[1].first == "setup" &&
+                        functions[1].second.instruction == 1, "misses by function");
+        }
+    }
+
+    std::cout << "\n[Reset]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.set_cache_simulator(std::make_unique<CacheSimulator>());
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        interp.run();
+        interp.get_cache_simulator()->reset();
+        cpu.set_pc(0x1000);
+        interp.run();
+        ok &= check(interp.get_cache_simulator()->get_dcache().get_stats().misses == 64, "cold again after reset");
+        interp.set_cache_simulator(nullptr);
+        cpu.set_pc(0x1000);
+        ok &= check(interp.run().reason == StopReason::EXIT, "runs detached");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Cache simulator counts the expected misses!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Cache simulator test failed" << std::endl;
+    return 1;
+}
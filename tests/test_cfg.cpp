@@ -0,0 +1,171 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "control_flow.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+// Control-flow graph rebuilt from block and edge profiles: a nested loop
+// must give the same blocks, edges, dominators and natural loops whether
+// it ran in blocks or one step at a time, and a loop around a call into
+// code outside the text range must still be found.
+
+// 10 outer iterations of 5 inner ones
+static const std::vector<uint32_t> kNested = {
+    0x00000513,  // ADDI a0, zero, 0
+    0x00000293,  // ADDI t0, zero, 0
+    0x00A00393,  // ADDI t2, zero, 10
+    0x00000313,  // outer: ADDI t1, zero, 0
+    0x00500E13,  // ADDI t3, zero, 5
+    0x00150513,  // inner: ADDI a0, a0, 1
+    0x00130313,  // ADDI t1, t1, 1
+    0xFFC34CE3,  // BLT  t1, t3, inner
+    0x00128293,  // ADDI t0, t0, 1
+    0xFE72C4E3,  // BLT  t0, t2, outer
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit
+};
+
+// 10 calls to a routine at 0x8000, outside the text range
+static const std::vector<uint32_t> kCallLoop = {
+    0x00A00513,  // ADDI a0, zero, 10
+    0x7FD060EF,  // loop: JAL ra, 0x8000
+    0xFFF50513,  // ADDI a0, a0, -1
+    0xFE051CE3,  // BNE  a0, zero, loop
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit
+};
+
+static const std::vector<uint32_t> kRoutine = {
+    0x00158593,  // ADDI a1, a1, 1
+    0x00008067   // RET
+};
+
+static ExecResult run(Interpreter& interp, bool single_step) {
+    ExecResult result;
+    if (single_step) {
+        do {
+            result = interp.step();
+        } while (result.reason == StopReason::NONE);
+    } else {
+        result = interp.run();
+    }
+    return result;
+}
+
+static const CFGEdge* find_edge(const ControlFlowGraph& cfg, uint32_t from, uint32_t to) {
+    const std::vector<CFGBlock>& blocks = cfg.get_blocks();
+    for (const CFGEdge& edge : cfg.get_edges()) {
+        if (blocks[edge.from].start == from && blocks[edge.to].start == to) {
+            return &edge;
+        }
+    }
+    return nullptr;
+}
+
+static bool edge_is(const ControlFlowGraph& cfg, uint32_t from, uint32_t to, uint64_t count, bool taken,
+                    bool back_edge) {
+    const CFGEdge* edge = find_edge(cfg, from, to);
+    return edge && edge->count == count && edge->taken == taken && edge->back_edge == back_edge;
+}
+
+int main() {
+    std::cout << "=== RISC-V Control-Flow Graph Test ===" << std::endl;
+    bool ok = true;
+
+    for (bool single_step : {false, true}) {
+        std::cout << "\n[Nested loop, " << (single_step ? "step" : "run") << "]" << std::endl;
+        CPU cpu;
+        Interpreter interp(cpu);
+        cpu.load_program(to_bytes(kNested), 0x1000);
+        ExecResult result = run(interp, single_step);
+        ok &= check(result.reason == StopReason::EXIT && interp.get_profiler().get_total_instructions() == 195,
+                    "program ran");
+
+        ControlFlowGraph cfg(interp.get_profiler());
+        const std::vector<CFGBlock>& blocks = cfg.get_blocks();
+        const uint32_t starts[] = {0x1000, 0x100C, 0x1014, 0x1020, 0x1028};
+        const uint32_t lengths[] = {3, 2, 3, 2, 2};
+        const uint64_t counts[] = {1, 10, 50, 10, 1};
+        bool shape = blocks.size() == 5;
+        for (size_t i = 0; shape && i < 5; i++) {
+            shape &= blocks[i].start == starts[i] && blocks[i].instruction_count == lengths[i] &&
+                     blocks[i].count == counts[i];
+        }
+        ok &= check(shape, "blocks split at branches and targets");
+
+        ok &= check(cfg.get_edges().size() == 6 &&
+                    edge_is(cfg, 0x1000, 0x100C, 1, false, false) &&
+                    edge_is(cfg, 0x100C, 0x1014, 10, false, false) &&
+                    edge_is(cfg, 0x1014, 0x1014, 40, true, true) &&
+                    edge_is(cfg, 0x1014, 0x1020, 10, false, false) &&
+                    edge_is(cfg, 0x1020, 0x100C, 9, true, true) &&
+                    edge_is(cfg, 0x1020, 0x1028, 1, false, false),
+                    "taken, fall-through and back edges");
+
+        ok &= check(cfg.dominates(1, 3) && cfg.dominates(2, 3) && !cfg.dominates(3, 2) && cfg.dominates(0, 4),
+                    "dominators");
+        ok &= check(cfg.find_block(0x1018) == &blocks[2] && cfg.find_block(0x1030) == nullptr,
+                    "block lookup");
+
+        const std::vector<NaturalLoop>& loops = cfg.get_loops();
+        ok &= check(loops.size() == 2, "two loops");
+        if (loops.size() == 2) {
+            const NaturalLoop& outer = loops[0];
+            const NaturalLoop& inner = loops[1];
+            ok &= check(outer.header == 0x100C && outer.depth == 1 &&
+                        outer.blocks == std::vector<uint32_t>{0x100C, 0x1014, 0x1020} &&
+                        outer.iterations == 9 && outer.entries == 1 && outer.average_trip_count() == 10.0 &&
+                        outer.instructions == 190, "outer loop");
+            ok &= check(inner.header == 0x1014 && inner.depth == 2 && inner.blocks == std::vector<uint32_t>{0x1014} &&
+                        inner.iterations == 40 && inner.entries == 10 && inner.average_trip_count() == 5.0 &&
+                        inner.instructions == 150, "inner loop");
+        }
+
+        ok &= check(cfg.hot_blocks(10) == std::vector<uint32_t>{0x100C, 0x1014, 0x1020}, "hot blocks, outer loop");
+        ok &= check(cfg.hot_blocks(20) == std::vector<uint32_t>{0x1014}, "hot blocks, inner loop only");
+        ok &= check(cfg.hot_blocks(100).empty(), "nothing above a high threshold");
+        ok &= check(interp.get_profiler().detect_hot_loops(20) == std::vector<uint32_t>{0x1014},
+                    "profiler hot loop headers");
+    }
+
+    for (bool text_range : {true, false}) {
+        std::cout << "\n[Loop around a call, " << (text_range ? "text range" : "fallback only") << "]"
+                  << std::endl;
+        CPU cpu;
+        Interpreter interp(cpu);
+        std::vector<uint8_t> routine = to_bytes(kRoutine);
+        cpu.write_bytes(0x8000, routine.data(), routine.size());
+        cpu.load_program(to_bytes(kCallLoop), 0x1000);
+        if (!text_range) {
+            cpu.set_text_range(0, 0);
+        }
+        interp.run();
+
+        ControlFlowGraph cfg(interp.get_profiler());
+        ok &= check(edge_is(cfg, 0x1004, 0x8000, 10, true, false) && edge_is(cfg, 0x8000, 0x1008, 10, true, false),
+                    "call and return edges");
+        const std::vector<NaturalLoop>& loops = cfg.get_loops();
+        ok &= check(loops.size() == 1 && loops[0].header == 0x1004 &&
+                    loops[0].blocks == std::vector<uint32_t>{0x1004, 0x1008, 0x8000} &&
+                    loops[0].iterations == 9 && loops[0].entries == 1, "loop body includes the routine");
+    }
+
+    std::cout << "\n[Sampled profile]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        cpu.load_program(to_bytes(kNested), 0x1000);
+        interp.get_profiler().set_sampling(4);
+        interp.run();
+        ControlFlowGraph cfg(interp.get_profiler());
+        ok &= check(cfg.get_blocks().empty() && cfg.get_loops().empty(), "no graph from estimates");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Control-flow graph matches the program!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Control-flow graph test failed" << std::endl;
+    return 1;
+}
@@ -1,6 +1,7 @@
 #include "cpu.h"
 #include "interpreter.h"
 #include "decoder.h"
+#include "disassembler.h"
 #include "elf_loader.h"
 #include <iostream>
 #include <iomanip>
@@ -27,7 +28,8 @@ int main(int argc, char** argv) {
             
             std::cout << "\n[" << i << "] PC: 0x" << std::hex << pc 
                       << " | Inst: 0x" << std::setw(8) << std::setfill('0') << raw_inst 
-                      << std::dec << std::setfill(' ') << std::endl;
+                      << std::dec << std::setfill(' ')
+                      << " | " << Disassembler::disassemble(raw_inst, pc) << std::endl;
             
             try {
                 Instruction decoded = Decoder::decode(raw_inst);
@@ -36,13 +38,21 @@ int main(int argc, char** argv) {
                           << " | rd: x" << std::dec << static_cast<int>(decoded.rd)
                           << " | rs1: x" << static_cast<int>(decoded.rs1)
                           << " | imm: " << decoded.imm << std::endl;
-                
-                interp.step();
-                
-                std::cout << "    a0: " << cpu.get_register(10)
-                          << " | a1: " << cpu.get_register(11) << std::endl;
             } catch (const std::exception& e) {
                 std::cout << "    ERROR: " << e.what() << std::endl;
+            }
+            
+            ExecResult result = interp.step();
+            
+            std::cout << "    a0: " << cpu.get_register(10)
+                      << " | a1: " << cpu.get_register(11) << std::endl;
+            
+            if (result.reason != StopReason::NONE) {
+                std::cout << "    STOP: " << stop_reason_name(result.reason);
+                if (result.reason == StopReason::EXIT) {
+                    std::cout << " (exit code " << result.exit_code << ")";
+                }
+                std::cout << std::endl;
                 break;
             }
         }
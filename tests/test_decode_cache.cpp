@@ -0,0 +1,67 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+int main() {
+    std::cout << "=== RISC-V Decode Cache Test ===" << std::endl;
+
+    CPU cpu;
+    Interpreter interp(cpu);
+
+    // Self-modifying program: the first pass executes ADDI x3, x0, 1,
+    // then stores ADDI x3, x0, 42 over it and jumps back.
+    std::vector<uint32_t> program = {
+        0x00001337,  // LUI  x6, 1            # x6 = 0x1000
+        0x02A002B7,  // LUI  x5, 0x2A00
+        0x19328293,  // ADDI x5, x5, 403      # x5 = 0x02A00193
+        0x00100193,  // ADDI x3, x0, 1        # patched below
+        0x00021863,  // BNE  x4, x0, 16
+        0x00532623,  // SW   x5, 12(x6)
+        0x00100213,  // ADDI x4, x0, 1
+        0xFF1FF06F   // JAL  x0, -16
+    };
+
+    cpu.load_program(to_bytes(program), 0x1000);
+
+    // First pass through the patched instruction
+    for (int i = 0; i < 4; i++) {
+        interp.step();
+    }
+    std::cout << "x3 after first pass = " << cpu.get_register(3) << " (expected 1)" << std::endl;
+    bool ok = cpu.get_register(3) == 1;
+
+    // Store, jump back and re-execute the patched slot
+    for (int i = 0; i < 5; i++) {
+        interp.step();
+    }
+    std::cout << "x3 after self-modification = " << cpu.get_register(3) << " (expected 42)" << std::endl;
+    ok = ok && cpu.get_register(3) == 42;
+
+    std::cout << "Decodes: " << interp.get_decode_cache().get_decodes()
+              << " for " << interp.get_instructions_executed() << " instructions" << std::endl;
+
+    // Host-side writes invalidate too
+    cpu.write_word(0x100C, 0x00700193);  // ADDI x3, x0, 7
+    cpu.set_pc(0x100C);
+    interp.step();
+    std::cout << "x3 after host patch = " << cpu.get_register(3) << " (expected 7)" << std::endl;
+    ok = ok && cpu.get_register(3) == 7;
+
+    // Same program through the block loop: the store lands in the block
+    // that is executing, which must be abandoned and rebuilt
+    CPU block_cpu;
+    Interpreter block_interp(block_cpu);
+    block_cpu.load_program(to_bytes(program), 0x1000);
+    block_interp.run(100);
+    std::cout << "x3 after block-mode run = " << block_cpu.get_register(3) << " (expected 42)" << std::endl;
+    ok = ok && block_cpu.get_register(3) == 42;
+
+    if (ok) {
+        std::cout << "\n✅ Decode cache invalidation works!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Decode cache returned stale instructions" << std::endl;
+    return 1;
+}
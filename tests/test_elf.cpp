@@ -1,29 +1,85 @@
 #include "cpu.h"
 #include "interpreter.h"
 #include "elf_loader.h"
+#include "../src/jit/execution_engine.h"
+#include <iomanip>
 #include <iostream>
+#include <string>
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <elf-file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <elf-file> [--predecode] [--host-mmu] [--cache DIR]"
+                  << " [--mode interpreter|jit|tiered] [--threshold N]" << std::endl;
         return 1;
     }
     
     try {
-        CPU cpu;
-        Interpreter interp(cpu);
+        LoadOptions options;
+        MemoryConfig config;
+        ExecutionMode mode = ExecutionMode::INTERPRETER;
+        uint64_t threshold = 0;
+        for (int i = 2; i < argc; i++) {
+            std::string flag = argv[i];
+            if (flag == "--predecode") {
+                options.predecode_text = true;
+            } else if (flag == "--host-mmu") {
+                config.backend = MemoryBackend::HOST_MMU;
+            } else if (flag == "--cache" && i + 1 < argc) {
+                options.cache_dir = argv[++i];
+            } else if (flag == "--mode" && i + 1 < argc) {
+                std::string value = argv[++i];
+                if (value == "interpreter") {
+                    mode = ExecutionMode::INTERPRETER;
+                } else if (value == "jit") {
+                    mode = ExecutionMode::JIT;
+                } else if (value == "tiered") {
+                    mode = ExecutionMode::TIERED;
+                } else {
+                    std::cerr << "Unknown mode: " << value << std::endl;
+                    return 1;
+                }
+            } else if (flag == "--threshold" && i + 1 < argc) {
+                threshold = std::stoull(argv[++i]);
+            }
+        }
+        
+        CPU cpu(config);
+        ExecutionEngine engine(cpu, mode);
+        Interpreter& interp = engine.get_interpreter();
+        if (threshold) {
+            engine.get_jit().set_threshold(threshold);
+        }
         
         // Load ELF
-        ELFLoader::load(argv[1], cpu);
+        ELFLoader::load(argv[1], cpu, options);
         
         std::cout << "\n=== Starting execution ===" << std::endl;
         
         // Run
-        interp.run(10000);
+        ExecResult result = engine.run(10000);
         
         std::cout << "\n=== Execution complete ===" << std::endl;
+        std::cout << "Stop reason: " << stop_reason_name(result.reason)
+                  << " at PC 0x" << std::hex << result.pc << std::dec << std::endl;
+        if (result.reason == StopReason::EXIT) {
+            std::cout << "Exit code: " << result.exit_code << std::endl;
+        } else if (result.reason == StopReason::MEMORY_FAULT) {
+            std::cout << "Fault address: 0x" << std::hex << result.fault_addr << std::dec << std::endl;
+        }
         std::cout << "Return value (a0): " << cpu.get_register(10) << std::endl;
-        std::cout << "Instructions executed: " << interp.get_instructions_executed() << std::endl;
+        std::cout << "Instructions executed: " << engine.get_instructions_executed() << std::endl;
+        if (mode != ExecutionMode::INTERPRETER) {
+            uint64_t total = engine.get_instructions_executed();
+            double coverage = total ? 100.0 * engine.get_native_instructions() / total : 0.0;
+            std::cout << "Mode: " << execution_mode_name(mode) << ", compiled blocks: "
+                      << engine.get_jit().get_compiled_blocks() << " (" << engine.get_jit().get_linked_exits()
+                      << " linked exits), rejected blocks: " << engine.get_rejected_blocks()
+                      << ", native instructions: " << engine.get_native_instructions() << " ("
+                      << std::fixed << std::setprecision(1) << coverage << std::defaultfloat << "%) in "
+                      << engine.get_native_blocks() << " block runs" << std::endl;
+        }
+        std::cout << "Decodes: " << interp.get_decode_cache().get_decodes()
+                  << ", text image fetches: " << interp.get_decode_cache().get_image_fetches() << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,146 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "elf_loader.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Segment loading on a synthetic ELF: a text segment of whole pages plus
+// a partial one, and a data segment that starts and ends mid-page with
+// a BSS tail spanning whole pages. Mapped and copied loads must agree,
+// BSS must be zero even over previously written memory, and guest
+// writes to mapped pages must not reach the file.
+
+static const uint32_t kTextOffset = 0x1000, kTextAddr = 0x10000, kTextSize = 0x3010;
+static const uint32_t kDataOffset = 0x5010, kDataAddr = 0x30010, kDataSize = 0x2000, kDataMemSize = 0x5000;
+static const uint32_t kImageEnd = 0x36000;
+
+static const std::vector<uint32_t> kProgram = {
+    0x000302B7,  // LUI  t0, 0x30
+    0x0102A503,  // LW   a0, 16(t0)         # first data word
+    0x00033337,  // LUI  t1, 0x33
+    0x00032583,  // LW   a1, 0(t1)          # BSS
+    0x00B50533,  // ADD  a0, a0, a1
+    0x000313B7,  // LUI  t2, 0x31
+    0x00A3A223,  // SW   a0, 4(t2)          # write a whole mapped page
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit(a0)
+};
+
+static void put16(std::vector<uint8_t>& out, size_t at, uint16_t value) {
+    out[at] = value & 0xFF;
+    out[at + 1] = value >> 8;
+}
+
+static void put32(std::vector<uint8_t>& out, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static std::vector<uint8_t> build_elf() {
+    std::vector<uint8_t> file(kDataOffset + kDataSize);
+    for (size_t i = 0; i < file.size(); i++) {
+        file[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+
+    // ELF header
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::copy(ident, ident + 16, file.begin());
+    put16(file, 16, 2);             // ET_EXEC
+    put16(file, 18, 0xF3);          // EM_RISCV
+    put32(file, 20, 1);
+    put32(file, 24, kTextAddr);     // e_entry
+    put32(file, 28, 52);            // e_phoff
+    put32(file, 32, 0);
+    put32(file, 36, 0);
+    put16(file, 40, 52);
+    put16(file, 42, 32);
+    put16(file, 44, 2);             // e_phnum
+    put16(file, 46, 0);
+    put16(file, 48, 0);
+    put16(file, 50, 0);
+
+    // Program headers: text (R+X), data (R+W) with BSS
+    const uint32_t phdrs[2][8] = {
+        {1, kTextOffset, kTextAddr, kTextAddr, kTextSize, kTextSize, 5, 0x1000},
+        {1, kDataOffset, kDataAddr, kDataAddr, kDataSize, kDataMemSize, 6, 0x1000},
+    };
+    for (int p = 0; p < 2; p++) {
+        for (int f = 0; f < 8; f++) {
+            put32(file, 52 + p * 32 + f * 4, phdrs[p][f]);
+        }
+    }
+
+    for (size_t i = 0; i < kProgram.size(); i++) {
+        put32(file, kTextOffset + i * 4, kProgram[i]);
+    }
+    put32(file, kDataOffset, 7);
+    return file;
+}
+
+static std::vector<uint8_t> guest_image(const CPU& cpu) {
+    std::vector<uint8_t> bytes(kImageEnd - kTextAddr);
+    cpu.read_bytes(kTextAddr, bytes.data(), bytes.size());
+    return bytes;
+}
+
+int main() {
+    std::cout << "=== RISC-V ELF Segment Loading Test ===" << std::endl;
+    bool ok = true;
+
+    const std::string path = "test_elf_loader.tmp.elf";
+    const std::vector<uint8_t> file = build_elf();
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), file.size());
+
+    for (MemoryBackend backend : {MemoryBackend::PAGED, MemoryBackend::HOST_MMU}) {
+        std::cout << (backend == MemoryBackend::PAGED ? "\n[Paged memory]" : "\n[Host-MMU memory]") << std::endl;
+        MemoryConfig config;
+        config.backend = backend;
+
+        CPU copied(config);
+        copied.write_word(0x30000, 0x12345678);
+        LoadOptions copy_options;
+        copy_options.map_segments = false;
+        ELFLoader::load(path, copied, copy_options);
+
+        // Scribble over the BSS and the unmapped head of the data page first
+        CPU mapped(config);
+        mapped.write_word(0x33000, 0xDEADBEEF);
+        mapped.write_word(0x32010, 0xFFFFFFFF);
+        mapped.write_word(0x30000, 0x12345678);
+        ELFLoader::load(path, mapped);
+
+        std::vector<uint8_t> image = guest_image(mapped);
+        ok &= check(image == guest_image(copied), "mapped load matches copied load");
+        ok &= check(std::equal(file.begin() + kTextOffset, file.begin() + kTextOffset + kTextSize,
+                               image.begin()), "text bytes");
+        ok &= check(mapped.read_word(kTextAddr + kTextSize) == 0, "text ends mid-page");
+        ok &= check(mapped.read_word(0x33000) == 0 && mapped.read_word(0x32010) == 0,
+                    "BSS zeroed over old data");
+        ok &= check(mapped.read_word(0x30000) == 0x12345678, "bytes before the segment untouched");
+        ok &= check(mapped.read_word(kDataAddr + kDataMemSize) == 0, "nothing past the segment");
+
+        Interpreter interp(mapped);
+        ExecResult result = interp.run();
+        ok &= check(result.reason == StopReason::EXIT && result.exit_code == 7, "program runs");
+        ok &= check(mapped.read_word(0x31004) == 7, "guest write to a data page");
+
+        std::vector<uint8_t> on_disk(file.size());
+        std::ifstream(path, std::ios::binary).read(reinterpret_cast<char*>(on_disk.data()), on_disk.size());
+        ok &= check(on_disk == file, "file unchanged (copy-on-write)");
+    }
+
+    std::remove(path.c_str());
+
+    if (ok) {
+        std::cout << "\n✅ ELF segments map copy-on-write with zero-page BSS!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ ELF loading test failed" << std::endl;
+    return 1;
+}
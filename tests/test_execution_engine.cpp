@@ -0,0 +1,216 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "elf_loader.h"
+#include "../src/jit/execution_engine.h"
+#include "test_util.h"
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Execution engine: every mode must leave the guest exactly as the
+// interpreter does, with hot blocks run natively (and chained) in the
+// JIT modes, exact instruction limits, and compiled code dropped when
+// the guest overwrites it. The shipped binaries run the same in every
+// mode, with however much of them the JIT covers reported.
+
+static const std::vector<uint32_t> kProgram = {
+    0x00000513,  // ADDI a0, zero, 0
+    0x0C800593,  // ADDI a1, zero, 200
+    0x00B50533,  // loop: ADD a0, a0, a1
+    0x00B542B3,  // XOR  t0, a0, a1
+    0xFFF58593,  // ADDI a1, a1, -1
+    0xFE059AE3,  // BNE  a1, zero, loop
+    0x00028313,  // MV   t1, t0
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit
+};
+static const uint64_t kInstructions = 2 + 200 * 4 + 3;
+
+// kBlocks three-instruction blocks chained by jumps, run kPasses times:
+// more code than a small code cache holds at once
+static const int kBlocks = 256;
+static const int kPasses = 20;
+
+static uint32_t bne_zero(uint8_t rs1, int32_t offset) {
+    uint32_t imm = static_cast<uint32_t>(offset);
+    return (((imm >> 12) & 1) << 31) | (((imm >> 5) & 0x3F) << 25) | (rs1 << 15) | (1 << 12) |
+           (((imm >> 1) & 0xF) << 8) | (((imm >> 11) & 1) << 7) | 0x63;
+}
+
+static std::vector<uint32_t> many_blocks_program() {
+    std::vector<uint32_t> program = {0x01400293};  // ADDI t0, zero, kPasses
+    for (int i = 0; i < kBlocks; i++) {
+        program.push_back(0x00150513);  // ADDI a0, a0, 1
+        program.push_back(0x00158593);  // ADDI a1, a1, 1
+        program.push_back(0x0040006F);  // JAL  zero, 4
+    }
+    program.push_back(0xFFF28293);  // ADDI t0, t0, -1
+    program.push_back(bne_zero(5, -4 * (3 * kBlocks + 1)));  // BNE t0, zero, first block
+    program.push_back(0x05D00893);  // ADDI a7, zero, 93
+    program.push_back(0x00000073);  // ECALL                   # exit
+    return program;
+}
+
+static bool same_registers(const CPU& a, const CPU& b) {
+    for (uint8_t reg = 0; reg < 32; reg++) {
+        if (a.get_register(reg) != b.get_register(reg)) {
+            return false;
+        }
+    }
+    return a.get_pc() == b.get_pc();
+}
+
+int main() {
+    std::cout << "=== Execution Engine Test ===" << std::endl;
+    bool ok = true;
+    const bool native = HOST_JIT_BACKEND != JITBackend::NONE;
+
+    CPU reference;
+    reference.load_program(to_bytes(kProgram), 0x1000);
+    Interpreter reference_interp(reference);
+    ExecResult reference_result = reference_interp.run();
+
+    // Natively run instructions per mode: in JIT mode the entry block
+    // through the first BNE, the remaining 199 iterations of the loop,
+    // which branches back to itself inside compiled code, and the exit
+    // prefix (MV, ADDI); in tiered mode the loop from the entry reaching
+    // the threshold, all in that one call
+    struct Case { ExecutionMode mode; uint64_t compiled, native_instructions, native_blocks; };
+    const Case cases[] = {
+        {ExecutionMode::INTERPRETER, 0, 0, 0},
+        {ExecutionMode::JIT, 3, 6 + 199 * 4 + 2, 3},
+        {ExecutionMode::TIERED, 1, (199 - 49) * 4, 1}
+    };
+    for (const Case& test : cases) {
+        std::cout << "\n[Mode: " << execution_mode_name(test.mode) << "]" << std::endl;
+        CPU cpu;
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        ExecutionEngine engine(cpu, test.mode);
+        ExecResult result = engine.run();
+        ok &= check(result.reason == StopReason::EXIT && result.exit_code == reference_result.exit_code &&
+                    same_registers(cpu, reference), "same result as the interpreter");
+        ok &= check(result.instructions_retired == kInstructions &&
+                    engine.get_instructions_executed() == kInstructions, "instruction count");
+        if (native || test.mode == ExecutionMode::INTERPRETER) {
+            ok &= check(engine.get_jit().get_compiled_blocks() == test.compiled &&
+                        engine.get_native_instructions() == test.native_instructions &&
+                        engine.get_native_blocks() == test.native_blocks, "hot blocks run natively");
+        }
+    }
+
+    std::cout << "\n[Block chaining]" << std::endl;
+    if (!native) {
+        std::cout << "  skipped: no backend for this host" << std::endl;
+    } else {
+        // Once all three blocks are compiled, their exits to each other
+        // are linked and a second run is a single native call up to the
+        // ECALL
+        CPU cpu;
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        ExecutionEngine engine(cpu, ExecutionMode::JIT);
+        engine.run();
+        ok &= check(engine.get_jit().get_linked_exits() == 3, "exits between compiled blocks linked");
+        cpu.set_pc(0x1000);
+        engine.reset_stats();
+        ExecResult result = engine.run();
+        ok &= check(result.reason == StopReason::EXIT && same_registers(cpu, reference) &&
+                    engine.get_native_blocks() == 1 && engine.get_native_instructions() == kInstructions - 1,
+                    "one call runs every block");
+    }
+
+    std::cout << "\n[Instruction limit]" << std::endl;
+    {
+        CPU cpu, stepped;
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        stepped.load_program(to_bytes(kProgram), 0x1000);
+        ExecutionEngine engine(cpu, ExecutionMode::TIERED);
+        engine.get_jit().set_threshold(2);
+        Interpreter interp(stepped);
+        bool exact = true;
+        for (uint64_t limit = 97; limit < kInstructions; limit += 97) {
+            ExecResult result = engine.run(limit);
+            interp.run(limit);
+            exact &= result.reason == StopReason::INSTRUCTION_LIMIT &&
+                     engine.get_instructions_executed() == limit && same_registers(cpu, stepped);
+        }
+        ok &= check(exact, "stops exactly at every limit, between native and interpreted blocks");
+        ok &= check(engine.run().reason == StopReason::EXIT && same_registers(cpu, reference), "resumes to the same exit");
+    }
+
+    std::cout << "\n[Code writes]" << std::endl;
+    {
+        CPU cpu, patched;
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        patched.load_program(to_bytes(kProgram), 0x1000);
+        ExecutionEngine engine(cpu, ExecutionMode::JIT);
+        engine.run();
+
+        // Turn the loop's ADD into SUB and run both again from the start
+        cpu.write_word(0x1008, 0x40B50533);
+        patched.write_word(0x1008, 0x40B50533);
+        ok &= check(!engine.get_jit().has_compiled_code(0x1008), "overwritten block dropped");
+        cpu.set_pc(0x1000);
+        engine.run();
+        Interpreter interp(patched);
+        interp.run();
+        ok &= check(same_registers(cpu, patched), "recompiled code matches the new program");
+    }
+
+    std::cout << "\n[Code cache flush]" << std::endl;
+    if (!native) {
+        std::cout << "  skipped: no backend for this host" << std::endl;
+    } else {
+        // Blocks evicted by a full cache are compiled again on their next
+        // entries, so after the first pass almost everything runs natively
+        const std::vector<uint32_t> program = many_blocks_program();
+        const uint64_t instructions = 1 + kPasses * (3 * kBlocks + 2) + 2;
+        CPU cpu, stepped;
+        cpu.load_program(to_bytes(program), 0x1000);
+        stepped.load_program(to_bytes(program), 0x1000);
+        ExecutionEngine engine(cpu, ExecutionMode::JIT, 8 * 1024);
+        ExecResult result = engine.run();
+        Interpreter interp(stepped);
+        interp.run();
+        ok &= check(result.reason == StopReason::EXIT && same_registers(cpu, stepped) &&
+                    engine.get_instructions_executed() == instructions, "same result as the interpreter");
+        std::cout << "  " << engine.get_jit().get_cache_flushes() << " flushes, "
+                  << engine.get_native_instructions() << " of " << instructions << " instructions native"
+                  << std::endl;
+        ok &= check(engine.get_jit().get_cache_flushes() > 1, "cache flushed repeatedly");
+        ok &= check(engine.get_native_instructions() * 10 > instructions * 9, "evicted blocks run natively again");
+    }
+
+    std::cout << "\n[Shipped binaries]" << std::endl;
+    for (const char* name : {"loop", "fib", "hello"}) {
+        const std::string path = std::string(BINARIES_DIR) + "/" + name;
+        CPU reference_cpu;
+        ELFLoader::load(path, reference_cpu);
+        Interpreter interp(reference_cpu);
+        ExecResult expected = interp.run();
+        for (ExecutionMode mode : {ExecutionMode::JIT, ExecutionMode::TIERED}) {
+            CPU cpu;
+            ELFLoader::load(path, cpu);
+            ExecutionEngine engine(cpu, mode);
+            ExecResult result = engine.run();
+            const uint64_t native_instructions = engine.get_native_instructions();
+            std::cout << "  " << name << " (" << execution_mode_name(mode) << "): " << native_instructions
+                      << " of " << result.instructions_retired << " instructions native (" << std::fixed
+                      << std::setprecision(1) << 100.0 * native_instructions / result.instructions_retired
+                      << std::defaultfloat << "%), " << engine.get_jit().get_compiled_blocks()
+                      << " blocks compiled, " << engine.get_rejected_blocks() << " turned down" << std::endl;
+            ok &= check(result.reason == expected.reason && result.exit_code == expected.exit_code &&
+                        result.instructions_retired == expected.instructions_retired &&
+                        same_registers(cpu, reference_cpu), "same result as the interpreter");
+            ok &= check(native_instructions + engine.get_interpreter().get_instructions_executed() ==
+                        result.instructions_retired, "native and interpreted instructions add up");
+        }
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Execution engine hands hot blocks to the JIT!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Execution engine test failed" << std::endl;
+    return 1;
+}
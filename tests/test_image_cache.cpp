@@ -0,0 +1,203 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "elf_loader.h"
+#include "image_cache.h"
+#include "text_image.h"
+#include "test_util.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Image cache round trips on a synthetic ELF: a miss loads normally and
+// writes an entry, a hit rebuilds the same guest memory and text image
+// without parsing or decoding, and stale, corrupt or truncated entries
+// fall back to the normal path and are rewritten.
+
+static const uint32_t kTextAddr = 0x10000, kDataAddr = 0x20010, kImageEnd = 0x25000;
+
+static const std::vector<uint32_t> kProgram = {
+    0x000202B7,  // LUI  t0, 0x20
+    0x0102A503,  // LW   a0, 16(t0)         # data
+    0x000233B7,  // LUI  t2, 0x23
+    0x0003A583,  // LW   a1, 0(t2)          # BSS
+    0x00B50533,  // ADD  a0, a0, a1
+    0x00A3A023,  // SW   a0, 0(t2)
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit(a0)
+};
+
+static void put32(std::vector<uint8_t>& out, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+// Text at 0x10000 (R+X), data at 0x20010 (R+W) with a BSS tail
+static std::vector<uint8_t> build_elf(uint32_t data_value) {
+    std::vector<uint8_t> file(0x4010);
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::copy(ident, ident + 16, file.begin());
+    file[16] = 2;                   // ET_EXEC
+    file[18] = 0xF3;                // EM_RISCV
+    put32(file, 20, 1);
+    put32(file, 24, kTextAddr);     // e_entry
+    put32(file, 28, 52);            // e_phoff
+    file[40] = 52;
+    file[42] = 32;
+    file[44] = 2;                   // e_phnum
+    const uint32_t phdrs[2][8] = {
+        {1, 0x1000, kTextAddr, kTextAddr, 0x1000, 0x1000, 5, 0x1000},
+        {1, 0x2010, kDataAddr, kDataAddr, 0x2000, 0x4000, 6, 0x1000},
+    };
+    for (int p = 0; p < 2; p++) {
+        for (int f = 0; f < 8; f++) {
+            put32(file, 52 + p * 32 + f * 4, phdrs[p][f]);
+        }
+    }
+    for (size_t i = 0; i < kProgram.size(); i++) {
+        put32(file, 0x1000 + i * 4, kProgram[i]);
+    }
+    for (size_t i = 0x1000 + kProgram.size() * 4; i < 0x2000; i += 4) {
+        put32(file, i, 0x00000013);  // NOP padding
+    }
+    put32(file, 0x2010, data_value);
+    return file;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static std::vector<uint8_t> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static std::vector<uint8_t> guest_image(const CPU& cpu) {
+    std::vector<uint8_t> bytes(kImageEnd - kTextAddr);
+    cpu.read_bytes(kTextAddr, bytes.data(), bytes.size());
+    return bytes;
+}
+
+static bool same_text(const TextImage* a, const TextImage* b) {
+    if (!a || !b || a->get_base() != b->get_base() ||
+        a->get_instruction_count() != b->get_instruction_count()) {
+        return false;
+    }
+    size_t n = a->get_instruction_count();
+    return std::equal(a->get_ops(), a->get_ops() + n, b->get_ops()) &&
+           std::equal(a->get_rd(), a->get_rd() + n, b->get_rd()) &&
+           std::equal(a->get_rs1(), a->get_rs1() + n, b->get_rs1()) &&
+           std::equal(a->get_rs2(), a->get_rs2() + n, b->get_rs2()) &&
+           std::equal(a->get_imm(), a->get_imm() + n, b->get_imm());
+}
+
+static int32_t run_exit_code(CPU& cpu) {
+    Interpreter interp(cpu);
+    ExecResult result = interp.run();
+    return result.reason == StopReason::EXIT ? result.exit_code : -1;
+}
+
+int main() {
+    std::cout << "=== RISC-V Image Cache Test ===" << std::endl;
+    bool ok = true;
+
+    const std::string elf_path = "test_image_cache.tmp.elf";
+    const std::string cache_dir = "test_image_cache.tmp.d";
+    const std::vector<uint8_t> elf = build_elf(7);
+    write_file(elf_path, elf);
+    const std::string entry = ImageCache::path_for(cache_dir, ImageCache::content_hash(elf.data(), elf.size()));
+    std::remove(entry.c_str());
+
+    LoadOptions options;
+    options.predecode_text = true;
+    options.cache_dir = cache_dir;
+
+    std::cout << "\n[Cold load]" << std::endl;
+    CPU cold;
+    LoadResult result = ELFLoader::load(elf_path, cold, options);
+    ok &= check(!result.from_cache && result.cache_written, "miss loads normally and writes an entry");
+    ok &= check(access(entry.c_str(), R_OK) == 0, "entry named by content hash");
+
+    for (MemoryBackend backend : {MemoryBackend::PAGED, MemoryBackend::HOST_MMU}) {
+        std::cout << (backend == MemoryBackend::PAGED ? "\n[Warm load: paged]" : "\n[Warm load: host MMU]")
+                  << std::endl;
+        MemoryConfig config;
+        config.backend = backend;
+        CPU warm(config);
+        warm.write_word(0x23000, 0xDEADBEEF);  // BSS must come back zeroed
+        result = ELFLoader::load(elf_path, warm, options);
+        ok &= check(result.from_cache && !result.cache_written && result.entry == kTextAddr, "hit");
+        ok &= check(guest_image(warm) == guest_image(cold), "same guest memory");
+        ok &= check(same_text(warm.get_text_image(), cold.get_text_image()), "same predecoded text");
+        ok &= check(warm.get_pc() == kTextAddr && warm.get_register(2) == warm.get_stack_top(),
+                    "PC and sp set");
+        ok &= check(warm.get_text_start() == cold.get_text_start() && warm.get_text_end() == kTextAddr + 0x1000,
+                    "text range set");
+        ok &= check(run_exit_code(warm) == 7, "program runs");
+    }
+
+    std::cout << "\n[Cache entry is not written through]" << std::endl;
+    std::vector<uint8_t> before = read_file(entry);
+    {
+        CPU warm;
+        ELFLoader::load(elf_path, warm, options);
+        warm.write_word(0x21000, 99);
+        ok &= check(warm.read_word(0x21000) == 99, "write to a mapped data page");
+    }
+    ok &= check(read_file(entry) == before, "entry unchanged");
+
+    std::cout << "\n[Without predecode]" << std::endl;
+    {
+        LoadOptions plain = options;
+        plain.predecode_text = false;
+        CPU warm;
+        result = ELFLoader::load(elf_path, warm, plain);
+        ok &= check(result.from_cache && warm.get_text_image() == nullptr, "hit leaves text image off");
+        ok &= check(run_exit_code(warm) == 7, "program runs");
+    }
+
+    std::cout << "\n[Corrupt and stale entries]" << std::endl;
+    // Header version, segment table, last byte of the last segment
+    const size_t offsets[] = {8, 100, before.size() - 1};
+    for (size_t offset : offsets) {
+        std::vector<uint8_t> corrupt = before;
+        corrupt[offset] ^= 0x40;
+        write_file(entry, corrupt);
+        CPU cpu;
+        result = ELFLoader::load(elf_path, cpu, options);
+        ok &= check(!result.from_cache && result.cache_written, "corrupt entry falls back and is rewritten");
+        ok &= check(run_exit_code(cpu) == 7, "fallback load runs");
+    }
+    {
+        write_file(entry, std::vector<uint8_t>(before.begin(), before.begin() + before.size() / 2));
+        CPU cpu;
+        result = ELFLoader::load(elf_path, cpu, options);
+        ok &= check(!result.from_cache && result.cache_written, "truncated entry falls back");
+        ok &= check(read_file(entry) == before, "rewritten entry matches the original");
+    }
+    {
+        const std::vector<uint8_t> changed = build_elf(9);
+        write_file(elf_path, changed);
+        CPU cpu;
+        result = ELFLoader::load(elf_path, cpu, options);
+        ok &= check(!result.from_cache, "changed ELF misses");
+        ok &= check(run_exit_code(cpu) == 9, "changed ELF runs");
+        std::remove(ImageCache::path_for(cache_dir, ImageCache::content_hash(changed.data(), changed.size())).c_str());
+    }
+
+    std::remove(entry.c_str());
+    std::remove(elf_path.c_str());
+    rmdir(cache_dir.c_str());
+
+    if (ok) {
+        std::cout << "\n✅ Image cache hits skip parsing and decoding!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Image cache test failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,422 @@
+#include "../src/core/cpu.h"
+#include "../src/core/interpreter.h"
+#include "../src/jit/jit_compiler.h"
+#include "../src/jit/x64_assembler.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// JIT backends: the register allocator must keep the busiest guest
+// registers in host registers, both code generators must emit known
+// encodings (checked against a disassembler) on any host, and blocks
+// compiled for the host must leave the registers exactly as the
+// interpreter does.
+
+// Code in buffer from offset from up to to (the end by default)
+static bool emitted(const CodeBuffer& buffer, const std::vector<uint8_t>& expected, size_t from = 0,
+                    size_t to = SIZE_MAX) {
+    to = std::min(to, buffer.get_position());
+    return to - from == expected.size() &&
+           std::memcmp(buffer.get_function<const uint8_t*>(from), expected.data(), expected.size()) == 0;
+}
+
+// Block table address for the stubs under test, which only embed it
+static const BlockTableEntry* const kTable = reinterpret_cast<const BlockTableEntry*>(0x123456789AB0);
+
+static uint32_t r_type(uint32_t funct7, uint32_t funct3, uint32_t rd, uint32_t rs1, uint32_t rs2) {
+    return (funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) | (rd << 7) | 0x33;
+}
+
+static uint32_t addi(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return (static_cast<uint32_t>(imm) << 20) | (rs1 << 15) | (rd << 7) | 0x13;
+}
+
+static uint32_t b_type(uint32_t funct3, uint32_t rs1, uint32_t rs2, int32_t offset) {
+    uint32_t imm = static_cast<uint32_t>(offset);
+    return (((imm >> 12) & 1) << 31) | (((imm >> 5) & 0x3F) << 25) | (rs2 << 20) | (rs1 << 15) |
+           (funct3 << 12) | (((imm >> 1) & 0xF) << 8) | (((imm >> 11) & 1) << 7) | 0x63;
+}
+
+static uint32_t jal(uint32_t rd, int32_t offset) {
+    uint32_t imm = static_cast<uint32_t>(offset);
+    return (((imm >> 20) & 1) << 31) | (((imm >> 1) & 0x3FF) << 21) | (((imm >> 11) & 1) << 20) |
+           (((imm >> 12) & 0xFF) << 12) | (rd << 7) | 0x6F;
+}
+
+static uint32_t jalr(uint32_t rd, uint32_t rs1, int32_t imm) {
+    return (static_cast<uint32_t>(imm) << 20) | (rs1 << 15) | (rd << 7) | 0x67;
+}
+
+// Emit block, at consecutive PCs from 0x1000, with host_registers of
+// the backend's registers
+static BlockCode generate(CodeGenerator& generator, const std::vector<DecodedInstruction>& block,
+                          size_t host_registers) {
+    generator.begin_block(allocate_registers(block, host_registers), 0x1000, static_cast<uint32_t>(block.size()));
+    for (size_t i = 0; i < block.size(); i++) {
+        generator.emit(block[i], static_cast<uint32_t>(0x1000 + i * 4));
+    }
+    return generator.end_block(static_cast<uint32_t>(0x1000 + block.size() * 4));
+}
+
+int main() {
+    std::cout << "=== JIT Backend Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[x86-64 assembler]" << std::endl;
+    {
+        CodeBuffer buffer;
+        X64Assembler asm_(buffer);
+        asm_.mov_reg_imm(X64Reg::RAX, 0x12345678);    // mov eax, 0x12345678
+        asm_.mov_reg_imm(X64Reg::R9, 5);              // mov r9d, 5
+        asm_.mov_reg_reg(X64Reg::RCX, X64Reg::R10);   // mov ecx, r10d
+        asm_.add_reg_reg(X64Reg::R8, X64Reg::RAX);    // add r8d, eax
+        asm_.add_reg_imm(X64Reg::RDX, -3);            // add edx, -3
+        asm_.add_reg_imm(X64Reg::R11, 1000);          // add r11d, 1000
+        asm_.sub_reg_reg(X64Reg::RSI, X64Reg::R9);    // sub esi, r9d
+        asm_.and_reg_reg(X64Reg::R10, X64Reg::R11);   // and r10d, r11d
+        asm_.or_reg_reg(X64Reg::RAX, X64Reg::RDX);    // or eax, edx
+        asm_.xor_reg_reg(X64Reg::RSI, X64Reg::RSI);   // xor esi, esi
+        asm_.neg_reg(X64Reg::R8);                     // neg r8d
+        asm_.cmp_reg_reg(X64Reg::RCX, X64Reg::R9);    // cmp ecx, r9d
+        asm_.jcc(X64Cond::L, 16);                     // jl +16
+        asm_.jmp(-32);                                // jmp -32
+        asm_.mov_reg_mem(X64Reg::RAX, X64Reg::RDI, 4);     // mov eax, [rdi + 4]
+        asm_.mov_reg_mem(X64Reg::R11, X64Reg::RDI, 28);    // mov r11d, [rdi + 28]
+        asm_.mov_mem_reg(X64Reg::RDI, 4, X64Reg::R8);      // mov [rdi + 4], r8d
+        asm_.mov_reg_mem(X64Reg::RCX, X64Reg::RSP, 8);     // mov ecx, [rsp + 8]
+        asm_.mov_reg_mem(X64Reg::RDX, X64Reg::R13, 0);     // mov edx, [r13]
+        asm_.mov_mem_reg(X64Reg::R12, 512, X64Reg::RBX);   // mov [r12 + 512], ebx
+        asm_.push_reg(X64Reg::RBX);                        // push rbx
+        asm_.pop_reg(X64Reg::R12);                         // pop r12
+        asm_.ret();
+        ok &= check(emitted(buffer, {
+            0xB8, 0x78, 0x56, 0x34, 0x12,  0x41, 0xB9, 0x05, 0x00, 0x00, 0x00,  0x44, 0x89, 0xD1,
+            0x41, 0x01, 0xC0,  0x83, 0xC2, 0xFD,  0x41, 0x81, 0xC3, 0xE8, 0x03, 0x00, 0x00,
+            0x44, 0x29, 0xCE,  0x45, 0x21, 0xDA,  0x09, 0xD0,  0x31, 0xF6,  0x41, 0xF7, 0xD8,
+            0x44, 0x39, 0xC9,  0x0F, 0x8C, 0x10, 0x00, 0x00, 0x00,  0xE9, 0xE0, 0xFF, 0xFF, 0xFF,
+            0x8B, 0x47, 0x04,  0x44, 0x8B, 0x5F, 0x1C,  0x44, 0x89, 0x47, 0x04,  0x8B, 0x4C, 0x24, 0x08,
+            0x41, 0x8B, 0x55, 0x00,  0x41, 0x89, 0x9C, 0x24, 0x00, 0x02, 0x00, 0x00,  0x53,  0x41, 0x5C,  0xC3
+        }), "encodings");
+    }
+
+    // ADDI x1, x0, -5; SUB x3, x1, x2; ADDI x4, x4, 7
+    const std::vector<DecodedInstruction> block = {
+        Decoder::predecode(addi(1, 0, -5)),
+        Decoder::predecode(r_type(0x20, 0, 3, 1, 2)),
+        Decoder::predecode(addi(4, 4, 7))
+    };
+
+    std::cout << "\n[Register allocation]" << std::endl;
+    {
+        RegisterAllocation all = allocate_registers(block, 8);
+        ok &= check(all.allocated == 4 && all.spilled == 0 && !all.in_host(0), "every used register fits");
+        RegisterAllocation two = allocate_registers(block, 2);
+        ok &= check(two.host[1] == 0 && two.host[4] == 1 && !two.in_host(2) && !two.in_host(3) &&
+                    two.spilled == 2, "busiest registers first, the rest spilled");
+        ok &= check(two.loaded == ((1u << 2) | (1u << 4)), "loads only registers read before written");
+        ok &= check(two.stored == ((1u << 1) | (1u << 3) | (1u << 4)), "stores only written registers");
+    }
+
+    // The same block with two host registers after the stubs: x1 and x4
+    // allocated, x2 and x3 read and written in the state, exit to 0x100C
+    std::cout << "\n[x86-64 code generator]" << std::endl;
+    {
+        CodeBuffer buffer;
+        auto generator = make_code_generator(JITBackend::X86_64, buffer);
+        generator->emit_stubs(kTable);
+        size_t stubs = buffer.get_position();
+        BlockCode code = generate(*generator, block, 2);
+        ok &= check(generator->host_registers() == 11 &&
+                    !generator->supports(Decoder::predecode(0x00002083)), "pool and operations");  // LW
+        ok &= check(emitted(buffer, {
+            0x44, 0x89, 0x97, 0x80, 0x00, 0x00, 0x00,          // exit: mov [rdi + 128], r10d
+            0x44, 0x89, 0xD0,                                  // mov eax, r10d
+            0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C,    // pop r15; pop r14; pop r13; pop r12
+            0x5D, 0x5B, 0xC3,                                  // pop rbp; pop rbx; ret
+            0x44, 0x89, 0xD0,                                  // lookup: mov eax, r10d
+            0x81, 0xE0, 0xFC, 0x3F, 0x00, 0x00,                // and eax, 0x3ffc
+            0xC1, 0xE0, 0x02,                                  // shl eax, 2
+            0x49, 0xBB, 0xB0, 0x9A, 0x78, 0x56, 0x34, 0x12, 0x00, 0x00,  // movabs r11, table
+            0x49, 0x01, 0xC3,  0x45, 0x3B, 0x53, 0x00,         // add r11, rax; cmp r10d, [r11]
+            0x0F, 0x85, 0xC8, 0xFF, 0xFF, 0xFF,                // jne exit
+            0x41, 0xFF, 0x63, 0x08                             // jmp [r11 + 8]
+        }, 0, stubs), "stubs");
+        ok &= check(emitted(buffer, {
+            0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57,  // push rbx, rbp, r12-r15
+            0xE9, 0x16, 0x00, 0x00, 0x00,                      // jmp body
+            0x44, 0x8B, 0x5E, 0x00,  0x41, 0x83, 0xFB, 0x03,   // chain: mov r11d, [rsi]; cmp r11d, 3
+            0x0F, 0x82, 0x32, 0x00, 0x00, 0x00,                // jb exhausted
+            0x41, 0x83, 0xC3, 0xFD,  0x44, 0x89, 0x5E, 0x00,   // add r11d, -3; mov [rsi], r11d
+            0x8B, 0x4F, 0x10,                                  // body: mov ecx, [rdi + 16]
+            0x31, 0xC0,  0x83, 0xC0, 0xFB,                     // xor eax, eax; add eax, -5
+            0x44, 0x8B, 0x5F, 0x08,  0x41, 0x89, 0xC2,         // mov r11d, [rdi + 8]; mov r10d, eax
+            0x45, 0x29, 0xDA,  0x44, 0x89, 0x57, 0x0C,         // sub r10d, r11d; mov [rdi + 12], r10d
+            0x83, 0xC1, 0x07,                                  // add ecx, 7
+            0x89, 0x47, 0x04,  0x89, 0x4F, 0x10,               // mov [rdi + 4], eax; mov [rdi + 16], ecx
+            0x41, 0xBA, 0x0C, 0x10, 0x00, 0x00,                // mov r10d, 0x100c
+            0xE9, 0x8A, 0xFF, 0xFF, 0xFF,                      // jmp lookup
+            0x41, 0xBA, 0x00, 0x10, 0x00, 0x00,                // exhausted: mov r10d, 0x1000
+            0xE9, 0x6A, 0xFF, 0xFF, 0xFF                       // jmp exit
+        }, stubs), "encodings");
+        ok &= check(code.entry == stubs && code.chain == stubs + 15 && code.exits.size() == 1 &&
+                    code.exits[0].jump == stubs + 74 && code.exits[0].target == 0x100C, "entries and exits");
+        
+        // Link the exit to the block's own chain entry, then undo it
+        size_t jump = code.exits[0].jump;
+        generator->link_exit(jump, code.chain);
+        bool linked = emitted(buffer, {0xE9, 0xC0, 0xFF, 0xFF, 0xFF}, jump, jump + 5);   // jmp chain
+        generator->unlink_exit(jump);
+        ok &= check(linked && emitted(buffer, {0xE9, 0x8A, 0xFF, 0xFF, 0xFF}, jump, jump + 5), "linking");
+    }
+
+    std::cout << "\n[ARM64 code generator]" << std::endl;
+    {
+        CodeBuffer buffer;
+        auto generator = make_code_generator(JITBackend::ARM64, buffer);
+        generator->emit_stubs(kTable);
+        size_t stubs = buffer.get_position();
+        BlockCode code = generate(*generator, block, 2);
+        ok &= check(generator->host_registers() == 13 &&
+                    !generator->supports(Decoder::predecode(0x00002083)), "pool and operations");  // LW
+        std::vector<uint32_t> stub_words = {
+            0xB9008010, 0x2A1003E0, 0xD65F03C0,  // exit: str w16, [x0, #128]; mov w0, w16; ret
+            0x5287FF88, 0x0A080208,              // lookup: mov w8, #0x3ffc; and w8, w16, w8
+            0xD2935611, 0xF2AACF11, 0xF2C24691, 0xF2E00011,  // mov x17, table
+            0x8B080A31, 0xB9400228, 0x6B10011F,  // add x17, x17, x8, lsl #2; ldr w8, [x17]; cmp w8, w16
+            0x54FFFE81, 0xF9400631, 0xD61F0220   // b.ne exit; ldr x17, [x17, #8]; br x17
+        };
+        ok &= check(emitted(buffer, to_bytes(stub_words), 0, stubs), "stubs");
+        std::vector<uint32_t> words = {
+            0xB9400031, 0x52800068, 0x6B08023F,  // chain: ldr w17, [x1]; mov w8, #3; cmp w17, w8
+            0x54000203, 0x4B080231, 0xB9000031,  // b.lo exhausted; sub w17, w17, w8; str w17, [x1]
+            0xB940100A,                          // entry: ldr w10, [x0, #16]
+            0x529FFF68, 0x72BFFFE8, 0x0B0803E9,  // mov w8, #-5; add w9, wzr, w8
+            0xB9400811, 0x4B110130, 0xB9000C10,  // ldr w17, [x0, #8]; sub w16, w9, w17; str w16, [x0, #12]
+            0x528000E8, 0x0B08014A,              // mov w8, #7; add w10, w10, w8
+            0xB9000409, 0xB900100A,              // str w9, [x0, #4]; str w10, [x0, #16]
+            0x52820190, 0x17FFFFE2,              // mov w16, #0x100c; b lookup
+            0x52820010, 0x17FFFFDD               // exhausted: mov w16, #0x1000; b exit
+        };
+        ok &= check(emitted(buffer, to_bytes(words), stubs), "encodings");
+        ok &= check(code.chain == stubs && code.entry == stubs + 24 && code.exits.size() == 1 &&
+                    code.exits[0].jump == stubs + 72 && code.exits[0].target == 0x100C, "entries and exits");
+        
+        size_t jump = code.exits[0].jump;
+        generator->link_exit(jump, code.chain);
+        bool linked = emitted(buffer, to_bytes({0x17FFFFEE}), jump, jump + 4);   // b chain
+        generator->unlink_exit(jump);
+        ok &= check(linked && emitted(buffer, to_bytes({0x17FFFFE2}), jump, jump + 4), "linking");
+
+        // ADDI x1, x1, -1; BNE x1, x0, 0x1000: loops while fuel covers
+        // the two instructions, exits to 0x1000 when it does not and to
+        // 0x1008 when the branch falls through
+        CodeBuffer loop_buffer;
+        auto loop_generator = make_code_generator(JITBackend::ARM64, loop_buffer);
+        loop_generator->emit_stubs(kTable);
+        generate(*loop_generator, {Decoder::predecode(addi(1, 1, -1)), Decoder::predecode(b_type(1, 1, 0, -4))}, 13);
+        std::vector<uint32_t> loop_words = {
+            0xB9400031, 0x52800048, 0x6B08023F,  // chain: ldr w17, [x1]; mov w8, #2; cmp w17, w8
+            0x540002C3, 0x4B080231, 0xB9000031,  // b.lo exhausted; sub w17, w17, w8; str w17, [x1]
+            0xB9400409,                          // entry: ldr w9, [x0, #4]
+            0x529FFFE8, 0x72BFFFE8, 0x0B080129,  // top: mov w8, #-1; add w9, w9, w8
+            0x6B1F013F, 0x54000160,              // cmp w9, wzr; b.eq fall
+            0xB9400031, 0x52800048, 0x6B08023F,  // ldr w17, [x1]; mov w8, #2; cmp w17, w8
+            0x54000083, 0x4B080231, 0xB9000031,  // b.lo loop_exhausted; sub w17, w17, w8; str w17, [x1]
+            0x17FFFFF5,                          // b top
+            0xB9000409, 0x52820010, 0x17FFFFDC,  // loop_exhausted: str w9, [x0, #4]; mov w16, #0x1000; b exit
+            0xB9000409, 0x52820110, 0x17FFFFDC,  // fall: str w9, [x0, #4]; mov w16, #0x1008; b lookup
+            0x52820010, 0x17FFFFD7               // exhausted: mov w16, #0x1000; b exit
+        };
+        ok &= check(emitted(loop_buffer, to_bytes(loop_words), stubs), "self loop and side exit");
+    }
+
+    std::cout << "\n[Host backend: " << jit_backend_name(HOST_JIT_BACKEND) << "]" << std::endl;
+    if (HOST_JIT_BACKEND == JITBackend::NONE) {
+        std::cout << "  skipped: no backend for this host" << std::endl;
+    } else {
+        // Random blocks of nine ALU instructions and a branch or jump,
+        // run for one pass, against ten interpreted instructions: over
+        // x0-x7 (every aliasing of rd with the sources, writes to x0)
+        // and over all 32 registers (more than the host has, so some
+        // spill). Taken branches go back to the start, forward, or out.
+        uint64_t rng = 12345;
+        auto next = [&rng]() {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            return static_cast<uint32_t>(rng);
+        };
+        static const uint32_t alu[][2] = {{0, 0}, {0x20, 0}, {0, 4}, {0, 6}, {0, 7}};  // ADD SUB XOR OR AND
+        static const uint32_t branch_funct3[] = {0, 1, 4, 5, 6, 7};  // BEQ BNE BLT BGE BLTU BGEU
+        static const int32_t offsets[] = {-36, 8, 0x400, -0x800};
+        int matched = 0;
+        const int blocks = 200;
+        for (int b = 0; b < blocks; b++) {
+            std::vector<uint32_t> program;
+            uint32_t regs = b % 2 ? 32 : 8;
+            for (int i = 0; i < 9; i++) {
+                uint32_t kind = next() % 6;
+                uint32_t rd = next() % regs, rs1 = next() % regs, rs2 = next() % regs;
+                if (kind == 5) {
+                    program.push_back(addi(rd, rs1, static_cast<int32_t>(next() % 4096) - 2048));
+                } else {
+                    program.push_back(r_type(alu[kind][0], alu[kind][1], rd, rs1, rs2));
+                }
+            }
+            uint32_t rd = next() % regs, rs1 = next() % regs, rs2 = next() % regs;
+            int32_t offset = offsets[next() % 4];
+            switch (next() % 8) {
+                case 6:  program.push_back(jal(rd, offset)); break;
+                case 7:  program.push_back(jalr(rd, rs1, static_cast<int32_t>(next() % 4096) - 2048)); break;
+                default: program.push_back(b_type(branch_funct3[next() % 6], rs1, rs2, offset)); break;
+            }
+
+            CPU jit_cpu, interp_cpu;
+            jit_cpu.load_program(to_bytes(program), 0x1000);
+            interp_cpu.load_program(to_bytes(program), 0x1000);
+            for (uint8_t reg = 1; reg < 32; reg++) {
+                // Few distinct values, so branches go both ways
+                uint32_t value = next() % 4 == 0 ? next() % 3 : next();
+                jit_cpu.set_register(reg, value);
+                interp_cpu.set_register(reg, value);
+            }
+
+            JITCompiler jit;
+            jit.set_verbose(false);
+            jit.compile_basic_block(jit_cpu, 0x1000);
+            Interpreter interp(interp_cpu);
+            interp.run(10);
+            const CompiledBlock* compiled = jit.get_compiled_block(0x1000);
+            if (!compiled || compiled->instructions != 10) {
+                continue;
+            }
+            uint32_t fuel = 0;
+            uint32_t next_pc = compiled->code(jit_cpu.get_state(), &fuel);
+            bool same = next_pc == interp_cpu.get_pc() && jit_cpu.get_pc() == next_pc;
+            for (uint8_t reg = 0; reg < 32; reg++) {
+                same &= jit_cpu.get_register(reg) == interp_cpu.get_register(reg);
+            }
+            matched += same;
+        }
+        ok &= check(matched == blocks, "compiled blocks match the interpreter, next PC included");
+
+        // ADDI x1, x1, -1; BNE x1, x0, 0x1000 from x1 = 10
+        const std::vector<uint32_t> loop = {addi(1, 1, -1), b_type(1, 1, 0, -4)};
+        bool loops = true;
+        for (uint32_t initial_fuel : {100u, 5u}) {
+            CPU cpu;
+            cpu.load_program(to_bytes(loop), 0x1000);
+            cpu.set_register(1, 10);
+            JITCompiler jit;
+            jit.set_verbose(false);
+            jit.compile_basic_block(cpu, 0x1000);
+            uint32_t fuel = initial_fuel;
+            uint32_t next_pc = jit.get_compiled_code(0x1000)(cpu.get_state(), &fuel);
+            if (initial_fuel == 100) {
+                loops &= next_pc == 0x1008 && cpu.get_register(1) == 0 && fuel == 100 - 9 * 2;
+            } else {
+                loops &= next_pc == 0x1000 && cpu.get_register(1) == 7 && fuel == 1;
+            }
+        }
+        ok &= check(loops, "self loops run natively until the branch falls through or fuel runs out");
+    }
+
+    std::cout << "\n[Block chaining]" << std::endl;
+    if (HOST_JIT_BACKEND == JITBackend::NONE) {
+        std::cout << "  skipped: no backend for this host" << std::endl;
+    } else {
+        // 0x1FF0: x1 += 1, JAL to 0x2000; 0x2000 (the next page): x2 += 2,
+        // BNE x1, x3 back to 0x1FF0, then an ECALL that is never compiled.
+        // 0x3000: JALR to x5.
+        const std::vector<uint32_t> program = {
+            addi(1, 1, 1), jal(0, 0xC), addi(0, 0, 0), addi(0, 0, 0),
+            addi(2, 2, 2), b_type(1, 1, 3, -0x14), 0x00000073
+        };
+        CPU cpu;
+        cpu.load_program(to_bytes(program), 0x1FF0);
+        cpu.write_word(0x3000, jalr(0, 5, 0));
+        JITCompiler jit;
+        jit.set_verbose(false);
+        cpu.add_code_listener(&jit);
+        auto restart = [&cpu]() {
+            cpu.set_register(1, 0);
+            cpu.set_register(2, 0);
+            cpu.set_register(3, 10);
+            cpu.set_register(5, 0x1FF0);
+        };
+        auto run = [&](uint32_t pc, uint32_t& fuel) { return jit.get_compiled_code(pc)(cpu.get_state(), &fuel); };
+
+        jit.compile_basic_block(cpu, 0x1FF0);
+        jit.compile_basic_block(cpu, 0x2000);
+        ok &= check(jit.get_linked_exits() == 2, "exits linked to blocks compiled before and after them");
+
+        // Ten passes through both blocks: two instructions paid by the
+        // caller, the other 38 from the fuel
+        restart();
+        uint32_t fuel = 100;
+        uint32_t next_pc = run(0x1FF0, fuel);
+        ok &= check(next_pc == 0x2008 && cpu.get_pc() == 0x2008 && cpu.get_register(1) == 10 &&
+                    cpu.get_register(2) == 20 && fuel == 100 - 38, "chained blocks run until a PC without a block");
+
+        restart();
+        fuel = 5;
+        next_pc = run(0x1FF0, fuel);
+        ok &= check(next_pc == 0x2000 && cpu.get_pc() == 0x2000 && cpu.get_register(1) == 2 &&
+                    cpu.get_register(2) == 2 && fuel == 1, "chaining stops at the block the fuel does not cover");
+
+        jit.compile_basic_block(cpu, 0x3000);
+        restart();
+        fuel = 100;
+        next_pc = run(0x3000, fuel);
+        ok &= check(next_pc == 0x2008 && cpu.get_register(2) == 20 && fuel == 100 - 40,
+                    "indirect jumps find their block in the block table");
+
+        // Rewriting the second block's page unlinks the jump into it
+        cpu.write_word(0x2000, addi(2, 2, 2));
+        restart();
+        fuel = 100;
+        next_pc = run(0x1FF0, fuel);
+        bool unlinked = jit.get_linked_exits() == 0 && next_pc == 0x2000 && cpu.get_register(1) == 1 && fuel == 100;
+        jit.compile_basic_block(cpu, 0x2000);
+        ok &= check(unlinked && jit.get_linked_exits() == 2, "invalidated blocks are unlinked, and linked again");
+        cpu.remove_code_listener(&jit);
+
+        // 200 blocks of x1 += 1 and a JAL to the next, compiled in order
+        // into a cache with room for fewer: the first ones are evicted
+        // and the rest still chain through to the end
+        std::vector<uint32_t> chain;
+        for (int i = 0; i < 200; i++) {
+            chain.push_back(addi(1, 1, 1));
+            chain.push_back(jal(0, 4));
+        }
+        const uint32_t end = 0x1000 + 200 * 8;
+        CPU chain_cpu;
+        chain_cpu.load_program(to_bytes(chain), 0x1000);
+        JITCompiler small_jit(16 * 1024);
+        small_jit.set_verbose(false);
+        for (uint32_t pc = 0x1000; pc < end; pc += 8) {
+            small_jit.compile_basic_block(chain_cpu, pc);
+        }
+        uint32_t first = 0x1000;
+        while (first < end && !small_jit.has_compiled_code(first)) {
+            first += 8;
+        }
+        uint32_t blocks = (end - first) / 8;
+        fuel = 1000;
+        next_pc = first < end ? small_jit.get_compiled_code(first)(chain_cpu.get_state(), &fuel) : 0;
+        ok &= check(small_jit.get_cache_flushes() == 1 && small_jit.get_compiled_blocks() == blocks &&
+                    small_jit.get_linked_exits() == blocks - 1 && next_pc == end &&
+                    chain_cpu.get_register(1) == blocks && fuel == 1000 - 2 * (blocks - 1),
+                    "a full cache evicts every block and chains the new ones");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ JIT backends emit and run correct code!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ JIT backend test failed" << std::endl;
+    return 1;
+}
@@ -29,7 +29,8 @@ int main() {
     
     if (jit.has_compiled_code(0x1000)) {
         CompiledFunc func = jit.get_compiled_code(0x1000);
-        func(cpu.get_register_ptr());
+        uint32_t fuel = 0;
+        func(cpu.get_state(), &fuel);
         
         std::cout << "\nResults:" << std::endl;
         std::cout << "x1 = " << cpu.get_register(1) << std::endl;
@@ -38,7 +39,8 @@ int main() {
         
         if (cpu.get_register(3) == 30) {
             std::cout << "\n🔥🔥🔥 RISC-V JIT COMPILER WORKS! 🔥🔥🔥" << std::endl;
-            std::cout << "You just compiled RISC-V to ARM64 at runtime!" << std::endl;
+            std::cout << "You just compiled RISC-V to " << jit_backend_name(jit.get_backend())
+                      << " at runtime!" << std::endl;
         }
     }
     
@@ -0,0 +1,82 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+// Byte, halfword and word loads/stores: sign and zero extension, stores
+// that touch only their own bytes, unaligned and page-crossing accesses
+// and the last halfword of memory, on both memory backends.
+
+static bool run_backend(MemoryBackend backend) {
+    bool ok = true;
+    MemoryConfig config;
+    config.backend = backend;
+    CPU cpu(config);
+
+    // Host-side API
+    cpu.store<uint32_t>(0x2000, 0x80FF7F81);
+    ok &= check(cpu.load<int8_t>(0x2000) == -127 && cpu.load<uint8_t>(0x2000) == 0x81, "byte extension");
+    ok &= check(cpu.load<int16_t>(0x2002) == -32513 && cpu.load<uint16_t>(0x2002) == 0x80FF,
+                "halfword extension");
+    cpu.store<uint16_t>(0x2FFF, 0xBEEF);
+    ok &= check(cpu.load<uint16_t>(0x2FFF) == 0xBEEF && cpu.read_byte(0x3000) == 0xBE,
+                "page-crossing halfword");
+    ok &= check(cpu.try_store<uint16_t>(MEMORY_SIZE - 2, 0x1234), "last halfword of memory");
+    uint16_t half;
+    ok &= check(!cpu.try_load(MEMORY_SIZE - 1, half), "halfword past the end fails");
+
+    // Guest code
+    cpu.store<uint32_t>(0x2004, 0xAABBCCDD);
+    cpu.store<uint32_t>(0x2008, 0x11223344);
+    std::vector<uint32_t> program = {
+        0x000022B7,  // LUI  t0, 0x2
+        0x00028503,  // LB   a0, 0(t0)
+        0x0002C583,  // LBU  a1, 0(t0)
+        0x00229603,  // LH   a2, 2(t0)
+        0x0022D683,  // LHU  a3, 2(t0)
+        0x00129703,  // LH   a4, 1(t0)          # unaligned
+        0xFFE00313,  // ADDI t1, zero, -2
+        0x00629223,  // SH   t1, 4(t0)
+        0x00628423,  // SB   t1, 8(t0)
+        0x0062A6A3,  // SW   t1, 13(t0)         # unaligned
+        0x00D2A783,  // LW   a5, 13(t0)
+        0x00639023,  // SH   t1, 0(t2)          # last halfword
+        0x0003D803,  // LHU  a6, 0(t2)
+        0x00100073   // EBREAK
+    };
+    cpu.load_program(to_bytes(program), 0x1000);
+    cpu.set_register(7, MEMORY_SIZE - 2);
+
+    Interpreter interp(cpu);
+    ExecResult result = interp.run();
+    ok &= check(result.reason == StopReason::BREAKPOINT, "program ran to EBREAK");
+    ok &= check(cpu.get_register(10) == 0xFFFFFF81, "LB sign-extends");
+    ok &= check(cpu.get_register(11) == 0x81, "LBU zero-extends");
+    ok &= check(cpu.get_register(12) == 0xFFFF80FF, "LH sign-extends");
+    ok &= check(cpu.get_register(13) == 0x80FF, "LHU zero-extends");
+    ok &= check(cpu.get_register(14) == 0xFFFFFF7F, "unaligned LH");
+    ok &= check(cpu.read_word(0x2004) == 0xAABBFFFE, "SH leaves the next halfword alone");
+    ok &= check(cpu.read_word(0x2008) == 0x112233FE, "SB writes one byte");
+    ok &= check(cpu.get_register(15) == 0xFFFFFFFE, "unaligned SW/LW round trip");
+    ok &= check(cpu.get_register(16) == 0xFFFE, "SH/LHU at the last halfword");
+    return ok;
+}
+
+int main() {
+    std::cout << "=== RISC-V Load/Store Width Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[Paged memory]" << std::endl;
+    ok &= run_backend(MemoryBackend::PAGED);
+
+    std::cout << "\n[Host-MMU memory]" << std::endl;
+    ok &= run_backend(MemoryBackend::HOST_MMU);
+
+    if (ok) {
+        std::cout << "\n✅ Loads and stores honour width and signedness!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Load/store test failed" << std::endl;
+    return 1;
+}
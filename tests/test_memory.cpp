@@ -0,0 +1,125 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+// Paged guest memory: pages appear on first write, reads of untouched
+// memory are free, and the layout is configurable. The host-MMU backend
+// turns host faults into the same resumable guest traps.
+
+class CountingListener : public CodeWriteListener {
+public:
+    int invalidations = 0;
+    void invalidate_code_page(uint32_t) override { invalidations++; }
+};
+
+int main() {
+    std::cout << "=== RISC-V Guest Memory Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[Default layout]" << std::endl;
+    CPU cpu;
+    ok &= check(cpu.get_memory_size() == MEMORY_SIZE, "128MB address space");
+    ok &= check(cpu.get_stack_top() == 0x07FFF000, "stack one page below the top");
+    ok &= check(cpu.get_memory().get_allocated_pages() == 0, "nothing allocated up front");
+    ok &= check(cpu.read_word(0x04000000) == 0, "untouched memory reads as zero");
+    ok &= check(cpu.get_memory().get_allocated_pages() == 0, "reads do not allocate");
+
+    cpu.write_word(0x2000, 0xCAFEBABE);
+    ok &= check(cpu.read_word(0x2000) == 0xCAFEBABE, "write then read");
+    ok &= check(cpu.get_memory().get_allocated_pages() == 1, "first write allocates one page");
+
+    // Word straddling two pages
+    cpu.write_word(0x2FFE, 0x11223344);
+    ok &= check(cpu.read_word(0x2FFE) == 0x11223344, "page-crossing word");
+    ok &= check(cpu.read_byte(0x3000) == 0x22 && cpu.read_byte(0x2FFF) == 0x33, "bytes split across pages");
+
+    uint32_t value;
+    ok &= check(!cpu.try_load(MEMORY_SIZE - 2, value), "access past the end fails");
+
+    std::cout << "\n[Code pages]" << std::endl;
+    CountingListener listener;
+    cpu.add_code_listener(&listener);
+    cpu.write_word(0x5000, 1);          // page now in the write TLB
+    cpu.mark_code_page(0x5000);
+    cpu.write_word(0x5004, 2);
+    ok &= check(listener.invalidations == 1, "store to a marked page is reported");
+    cpu.write_word(0x5008, 3);
+    ok &= check(listener.invalidations == 1, "flag cleared after invalidation");
+    cpu.remove_code_listener(&listener);
+
+    std::cout << "\n[Custom layout]" << std::endl;
+    MemoryConfig config;
+    config.size = uint64_t(1) << 32;
+    config.stack_top = 0x80000000;
+    CPU big(config);
+    big.write_word(0xFFFFFFFC, 0x12345678);
+    ok &= check(big.read_word(0xFFFFFFFC) == 0x12345678, "top of a 4 GB space");
+    ok &= check(big.get_stack_top() == 0x80000000, "configured stack top");
+    ok &= check(big.get_memory().get_allocated_pages() == 1, "still one page resident");
+
+    std::cout << "\n[Host-MMU backend]" << std::endl;
+    MemoryConfig host_config;
+    host_config.backend = MemoryBackend::HOST_MMU;
+    CPU host(host_config);
+    ok &= check(host.get_flat_base() != nullptr, "flat reservation");
+    ok &= check(host.get_memory().get_allocated_pages() == STACK_SIZE / PAGE_SIZE, "stack committed up front");
+    ok &= check(host.read_word(0x00800000) == 0, "uncommitted memory reads as zero");
+    ok &= check(host.get_memory().get_allocated_pages() == STACK_SIZE / PAGE_SIZE, "host reads do not commit");
+
+    host.load_program(to_bytes({
+        0x00100513,  // ADDI a0, zero, 1
+        0x008002B7,  // LUI  t0, 0x800          # uncommitted
+        0x0002A303,  // LW   t1, 0(t0)
+        0x00150513,  // ADDI a0, a0, 1
+        0x05D00893,  // ADDI a7, zero, 93
+        0x00000073   // ECALL                   # exit(a0)
+    }), 0x1000);
+    Interpreter host_interp(host);
+    ExecResult result = host_interp.run();
+    ok &= check(result.reason == StopReason::MEMORY_FAULT, "uncommitted load traps");
+    ok &= check(result.pc == 0x1008 && host.get_pc() == 0x1008, "PC stays on the faulting LW");
+    ok &= check(result.fault_addr == 0x00800000, "reported faulting address");
+    ok &= check(result.instructions_retired == 2, "instructions before it retired");
+
+    ok &= check(host.commit_memory(0x00800000, PAGE_SIZE), "commit the page");
+    host.write_word(0x00800000, 5);
+    result = host_interp.run();
+    ok &= check(result.reason == StopReason::EXIT && result.exit_code == 2, "resumed to exit");
+    ok &= check(host.get_register(6) == 5, "load sees committed data");
+
+    host.set_register(5, 0x90000000);   // beyond the 128MB address space
+    host.set_pc(0x1008);
+    result = host_interp.step();
+    ok &= check(result.reason == StopReason::MEMORY_FAULT && result.fault_addr == 0x90000000,
+                "step traps outside the address space");
+    ok &= check(!host.commit_memory(0x90000000, PAGE_SIZE), "cannot commit outside the address space");
+
+    std::cout << "\n[Host-MMU code pages]" << std::endl;
+    CPU smc(host_config);
+    smc.write_word(0x2000, 0x02A00513);     // ADDI a0, zero, 42
+    smc.load_program(to_bytes({
+        0x000022B7,  // LUI  t0, 0x2
+        0x0002A303,  // LW   t1, 0(t0)
+        0x000013B7,  // LUI  t2, 0x1
+        0x0063AC23,  // SW   t1, 24(t2)         # patch 0x1018
+        0x00100513,  // ADDI a0, zero, 1
+        0x00150513,  // ADDI a0, a0, 1
+        0x00700513,  // ADDI a0, zero, 7        # becomes ADDI a0, zero, 42
+        0x05D00893,  // ADDI a7, zero, 93
+        0x00000073   // ECALL
+    }), 0x1000);
+    Interpreter smc_interp(smc);
+    result = smc_interp.run();
+    ok &= check(result.reason == StopReason::EXIT && result.exit_code == 42,
+                "store into read-only code is retried and invalidates it");
+    ok &= check(smc_interp.get_instructions_executed() == 9, "all instructions retired");
+
+    if (ok) {
+        std::cout << "\n✅ Paged guest memory works!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Guest memory test failed" << std::endl;
+    return 1;
+}
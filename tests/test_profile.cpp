@@ -1,11 +1,18 @@
 #include "cpu.h"
 #include "interpreter.h"
 #include "elf_loader.h"
+#include "profile_export.h"
+#include "timing_model.h"
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <elf-file>" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <elf-file> [--sample N] [--timing latency|pipeline] [--cache]"
+                  << " [--branch static|bimodal|gshare|tournament]"
+                  << " [--flamegraph FILE] [--pprof FILE] [--trace FILE]" << std::endl;
         return 1;
     }
     
@@ -15,18 +22,87 @@ int main(int argc, char** argv) {
         
         // Load ELF
         ELFLoader::load(argv[1], cpu);
+        interp.get_profiler().set_symbols(ELFLoader::read_symbols(argv[1]));
+        std::string flamegraph_path, pprof_path, trace_path;
+        for (int i = 2; i < argc; i++) {
+            std::string option = argv[i];
+            if (option == "--cache") {
+                interp.set_cache_simulator(std::make_unique<CacheSimulator>());
+                continue;
+            }
+            std::string value = i + 1 < argc ? argv[++i] : "";
+            if (option == "--sample") {
+                interp.get_profiler().set_sampling(static_cast<uint32_t>(std::stoul(value)));
+            } else if (option == "--timing" && value == "latency") {
+                interp.set_timing_model(std::make_unique<LatencyModel>());
+            } else if (option == "--timing" && value == "pipeline") {
+                interp.set_timing_model(std::make_unique<PipelineModel>());
+            } else if (option == "--branch" && value == "static") {
+                interp.set_branch_simulator(std::make_unique<BranchSimulator>(std::make_unique<StaticPredictor>()));
+            } else if (option == "--branch" && value == "bimodal") {
+                interp.set_branch_simulator(std::make_unique<BranchSimulator>(std::make_unique<BimodalPredictor>()));
+            } else if (option == "--branch" && value == "gshare") {
+                interp.set_branch_simulator(std::make_unique<BranchSimulator>(std::make_unique<GSharePredictor>()));
+            } else if (option == "--branch" && value == "tournament") {
+                interp.set_branch_simulator(std::make_unique<BranchSimulator>(std::make_unique<TournamentPredictor>()));
+            } else if (option == "--flamegraph" && !value.empty()) {
+                flamegraph_path = value;
+            } else if (option == "--pprof" && !value.empty()) {
+                pprof_path = value;
+            } else if (option == "--trace" && !value.empty()) {
+                trace_path = value;
+                interp.get_profiler().set_call_trace_limit(1 << 20);
+            } else {
+                std::cerr << "Unknown option: " << option << " " << value << std::endl;
+                return 1;
+            }
+        }
         
         std::cout << "\n=== Starting execution with profiling ===" << std::endl;
         
         // Run
-        interp.run(100000);
+        ExecResult result = interp.run(100000);
         
         std::cout << "\n=== Execution complete ===" << std::endl;
+        std::cout << "Stop reason: " << stop_reason_name(result.reason)
+                  << " at PC 0x" << std::hex << result.pc << std::dec << std::endl;
+        if (result.reason == StopReason::EXIT) {
+            std::cout << "Exit code: " << result.exit_code << std::endl;
+        } else if (result.reason == StopReason::MEMORY_FAULT) {
+            std::cout << "Fault address: 0x" << std::hex << result.fault_addr << std::dec << std::endl;
+        }
         std::cout << "Return value (a0): " << cpu.get_register(10) << std::endl;
         std::cout << "Instructions executed: " << interp.get_instructions_executed() << std::endl;
+        if (interp.get_timing_model()) {
+            std::cout << "Cycles (" << interp.get_timing_model()->name() << " model): "
+                      << interp.get_cycles() << std::endl;
+        }
         
         // Print profile
         interp.get_profiler().print_profile();
+        if (interp.get_cache_simulator()) {
+            interp.get_cache_simulator()->print_report(interp.get_profiler().get_symbols());
+        }
+        if (interp.get_branch_simulator()) {
+            interp.get_branch_simulator()->print_report(interp.get_profiler().get_symbols());
+        }
+        
+        // Exports for external visualisation tools
+        auto export_to = [](const std::string& path, auto&& write) {
+            if (path.empty()) {
+                return;
+            }
+            std::ofstream out(path, std::ios::binary);
+            write(out);
+            if (!out) {
+                throw std::runtime_error("Failed to write " + path);
+            }
+            std::cout << "Wrote " << path << std::endl;
+        };
+        const Profiler& profiler = interp.get_profiler();
+        export_to(flamegraph_path, [&](std::ostream& out) { write_collapsed_stacks(profiler, out); });
+        export_to(pprof_path, [&](std::ostream& out) { write_pprof(profiler, out); });
+        export_to(trace_path, [&](std::ostream& out) { write_chrome_trace(profiler, out); });
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
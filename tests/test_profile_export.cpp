@@ -0,0 +1,255 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "profile_export.h"
+#include "timing_model.h"
+#include "test_util.h"
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+// Call-path profiles and their exports: a program calling a leaf twice
+// and recursing three deep must give the same call paths in block and
+// single-step execution and while sampling, and the flamegraph, pprof
+// and Chrome trace outputs must carry them.
+
+static const std::vector<uint32_t> kProgram = {
+    // _start (0x1000)
+    0x00300513,  // ADDI a0, zero, 3
+    0x01C000EF,  // JAL  ra, leaf
+    0x018000EF,  // JAL  ra, leaf
+    0x00200513,  // ADDI a0, zero, 2
+    0x020000EF,  // JAL  ra, rec
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073,  // ECALL                   # exit
+    0x00000013,  // NOP
+    // leaf (0x1020)
+    0x00158593,  // ADDI a1, a1, 1
+    0x00158593,  // ADDI a1, a1, 1
+    0x00008067,  // RET
+    0x00000013,  // NOP
+    // rec (0x1030)
+    0x00050E63,  // BEQ  a0, zero, done
+    0xFF010113,  // ADDI sp, sp, -16
+    0x00112023,  // SW   ra, 0(sp)
+    0xFFF50513,  // ADDI a0, a0, -1
+    0xFF1FF0EF,  // JAL  ra, rec
+    0x00012083,  // LW   ra, 0(sp)
+    0x01010113,  // ADDI sp, sp, 16
+    0x00008067   // done: RET
+};
+
+static const char* const kStacks =
+    "_start 7\n"
+    "_start;leaf 6\n"
+    "_start;rec 8\n"
+    "_start;rec;rec 8\n"
+    "_start;rec;rec;rec 2\n";
+
+static SymbolTable make_symbols() {
+    SymbolTable symbols;
+    symbols.add(0x1000, 0x20, "_start");
+    symbols.add(0x1020, 0x10, "leaf");
+    symbols.add(0x1030, 0x20, "rec");
+    symbols.finalize();
+    return symbols;
+}
+
+enum class Mode { RUN, STEP, SAMPLED };
+
+static void run_program(Interpreter& interp, CPU& cpu, Mode mode) {
+    interp.get_profiler().set_symbols(make_symbols());
+    if (mode == Mode::SAMPLED) {
+        interp.get_profiler().set_sampling(3);
+    }
+    cpu.load_program(to_bytes(kProgram), 0x1000);
+    cpu.set_register(2, 0x8000);
+    if (mode == Mode::STEP) {
+        while (interp.step().reason == StopReason::NONE) {
+        }
+    } else {
+        interp.run();
+    }
+}
+
+static std::string collapsed(const Profiler& profiler, StackWeight weight = StackWeight::INSTRUCTIONS) {
+    std::ostringstream out;
+    write_collapsed_stacks(profiler, out, weight);
+    return out.str();
+}
+
+static size_t count_of(const std::string& text, const std::string& what) {
+    size_t count = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) {
+        count++;
+    }
+    return count;
+}
+
+// Just enough protobuf decoding to read the profile back
+struct ProtoField {
+    uint32_t number;
+    uint64_t value;       // Varint fields
+    std::string payload;  // Length-delimited fields
+};
+
+static uint64_t read_varint(const std::string& data, size_t& at) {
+    uint64_t value = 0;
+    for (int shift = 0; at < data.size(); shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(data[at++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    return value;
+}
+
+static std::vector<ProtoField> read_fields(const std::string& data) {
+    std::vector<ProtoField> fields;
+    size_t at = 0;
+    while (at < data.size()) {
+        uint64_t key = read_varint(data, at);
+        ProtoField field{static_cast<uint32_t>(key >> 3), 0, ""};
+        if ((key & 7) == 2) {
+            size_t length = read_varint(data, at);
+            field.payload = data.substr(at, length);
+            at += length;
+        } else {
+            field.value = read_varint(data, at);
+        }
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+static std::string gunzip(const std::string& data) {
+    z_stream stream = {};
+    inflateInit2(&stream, 15 + 16);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    std::string output;
+    char buffer[4096];
+    int status = Z_OK;
+    while (status == Z_OK) {
+        stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        stream.avail_out = sizeof(buffer);
+        status = inflate(&stream, Z_NO_FLUSH);
+        output.append(buffer, sizeof(buffer) - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    return status == Z_STREAM_END ? output : "";
+}
+
+int main() {
+    std::cout << "=== RISC-V Profile Export Test ===" << std::endl;
+    bool ok = true;
+
+    for (Mode mode : {Mode::RUN, Mode::STEP, Mode::SAMPLED}) {
+        const char* mode_name[] = {"run", "step", "sampled"};
+        std::cout << "\n[Call paths, " << mode_name[static_cast<int>(mode)] << "]" << std::endl;
+        CPU cpu;
+        Interpreter interp(cpu);
+        run_program(interp, cpu, mode);
+        ok &= check(collapsed(interp.get_profiler()) == kStacks, "collapsed stacks");
+    }
+
+    std::cout << "\n[Cycles]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.set_timing_model(std::make_unique<PipelineModel>());
+        run_program(interp, cpu, Mode::RUN);
+        uint64_t total = 0;
+        std::istringstream lines(collapsed(interp.get_profiler(), StackWeight::CYCLES));
+        for (std::string line; std::getline(lines, line);) {
+            total += std::stoull(line.substr(line.rfind(' ') + 1));
+        }
+        ok &= check(total == interp.get_cycles() && total > 31, "cycles by call path add up");
+
+        std::ostringstream pprof;
+        write_pprof(interp.get_profiler(), pprof);
+        std::string profile = gunzip(pprof.str());
+        ok &= check(!profile.empty(), "pprof is gzipped");
+
+        std::vector<std::string> strings;
+        std::vector<std::vector<uint64_t>> samples;
+        size_t types = 0, locations = 0, functions = 0;
+        for (const ProtoField& field : read_fields(profile)) {
+            if (field.number == 1) {
+                types++;
+            } else if (field.number == 2) {
+                for (const ProtoField& sample_field : read_fields(field.payload)) {
+                    if (sample_field.number == 2) {
+                        std::vector<uint64_t> values;
+                        for (size_t at = 0; at < sample_field.payload.size();) {
+                            values.push_back(read_varint(sample_field.payload, at));
+                        }
+                        samples.push_back(values);
+                    }
+                }
+            } else if (field.number == 4) {
+                locations++;
+            } else if (field.number == 5) {
+                functions++;
+            } else if (field.number == 6) {
+                strings.push_back(field.payload);
+            }
+        }
+        uint64_t instructions = 0, cycles = 0;
+        for (const auto& values : samples) {
+            instructions += values.size() == 2 ? values[0] : 0;
+            cycles += values.size() == 2 ? values[1] : 0;
+        }
+        ok &= check(types == 2 && samples.size() == 5 && locations == 3 && functions == 3,
+                    "pprof: two sample types, five paths, three functions");
+        ok &= check(instructions == 31 && cycles == interp.get_cycles(), "pprof: sample values add up");
+        ok &= check(!strings.empty() && strings[0].empty() && count_of(profile, "leaf") == 1 &&
+                    count_of(profile, "instructions") == 1, "pprof: string table");
+    }
+
+    std::cout << "\n[Chrome trace]" << std::endl;
+    for (size_t limit : {size_t(1000), size_t(3)}) {
+        CPU cpu;
+        Interpreter interp(cpu);
+        interp.get_profiler().set_call_trace_limit(limit);
+        run_program(interp, cpu, Mode::RUN);
+        std::ostringstream out;
+        write_chrome_trace(interp.get_profiler(), out);
+        std::string trace = out.str();
+        size_t begins = count_of(trace, "\"ph\":\"B\"");
+        size_t ends = count_of(trace, "\"ph\":\"E\"");
+        if (limit == 3) {
+            ok &= check(interp.get_profiler().is_call_trace_truncated() && begins == 2 && ends == 2,
+                        "truncated trace closes its open frames");
+            continue;
+        }
+        ok &= check(!interp.get_profiler().is_call_trace_truncated() && begins == 6 && ends == 6,
+                    "a begin and an end per frame");
+        ok &= check(trace.find("{\"name\":\"_start\",\"ph\":\"B\",\"ts\":0,") != std::string::npos &&
+                    trace.find("{\"name\":\"leaf\",\"ph\":\"B\",\"ts\":2,") != std::string::npos &&
+                    trace.find("{\"name\":\"leaf\",\"ph\":\"E\",\"ts\":5,") != std::string::npos &&
+                    trace.find("{\"name\":\"_start\",\"ph\":\"E\",\"ts\":31,") != std::string::npos,
+                    "timestamps in instructions");
+    }
+
+    std::cout << "\n[No calls]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        cpu.load_program(to_bytes({0x05D00893, 0x00000073}), 0x1000);  // exit
+        interp.run();
+        ok &= check(collapsed(interp.get_profiler()) == "[unknown] 2\n", "outside any frame");
+        interp.get_profiler().reset();
+        ok &= check(collapsed(interp.get_profiler()).empty(), "reset clears call paths");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Call paths export to flamegraph, pprof and Chrome trace!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Profile export test failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,191 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Per-PC counts from the dense text-range counters and from the hash
+// fallback: a loop in the text range calls a routine outside it, and
+// block and single-step execution, with and without a text range, must
+// give the same counts. Sampled profiles must estimate a tight loop's
+// counts even when the mean period divides the loop length.
+
+static const std::vector<uint32_t> kProgram = {
+    0x00A00513,  // ADDI a0, zero, 10
+    0x7FD060EF,  // loop: JAL ra, 0x8000
+    0xFFF50513,  // ADDI a0, a0, -1
+    0xFE051CE3,  // BNE  a0, zero, loop
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit
+};
+
+static const std::vector<uint32_t> kRoutine = {
+    0x00158593,  // ADDI a1, a1, 1
+    0x00008067   // RET
+};
+
+// 2000 iterations of a 4-instruction loop at 0x1008
+static const std::vector<uint32_t> kTightLoop = {
+    0x00000513,  // ADDI a0, zero, 0
+    0x7D000593,  // ADDI a1, zero, 2000
+    0x00150513,  // loop: ADDI a0, a0, 1
+    0x00360613,  // ADDI a2, a2, 3
+    0x00C6C6B3,  // XOR  a3, a3, a2
+    0xFEB54AE3,  // BLT  a0, a1, loop
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073   // ECALL                   # exit
+};
+
+static const std::map<uint32_t, uint64_t> kExpected = {
+    {0x1000, 1},  {0x1004, 10}, {0x1008, 10}, {0x100C, 10}, {0x1010, 1}, {0x1014, 1},
+    {0x8000, 10}, {0x8004, 10},
+};
+
+static std::map<uint32_t, uint64_t> counts_of(const Profiler& profiler) {
+    std::map<uint32_t, uint64_t> counts;
+    profiler.for_each_instruction_count([&](uint32_t pc, uint64_t count) { counts[pc] += count; });
+    return counts;
+}
+
+// Load the program (text range over the loop only) and the routine
+static void load(CPU& cpu, bool text_range) {
+    std::vector<uint8_t> routine = to_bytes(kRoutine);
+    cpu.write_bytes(0x8000, routine.data(), routine.size());
+    cpu.load_program(to_bytes(kProgram), 0x1000);
+    if (!text_range) {
+        cpu.set_text_range(0, 0);
+    }
+}
+
+int main() {
+    std::cout << "=== RISC-V Profiler Counter Test ===" << std::endl;
+    bool ok = true;
+
+    for (bool text_range : {true, false}) {
+        for (bool single_step : {false, true}) {
+            std::cout << "\n[" << (text_range ? "Text range" : "Fallback only") << ", "
+                      << (single_step ? "step" : "run") << "]" << std::endl;
+            CPU cpu;
+            Interpreter interp(cpu);
+            load(cpu, text_range);
+            ExecResult result;
+            if (single_step) {
+                do {
+                    result = interp.step();
+                } while (result.reason == StopReason::NONE);
+            } else {
+                result = interp.run();
+            }
+            const Profiler& profiler = interp.get_profiler();
+            ok &= check(result.reason == StopReason::EXIT && profiler.get_total_instructions() == 53,
+                        "program ran");
+            ok &= check(counts_of(profiler) == kExpected, "per-PC counts");
+            ok &= check(profiler.get_instruction_count(0x1008) == 10 && profiler.get_instruction_count(0x8004) == 10 &&
+                        profiler.get_instruction_count(0x1018) == 0, "single PC lookups");
+            ok &= check(profiler.get_unique_instructions() == 8, "unique PCs");
+
+            auto hot = profiler.get_hot_instructions(3);
+            ok &= check(hot.size() == 3 && hot[0].pc == 0x1004 && hot[1].pc == 0x1008 && hot[2].pc == 0x100C &&
+                        hot[2].count == 10, "top 3, ties by address");
+            ok &= check(profiler.get_hot_instructions(100).size() == 8 &&
+                        profiler.get_hot_instructions(0).empty(), "top N bounds");
+            ok &= check(profiler.detect_hot_loops(10) == std::vector<uint32_t>{0x1004}, "hot loop around the call");
+        }
+    }
+
+    std::cout << "\n[Range set mid-profile]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        load(cpu, false);
+        interp.run(20);
+        uint64_t early = interp.get_profiler().get_instruction_count(0x1008);
+        cpu.set_text_range(0x1000, 0x9000);  // Now covers the routine too
+        ExecResult result = interp.run();
+        ok &= check(result.reason == StopReason::EXIT, "program ran");
+        ok &= check(early > 0 && early < 10 && interp.get_profiler().get_instruction_count(0x1008) == 10 &&
+                    interp.get_profiler().get_instruction_count(0x8004) == 10, "lookups follow later records");
+        ok &= check(counts_of(interp.get_profiler()) == kExpected, "earlier counts carried over");
+        ok &= check(interp.get_profiler().detect_hot_loops(10) == std::vector<uint32_t>{0x1004},
+                    "earlier edges carried over");
+    }
+
+    std::cout << "\n[Reset and disable]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        load(cpu, true);
+        interp.run(20);
+        Profiler& profiler = interp.get_profiler();
+        bool counted = profiler.get_instruction_count(0x1004) != 0;
+        profiler.reset();
+        ok &= check(profiler.get_total_instructions() == 0 && counts_of(profiler).empty(), "reset clears counts");
+        ok &= check(counted && profiler.get_instruction_count(0x1004) == 0, "reset clears single PC lookups");
+        profiler.disable_profiling();
+        interp.run();
+        ok &= check(counts_of(profiler).empty(), "nothing recorded while disabled");
+    }
+
+    for (bool single_step : {false, true}) {
+        for (uint32_t period : {4u, 64u}) {
+            std::cout << "\n[Sampling 1 in ~" << period << ", " << (single_step ? "step" : "run") << "]"
+                      << std::endl;
+            CPU cpu;
+            Interpreter interp(cpu);
+            cpu.load_program(to_bytes(kTightLoop), 0x1000);
+            Profiler& profiler = interp.get_profiler();
+            profiler.set_sampling(period, 7);
+            ExecResult result;
+            if (single_step) {
+                do {
+                    result = interp.step();
+                } while (result.reason == StopReason::NONE);
+            } else {
+                result = interp.run();
+            }
+            ok &= check(result.reason == StopReason::EXIT && profiler.get_total_instructions() == 8004,
+                        "exact instruction total");
+            uint64_t expected_samples = 8004 / period;
+            ok &= check(profiler.get_sample_count() > expected_samples * 9 / 10 &&
+                        profiler.get_sample_count() < expected_samples * 11 / 10, "about one sample per period");
+
+            auto hot = profiler.get_hot_instructions(4);
+            bool loop_pcs = hot.size() == 4;
+            for (const ProfileEntry& entry : hot) {
+                loop_pcs &= entry.pc >= 0x1008 && entry.pc <= 0x1014;
+            }
+            ok &= check(loop_pcs, "hottest PCs are the loop body");
+            if (period == 4) {
+                bool close = true;
+                for (uint32_t pc = 0x1008; pc <= 0x1014; pc += 4) {
+                    uint64_t estimate = profiler.get_instruction_count(pc);
+                    close &= estimate > 1700 && estimate < 2300;
+                }
+                ok &= check(close, "every loop PC estimated within 15% despite period dividing the loop");
+            }
+        }
+    }
+
+    std::cout << "\n[Back to exact counting]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        load(cpu, true);
+        Profiler& profiler = interp.get_profiler();
+        profiler.set_sampling(16);
+        interp.run(20);
+        profiler.set_sampling(0);
+        ok &= check(!profiler.is_sampling() && profiler.get_total_instructions() == 0, "mode change clears");
+        load(cpu, true);
+        interp.run();
+        ok &= check(counts_of(profiler) == kExpected, "exact counts");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Dense and fallback counters agree!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Profiler counter test failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,98 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+// Snapshot a loaded program, run it, restore and run it again with a
+// different input. Restore must undo data writes, writes to pages that
+// did not exist at snapshot time and self-modified code, and it should
+// only touch the pages the run dirtied.
+
+static bool run_backend(MemoryBackend backend) {
+    bool ok = true;
+    MemoryConfig config;
+    config.backend = backend;
+    CPU cpu(config);
+    Interpreter interp(cpu);
+
+    std::vector<uint32_t> program = {
+        0x000032B7,  // LUI  t0, 0x3            # input/output at 0x3000
+        0x0002A503,  // LW   a0, 0(t0)
+        0x00A2A223,  // SW   a0, 4(t0)
+        0x00005337,  // LUI  t1, 0x5            # page absent at snapshot
+        0x00A32023,  // SW   a0, 0(t1)
+        0x00A00E93,  // ADDI t4, zero, 10
+        0x01D51863,  // BNE  a0, t4, +16        # patch only for input 10
+        0x0082AE03,  // LW   t3, 8(t0)
+        0x000013B7,  // LUI  t2, 0x1
+        0x03C3A423,  // SW   t3, 40(t2)         # patch 0x1028
+        0x00150513,  // ADDI a0, a0, 1          # becomes ADDI a0, a0, 100
+        0x05D00893,  // ADDI a7, zero, 93
+        0x00000073   // ECALL                   # exit(a0)
+    };
+    cpu.load_program(to_bytes(program), 0x1000);
+    cpu.write_word(0x3008, 0x06450513);     // ADDI a0, a0, 100
+    cpu.set_register(2, cpu.get_stack_top());
+
+    interp.take_snapshot();
+    ok &= check(cpu.has_snapshot(), "snapshot taken");
+    ok &= check(cpu.get_memory().get_snapshot_pages() == 2, "only non-zero pages copied");
+
+    // Host-MMU: committed like a brk/mmap syscall during the run would
+    cpu.commit_memory(0x5000, PAGE_SIZE);
+    cpu.write_word(0x3000, 10);
+    ExecResult result = interp.run();
+    ok &= check(result.reason == StopReason::EXIT && result.exit_code == 110, "first run patched itself");
+    ok &= check(cpu.get_memory().get_dirty_pages().size() == 3, "three pages dirtied");
+
+    interp.restore_snapshot();
+    ok &= check(cpu.get_memory().get_dirty_pages().empty(), "restore leaves nothing dirty");
+    ok &= check(cpu.get_pc() == 0x1000 && cpu.get_register(10) == 0, "registers and PC restored");
+    ok &= check(cpu.get_register(2) == cpu.get_stack_top(), "sp restored");
+    ok &= check(interp.get_instructions_executed() == 0, "instruction count restored");
+    ok &= check(cpu.read_word(0x3004) == 0 && cpu.read_word(0x5000) == 0, "data writes undone");
+    ok &= check(cpu.read_word(0x1028) == 0x00150513, "code restored");
+
+    cpu.write_word(0x3000, 20);
+    result = interp.run();
+    ok &= check(result.reason == StopReason::EXIT && result.exit_code == 21,
+                "second run executes the restored code");
+    ok &= check(cpu.read_word(0x5000) == 20, "fresh page written again");
+    ok &= check(cpu.get_memory().get_dirty_pages().size() == 2, "no code page dirtied without the patch");
+
+    // Restoring twice in a row is harmless
+    interp.restore_snapshot();
+    interp.restore_snapshot();
+    cpu.write_word(0x3000, 10);
+    result = interp.run();
+    ok &= check(result.exit_code == 110, "runs stay independent");
+    return ok;
+}
+
+int main() {
+    std::cout << "=== RISC-V Snapshot Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[Paged memory]" << std::endl;
+    ok &= run_backend(MemoryBackend::PAGED);
+
+    std::cout << "\n[Host-MMU memory]" << std::endl;
+    ok &= run_backend(MemoryBackend::HOST_MMU);
+
+    CPU fresh;
+    bool threw = false;
+    try {
+        fresh.restore_snapshot();
+    } catch (const std::logic_error&) {
+        threw = true;
+    }
+    ok &= check(threw, "restore without a snapshot throws");
+
+    if (ok) {
+        std::cout << "\n✅ Snapshots restore only what a run dirtied!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Snapshot test failed" << std::endl;
+    return 1;
+}
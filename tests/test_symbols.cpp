@@ -0,0 +1,209 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "elf_loader.h"
+#include "test_util.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Symbols from a synthetic ELF's .symtab/.strtab, and the profile rolled
+// up into functions: _start calls leaf twice and rec(2), which recurses
+// down to rec(0). Block and single-step execution must agree.
+
+static const std::vector<uint32_t> kProgram = {
+    // _start (0x1000)
+    0x00300513,  // ADDI a0, zero, 3
+    0x01C000EF,  // JAL  ra, leaf
+    0x018000EF,  // JAL  ra, leaf
+    0x00200513,  // ADDI a0, zero, 2
+    0x020000EF,  // JAL  ra, rec
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073,  // ECALL                   # exit
+    0x00000013,  // NOP
+    // leaf (0x1020)
+    0x00158593,  // ADDI a1, a1, 1
+    0x00158593,  // ADDI a1, a1, 1
+    0x00008067,  // RET
+    0x00000013,  // NOP
+    // rec (0x1030)
+    0x00050E63,  // BEQ  a0, zero, done
+    0xFF010113,  // ADDI sp, sp, -16
+    0x00112023,  // SW   ra, 0(sp)
+    0xFFF50513,  // ADDI a0, a0, -1
+    0xFF1FF0EF,  // JAL  ra, rec
+    0x00012083,  // LW   ra, 0(sp)
+    0x01010113,  // ADDI sp, sp, 16
+    0x00008067   // done: RET
+};
+
+static const uint32_t kTextOffset = 0x1000, kTextAddr = 0x1000;
+static const uint32_t kSymtabOffset = 0x1100, kStrtabOffset = 0x1200, kSectionsOffset = 0x1300;
+
+static void put16(std::vector<uint8_t>& out, size_t at, uint16_t value) {
+    out[at] = value & 0xFF;
+    out[at + 1] = value >> 8;
+}
+
+static void put32(std::vector<uint8_t>& out, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out[at + i] = (value >> (8 * i)) & 0xFF;
+    }
+}
+
+static std::vector<uint8_t> build_elf(bool stripped) {
+    std::vector<uint8_t> file(kSectionsOffset + 4 * 40);
+    const uint32_t text_size = kProgram.size() * 4;
+
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::copy(ident, ident + 16, file.begin());
+    put16(file, 16, 2);             // ET_EXEC
+    put16(file, 18, 0xF3);          // EM_RISCV
+    put32(file, 20, 1);
+    put32(file, 24, kTextAddr);     // e_entry
+    put32(file, 28, 52);            // e_phoff
+    put32(file, 32, stripped ? 0 : kSectionsOffset);
+    put16(file, 40, 52);
+    put16(file, 42, 32);
+    put16(file, 44, 1);             // e_phnum
+    put16(file, 46, 40);            // e_shentsize
+    put16(file, 48, stripped ? 0 : 4);
+
+    const uint32_t phdr[8] = {1, kTextOffset, kTextAddr, kTextAddr, text_size, text_size, 5, 0x1000};
+    for (int f = 0; f < 8; f++) {
+        put32(file, 52 + f * 4, phdr[f]);
+    }
+    for (size_t i = 0; i < kProgram.size(); i++) {
+        put32(file, kTextOffset + i * 4, kProgram[i]);
+    }
+
+    // String table, then symbols: {name, value, size, type, section}
+    const std::string strings = std::string("\0$x\0_start\0leaf\0rec\0counter\0_end\0", 33);
+    std::copy(strings.begin(), strings.end(), file.begin() + kStrtabOffset);
+    const uint32_t symbols[][5] = {
+        {0,  0,      0,    0, 0},   // null symbol
+        {1,  0x1000, 0,    0, 1},   // $x mapping symbol
+        {4,  0x1000, 0x20, 2, 1},   // _start (FUNC)
+        {11, 0x1020, 0x10, 2, 1},   // leaf (FUNC)
+        {16, 0x1030, 0,    0, 1},   // rec (label, no size)
+        {20, 0x2000, 4,    1, 1},   // counter (OBJECT)
+        {28, 0x2000, 0,    0, 1},   // _end (label past the section)
+    };
+    const size_t symbol_count = sizeof(symbols) / sizeof(symbols[0]);
+    for (size_t i = 0; i < symbol_count; i++) {
+        size_t at = kSymtabOffset + i * 16;
+        put32(file, at, symbols[i][0]);
+        put32(file, at + 4, symbols[i][1]);
+        put32(file, at + 8, symbols[i][2]);
+        file[at + 12] = static_cast<uint8_t>(symbols[i][3] | 0x10);  // STB_GLOBAL
+        put16(file, at + 14, static_cast<uint16_t>(symbols[i][4]));
+    }
+
+    // Sections: null, .text, .symtab (linked to 3), .strtab
+    const uint32_t sections[4][10] = {
+        {0, 0, 0, 0,         0,             0,                0,               0, 0, 0},
+        {0, 1, 6, kTextAddr, kTextOffset,   text_size,        0,               0, 4, 0},
+        {0, 2, 0, 0,         kSymtabOffset, static_cast<uint32_t>(symbol_count * 16), 3, 1, 4, 16},
+        {0, 3, 0, 0,         kStrtabOffset, static_cast<uint32_t>(strings.size()),    0, 0, 1, 0},
+    };
+    for (int s = 0; s < 4; s++) {
+        for (int f = 0; f < 10; f++) {
+            put32(file, kSectionsOffset + s * 40 + f * 4, sections[s][f]);
+        }
+    }
+    return file;
+}
+
+static void write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static const FunctionProfile* find_function(const std::vector<FunctionProfile>& profile, const char* name) {
+    for (const FunctionProfile& function : profile) {
+        if (function.name == name) {
+            return &function;
+        }
+    }
+    return nullptr;
+}
+
+static bool check_profile(const Profiler& profiler) {
+    bool ok = true;
+    auto profile = profiler.get_function_profile();
+    const FunctionProfile* start = find_function(profile, "_start");
+    const FunctionProfile* leaf = find_function(profile, "leaf");
+    const FunctionProfile* rec = find_function(profile, "rec");
+    ok &= check(profile.size() == 3 && start && leaf && rec, "three functions");
+    if (!ok) {
+        return false;
+    }
+    ok &= check(profile[0].name == "rec", "hottest function first");
+    ok &= check(start->calls == 0 && start->exclusive == 7 && start->inclusive == 31,
+                "_start: 7 own, 31 with callees");
+    ok &= check(leaf->calls == 2 && leaf->exclusive == 6 && leaf->inclusive == 6, "leaf: 2 calls, 6 own");
+    ok &= check(rec->calls == 3 && rec->exclusive == 18 && rec->inclusive == 18,
+                "rec: recursion counted once");
+    return ok;
+}
+
+int main() {
+    std::cout << "=== RISC-V Symbol Profile Test ===" << std::endl;
+    bool ok = true;
+
+    std::cout << "\n[Symbol table]" << std::endl;
+    SymbolTable table;
+    table.add(0x100, 0, "label");
+    table.add(0x100, 0x10, "func");
+    table.add(0x200, 0, "tail");
+    table.add(0x180, 0x40, "next");
+    table.finalize();
+    ok &= check(table.size() == 3, "duplicate address dropped");
+    ok &= check(table.lookup(0x104) && table.lookup(0x104)->name == "func", "sized symbol wins an address");
+    ok &= check(table.lookup(0x110) == nullptr, "gap after a sized symbol");
+    ok &= check(table.lookup(0x1BC) && table.lookup(0x1BC)->name == "next", "lookup inside a range");
+    ok &= check(table.lookup(0x200) == nullptr, "trailing zero-sized symbol covers nothing");
+    ok &= check(table.describe(0x188) == "next+0x8" && table.describe(0x50) == "0x50", "describe");
+
+    std::cout << "\n[ELF symbols]" << std::endl;
+    const std::string path = "test_symbols.tmp.elf";
+    write_file(path, build_elf(false));
+    SymbolTable symbols = ELFLoader::read_symbols(path);
+    ok &= check(symbols.size() == 3, "functions and code labels only");
+    ok &= check(symbols.find("$x") == nullptr && symbols.find("counter") == nullptr &&
+                symbols.find("_end") == nullptr, "mapping, data and out-of-section symbols skipped");
+    const Symbol* rec = symbols.find("rec");
+    ok &= check(rec && rec->start == 0x1030 && rec->size == 0x20, "label runs to section end");
+    ok &= check(symbols.describe(0x1044) == "rec+0x14" && symbols.describe(0x102C) == "leaf+0xc",
+                "PCs map back to functions");
+
+    for (bool single_step : {false, true}) {
+        std::cout << (single_step ? "\n[Function profile: step]" : "\n[Function profile: run]") << std::endl;
+        CPU cpu;
+        Interpreter interp(cpu);
+        ELFLoader::load(path, cpu);
+        interp.get_profiler().set_symbols(symbols);
+        ExecResult result;
+        if (single_step) {
+            do {
+                result = interp.step();
+            } while (result.reason == StopReason::NONE);
+        } else {
+            result = interp.run();
+        }
+        ok &= check(result.reason == StopReason::EXIT && interp.get_instructions_executed() == 31, "program ran");
+        ok &= check_profile(interp.get_profiler());
+    }
+
+    std::cout << "\n[Stripped ELF]" << std::endl;
+    write_file(path, build_elf(true));
+    ok &= check(ELFLoader::read_symbols(path).empty(), "no section headers, no symbols");
+    std::remove(path.c_str());
+
+    if (ok) {
+        std::cout << "\n✅ Profiles roll up into functions!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Symbol profile test failed" << std::endl;
+    return 1;
+}
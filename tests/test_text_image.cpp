@@ -0,0 +1,92 @@
+#include "cpu.h"
+#include "decoder.h"
+#include "interpreter.h"
+#include "text_image.h"
+#include "test_util.h"
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Every bulk-decode path must agree with Decoder::predecode, and a CPU
+// with a text image must run without decoding and still see code writes.
+
+static bool matches_predecode(const TextImage& image, const std::vector<uint32_t>& words) {
+    for (size_t i = 0; i < words.size(); i++) {
+        DecodedInstruction expected = Decoder::predecode(words[i]);
+        DecodedInstruction actual;
+        if (!image.lookup(image.get_base() + static_cast<uint32_t>(i * 4), actual) ||
+            actual.op != expected.op || actual.imm != expected.imm || actual.rd != expected.rd ||
+            actual.rs1 != expected.rs1 || actual.rs2 != expected.rs2) {
+            std::cout << "    mismatch at word " << i << " (0x" << std::hex << words[i]
+                      << std::dec << ")" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    std::cout << "=== RISC-V Text Image Test ===" << std::endl;
+    bool ok = true;
+
+    // Random words hit illegal and rare encodings; real-looking words
+    // (low bits 11) cover every row. Odd length exercises the tails.
+    std::mt19937 rng(7);
+    std::vector<uint32_t> words(4099);
+    for (size_t i = 0; i < words.size(); i++) {
+        words[i] = (i % 3 == 0) ? rng() : (rng() | 0x3);
+    }
+
+    std::cout << "\n[Bulk decode] best path: " << TextImage::path_name(TextImage::best_path()) << std::endl;
+    const TextImage::Path paths[] = {TextImage::Path::SCALAR, TextImage::Path::SSE2, TextImage::Path::AVX2};
+    for (TextImage::Path path : paths) {
+        if (path == TextImage::Path::AVX2 && TextImage::best_path() != TextImage::Path::AVX2) {
+            continue;
+        }
+        TextImage image(0x1000, words.data(), words.size(), path);
+        std::string what = std::string(TextImage::path_name(path)) + " matches predecode";
+        ok &= check(matches_predecode(image, words), what.c_str());
+    }
+
+    // Self-modifying loop from test_decode_cache, run from a text image
+    std::vector<uint32_t> program = {
+        0x00001337,  // LUI  x6, 1            # x6 = 0x1000
+        0x02A002B7,  // LUI  x5, 0x2A00
+        0x19328293,  // ADDI x5, x5, 403      # x5 = 0x02A00193
+        0x00100193,  // ADDI x3, x0, 1        # patched below
+        0x00021863,  // BNE  x4, x0, 16
+        0x00532623,  // SW   x5, 12(x6)
+        0x00100213,  // ADDI x4, x0, 1
+        0xFF1FF06F   // JAL  x0, -16
+    };
+
+    std::cout << "\n[Execution] single-step from the image" << std::endl;
+    CPU cpu;
+    Interpreter interp(cpu);
+    cpu.load_program(to_bytes(program), 0x1000);
+    cpu.predecode_text(0x1000, static_cast<uint32_t>(program.size() * 4));
+    for (int i = 0; i < 5; i++) {
+        interp.step();
+    }
+    ok &= check(interp.get_decode_cache().get_decodes() == 0, "no decodes before the store");
+    ok &= check(interp.get_decode_cache().get_image_fetches() == 5, "fetched from the image");
+    for (int i = 0; i < 4; i++) {
+        interp.step();
+    }
+    ok &= check(cpu.get_register(3) == 42, "store into the image is seen");
+
+    std::cout << "\n[Execution] block mode from the image" << std::endl;
+    CPU block_cpu;
+    Interpreter block_interp(block_cpu);
+    block_cpu.load_program(to_bytes(program), 0x1000);
+    block_cpu.predecode_text(0x1000, static_cast<uint32_t>(program.size() * 4));
+    block_interp.run(100);
+    ok &= check(block_cpu.get_register(3) == 42, "patched instruction executed");
+
+    if (ok) {
+        std::cout << "\n✅ Text image decodes match and stay coherent!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Text image test failed" << std::endl;
+    return 1;
+}
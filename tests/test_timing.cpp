@@ -0,0 +1,125 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "timing_model.h"
+#include "test_util.h"
+#include <iostream>
+#include <memory>
+#include <vector>
+
+// Cycle estimates from the latency-table and pipeline timing models on
+// a short program with load-use pairs, taken and untaken branches, a
+// call, a return and an ECALL. Block and single-step execution, with
+// and without superinstructions, must charge the same cycles.
+
+static const std::vector<uint32_t> kProgram = {
+    0x00300293,  // ADDI t0, zero, 3
+    0x00002437,  // LUI  s0, 0x2
+    0x00042503,  // loop: LW a0, 0(s0)
+    0x00150513,  // ADDI a0, a0, 1           # uses the load
+    0x00A42023,  // SW   a0, 0(s0)
+    0xFFF28293,  // ADDI t0, t0, -1
+    0xFE0298E3,  // BNE  t0, zero, loop
+    0x00C000EF,  // JAL  ra, func
+    0x05D00893,  // ADDI a7, zero, 93
+    0x00000073,  // ECALL                    # exit
+    0x00042583,  // func: LW a1, 0(s0)
+    0x00008067   // RET
+};
+
+// 22 instructions. Latency table defaults:
+//   ADDI, LUI                          1 + 1
+//   3 x (LW 2, ADDI 1, SW 1, ADDI 1)   15
+//   BNE taken, taken, not taken        3 + 3 + 1
+//   JAL 2, LW 2, RET 2, ADDI 1, ECALL 5
+static const uint64_t kLatencyCycles = 36;
+
+// Pipeline defaults: one cycle each, plus the fill (4) on the first
+// instruction, a load-use stall per iteration (3), two taken branches
+// (2 + 2), JAL (1), JALR (2) and the ECALL drain (4)
+static const uint64_t kPipelineCycles = 40;
+
+static ExecResult run(Interpreter& interp, bool single_step) {
+    ExecResult result;
+    if (single_step) {
+        do {
+            result = interp.step();
+        } while (result.reason == StopReason::NONE);
+    } else {
+        result = interp.run();
+    }
+    return result;
+}
+
+static std::unique_ptr<TimingModel> make_model(bool pipeline) {
+    if (pipeline) {
+        return std::make_unique<PipelineModel>();
+    }
+    return std::make_unique<LatencyModel>();
+}
+
+int main() {
+    std::cout << "=== RISC-V Timing Model Test ===" << std::endl;
+    bool ok = true;
+
+    for (bool pipeline : {false, true}) {
+        for (int mode = 0; mode < 3; mode++) {
+            const char* mode_name[] = {"run", "run, no fusion", "step"};
+            std::cout << "\n[" << (pipeline ? "Pipeline" : "Latency table") << ", " << mode_name[mode] << "]"
+                      << std::endl;
+            CPU cpu;
+            Interpreter interp(cpu);
+            interp.get_block_cache().set_fusion_enabled(mode != 1);
+            cpu.load_program(to_bytes(kProgram), 0x1000);
+            interp.set_timing_model(make_model(pipeline));
+            ExecResult result = run(interp, mode == 2);
+            const Profiler& profiler = interp.get_profiler();
+            const uint64_t expected = pipeline ? kPipelineCycles : kLatencyCycles;
+
+            ok &= check(result.reason == StopReason::EXIT && interp.get_instructions_executed() == 22,
+                        "program ran");
+            ok &= check(interp.get_cycles() == expected, "total cycles");
+            ok &= check(profiler.get_total_cycles() == expected, "profiled cycles");
+            ok &= check(profiler.get_cycles(0x1000) == (pipeline ? 5u : 1u) &&
+                        profiler.get_cycles(0x100C) == (pipeline ? 6u : 3u) &&
+                        profiler.get_cycles(0x1018) == 7 &&
+                        profiler.get_cycles(0x102C) == (pipeline ? 3u : 2u), "per-PC cycles");
+
+            auto hot = profiler.get_hot_instructions(1);
+            ok &= check(hot.size() == 1 && hot[0].total_cycles == profiler.get_cycles(hot[0].pc),
+                        "hot instructions carry cycles");
+        }
+    }
+
+    std::cout << "\n[Snapshot restore]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        interp.set_timing_model(std::make_unique<PipelineModel>());
+        interp.take_snapshot();
+        interp.run();
+        interp.restore_snapshot();
+        ok &= check(interp.get_cycles() == 0, "cycles restored");
+        interp.run();
+        ok &= check(interp.get_cycles() == kPipelineCycles, "re-run refills the pipeline");
+    }
+
+    std::cout << "\n[No timing model]" << std::endl;
+    {
+        CPU cpu;
+        Interpreter interp(cpu);
+        cpu.load_program(to_bytes(kProgram), 0x1000);
+        interp.run();
+        const Profiler& profiler = interp.get_profiler();
+        auto hot = profiler.get_hot_instructions(1);
+        ok &= check(interp.get_cycles() == 0 && profiler.get_total_cycles() == 0, "no cycles charged");
+        ok &= check(hot.size() == 1 && hot[0].total_cycles == hot[0].count, "one cycle per instruction");
+    }
+
+    if (ok) {
+        std::cout << "\n✅ Timing models charge the expected cycles!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Timing model test failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,65 @@
+#include "cpu.h"
+#include "interpreter.h"
+#include "test_util.h"
+#include <iostream>
+#include <vector>
+
+// Breakpoint, memory fault and exit come back as stop reasons, and each
+// trap leaves the CPU in a state run() can resume from.
+
+int main() {
+    std::cout << "=== RISC-V Trap Test ===" << std::endl;
+
+    std::vector<uint32_t> program = {
+        0x00100513,  // ADDI a0, zero, 1
+        0x00100073,  // EBREAK
+        0x00150513,  // ADDI a0, a0, 1
+        0x800002B7,  // LUI  t0, 0x80000        # outside guest memory
+        0x0002A303,  // LW   t1, 0(t0)
+        0x00150513,  // ADDI a0, a0, 1
+        0x05D00893,  // ADDI a7, zero, 93
+        0x00000073   // ECALL                   # exit(a0)
+    };
+
+    CPU cpu;
+    Interpreter interp(cpu);
+    cpu.load_program(to_bytes(program), 0x1000);
+    bool ok = true;
+
+    std::cout << "\n[Run 1] breakpoint" << std::endl;
+    ExecResult result = interp.run();
+    ok &= check(result.reason == StopReason::BREAKPOINT, "stopped at EBREAK");
+    ok &= check(result.pc == 0x1004, "reported EBREAK PC");
+    ok &= check(result.instructions_retired == 2, "ADDI and EBREAK retired");
+    ok &= check(cpu.get_pc() == 0x1008, "PC resumes after EBREAK");
+
+    std::cout << "\n[Run 2] memory fault" << std::endl;
+    result = interp.run();
+    ok &= check(result.reason == StopReason::MEMORY_FAULT, "stopped on LW");
+    ok &= check(result.pc == 0x1010, "reported faulting PC");
+    ok &= check(result.fault_addr == 0x80000000, "reported faulting address");
+    ok &= check(cpu.get_pc() == 0x1010, "PC stays on faulting LW");
+    ok &= check(cpu.get_register(6) == 0, "faulting LW wrote nothing");
+
+    std::cout << "\n[Run 3] fix the base register and resume" << std::endl;
+    cpu.set_register(5, 0x2000);
+    result = interp.run();
+    ok &= check(result.reason == StopReason::EXIT, "guest exited");
+    ok &= check(result.exit_code == 3, "exit code is a0");
+    ok &= check(result.instructions_retired == 4, "LW, ADDI, ADDI, ECALL retired");
+    ok &= check(interp.get_instructions_executed() == 8, "total retired");
+
+    std::cout << "\n[Step] illegal instruction" << std::endl;
+    cpu.write_word(0x3000, 0xFFFFFFFF);
+    cpu.set_pc(0x3000);
+    result = interp.step();
+    ok &= check(result.reason == StopReason::ILLEGAL_INSTRUCTION, "illegal instruction reported");
+    ok &= check(result.instructions_retired == 0 && cpu.get_pc() == 0x3000, "nothing retired");
+
+    if (ok) {
+        std::cout << "\n✅ Traps are reported without exceptions and resumable!" << std::endl;
+        return 0;
+    }
+    std::cout << "\n❌ Trap handling failed" << std::endl;
+    return 1;
+}
@@ -0,0 +1,27 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Helpers shared by the standalone test programs
+
+// Print one check's outcome and pass it through, for `ok &= check(...)`
+inline bool check(bool condition, const char* what) {
+    std::cout << (condition ? "  ok: " : "  FAILED: ") << what << std::endl;
+    return condition;
+}
+
+// Instruction words as little-endian program bytes, for load_program
+inline std::vector<uint8_t> to_bytes(const std::vector<uint32_t>& words) {
+    std::vector<uint8_t> bytes;
+    for (uint32_t word : words) {
+        for (int i = 0; i < 4; i++) {
+            bytes.push_back((word >> (8 * i)) & 0xFF);
+        }
+    }
+    return bytes;
+}
+
+#endif // TEST_UTIL_H